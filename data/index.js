@@ -13,6 +13,7 @@ const setting_mock = {
   "tzarea": "Asia",
   "tzcity": "Tokyo",
   "ntp": ["ntp.nict.jp"],
+  "serve_ntp": false,
   "elev": 0,
   "use_ambient": false,
   "ambient_channelid": 100,
@@ -134,6 +135,7 @@ function setSettingValues(setting) {
     $('#ntp2').val(setting.ntp[1]);
   if (setting.ntp.length > 2)
     $('#ntp3').val(setting.ntp[2]);
+  $('#serve-ntp').prop('checked', setting.serve_ntp);
 
   $('#elev').val(setting.elev);
 
@@ -7,6 +7,7 @@
 
 #include "BufferBase.h"
 #include "EmptyGraphics.h"
+#include "format.h"
 #include <string>
 using std::u16string;
 
@@ -18,6 +19,7 @@ namespace MAX7219 {
  * @tparam BufferWidth バッファ領域の幅
  * @tparam BufferHeight バッファ領域の高さ
  * @tparam TGraphics 文字グリフ（フォント）を Buffer に提供してくれるクラス。ユーザーが定義することを想定している。
+ * @tparam TStorage グラフィックの記憶方式（BufferBase を参照）
  * 
  * @par TGraphics について
  * @parblock
@@ -40,8 +42,8 @@ namespace MAX7219 {
  * @e TGraphics のデフォルトパラメータとして指定されている EmptyGraphics は、文字グリフを持たないダミーのクラスです。
  * @endparblock
  */
-template <size_t BufferWidth, size_t BufferHeight, class TGraphics = EmptyGraphics>
-class Buffer : public BufferBase<BufferWidth, BufferHeight> {
+template <size_t BufferWidth, size_t BufferHeight, class TGraphics = EmptyGraphics, class TStorage = RowMajorStorage<BufferWidth, BufferHeight>>
+class Buffer : public BufferBase<BufferWidth, BufferHeight, TStorage> {
 
 private:
   TGraphics graphics;
@@ -49,26 +51,55 @@ private:
   /**
    * @brief 指定の文字列を描画するのに必要な領域の幅を計算する
    * 
-   * @param width 文字列
-   * @param cwidth 文字幅
+   * @param length 文字数
+   * @param dots 文字列に含まれる '.' の数
+   * @param has_dot_glyph '.' のグリフが存在するか
+   * @param charSpace 字間
    * @return size_t 必要な描画領域の幅
    */
-  template <uint8_t CWidth, uint8_t CHeight, class TString>
-  size_t calcRequiredWidth(TString str, ssize_t charSpace) {
-
-    if (graphics.template tryGetGlyph<CWidth, CHeight>(u'.', nullptr))
-      return str.length() * (CWidth + charSpace) - charSpace;
-
-    size_t retval = 0;
-    for (size_t i = 0; i < str.length(); i++){
-      auto c = str[i];
-      if (c == u'.')
-        retval += 1 + charSpace;
-      else
-        retval += CWidth + charSpace;
+  template <uint8_t CWidth>
+  static size_t calcRequiredWidth(size_t length, size_t dots, bool has_dot_glyph, ssize_t charSpace) {
+
+    // グリフが無い '.' は、1 ドットの点として描かれる
+    if (has_dot_glyph)
+      return length * (CWidth + charSpace) - charSpace;
+
+    return (length - dots) * (CWidth + charSpace) + dots * (1 + charSpace) - charSpace;
+  }
+
+  /**
+   * @brief 数値の文字列を、width に収まるよう上位桁を切り落としてから右詰めで描画
+   * 
+   * @param str 描画する文字列
+   * @param length 文字数
+   * @param has_dot_glyph '.' のグリフが存在するか
+   * @param x 描画領域左上の x 座標
+   * @param y 描画領域左上の y 座標
+   * @param width 描画領域の幅
+   * @param charSpace 字間
+   */
+  template <uint8_t CWidth, uint8_t CHeight>
+  void writeRightAligned(const char *str, size_t length, bool has_dot_glyph, ssize_t x, ssize_t y, size_t width, ssize_t charSpace) {
+
+    size_t dots = 0;
+    for (size_t i = 0; i < length; i++) {
+      if (str[i] == '.')
+        dots++;
     }
 
-    return retval - charSpace;
+    size_t real_width = width;
+    while (length > 0 && (real_width = calcRequiredWidth<CWidth>(length, dots, has_dot_glyph, charSpace)) > width) {
+      if (*str == '.')
+        dots--;
+      str++;
+      length--;
+    }
+
+    // 1 文字も収まらなければ何も描かない
+    if (length == 0)
+      return;
+
+    writeChars<CWidth, CHeight>(str, length, x + width - real_width, y, charSpace);
   }
 
 public:
@@ -143,6 +174,24 @@ public:
       char_x += writeChar<CWidth, CHeight>(str.at(i), char_x, y) + charSpace;
   }
 
+  /**
+   * @brief 指定位置に文字列を描画
+   * 
+   * @tparam CWidth 文字の幅
+   * @tparam CHeight 文字の高さ
+   * @param str 描画する文字列（終端文字は不要）
+   * @param length 文字数
+   * @param x 描画領域左上の x 座標
+   * @param y 描画領域左上の y 座標
+   * @param charSpace 字間
+   */
+  template <uint8_t CWidth, uint8_t CHeight>
+  void writeChars(const char *str, size_t length, ssize_t x, ssize_t y, ssize_t charSpace = 1) {
+    ssize_t char_x = x;
+    for (size_t i = 0; i < length; i++)
+      char_x += writeChar<CWidth, CHeight>(str[i], char_x, y) + charSpace;
+  }
+
   /**
    * @brief 指定位置に整数を右詰めで描画
    * 
@@ -158,23 +207,11 @@ public:
   template <uint8_t CWidth, uint8_t CHeight>
   void writeInteger(long value, uint8_t zero_pad, ssize_t x, ssize_t y, size_t width, ssize_t charSpace = 1) {
 
-    static constexpr size_t buf_size = 2 + 8 * sizeof(long);
-
-    String str;
-    if (zero_pad) {
-      char buf[buf_size];
-      sprintf(buf, "%0*ld", std::min(buf_size - 3, static_cast<size_t>(zero_pad)), value);
-      str = buf;
-    } else {
-      str = String(value);
-    }
-
-    // 文字列が width に収まるように切り詰める
-    size_t real_width = width;
-    while (str.length() > 0 && (real_width = calcRequiredWidth<CWidth, CHeight>(str, charSpace)) > width)
-      str = str.substring(1, str.length());
+    char   buf[NUMBER_TEXT_SIZE];
+    size_t length = formatInteger(value, std::min(NUMBER_TEXT_SIZE - 3, static_cast<size_t>(zero_pad)), buf);
 
-    writeString<CWidth, CHeight>(str, x + width - real_width, y, charSpace);
+    bool has_dot_glyph = graphics.template tryGetGlyph<CWidth, CHeight>(u'.', nullptr);
+    writeRightAligned<CWidth, CHeight>(buf, length, has_dot_glyph, x, y, width, charSpace);
   }
 
   /**
@@ -192,24 +229,20 @@ public:
   template <uint8_t CWidth, uint8_t CHeight>
   void writeReal(double value, uint8_t prec_max, ssize_t x, ssize_t y, size_t width, ssize_t charSpace = 1) {
 
-    int    prec       = std::min(static_cast<int>(prec_max), 30);
-    size_t real_width = width;
-    String str;
+    bool has_dot_glyph = graphics.template tryGetGlyph<CWidth, CHeight>(u'.', nullptr);
+    int  prec          = std::min(static_cast<int>(prec_max), 30);
 
-    // 文字列が width に収まるよう、まず小数点以下を切り詰める
-    for (; prec >= 0; prec--) {
-      str = String(value, prec);
-      if ((real_width = calcRequiredWidth<CWidth, CHeight>(str, charSpace)) <= width)
+    // 文字列が width に収まるよう、まず小数点以下を切り詰める（文字列は作らず、長さだけで判定する）
+    for (; prec > 0; prec--) {
+      size_t length = realLength(value, prec);
+      if (calcRequiredWidth<CWidth>(length, 1, has_dot_glyph, charSpace) <= width)
         break;
     }
 
-    if (prec < 0) {
-      // prec == 0 でもはみ出す場合は、上位桁を切り落とす
-      while (str.length() > 0 && (real_width = calcRequiredWidth<CWidth, CHeight>(str, charSpace)) > width)
-        str = str.substring(1, str.length());
-    }
-
-    writeString<CWidth, CHeight>(str, x + width - real_width, y, charSpace);
+    // prec == 0 でもはみ出す場合は、上位桁を切り落とす
+    char   buf[NUMBER_TEXT_SIZE];
+    size_t length = formatReal(value, prec, buf);
+    writeRightAligned<CWidth, CHeight>(buf, length, has_dot_glyph, x, y, width, charSpace);
   }
 };
 
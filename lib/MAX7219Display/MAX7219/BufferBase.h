@@ -6,7 +6,8 @@
 #define MAX7219Display_BufferBase_H_
 
 #include "IBuffer.h"
-#include "bitset.h"
+#include "RowMajorStorage.h"
+#include "bitrow.h"
 #include <array>
 #include <limits>
 #include <stdint.h>
@@ -20,14 +21,16 @@ namespace MAX7219 {
  * 
  * @tparam BufferWidth バッファ領域の幅
  * @tparam BufferHeight バッファ領域の高さ
+ * @tparam TStorage グラフィックの記憶方式（RowMajorStorage または DeviceNativeStorage）
  *
  * @par 内部実装
  * @parblock
  * MAX7219::BufferBase は、%MAX7219 LED モジュール用のフレームバッファです。
- * LED モジュールに表示させるグラフィックを、std::bitset の配列として内部で保持しています。
+ * 既定の記憶方式 (MAX7219::RowMajorStorage) では、
+ * LED モジュールに表示させるグラフィックを、1 行 = 1 個の整数 (MAX7219::bitrow) の配列として内部で保持しています。
  * 
  * 例えば MAX7219::BufferBase<24, 16> の場合、
- * 内部配列 @c _buffer は、マトリックス LED に対して次のようにマッピングされます。
+ * RowMajorStorage の内部配列 @c _buffer は、マトリックス LED に対して次のようにマッピングされます。
  * 
  * @verbatim
           x: 0 1 ...     7 8 9 ...    15 16 17 ...  23
@@ -47,35 +50,39 @@ namespace MAX7219 {
     └ device_y
  * @endverbatim
  * 
- * ※bitset の 0 番目の要素は右端に来ることに注意して下さい。
+ * ※bitrow の 0 番目の要素は右端に来ることに注意して下さい。
  * 
  * すなわち、座標 (x, y) の ON/OFF は、
- * <code>_buffer[y][BufferWidth - x - 1]</code> にアクセスすることで取得・設定できます。
+ * <code>_buffer[y]</code> の <code>BufferWidth - x - 1</code> 番目のビットにアクセスすることで取得・設定できます。
  * 例えば上図において (3, 5) を ON にするなら
  * @code
- *   _buffer[5][24 - 3 - 1] = true;
+ *   _buffer[5].set(24 - 3 - 1, true);
  * @endcode
  * とします。
  * 
  * @c _buffer に加えた変更は、MAX7219::Display::send() を呼び出すことにより
  * SPI 経由で %MAX7219 に送られ、LED モジュールの表示が更新されます。
+ * 
+ * 送信した時点の @c _buffer は @c _sent_buffer に控えておき、
+ * MAX7219::Display::sendChanged() はこれと比べて変化した行だけを送ります。
+ * 
+ * MAX7219::DeviceNativeStorage を指定すると、グラフィックは最初から %MAX7219 に送る並び・向きで保持され、
+ * 同じ並びの MAX7219::Display はそれを並べ替えずにそのまま送ります。
+ * 描画関数の使い方は、どちらの記憶方式でも変わりません。
  * @endparblock
  */
-template <size_t BufferWidth, size_t BufferHeight>
+template <size_t BufferWidth, size_t BufferHeight, class TStorage = RowMajorStorage<BufferWidth, BufferHeight>>
 class BufferBase : public IBuffer {
-  // TODO: 毎回バッファ全部を送るのはやめて、変更された部分だけ送るようにして
-  // SPI の転送に要する時間を短縮したい
-  // そのための _changed_area
 
 private:
-  using TBitset = MAX7219::bitset<BufferWidth>;
-  using TBuffer = std::array<TBitset, BufferHeight>;
+  using TRow  = typename TStorage::TRow;
+  using TWord = typename TStorage::TWord;
 
   static constexpr ssize_t BufferWidth_S  = static_cast<ssize_t>(BufferWidth);
   static constexpr ssize_t BufferHeight_S = static_cast<ssize_t>(BufferHeight);
 
-  TBuffer _buffer; //! グラフィックを保持している配列（VRAMのようなもの）
-  //TBuffer _changed_area;        //! 更新された範囲を追跡するための配列
+  TStorage     _storage;               //! グラフィックを保持しているオブジェクト（VRAMのようなもの）
+  mutable bool _is_all_changed = true; //! true なら送信済みの内容にかかわらず全領域を未送信として扱う
 
   /**
    * @brief 対象範囲が描画可能領域に含まれるかチェック
@@ -118,6 +125,9 @@ private:
   }
 
 public:
+  //! saveFrame() / loadFrame() でやりとりする、画面 1 枚分のバイト数
+  static constexpr size_t FrameBytes = TStorage::FrameBytes;
+
   // Disallow copy
   BufferBase(const BufferBase &) = delete;
   BufferBase &operator=(const BufferBase &) = delete;
@@ -126,11 +136,7 @@ public:
   BufferBase(BufferBase &&) = default;
   BufferBase &operator=(BufferBase &&) = default;
 
-  BufferBase() {
-
-    _buffer = TBuffer();
-    //_changed_area = TBuffer();
-  }
+  BufferBase() {}
 
   virtual ~BufferBase() = default;
 
@@ -152,18 +158,24 @@ public:
 
     width = std::min(width, sizeof(Tdata) * 8U);
 
-    if (isOutOfBound(x, y, width, height))
+    if (width == 0 || isOutOfBound(x, y, width, height))
       return;
 
-    auto   width_s      = static_cast<ssize_t>(width);
-    size_t right_space  = BufferWidth_S - x - width_s; // グラフィックの右端と _buffer 右端の距離
-    size_t actual_width = width_s + std::min(x, 0);
+    // グラフィックの右端と _buffer 右端の距離（グラフィックが右にはみ出すと負になる）
+    ssize_t right_space = BufferWidth_S - x - static_cast<ssize_t>(width);
+    // 描画範囲のうち、_buffer に収まる部分
+    ssize_t right_end  = right_space + static_cast<ssize_t>(width);
+    ssize_t mask_start = right_space > 0 ? right_space : 0;
+    ssize_t mask_end   = right_end < BufferWidth_S ? right_end : BufferWidth_S;
+    TWord   mask       = TRow::mask(mask_start, mask_end - mask_start);
+    // グラフィックの有効幅を超えるビットは捨てる
+    uint64_t data_mask = ~static_cast<uint64_t>(0) >> (64 - width);
 
     size_t buf_i;
-    for (size_t data_i = -std::min(y, 0); data_i < height && (buf_i = y + static_cast<ssize_t>(data_i)) < _buffer.size(); data_i++) {
-      auto d = TBitset(data[data_i]) << right_space;
-      _buffer.at(buf_i).setRange(right_space, actual_width, false);
-      _buffer.at(buf_i) |= d;
+    for (size_t data_i = -std::min<ssize_t>(y, 0); data_i < height && (buf_i = y + static_cast<ssize_t>(data_i)) < BufferHeight; data_i++) {
+      uint64_t d = static_cast<uint64_t>(data[data_i]) & data_mask;
+      d          = right_space >= 0 ? d << right_space : d >> -right_space;
+      _storage.assignRow(buf_i, static_cast<TWord>(d), mask);
     }
   }
 
@@ -198,9 +210,10 @@ public:
     if (isOutOfBound(x, y))
       return;
 
-    size_t bit_i             = BufferWidth - x - 1;
-    size_t buf_i             = y;
-    _buffer.at(buf_i)[bit_i] = is_on;
+    size_t bit_i = BufferWidth - x - 1;
+    size_t buf_i = y;
+    TWord  mask  = TRow::mask(bit_i, 1);
+    _storage.assignRow(buf_i, is_on ? mask : 0, mask);
   }
 
   /**
@@ -232,24 +245,42 @@ public:
     }
     // x >= 0, y >= 0 が保証される
 
-    size_t actual_width = width;
-    size_t right_space  = BufferWidth_S - x - static_cast<ssize_t>(width);
+    // 右にはみ出した部分は切り捨てる
+    width = std::min(width, BufferWidth - x);
+
+    size_t right_space = BufferWidth - x - width;
+    TWord  mask        = TRow::mask(right_space, width);
 
     size_t buf_i;
-    for (size_t data_i = -std::min(y, 0); data_i < height && (buf_i = y + data_i) < _buffer.size(); data_i++) {
-      _buffer.at(buf_i).setRange(right_space, actual_width, false);
-    }
+    for (size_t data_i = 0; data_i < height && (buf_i = y + data_i) < BufferHeight; data_i++)
+      _storage.assignRow(buf_i, 0, mask);
   }
 
   /**
    * @brief 全領域をクリア
    */
   void clearAll() {
+    _storage.reset();
+  }
 
-    for (size_t i = 0; i < _buffer.size(); i++) {
-      _buffer.at(i).reset();
-      //_changed_area[i].set();
-    }
+  /**
+   * @brief 画面 1 枚分の内容を書き出す
+   * 
+   * @param[out] dest 要素数 FrameBytes 以上の配列
+   */
+  void saveFrame(uint8_t *dest) const {
+    _storage.saveFrame(dest);
+  }
+
+  /**
+   * @brief saveFrame() で書き出した内容に戻す
+   * 
+   * 送信済みの内容は変わらないので、 MAX7219::Display::sendChanged() は、戻した結果として変化した行だけを送る。
+   * 
+   * @param src saveFrame() で書き出した配列
+   */
+  void loadFrame(const uint8_t *src) {
+    _storage.loadFrame(src);
   }
 
   /**
@@ -266,13 +297,13 @@ public:
     if (isOutOfBound(x, y, 8, 1) || y >= BufferHeight_S)
       return 0;
 
-    ssize_t            bitset_start_i = BufferWidth_S - x - 8;
-    MAX7219::bitset<8> retval         = _buffer.at(y).template range<8>(bitset_start_i);
+    ssize_t            start_i = BufferWidth_S - x - 8;
+    MAX7219::bitrow<8> retval  = _storage.getRow(y).template range<8>(start_i);
 
     if (swap)
       retval.swap();
 
-    return static_cast<uint8_t>(retval.to_ulong());
+    return retval.to_word();
   }
 
   /**
@@ -289,20 +320,85 @@ public:
     if (isOutOfBound(x, y, 1, 8))
       return 0;
 
-    ssize_t bitset_i = BufferWidth_S - x - 1;
-    if (bitset_i < 0)
+    ssize_t bit_i = BufferWidth_S - x - 1;
+    if (bit_i < 0)
       return 0;
 
-    auto retval = MAX7219::bitset<8>();
+    auto retval = MAX7219::bitrow<8>();
 
     if (swap) {
-      for (size_t i = -std::min(y, 0U); i < 8 && y + i < _buffer.size(); i++)
-        retval[7 - i] = _buffer.at(y + i)[bitset_i];
+      for (size_t i = 0; i < 8 && y + i < BufferHeight; i++)
+        retval.set(7 - i, _storage.getRow(y + i).test(bit_i));
     } else {
-      for (size_t i = -std::min(y, 0U); i < 8 && y + i < _buffer.size(); i++)
-        retval[i] = _buffer.at(y + i)[bitset_i];
+      for (size_t i = 0; i < 8 && y + i < BufferHeight; i++)
+        retval.set(i, _storage.getRow(y + i).test(bit_i));
+    }
+    return retval.to_word();
+  }
+
+  /**
+   * @copydoc IBuffer::getBlockFrom(size_t, size_t) const
+   */
+  virtual uint64_t getBlockFrom(size_t x, size_t y) const {
+
+    // 8 行分を、左端 = MSB の 1 バイトずつ詰める
+    uint64_t block = 0;
+    for (size_t i = 0; i < 8; i++) {
+      uint64_t row = getHorizontialFrom(x, y + i, false);
+      block |= row << (8 * i);
+    }
+    return block;
+  }
+
+  /**
+   * @copydoc IBuffer::isChangedArea(size_t, size_t, size_t, size_t) const
+   */
+  virtual bool isChangedArea(size_t x, size_t y, size_t width, size_t height) const {
+
+    if (_is_all_changed)
+      return true;
+
+    if (x >= BufferWidth || y >= BufferHeight || width == 0)
+      return false;
+
+    width = std::min(width, BufferWidth - x);
+
+    // 変化したビットのうち、[x, x + width) の範囲だけを残して調べる
+    TWord mask = TRow::mask(BufferWidth - x - width, width);
+    for (size_t i = y; i < y + height && i < BufferHeight; i++) {
+      if ((_storage.getRow(i) ^ _storage.getSentRow(i)).to_word() & mask)
+        return true;
     }
-    return static_cast<uint8_t>(retval.to_ulong());
+    return false;
+  }
+
+  /**
+   * @copydoc IBuffer::markAsSent() const
+   */
+  virtual void markAsSent() const {
+    _storage.markAsSent();
+    _is_all_changed = false;
+  }
+
+  /**
+   * @copydoc IBuffer::markAllAsChanged() const
+   */
+  virtual void markAllAsChanged() const {
+    _is_all_changed = true;
+  }
+
+  /**
+   * @copydoc IBuffer::getNativeFrame(const void *, const uint8_t *&, const uint8_t *&) const
+   */
+  virtual bool getNativeFrame(const void *layout_tag, const uint8_t *&frame, const uint8_t *&sent) const {
+
+    if (!_storage.getNativeFrame(layout_tag, frame, sent))
+      return false;
+
+    // 全領域が未送信なら、送信済みの内容は当てにならない
+    if (_is_all_changed)
+      sent = nullptr;
+    return true;
   }
 
   /**
@@ -327,9 +423,9 @@ public:
     // 区切り線
     Serial.println(std::string(BufferWidth, '-').c_str());
 
-    for (size_t i = 0; i < _buffer.size(); i++) {
+    for (size_t i = 0; i < BufferHeight; i++) {
 
-      auto bstr = _buffer.at(i).to_string(' ', '*');
+      auto bstr = _storage.getRow(i).to_string(' ', '*');
       Serial.println(bstr.c_str());
     }
   }
@@ -0,0 +1,252 @@
+/**
+ * @file DeviceNativeStorage.h
+ */
+
+#ifndef MAX7219Display_DeviceNativeStorage_H_
+#define MAX7219Display_DeviceNativeStorage_H_
+
+#include "bitops.h"
+#include "bitrow.h"
+#include "opcodes.h"
+#include "setting_t.h"
+#include <stdint.h>
+#include <string.h>
+
+namespace MAX7219 {
+
+template <size_t BufferWidth, size_t BufferHeight, class TLayout>
+class DeviceNativeStorage;
+
+/**
+ * @brief BufferBase の記憶方式のひとつ。グラフィックを、MAX7219 に送る並び・向きのまま保持する
+ * 
+ * @tparam BufferWidth バッファ領域の幅
+ * @tparam BufferHeight バッファ領域の高さ
+ * @tparam Devices デイジーチェーン接続された MAX7219 モジュールの setting_t（Display に与えるものと同じ）
+ * 
+ * 内部配列 @c _frame は <code>[行][デバイス]</code> の順に、(OP_DIGITn, データ) の 2 バイトずつを並べたもので、
+ * @c _frame[row] をそのまま SPI に流せば 1 行分の送信になる。
+ * 描画は、描画と同時にモジュールごとの向きに並べ替えて書き込む。
+ * 
+ * 同じ並びの Display<layout_t<Devices...>> は、これを検出して
+ * IBuffer::getBlockFrom() による並べ替えを省略し、 @c _frame を順番に送るだけで済ませる。
+ * 並びが異なる Display と組み合わせた場合は、RowMajorStorage と同じ方法で送られる。
+ * 
+ * @note どのモジュールにも対応しない座標のドットは保持されない（常に OFF として読み出される）。
+ * @see RowMajorStorage
+ */
+template <size_t BufferWidth, size_t BufferHeight, class... Devices>
+class DeviceNativeStorage<BufferWidth, BufferHeight, layout_t<Devices...>> {
+public:
+  using TRow  = MAX7219::bitrow<BufferWidth>;
+  using TWord = typename TRow::word_t;
+
+private:
+  using TLayout = layout_t<Devices...>;
+  using expand  = int[];
+
+  static constexpr size_t  RowBytes      = TLayout::size * 2;
+  static constexpr ssize_t BufferWidth_S = static_cast<ssize_t>(BufferWidth);
+
+  using TFrame = uint8_t[8][RowBytes];
+
+  TFrame         _frame;      //! MAX7219 に送る形のグラフィック（VRAMのようなもの）
+  mutable TFrame _sent_frame; //! 最後に送信した時点の _frame（変更された範囲を追跡するため）
+
+  /**
+   * @brief 行のデータから、x 座標 @c x を左端とする 8 ドット分を取り出す（左端 = MSB）
+   */
+  static uint8_t extractSegment(TWord word, size_t x) {
+    return TRow(word).template range<8>(BufferWidth_S - static_cast<ssize_t>(x) - 8).to_word();
+  }
+
+  /**
+   * @brief extractSegment() の逆。8 ドット分のデータを、行のデータの x 座標 @c x の位置に置く
+   */
+  static TWord placeSegment(uint8_t segment, size_t x) {
+
+    if (x >= BufferWidth)
+      return 0;
+
+    ssize_t  shift = BufferWidth_S - static_cast<ssize_t>(x) - 8;
+    uint64_t value = shift >= 0 ? static_cast<uint64_t>(segment) << shift : static_cast<uint64_t>(segment) >> -shift;
+    return TRow(static_cast<TWord>(value)).to_word();
+  }
+
+  /**
+   * @brief デバイス @e TDevice が表示している y 行目の 8 ドット分を、行のデータとして取り出す
+   * 
+   * @param frame _frame または _sent_frame
+   * @param device デバイスの番号（ @e Devices の何番目か）
+   * @param y 行の y 座標
+   */
+  template <class TDevice>
+  static TWord gatherSegment(const TFrame &frame, size_t device, size_t y) {
+
+    if (y < TDevice::topleft_y || y >= TDevice::topleft_y + 8)
+      return 0;
+
+    size_t  ly      = y - TDevice::topleft_y;
+    size_t  data_i  = device * 2 + 1;
+    uint8_t segment = 0;
+
+    if (!TDevice::is_vertical) {
+      // 1 行がそのまま 1 バイトに対応する
+      segment = frame[TDevice::digitRow(0, ly)][data_i];
+      if (TDevice::digitBit(0, ly) == 0)
+        segment = reverseBits(segment);
+
+    } else {
+      for (size_t lx = 0; lx < 8; lx++) {
+        if ((frame[TDevice::digitRow(lx, ly)][data_i] >> TDevice::digitBit(lx, ly)) & 1U)
+          segment |= 0x80 >> lx;
+      }
+    }
+
+    return placeSegment(segment, TDevice::topleft_x);
+  }
+
+  /**
+   * @brief y 行目のうち、デバイス @e TDevice が表示している範囲を書き換える
+   * 
+   * @param device デバイスの番号（ @e Devices の何番目か）
+   * @param y 行の y 座標
+   * @param value 新しい値
+   * @param mask 置き換える範囲
+   */
+  template <class TDevice>
+  void assignSegment(size_t device, size_t y, TWord value, TWord mask) {
+
+    if (y < TDevice::topleft_y || y >= TDevice::topleft_y + 8)
+      return;
+
+    uint8_t m = extractSegment(mask, TDevice::topleft_x);
+    if (!m)
+      return;
+
+    uint8_t v      = extractSegment(value, TDevice::topleft_x);
+    size_t  ly     = y - TDevice::topleft_y;
+    size_t  data_i = device * 2 + 1;
+
+    if (!TDevice::is_vertical) {
+      if (TDevice::digitBit(0, ly) == 0) {
+        v = reverseBits(v);
+        m = reverseBits(m);
+      }
+      uint8_t &d = _frame[TDevice::digitRow(0, ly)][data_i];
+      d          = (d & ~m) | (v & m);
+
+    } else {
+      for (size_t lx = 0; lx < 8; lx++) {
+        uint8_t pixel = 0x80 >> lx;
+        if (!(m & pixel))
+          continue;
+
+        uint8_t &d   = _frame[TDevice::digitRow(lx, ly)][data_i];
+        uint8_t  bit = 1U << TDevice::digitBit(lx, ly);
+        if (v & pixel)
+          d |= bit;
+        else
+          d &= ~bit;
+      }
+    }
+  }
+
+  /**
+   * @brief y 行目を、全デバイスの gatherSegment() を集めて組み立てる
+   * 
+   * y 行目に掛かるデバイスをすべて見るので、1 回あたり O(デバイス数) の処理になり、
+   * 縦向き（ is_vertical ）のデバイスは 1 個につきさらに 8 回の読み出しが要る（最悪 O(デバイス数 * 8)）。
+   */
+  static TRow gatherRow(const TFrame &frame, size_t y) {
+
+    TWord  value = 0;
+    size_t i     = 0;
+    (void)expand{0, (value |= gatherSegment<Devices>(frame, i, y), ++i, 0)...};
+    return TRow(value);
+  }
+
+public:
+  static constexpr size_t FrameBytes = sizeof(TFrame);
+
+  DeviceNativeStorage() {
+
+    // アドレス部分は固定なので、ここで埋めておく
+    // MAX7219 モジュールでは、LED 上端が OP_DIGIT7、下端が OP_DIGIT0 に対応する。
+    for (size_t row = 0; row < 8; row++) {
+      for (size_t i = 0; i < RowBytes; i += 2) {
+        _frame[row][i]     = OP_DIGIT7 - row;
+        _frame[row][i + 1] = 0;
+      }
+    }
+    memcpy(_sent_frame, _frame, sizeof(_frame));
+  }
+
+  /**
+   * @brief y 行目の現在の内容
+   * 
+   * 行の形では保持していないので、呼ぶたびに gatherRow() で組み立て直す（キャッシュしない）。
+   * 同じ並びの Display は getNativeFrame() で送るので、送信（ send() / sendChanged() / commit() ）では呼ばれない。
+   * 呼ばれるのは BufferBase の読み出し（ getHorizontialFrom() 、 getVerticalFrom() 、 isChangedArea() など）だけで、
+   * getVerticalFrom() は 1 回で 8 行分、並びの異なる Display への送信は 1 フレームでその全行分を組み立てることになる。
+   */
+  TRow getRow(size_t y) const {
+    return gatherRow(_frame, y);
+  }
+
+  /**
+   * @brief y 行目の送信済みの内容（ getRow() と同じく、呼ぶたびに組み立て直す）
+   */
+  TRow getSentRow(size_t y) const {
+    return gatherRow(_sent_frame, y);
+  }
+
+  void assignRow(size_t y, TWord value, TWord mask) {
+
+    size_t i = 0;
+    (void)expand{0, (assignSegment<Devices>(i, y, value, mask), ++i, 0)...};
+  }
+
+  void reset() {
+
+    for (size_t row = 0; row < 8; row++) {
+      for (size_t i = 1; i < RowBytes; i += 2)
+        _frame[row][i] = 0;
+    }
+  }
+
+  void markAsSent() const {
+    memcpy(_sent_frame, _frame, sizeof(_frame));
+  }
+
+  void saveFrame(uint8_t *dest) const {
+    memcpy(dest, _frame, FrameBytes);
+  }
+
+  void loadFrame(const uint8_t *src) {
+    memcpy(_frame, src, FrameBytes);
+  }
+
+  /**
+   * @brief MAX7219 に送る形のデータを取得
+   * 
+   * @param layout_tag 送信先の Display の layout_t::tag()
+   * @param[out] frame 8 行分の送信データ。1 行は <code>Devices の個数 * 2</code> バイト
+   * @param[out] sent 最後に送信した時点の @c frame
+   * @retval true @c layout_tag がこのストレージの並びと一致した（ @c frame と @c sent に値が入る）
+   * @retval false 並びが一致しない
+   */
+  bool getNativeFrame(const void *layout_tag, const uint8_t *&frame, const uint8_t *&sent) const {
+
+    if (layout_tag != TLayout::tag())
+      return false;
+
+    frame = &_frame[0][0];
+    sent  = &_sent_frame[0][0];
+    return true;
+  }
+};
+
+} // namespace MAX7219
+
+#endif // MAX7219Display_DeviceNativeStorage_H_
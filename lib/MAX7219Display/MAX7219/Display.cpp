@@ -1,24 +1,11 @@
 #include "Display.h"
 #include <assert.h>
 #include <SPI.h>
+#ifdef ARDUINO_ARCH_ESP8266
+#include <ets_sys.h>
+#endif
 using namespace MAX7219;
 
-// opcodes for the MAX7221 and MAX7219
-static constexpr uint8_t OP_NOOP        = 0;
-static constexpr uint8_t OP_DIGIT0      = 1;
-static constexpr uint8_t OP_DIGIT1      = 2;
-static constexpr uint8_t OP_DIGIT2      = 3;
-static constexpr uint8_t OP_DIGIT3      = 4;
-static constexpr uint8_t OP_DIGIT4      = 5;
-static constexpr uint8_t OP_DIGIT5      = 6;
-static constexpr uint8_t OP_DIGIT6      = 7;
-static constexpr uint8_t OP_DIGIT7      = 8;
-static constexpr uint8_t OP_DECODEMODE  = 9;
-static constexpr uint8_t OP_INTENSITY   = 10;
-static constexpr uint8_t OP_SCANLIMIT   = 11;
-static constexpr uint8_t OP_SHUTDOWN    = 12;
-static constexpr uint8_t OP_DISPLAYTEST = 15;
-
 #define CS_LOW()           digitalWrite(_pin_cs, LOW)
 
 #define CS_HIGH()                \
@@ -27,123 +14,340 @@ static constexpr uint8_t OP_DISPLAYTEST = 15;
     delayMicroseconds(5);        \
   } while (0)
 
-static void inline transfer(uint8_t address, uint8_t data) {
-  uint8_t d[2] = {address, data};
-  SPI.transferBytes(d, d, 2 * sizeof(uint8_t));
+constexpr uint8_t DisplayBase::QUEUED_REGISTERS[];
+
+/**
+ * @brief endBurst() で送り始めた行の送信状態
+ * 
+ * SPI（HSPI）は 1 つしかないので、Display が複数あっても共有する。
+ */
+struct burst_state_t {
+  const uint8_t *volatile data;      //! 送信中の行
+  volatile size_t         rows;      //! 送り終えていない行数（送信中の行を含む）
+  size_t                  row_bytes; //! 1 行のバイト数
+  int                     pin_cs;    //! SPI CS ピン番号
+  volatile uint32_t       finished;  //! 最後に送り終えたときの micros() の値
+};
+
+static burst_state_t _burst_state = {};
+
+#ifdef ARDUINO_ARCH_ESP8266
+
+/**
+ * @brief 1 行分のデータを SPI の FIFO に詰め、送信するビット数を設定する
+ */
+static void IRAM_ATTR loadRow(const uint8_t *data, size_t size) {
+
+  uint32_t bits = size * 8 - 1;
+  SPI1U1        = (SPI1U1 & ~((SPIMMOSI << SPILMOSI) | (SPIMMISO << SPILMISO))) | (bits << SPILMOSI) | (bits << SPILMISO);
+
+  // FIFO は 32 ビット単位で、下位バイトから送られる
+  volatile uint32_t *fifo = &SPI1W0;
+  for (size_t i = 0; i < size; i += 4) {
+    uint32_t word = 0;
+    for (size_t j = 0; j < 4 && i + j < size; j++)
+      word |= static_cast<uint32_t>(data[i + j]) << (8 * j);
+    *fifo++ = word;
+  }
+}
+
+/**
+ * @brief 1 行送り終えるごとに呼ばれ、CS を上げて MAX7219 に取り込ませてから、次の行を送り始める
+ */
+static void IRAM_ATTR onSPIInterrupt(void *) {
+
+  if (!(SPIIR & (1 << SPII1)) || !(SPI1S & SPISTRIS))
+    return;
+  SPI1S &= ~SPISTRIS;
+
+  auto &state = _burst_state;
+  digitalWrite(state.pin_cs, HIGH);
+  delayMicroseconds(5);
+
+  if (--state.rows == 0) {
+    SPI1S &= ~SPISTRIE;
+    state.finished = micros();
+    return;
+  }
+
+  state.data += state.row_bytes;
+  digitalWrite(state.pin_cs, LOW);
+  loadRow(state.data, state.row_bytes);
+  SPI1CMD |= SPIBUSY;
 }
 
-Display::Display(const int pin_cs, const IBuffer &buffer, const std::vector<setting_t> &devices)
+#endif
+
+DisplayBase::DisplayBase(const int pin_cs, const IBuffer &buffer, size_t device_count, uint8_t *commands, uint8_t *burst, size_t burst_capacity)
     : _pin_cs(pin_cs)
     , _buffer(&buffer)
-    , _devices(devices.cbegin(), devices.cend()) {}
+    , _device_count(device_count)
+    , _commands(commands)
+    , _burst(burst)
+    , _burst_capacity(burst_capacity) {}
+
+void DisplayBase::write(const uint8_t *data, size_t size) const {
+
+  if (_staging) {
+    assert(size == _device_count * 2 && _burst_rows < _burst_capacity);
+    memcpy(_burst + _burst_rows * size, data, size);
+    _burst_rows++;
+    _sent_bytes += size;
+    return;
+  }
+
+  waitTransmitted();
+  CS_LOW();
+  SPI.writeBytes(data, size * sizeof(uint8_t));
+  CS_HIGH();
+  _sent_bytes += size;
+}
+
+void DisplayBase::beginBurst() const {
+  _burst_rows = 0;
+  _staging    = true;
+}
+
+void DisplayBase::endBurst() const {
+
+  _staging = false;
+  if (_burst_rows == 0)
+    return;
+
+  auto  size  = _device_count * 2;
+  auto &state = _burst_state;
+
+#ifdef ARDUINO_ARCH_ESP8266
+  static bool attached = false;
+  if (!attached) {
+    ETS_SPI_INTR_ATTACH(onSPIInterrupt, nullptr);
+    ETS_SPI_INTR_ENABLE();
+    attached = true;
+  }
+
+  // 最初の行だけここで送り始め、残りは onSPIInterrupt() に任せる
+  while (SPI1CMD & SPIBUSY)
+    ;
+  state.data      = _burst;
+  state.rows      = _burst_rows;
+  state.row_bytes = size;
+  state.pin_cs    = _pin_cs;
+  SPI1S           = (SPI1S & ~SPISTRIS) | SPISTRIE;
+
+  CS_LOW();
+  loadRow(_burst, size);
+  SPI1CMD |= SPIBUSY;
+#else
+  for (size_t i = 0; i < _burst_rows; i++) {
+    CS_LOW();
+    SPI.writeBytes(_burst + i * size, size * sizeof(uint8_t));
+    CS_HIGH();
+  }
+  state.finished = micros();
+#endif
+}
+
+bool DisplayBase::isBursting() const {
+  return _burst_state.rows != 0;
+}
+
+void DisplayBase::waitTransmitted() const {
+  while (isBursting())
+    ;
+}
 
-void Display::broadcast(uint8_t address, uint8_t data) const {
-  size_t  size = _devices.size() * 2;
+uint32_t DisplayBase::getTransmittedAt() const {
+  return _burst_state.finished;
+}
+
+void DisplayBase::broadcast(uint8_t address, uint8_t data) const {
+  size_t  size = _device_count * 2;
   uint8_t spiData[size];
 
   spiData[0] = address;
   spiData[1] = data;
 
-  for (size_t i = 1; i < _devices.size(); i++) {
+  for (size_t i = 1; i < _device_count; i++) {
     void *src  = spiData;
     void *dest = spiData + (i * 2);
     memcpy(dest, src, 2 * sizeof(uint8_t));
   }
 
+  waitTransmitted();
   CS_LOW();
   SPI.transferBytes(spiData, spiData, size * sizeof(uint8_t));
   CS_HIGH();
 }
 
-void Display::init() const {
+void DisplayBase::init() const {
   pinMode(_pin_cs, OUTPUT);
   CS_HIGH();
 
-  shutdownMode(true); // すべてのモジュールが shutdown 状態であることを保証する
-  testMode(false);    // すべてのモジュールが test mode でないことを保証する
-  setIntensity(15);
+  // 送信待ちの書き込みは、初期化で上書きされるので捨てる
+  memset(_commands, 0, _device_count * CommandStride);
+
+  broadcast(OP_SHUTDOWN, 0);    // すべてのモジュールが shutdown 状態であることを保証する
+  broadcast(OP_DISPLAYTEST, 0); // すべてのモジュールが test mode でないことを保証する
+  broadcast(OP_INTENSITY, 15);
   broadcast(OP_SCANLIMIT, 7);
   broadcast(OP_DECODEMODE, 0);
+
+  // 表示内容が不定になったので、次回は全部送る
+  discardFrames();
+  _buffer->markAllAsChanged();
+}
+
+void DisplayBase::testMode(bool value) const {
+  for (size_t i = 0; i < _device_count; i++)
+    queueCommand(i, OP_DISPLAYTEST, value ? 1 : 0);
 }
 
-void Display::testMode(bool value) const {
-  broadcast(OP_DISPLAYTEST, value ? 1 : 0);
+void DisplayBase::shutdownMode(bool value) const {
+  for (size_t i = 0; i < _device_count; i++)
+    queueCommand(i, OP_SHUTDOWN, value ? 0 : 1);
+}
+
+void DisplayBase::setIntensity(uint8_t intensity) const {
+  for (size_t i = 0; i < _device_count; i++)
+    queueCommand(i, OP_INTENSITY, intensity);
+}
+
+void DisplayBase::queueCommand(size_t device, uint8_t address, uint8_t data) const {
+  uint8_t *command = _commands + device * CommandStride;
+
+  for (size_t k = 0; k < QueuedRegisterCount; k++) {
+    if (QUEUED_REGISTERS[k] != address)
+      continue;
+
+    // 先頭バイトは送信待ちフラグ（1 ビット = QUEUED_REGISTERS の 1 要素）
+    command[0] |= 1U << k;
+    command[1 + k] = data;
+    return;
+  }
+
+  assert(false);
 }
 
-void Display::shutdownMode(bool value) const {
-  broadcast(OP_SHUTDOWN, value ? 0 : 1);
+void DisplayBase::fillCommands(uint8_t *spiData) const {
+
+  for (size_t i = 0; i < _device_count; i++, spiData += 2) {
+    uint8_t *command = _commands + i * CommandStride;
+
+    if (spiData[0] != OP_NOOP || !command[0])
+      continue;
+
+    // 送信待ちのうち、QUEUED_REGISTERS で先に書かれているものから送る
+    size_t k = 0;
+    while (!(command[0] & (1U << k)))
+      k++;
+
+    spiData[0] = QUEUED_REGISTERS[k];
+    spiData[1] = command[1 + k];
+    command[0] &= ~(1U << k);
+  }
 }
 
-void Display::setIntensity(uint8_t intensity) const {
-  broadcast(OP_INTENSITY, intensity);
+void DisplayBase::writeRow(const uint8_t *spiData) const {
+  size_t size = _device_count * 2;
+
+  if (!hasPendingCommands()) {
+    write(spiData, size);
+    return;
+  }
+
+  uint8_t merged[size];
+  memcpy(merged, spiData, size);
+  fillCommands(merged);
+  write(merged, size);
 }
 
-void Display::setIntensity(std::vector<uint8_t> intensities) const {
+bool DisplayBase::flushCommandsOnce() const {
 
-  assert(intensities.size() == _devices.size());
+  if (!hasPendingCommands())
+    return false;
 
-  size_t  size = _devices.size() * 2;
+  size_t  size = _device_count * 2;
   uint8_t spiData[size];
+  memset(spiData, OP_NOOP, size);
+  fillCommands(spiData);
+  write(spiData, size);
+  return true;
+}
+
+bool DisplayBase::hasPendingCommands() const {
 
-  for (size_t i = 0; i < _devices.size(); i++) {
-    size_t addr       = i * 2;
-    spiData[addr]     = OP_INTENSITY;
-    spiData[addr + 1] = intensities.at(i);
+  for (size_t i = 0; i < _device_count; i++) {
+    if (_commands[i * CommandStride])
+      return true;
   }
+  return false;
+}
 
-  CS_LOW();
-  SPI.transferBytes(spiData, spiData, size * sizeof(uint8_t));
-  CS_HIGH();
+void DisplayBase::flush() const {
+  while (flushCommandsOnce())
+    ;
 }
 
-void Display::clearAll() const {
+void DisplayBase::clearAll() const {
   for (uint8_t opcode = OP_DIGIT0; opcode <= OP_DIGIT7; opcode++)
     broadcast(opcode, 0);
+
+  // LED の表示がバッファと食い違ったので、次回は全部送る
+  discardFrames();
+  _buffer->markAllAsChanged();
 }
 
-void Display::send() const {
+size_t DisplayBase::getLastSentBytes() const {
+  return _sent_bytes;
+}
 
-#ifdef DEBUG_MAX7219DISPLAY_BUFFER
-  _buffer->printToSerial();
-#endif
+bool DisplayBase::isTransmitting() const {
+  return _front_rows || _back_rows || isBursting();
+}
 
-  size_t dev_size = _devices.size();
-  if (dev_size == 0)
-    return;
+size_t DisplayBase::getPendingRows() const {
+  return __builtin_popcount(_front_rows) + __builtin_popcount(_back_rows) + _burst_state.rows;
+}
 
-  // 送信するデータの長さ
-  size_t size = dev_size * 2U;
+void DisplayBase::hold() const {
+  _holding = true;
+}
 
-  for (size_t row = 0; row < 8; row++) {
-    
-    // MAX7219 モジュールでは、LED 上端が OP_DIGIT7、下端が OP_DIGIT0 に対応する。
-    uint8_t opcode = OP_DIGIT7 - row;
+void DisplayBase::release() const {
+  _holding = false;
+}
 
-    uint8_t spiData[size];
+bool DisplayBase::isHolding() const {
+  return _holding;
+}
 
-    for (size_t dev_i = 0; dev_i < dev_size; dev_i++) {
-      auto    dev       = _devices.at(dev_i);
-      uint8_t data;
+bool DisplayBase::loopback(uint8_t seed) const {
+  size_t  size = _device_count * 2;
+  uint8_t spiData[size * 2];
+  uint8_t pattern[size];
 
-      if (dev.rotation == Rotate::Clockwise)
-        data = _buffer->getVerticalFrom(dev.topleft_x + row, dev.topleft_y, !dev.reverse);
-      else if (dev.rotation == Rotate::_180)
-        data = _buffer->getHorizontialFrom(dev.topleft_x, dev.topleft_y + 7 - row, dev.reverse);
-      else if (dev.rotation == Rotate::Counterclockwise)
-        data = _buffer->getVerticalFrom(dev.topleft_x + 7 - row, dev.topleft_y, dev.reverse);
-      else /* Rotate::_0 */
-        data = _buffer->getHorizontialFrom(dev.topleft_x, dev.topleft_y + row, !dev.reverse);
+  // 前半は検査パターン。アドレス部（上位バイトの下位 4 ビット）は 0 = OP_NOOP にしておく
+  for (size_t i = 0; i < size; i += 2) {
+    pattern[i]     = static_cast<uint8_t>(seed + i * 0x35) & 0xF0;
+    pattern[i + 1] = static_cast<uint8_t>(seed ^ (i * 0x5B + 0xA5));
+  }
+  memcpy(spiData, pattern, size);
+  // 後半は OP_NOOP で、検査パターンをチェーンの外へ押し出す
+  memset(spiData + size, OP_NOOP, size);
 
-      // 遠いデバイスから順に送る
-      size_t addr       = dev_i * 2;
-      spiData[addr]     = opcode;
-      spiData[addr + 1] = data;
-    }
+  waitTransmitted();
+  CS_LOW();
+  SPI.transferBytes(spiData, spiData, size * 2 * sizeof(uint8_t));
+  CS_HIGH();
 
-    CS_LOW();
-    SPI.transferBytes(spiData, spiData, size * sizeof(uint8_t));
-    CS_HIGH();
-  }
+  // チェーン全体を通り抜けた検査パターンが、後半の送信中に返ってくる
+  return memcmp(spiData + size, pattern, size) == 0;
+}
+
+void DisplayBase::discardFrames() const {
+  _front_rows = 0;
+  _back_rows  = 0;
+  _holding    = false;
 }
 
 #undef CS_LOW
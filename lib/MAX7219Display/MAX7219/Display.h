@@ -6,20 +6,52 @@
 #define MAX7219Display_Display_H_
 
 #include "IBuffer.h"
+#include "bitops.h"
+#include "opcodes.h"
 #include "setting_t.h"
+#include <array>
+#include <string.h>
 #include <stdint.h>
 
 namespace MAX7219 {
 
 /**
- * @brief IBuffer が保持しているグラフィックを実際に MAX7219 に送信するクラス
- * 
+ * @brief Display のうち、モジュールの並びに依存しない部分
  */
-class Display {
-private:
-  const int                    _pin_cs;
-  const IBuffer *              _buffer;  //! グラフィックを保持している IBuffer オブジェクト
-  const std::vector<setting_t> _devices; //! MAX7219 モジュールの相対位置や順序の設定
+class DisplayBase {
+public:
+  //! 送信待ちにできる（書き込みをまとめられる）レジスタ
+  static constexpr uint8_t QUEUED_REGISTERS[] = {OP_INTENSITY, OP_SHUTDOWN, OP_DISPLAYTEST};
+  //! QUEUED_REGISTERS の個数
+  static constexpr size_t QueuedRegisterCount = sizeof(QUEUED_REGISTERS) / sizeof(QUEUED_REGISTERS[0]);
+  //! デバイス 1 個あたりの送信待ちレジスタの記録に必要なバイト数（送信待ちフラグ + 値）
+  static constexpr size_t CommandStride = 1 + QueuedRegisterCount;
+
+protected:
+  const int       _pin_cs;
+  const IBuffer  *_buffer;             //! グラフィックを保持している IBuffer オブジェクト
+  const size_t    _device_count;       //! デイジーチェーン接続された MAX7219 モジュールの個数
+  mutable size_t  _sent_bytes = 0;     //! 直前の send() / sendChanged() で送信したバイト数
+  mutable uint8_t _front_rows = 0;     //! 送信中のフレームのうち、まだ送っていない行（1 ビット = 1 行）
+  mutable uint8_t _back_rows  = 0;     //! commit() されて送信を待っているフレームに含まれる行（1 ビット = 1 行）
+  mutable bool    _holding    = false; //! true の間は、送信待ちのフレームを送り始めない（ hold() を参照）
+  uint8_t *const  _commands;           //! デバイスごとの送信待ちレジスタ（ CommandStride バイトずつ）
+  uint8_t *const  _burst;              //! transmitFrame() でまとめて送る行の控え（ _burst_capacity 行分）
+  const size_t    _burst_capacity;     //! _burst に控えられる行数
+  mutable size_t  _burst_rows = 0;     //! _burst に控えた行数
+  mutable bool    _staging    = false; //! true の間は、 write() は送らずに _burst に控える
+
+  /**
+   * @brief Construct a new DisplayBase object
+   * 
+   * @param pin_cs SPI CS ピン番号
+   * @param buffer グラフィックを保持している Buffer オブジェクト
+   * @param device_count MAX7219 モジュールの個数
+   * @param commands 送信待ちレジスタの記録先。 <code>device_count * CommandStride</code> バイトを 0 で初期化しておく
+   * @param burst transmitFrame() でまとめて送る行の控え。 <code>burst_capacity * device_count * 2</code> バイト
+   * @param burst_capacity @c burst に控えられる行数
+   */
+  DisplayBase(const int pin_cs, const IBuffer &buffer, size_t device_count, uint8_t *commands, uint8_t *burst, size_t burst_capacity);
 
   /**
    * @brief すべての MAX7219 に同じ命令を送る
@@ -29,16 +61,71 @@ private:
    */
   void broadcast(uint8_t address, uint8_t data) const;
 
-public:
   /**
-   * @brief Construct a new Display object
+   * @brief CS を LOW にしてから @c data を送り、CS を HIGH に戻す
    * 
-   * @param buffer グラフィックを保持している Buffer オブジェクト
-   * @param pin_cs SPI CS ピン番号
-   * @param devices デイジーチェーン接続された MAX7219 モジュールの相対位置や順序の設定
-   * @note @c devices の順序は、マスター (ESP8266) から見て遠い順に書く。
+   * beginBurst() から endBurst() までの間は、送らずに _burst に控える。
+   * 
+   * @param data 送信するデータ（遠いデバイス宛てのものから順に並べる）
+   * @param size @c data のバイト数
+   */
+  void write(const uint8_t *data, size_t size) const;
+
+  /**
+   * @brief 以後の write() を、送らずに _burst に控えるようにする
+   */
+  void beginBurst() const;
+
+  /**
+   * @brief beginBurst() から控えた行を、1 行ずつ CS を上げ下げしながら送り始める
+   * 
+   * ESP8266 では、1 行を SPI の FIFO に詰めて送信を始めたらすぐに戻り、
+   * 残りの行は送信完了の割り込みで順に送る。そのほかの環境では、送り終えてから戻る。
+   */
+  void endBurst() const;
+
+  /**
+   * @brief commit() されたまま送信されていないフレームを捨てる
+   * 
+   * MAX7219 の表示内容を直接書き換えたときに、古いフレームが後から送られないようにする。
+   * hold() も解除される。
+   */
+  void discardFrames() const;
+
+  /**
+   * @brief デバイス @c device のレジスタ @c address への書き込みを送信待ちにする
+   * 
+   * 同じレジスタへの書き込みが既に送信待ちなら、新しい値で上書きする。
+   * 
+   * @param device デバイスの番号（遠い方から 0, 1, ...）
+   * @param address QUEUED_REGISTERS のいずれか
+   * @param data データ
+   */
+  void queueCommand(size_t device, uint8_t address, uint8_t data) const;
+
+  /**
+   * @brief 1 行分の送信データのうち OP_NOOP のデバイスに、送信待ちのレジスタ書き込みを 1 つずつ詰める
+   * 
+   * @param[in,out] spiData 1 行分の送信データ（デバイスの個数 * 2 バイト）
+   */
+  void fillCommands(uint8_t *spiData) const;
+
+  /**
+   * @brief 1 行分の送信データに、送信待ちのレジスタ書き込みを詰めてから送る
+   * 
+   * @param spiData 1 行分の送信データ（デバイスの個数 * 2 バイト）
+   */
+  void writeRow(const uint8_t *spiData) const;
+
+  /**
+   * @brief 送信待ちのレジスタ書き込みを、デバイスごとに 1 つずつ送る
+   * 
+   * @retval true 送った
+   * @retval false 送信待ちの書き込みはなかった
    */
-  Display(const int pin_cs, const IBuffer &buffer, const std::vector<setting_t> &devices);
+  bool flushCommandsOnce() const;
+
+public:
   /**
    * @brief MAX7219 を初期化する
    */
@@ -47,38 +134,420 @@ public:
    * @brief TEST MODE（全ドット点灯）の入切
    * 
    * @param value true = テストモード、false = 通常モード
+   * @note 送信待ちになる（ flush() を参照）。
    */
   void testMode(bool value) const;
   /**
    * @brief SHUTDOWN MODE（全ドット消灯）の入切
    * 
    * @param value true = シャットダウン、false = 復帰
+   * @note 送信待ちになる（ flush() を参照）。
    */
   void shutdownMode(bool value) const;
   /**
    * @brief 明るさを設定
    * 
    * @param intensity 明るさ（0 から 15 まで）
-   * @note 全てのデバイスに同じ値が設定される。
+   * @note 全てのデバイスに同じ値が設定される。送信待ちになる（ flush() を参照）。
    */
   void setIntensity(uint8_t intensity) const;
   /**
-   * @brief 明るさを設定
+   * @brief 送信待ちのレジスタ書き込みがあるか
+   */
+  bool hasPendingCommands() const;
+  /**
+   * @brief 送信待ちのレジスタ書き込みを、すぐにすべて送る
    * 
-   * @param intensities デバイスごとの明るさ（0 から 15 まで）
-   * @pre @c intensities の要素数は、コンストラクタ Display::Display() の引数 @c devices の要素数と一致しなければならない。
+   * testMode()、shutdownMode()、setIntensity() による書き込みは、すぐには送られずに送信待ちになり、
+   * 次に送る行（send()、sendChanged()、transmitStep()）のうち OP_NOOP のデバイスの枠に詰めて送られる。
+   * 同じレジスタへの書き込みが重なった場合は、最後の値だけが送られる。
    */
-  void setIntensity(std::vector<uint8_t> intensities) const;
+  void flush() const;
   /**
    * @brief 全ドットクリア（IBuffer の内容は変化しない）
    */
   void clearAll() const;
+  /**
+   * @brief 直前の send() または sendChanged() で SPI に送ったバイト数を取得（計測用）
+   * 
+   * commit() で送った場合は、送信中（または最後に送信した）フレームのバイト数を返す。
+   */
+  size_t getLastSentBytes() const;
+  /**
+   * @brief commit() されたフレームのうち、まだ送信が終わっていないものがあるか
+   */
+  bool isTransmitting() const;
+  /**
+   * @brief commit() されたフレームのうち、まだ送っていない行の数を取得する（送信中と送信待ちの合計）
+   */
+  size_t getPendingRows() const;
+  /**
+   * @brief transmitFrame() で送り始めた行が、まだ送り終わっていないか
+   */
+  bool isBursting() const;
+  /**
+   * @brief transmitFrame() で送り始めた行を、送り終えるまで待つ
+   * 
+   * SPI のクロック周波数を変えるなど、SPI を直接使う前に呼ぶ。
+   * このクラスの中で SPI を使うところ（ send() や init() など）は、自分で待つ。
+   */
+  void waitTransmitted() const;
+  /**
+   * @brief transmitFrame() で送り始めた行を、最後に送り終えた時刻を取得する（計測用）
+   * 
+   * @return 送り終えたときの micros() の値
+   */
+  uint32_t getTransmittedAt() const;
+  /**
+   * @brief 以後 commit() されるフレームを、release() が呼ばれるまで送らずに持っておく
+   * 
+   * 送信中のフレームの残りと、送信待ちのレジスタ書き込みは、これまで通り transmitStep() で送られる。
+   * 先に描いておいた画面を、決まった時刻にまとめて送りたいときに使う。
+   */
+  void hold() const;
+  /**
+   * @brief hold() を解除する。持っていたフレームは、次の transmitStep() から送られる
+   */
+  void release() const;
+  /**
+   * @brief hold() されているか
+   */
+  bool isHolding() const;
+  /**
+   * @brief 検査パターンをデイジーチェーンに通し、最後の MAX7219 の DOUT から読み戻せるか調べる
+   * 
+   * 検査パターンのアドレス部はすべて OP_NOOP なので、正しく届けば表示内容は変化しない。
+   * 
+   * @param seed 検査パターンを変えるための値
+   * @retval true 送ったパターンをそのまま読み戻せた
+   * @retval false 読み戻せなかった（通信が化けている）
+   * @pre 最後の MAX7219 の DOUT が MISO に接続されていること
+   */
+  bool loopback(uint8_t seed) const;
+};
+
+template <class TLayout>
+class Display;
+
+/**
+ * @brief IBuffer が保持しているグラフィックを実際に MAX7219 に送信するクラス
+ * 
+ * @tparam Devices デイジーチェーン接続された MAX7219 モジュールの setting_t（マスター (ESP8266) から見て遠い順）
+ * 
+ * モジュールの位置・向きはテンプレート引数として与えるので、
+ * send() の内部ループはモジュールごとに展開され、向きによる分岐もコンパイル時に解決される。
+ * 
+ * @par 非同期送信
+ * @parblock
+ * send() / sendChanged() は 1 フレーム分を送り終わるまで戻らない。
+ * 代わりに commit() を使うと、その時点の IBuffer の内容（前回からの差分）を内部のフレームに控えるだけで、すぐに戻る。
+ * 実際の送信は transmitFrame()（1 フレームずつ）か transmitStep()（1 行ずつ）で行われるので、タイマー等から呼び出すこと。
+ * ESP8266 では、transmitFrame() は行を SPI の FIFO に詰めて送り始めるだけで、残りは SPI の割り込みで送られる。
+ * 
+ * 控えたフレームは「送信中 (front)」と「送信待ち (back)」の 2 枚で、
+ * 送信中のフレームを送り終えるまでは次のフレームの行を 1 行も送らない。
+ * 送信中に commit() を繰り返した場合は、送信待ちのフレームに上書きでまとめられる。
+ * したがって、新旧のフレームの行が混ざった状態で表示が止まることはない。
+ * 
+ * testMode()、shutdownMode()、setIntensity() による書き込みも送信待ちになり、フレームの行と同じ送信にまとめられる。
+ * 送るべき行がないときは、transmitStep() がそれだけを送る。
+ * 
+ * @note commit() と transmitStep() は同時に実行されてはならない。
+ *       ESP8266 の Ticker のコールバックは loop() と並行しては走らないので、そのまま使ってよい。
+ * @endparblock
+ * 
+ * @code
+ * using MyLayout = MAX7219::layout_t<
+ *     MAX7219::setting_t<8, 0, MAX7219::Rotate::_0, false>,
+ *     MAX7219::setting_t<0, 0, MAX7219::Rotate::_0, false>>;
+ * MAX7219::Display<MyLayout> display(pin_cs, buffer);
+ * @endcode
+ */
+template <class... Devices>
+class Display<layout_t<Devices...>> : public DisplayBase {
+private:
+  using TLayout = layout_t<Devices...>;
+  using expand  = int[];
+
+  static constexpr size_t DeviceCount   = TLayout::size;
+  static constexpr size_t RowBytes      = DeviceCount * 2;
+  static constexpr size_t BurstCapacity = 8 + QueuedRegisterCount; //! 1 フレームと、送信待ちのレジスタ書き込みを送り切れる行数
+
+  // ESP8266 の SPI の FIFO（ 64 バイト）に 1 行が収まること
+  static_assert(RowBytes <= 64, "too many devices in the chain");
+
+  mutable uint8_t _frames[2][8][RowBytes]; //! commit() で控えたフレーム。 _front_frame 番目が送信中、もう一方が送信待ち
+  mutable uint8_t _front_frame = 0;        //! _frames のうち、送信中のフレームの番号
+
+  mutable uint8_t _command_queue[DeviceCount * CommandStride] = {}; //! DisplayBase::_commands の実体
+  mutable uint8_t _burst_buffer[BurstCapacity][RowBytes];           //! DisplayBase::_burst の実体
+
+  /**
+   * @brief デバイス @e TDevice の 8 行分のデータを取り出す
+   * 
+   * @param changed_only true なら、変化のないデバイスは取り出さない
+   * @param[out] block 要素数 8 の配列
+   * @return true デバイスの表示内容が変化した（ @c block に値が入る）
+   */
+  template <class TDevice>
+  bool fetchBlock(bool changed_only, uint8_t *block) const {
+    if (changed_only && !_buffer->isChangedArea(TDevice::topleft_x, TDevice::topleft_y, 8, 8))
+      return false;
+
+    arrangeBlock<TDevice::rotation, TDevice::reverse>(_buffer->getBlockFrom(TDevice::topleft_x, TDevice::topleft_y), block);
+    return true;
+  }
+
+  /**
+   * @brief デバイス @e TDevice 宛ての 1 行分のデータ（2 バイト）を埋める
+   * 
+   * @param row 行（0 = LED 上端 = OP_DIGIT7）
+   * @param changed_only true なら、変化のない行には OP_NOOP を送る
+   * @param block_changed fetchBlock() の戻り値
+   * @param block fetchBlock() で取り出したデータ
+   * @param[out] spiData 送信データの書き込み先
+   * @return true OP_NOOP 以外を書き込んだ
+   */
+  template <class TDevice>
+  bool fillRow(size_t row, bool changed_only, bool block_changed, const uint8_t *block, uint8_t *spiData) const {
+    if (changed_only && (!block_changed || !_buffer->isChangedArea(TDevice::rowX(row), TDevice::rowY(row), TDevice::row_width, TDevice::row_height))) {
+      // 変化のないデバイスは読み飛ばさせる
+      spiData[0] = OP_NOOP;
+      spiData[1] = 0;
+      return false;
+    }
+
+    // MAX7219 モジュールでは、LED 上端が OP_DIGIT7、下端が OP_DIGIT0 に対応する。
+    spiData[0] = OP_DIGIT7 - row;
+    spiData[1] = block[row];
+    return true;
+  }
+
+  /**
+   * @brief IBuffer の内容を 1 行（OP_DIGIT0 ～ OP_DIGIT7 のどれか）ずつ、MAX7219 に送る形に組み立てる
+   * 
+   * @param changed_only true なら変化したデバイス・行だけを組み立てる（変化のない行は @c emit を呼ばない）
+   * @param emit 1 行組み立てるごとに <code>emit(size_t row, const uint8_t *spiData)</code> の形で呼ばれる
+   */
+  template <class TEmit>
+  void buildRows(bool changed_only, TEmit emit) const {
+
+    // バッファが同じ並びのデータを持っていれば、並べ替える必要はない
+    const uint8_t *frame;
+    const uint8_t *sent;
+    if (_buffer->getNativeFrame(TLayout::tag(), frame, sent)) {
+
+      for (size_t row = 0; row < 8; row++, frame += RowBytes) {
+
+        if (!changed_only || !sent) {
+          emit(row, frame);
+          continue;
+        }
+
+        const uint8_t *prev = sent + row * RowBytes;
+        if (memcmp(frame, prev, RowBytes) == 0)
+          continue;
+
+        // 変化のないデバイスは読み飛ばさせる
+        uint8_t spiData[RowBytes];
+        for (size_t i = 0; i < RowBytes; i += 2) {
+          bool changed   = frame[i + 1] != prev[i + 1];
+          spiData[i]     = changed ? frame[i] : OP_NOOP;
+          spiData[i + 1] = changed ? frame[i + 1] : 0;
+        }
+        emit(row, spiData);
+      }
+      return;
+    }
+
+    // デバイスごとに、8 行分のデータをまとめて取り出しておく
+    uint8_t blocks[DeviceCount][8];
+    bool    block_changed[DeviceCount];
+
+    size_t i = 0;
+    (void)expand{0, (block_changed[i] = fetchBlock<Devices>(changed_only, blocks[i]), ++i, 0)...};
+
+    for (size_t row = 0; row < 8; row++) {
+
+      uint8_t spiData[RowBytes];
+      bool    row_changed = false;
+
+      // 遠いデバイスから順に詰める
+      i = 0;
+      (void)expand{0, (row_changed |= fillRow<Devices>(row, changed_only, block_changed[i], blocks[i], spiData + i * 2), ++i, 0)...};
+
+      // この行に変化したデバイスが 1 つもなければ、CS を動かす必要もない
+      if (!row_changed)
+        continue;
+
+      emit(row, spiData);
+    }
+  }
+
+  /**
+   * @brief IBuffer の内容を 1 行（OP_DIGIT0 ～ OP_DIGIT7 のどれか）ずつ MAX7219 に送る
+   * 
+   * @param changed_only true なら変化したデバイス・行だけを送る
+   */
+  void sendRows(bool changed_only) const {
+
+#ifdef DEBUG_MAX7219DISPLAY_BUFFER
+    _buffer->printToSerial();
+#endif
+
+    if (changed_only) {
+      // 控えてあるフレームは、IBuffer 上では送信済みの扱いになっているので、保留中のものも含めて先に送り切る
+      _holding = false;
+      while (transmitStep())
+        ;
+    } else {
+      // 全部送り直すので、控えてあるフレームは不要
+      discardFrames();
+    }
+
+    _sent_bytes = 0;
+    buildRows(changed_only, [this](size_t, const uint8_t *spiData) {
+      writeRow(spiData);
+    });
+    _buffer->markAsSent();
+
+    // 行の隙間に詰め切れなかった分を送る
+    flush();
+  }
+
+public:
+  /**
+   * @brief Construct a new Display object
+   * 
+   * @param pin_cs SPI CS ピン番号
+   * @param buffer グラフィックを保持している Buffer オブジェクト
+   */
+  Display(const int pin_cs, const IBuffer &buffer)
+      : DisplayBase(pin_cs, buffer, DeviceCount, _command_queue, _burst_buffer[0], BurstCapacity) {}
+
+  using DisplayBase::setIntensity;
+
+  /**
+   * @brief 明るさを設定
+   * 
+   * @param intensities デバイスごとの明るさ（0 から 15 まで）。 @e Devices と同じ順に並べる。
+   * @note 送信待ちになる（ flush() を参照）。
+   */
+  void setIntensity(const std::array<uint8_t, DeviceCount> &intensities) const {
+
+    for (size_t i = 0; i < DeviceCount; i++)
+      queueCommand(i, OP_INTENSITY, intensities[i]);
+  }
+
   /**
    * @brief IBuffer の現在の内容を MAX7219 に送る
    */
-  void send() const;
+  void send() const {
+    sendRows(false);
+  }
+
+  /**
+   * @brief IBuffer の内容のうち、前回の送信から変化した部分だけを MAX7219 に送る
+   * 
+   * 変化のない行は送信自体を省略し、変化のないデバイスには OP_NOOP を送る。
+   */
+  void sendChanged() const {
+    sendRows(true);
+  }
+
+  /**
+   * @brief IBuffer の内容のうち、前回の送信（または commit()）から変化した部分を送信待ちにする
+   * 
+   * 実際の送信は transmitStep() で行われる。
+   * 送信待ちのフレームが既にあれば、それに上書きでまとめる。
+   */
+  void commit() const {
+
+    auto back = _frames[_front_frame ^ 1];
+
+    buildRows(true, [this, back](size_t row, const uint8_t *spiData) {
+      uint8_t bit = 1U << row;
+
+      if (!(_back_rows & bit)) {
+        memcpy(back[row], spiData, RowBytes);
+        _back_rows |= bit;
+        return;
+      }
+
+      // 送信待ちの行と重ねる。今回変化のないデバイスは、前回の内容を残す
+      for (size_t i = 0; i < RowBytes; i += 2) {
+        if (spiData[i] == OP_NOOP)
+          continue;
+        back[row][i]     = spiData[i];
+        back[row][i + 1] = spiData[i + 1];
+      }
+    });
+    _buffer->markAsSent();
+  }
+
+  /**
+   * @brief commit() されたフレームを 1 行だけ送る
+   * 
+   * 送るべき行がなければ、送信待ちのレジスタ書き込みだけを送る。
+   * hold() されている間は、送信待ちのフレームは送らない。
+   * 
+   * @retval true まだ送っていない行（またはレジスタ書き込み）が残っている
+   * @retval false 今送るべきものはもう無い
+   */
+  bool transmitStep() const {
+
+    if (!_front_rows && _back_rows && !_holding) {
+      // 送信中のフレームを送り終えたので、送信待ちのフレームに切り替える
+      _front_frame ^= 1;
+      _front_rows  = _back_rows;
+      _back_rows   = 0;
+      _sent_bytes  = 0;
+    }
+
+    if (_front_rows) {
+      // 上の行から順に送る
+      size_t row = 0;
+      while (!(_front_rows & (1U << row)))
+        row++;
+
+      writeRow(_frames[_front_frame][row]);
+      _front_rows &= ~(1U << row);
+
+    } else if (!flushCommandsOnce()) {
+      return false;
+    }
+
+    return _front_rows || (_back_rows && !_holding) || hasPendingCommands();
+  }
+
+  /**
+   * @brief commit() されたフレームの残りの行と、送信待ちのレジスタ書き込みを、まとめて送る
+   * 
+   * transmitStep() を間をあけて呼ぶと、1 フレームを送り終えるまでの間、新旧のフレームの行が混ざって表示される。
+   * こちらは 1 回で送り切るので、混ざって見えるのは SPI で送っている間だけになる。
+   * 
+   * 送る行は控えておいて、endBurst() でまとめて送り始める（ESP8266 では送り終わるのを待たずに戻る）。
+   * 前回送り始めた行をまだ送っている間は、何もしない。
+   * 
+   * @retval true まだ送っていないフレームが残っている（送信中のフレームを送り切った後に、送信待ちのフレームがある）
+   * @retval false 今送るべきものはもう無い
+   */
+  bool transmitFrame() const {
+
+    if (isBursting())
+      return true;
+
+    bool remaining;
+    beginBurst();
+    do {
+      remaining = transmitStep();
+    } while (remaining && (_front_rows || hasPendingCommands()) && _burst_rows < _burst_capacity);
+    endBurst();
+
+    return remaining;
+  }
 };
 
 }; // namespace MAX7219
 
-#endif // MAX7219Display_Display_H_
\ No newline at end of file
+#endif // MAX7219Display_Display_H_
@@ -13,6 +13,7 @@ namespace MAX7219 {
  * @brief Buffer に対する読み取り専用操作を提供するインターフェイス
  * 
  * Display からはこのインターフェイスを扱い、Buffer を直接触らない。
+ * グラフィックそのものは変更しないが、「どこまで送信済みか」の記録だけは Display から更新される。
  */
 class IBuffer {
 public:
@@ -36,6 +37,55 @@ public:
    */
   virtual const uint8_t getVerticalFrom(size_t x, size_t y, bool swap) const = 0;
 
+  /**
+   * @brief 座標 (x,y) を左上隅とする 8x8 の領域を、64 ビットにまとめて取得
+   * 
+   * 戻り値の i バイト目の j ビット目が、座標 (x + 7 - j, y + i) に対応する。
+   * MAX7219 に送る形への並べ替えは arrangeBlock() で行う。
+   * 
+   * @param x 左上隅の x 座標
+   * @param y 左上隅の y 座標
+   * @return 8x8 の領域を表す値
+   */
+  virtual uint64_t getBlockFrom(size_t x, size_t y) const = 0;
+
+  /**
+   * @brief 指定領域が、最後に markAsSent() を呼んだ時から変化しているか調べる
+   * 
+   * @param x 領域の左上隅の x 座標
+   * @param y 領域の左上隅の y 座標
+   * @param width 領域の幅
+   * @param height 領域の高さ
+   * @retval true 変化している（送信が必要）
+   * @retval false 変化していない
+   */
+  virtual bool isChangedArea(size_t x, size_t y, size_t width, size_t height) const = 0;
+
+  /**
+   * @brief 現在の内容を「送信済み」として記録する
+   */
+  virtual void markAsSent() const = 0;
+
+  /**
+   * @brief 全領域を「未送信」として扱うようにする
+   * 
+   * MAX7219 側の表示内容がバッファと食い違った（初期化した、全消去した等）ときに呼ぶ。
+   */
+  virtual void markAllAsChanged() const = 0;
+
+  /**
+   * @brief MAX7219 に送る形のまま保持しているデータを取得
+   * 
+   * DeviceNativeStorage を使っている場合に限り、Display はこれを並べ替えずにそのまま送る。
+   * 
+   * @param layout_tag 送信先の Display の layout_t::tag()
+   * @param[out] frame 8 行分の送信データ（1 行 = デバイスの個数 * 2 バイト、上端の行から順に並ぶ）
+   * @param[out] sent 最後に markAsSent() を呼んだ時点の @c frame 。全領域が未送信なら nullptr
+   * @retval true @c layout_tag の並びのデータを保持している（ @c frame と @c sent に値が入る）
+   * @retval false 保持していない
+   */
+  virtual bool getNativeFrame(const void *layout_tag, const uint8_t *&frame, const uint8_t *&sent) const = 0;
+
   /**
    * @brief バッファの幅を取得
    */
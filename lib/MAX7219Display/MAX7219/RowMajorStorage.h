@@ -0,0 +1,103 @@
+/**
+ * @file RowMajorStorage.h
+ */
+
+#ifndef MAX7219Display_RowMajorStorage_H_
+#define MAX7219Display_RowMajorStorage_H_
+
+#include "bitrow.h"
+#include <array>
+#include <stdint.h>
+#include <string.h>
+
+namespace MAX7219 {
+
+/**
+ * @brief BufferBase の記憶方式のひとつ。バッファ全体を 1 行 = 1 個の bitrow として保持する（既定）
+ * 
+ * @tparam BufferWidth バッファ領域の幅
+ * @tparam BufferHeight バッファ領域の高さ
+ * 
+ * モジュールの並びに依存しないので、どの Display とも組み合わせられる。
+ * 
+ * @par 記憶方式の要件
+ * @parblock
+ * BufferBase の @e TStorage に指定するクラスは、次の public メンバを持っている必要があります。
+ * 
+ * @code
+ * using TRow  = MAX7219::bitrow<BufferWidth>;
+ * using TWord = typename TRow::word_t;
+ * static constexpr size_t FrameBytes;                // saveFrame() / loadFrame() でやりとりするバイト数
+ * TRow getRow(size_t y) const;                       // y 行目の現在の内容
+ * TRow getSentRow(size_t y) const;                   // y 行目の送信済みの内容
+ * void assignRow(size_t y, TWord value, TWord mask); // y 行目の mask 部分を value で置き換える
+ * void reset();                                      // 全領域をクリア
+ * void markAsSent() const;                           // 現在の内容を送信済みとして控える
+ * void saveFrame(uint8_t *dest) const;               // 現在の内容を dest に書き出す
+ * void loadFrame(const uint8_t *src);                // saveFrame() で書き出した内容に戻す
+ * bool getNativeFrame(const void *layout_tag, const uint8_t *&frame, const uint8_t *&sent) const;
+ * @endcode
+ * @endparblock
+ */
+template <size_t BufferWidth, size_t BufferHeight>
+class RowMajorStorage {
+public:
+  using TRow  = MAX7219::bitrow<BufferWidth>;
+  using TWord = typename TRow::word_t;
+
+private:
+  using TBuffer = std::array<TRow, BufferHeight>;
+
+  TBuffer         _buffer;      //! グラフィックを保持している配列（VRAMのようなもの）
+  mutable TBuffer _sent_buffer; //! 最後に送信した時点の _buffer（変更された範囲を追跡するため）
+
+public:
+  static constexpr size_t FrameBytes = sizeof(TBuffer);
+
+  RowMajorStorage() {
+
+    _buffer      = TBuffer();
+    _sent_buffer = TBuffer();
+  }
+
+  TRow getRow(size_t y) const {
+    return _buffer[y];
+  }
+
+  TRow getSentRow(size_t y) const {
+    return _sent_buffer[y];
+  }
+
+  void assignRow(size_t y, TWord value, TWord mask) {
+    _buffer[y].assign(value, mask);
+  }
+
+  void reset() {
+
+    for (size_t i = 0; i < _buffer.size(); i++)
+      _buffer[i].reset();
+  }
+
+  void markAsSent() const {
+    _sent_buffer = _buffer;
+  }
+
+  void saveFrame(uint8_t *dest) const {
+    memcpy(dest, &_buffer, FrameBytes);
+  }
+
+  void loadFrame(const uint8_t *src) {
+    memcpy(&_buffer, src, FrameBytes);
+  }
+
+  /**
+   * @brief MAX7219 に送る形のデータは持っていないので、常に false を返す
+   */
+  bool getNativeFrame(const void *layout_tag, const uint8_t *&frame, const uint8_t *&sent) const {
+    return false;
+  }
+};
+
+} // namespace MAX7219
+
+#endif // MAX7219Display_RowMajorStorage_H_
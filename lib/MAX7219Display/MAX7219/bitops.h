@@ -0,0 +1,89 @@
+/**
+ * @file bitops.h
+ * @brief フレームバッファを MAX7219 の並びに変換するためのビット演算
+ */
+
+#ifndef MAX7219Display_bitops_H_
+#define MAX7219Display_bitops_H_
+
+#include "setting_t.h"
+#include <Arduino.h>
+#include <stdint.h>
+
+namespace MAX7219 {
+
+//! REVERSED_BITS[b] は b の MSB と LSB を入れ替えた値
+extern const uint8_t REVERSED_BITS[256] PROGMEM;
+
+/**
+ * @brief 1 バイトの MSB と LSB を入れ替える
+ * 
+ * @param b 入れ替える値
+ * @return ビットの並びを逆順にした値
+ */
+inline uint8_t reverseBits(uint8_t b) {
+  return pgm_read_byte(&REVERSED_BITS[b]);
+}
+
+/**
+ * @brief 8x8 のビット行列を転置する
+ * 
+ * 行列の (i, j) 要素を、 @c m の <code>8 * i + j</code> ビット目とみなす。
+ * すなわち、入力の i バイト目の j ビット目が、出力の j バイト目の i ビット目に移る。
+ * 
+ * @param m 転置する行列
+ * @return 転置後の行列
+ */
+inline uint64_t transpose8x8(uint64_t m) {
+  uint64_t t;
+  t = (m ^ (m >> 7)) & 0x00AA00AA00AA00AAULL;
+  m ^= t ^ (t << 7);
+  t = (m ^ (m >> 14)) & 0x0000CCCC0000CCCCULL;
+  m ^= t ^ (t << 14);
+  t = (m ^ (m >> 28)) & 0x00000000F0F0F0F0ULL;
+  m ^= t ^ (t << 28);
+  return m;
+}
+
+/**
+ * @brief IBuffer::getBlockFrom() で取り出した 8x8 の領域を、MAX7219 に送る順番・向きに並べ替える
+ * 
+ * @tparam Rotation マトリックスLED の向き
+ * @tparam Reverse 反転させるかどうか（ setting_t::reverse と同じ意味）
+ * @param block IBuffer::getBlockFrom() の戻り値
+ * @param[out] retval 要素数 8 の配列。 @c retval[0] が OP_DIGIT7（LED 上端）、 @c retval[7] が OP_DIGIT0 に送る値になる
+ * @note 分岐はすべてテンプレート引数で決まるので、コンパイル時に畳み込まれる。
+ */
+template <Rotate Rotation, bool Reverse>
+inline void arrangeBlock(uint64_t block, uint8_t *retval) {
+
+  if (Rotation == Rotate::Clockwise || Rotation == Rotate::Counterclockwise) {
+    // 転置すると、cols の j バイト目が x + 7 - j 列目（上端 = LSB）になる
+    uint64_t cols = transpose8x8(block);
+
+    for (size_t row = 0; row < 8; row++) {
+      if (Rotation == Rotate::Clockwise) {
+        auto col    = static_cast<uint8_t>(cols >> (8 * (7 - row)));
+        retval[row] = Reverse ? col : reverseBits(col);
+      } else {
+        auto col    = static_cast<uint8_t>(cols >> (8 * row));
+        retval[row] = Reverse ? reverseBits(col) : col;
+      }
+    }
+
+  } else {
+    for (size_t row = 0; row < 8; row++) {
+      if (Rotation == Rotate::_180) {
+        auto b      = static_cast<uint8_t>(block >> (8 * (7 - row)));
+        retval[row] = Reverse ? reverseBits(b) : b;
+      } else {
+        auto b      = static_cast<uint8_t>(block >> (8 * row));
+        retval[row] = Reverse ? b : reverseBits(b);
+      }
+    }
+  }
+}
+
+} // namespace MAX7219
+
+#endif // MAX7219Display_bitops_H_
@@ -0,0 +1,212 @@
+/**
+ * @file bitrow.h
+ */
+
+#ifndef MAX7219Display_bitrow_H_
+#define MAX7219Display_bitrow_H_
+
+#include "bitops.h"
+#include <Arduino.h>
+#include <assert.h>
+#include <string>
+#include <type_traits>
+
+namespace MAX7219 {
+
+/**
+ * @brief 要素数 @e N 以上のビット幅を持つ、最小の符号なし整数型
+ * 
+ * @tparam N ビット数（64 以下）
+ */
+template <size_t N>
+using bitrow_word_t = typename std::conditional<
+    N <= 8, uint8_t,
+    typename std::conditional<
+        N <= 16, uint16_t,
+        typename std::conditional<N <= 32, uint32_t, uint64_t>::type>::type>::type;
+
+/**
+ * @brief フレームバッファの 1 行を、1 個のネイティブ整数として保持するクラス
+ * 
+ * std::bitset と異なり、範囲指定の操作はすべて constexpr なマスクとシフトで行うので、
+ * ヒープ確保やビット単位のループが発生しない。
+ * 
+ * @tparam N 要素数（1 以上 64 以下）
+ * @note LSB = 右端が 0 番目であることに注意
+ */
+template <size_t N>
+class bitrow {
+  static_assert(N > 0 && N <= 64, "bitrow supports 1 to 64 bits");
+
+public:
+  using word_t = bitrow_word_t<N>;
+
+  //! 全ビットが 1 のマスク
+  static constexpr word_t ALL = static_cast<word_t>(~static_cast<word_t>(0) >> (sizeof(word_t) * 8 - N));
+
+  /**
+   * @brief 範囲 <code>[start, start + length)</code> のビットだけが 1 のマスクを作る
+   * 
+   * @param start 範囲の始点
+   * @param length 範囲の長さ（N を超える部分は切り捨てられる）
+   */
+  static constexpr word_t mask(size_t start, size_t length) {
+    return start >= N || length == 0
+               ? 0
+               : static_cast<word_t>((ALL >> (N - (length < N - start ? length : N - start))) << start);
+  }
+
+private:
+  word_t _bits;
+
+public:
+  constexpr bitrow()
+      : _bits(0) {}
+
+  constexpr explicit bitrow(word_t value)
+      : _bits(value & ALL) {}
+
+  /**
+   * @brief 内部表現をそのまま取得
+   */
+  constexpr word_t to_word() const {
+    return _bits;
+  }
+
+  /**
+   * @brief @c pos 番目のビットを取得
+   * 
+   * @pre <code>pos @< N</code>（さもなければ assert failed）
+   */
+  bool test(size_t pos) const {
+    assert(pos < N);
+    return (_bits >> pos) & 1U;
+  }
+
+  /**
+   * @brief @c pos 番目のビットを設定
+   * 
+   * @pre <code>pos @< N</code>（さもなければ assert failed）
+   */
+  void set(size_t pos, bool val = true) {
+    assert(pos < N);
+    if (val)
+      _bits |= static_cast<word_t>(static_cast<word_t>(1) << pos);
+    else
+      _bits &= static_cast<word_t>(~(static_cast<word_t>(1) << pos));
+  }
+
+  /**
+   * @brief 全ビットを 0 にする
+   */
+  void reset() {
+    _bits = 0;
+  }
+
+  /**
+   * @brief 1 のビットが 1 つでもあるか
+   */
+  bool any() const {
+    return _bits != 0;
+  }
+
+  /**
+   * @brief @c mask が 1 のビットだけを @c value の値で置き換える
+   * 
+   * @param value 新しい値
+   * @param mask 置き換える範囲
+   */
+  void assign(word_t value, word_t mask) {
+    _bits = static_cast<word_t>((_bits & ~mask) | (value & mask));
+  }
+
+  /**
+   * @brief bitrow の範囲 <code>[start, start + length)</code> のビットをすべて 1 または 0 にする
+   * 
+   * @param start 範囲の始点
+   * @param length 範囲の長さ
+   * @param val true なら 1 が、false なら 0 が指定の範囲にセットされる
+   * @pre <code>start @< N</code>（さもなければ assert failed）
+   */
+  void setRange(size_t start, size_t length, bool val = true) {
+    assert(start < N);
+    if (val)
+      _bits |= mask(start, length);
+    else
+      _bits &= static_cast<word_t>(~mask(start, length));
+  }
+
+  /**
+   * @brief bitrow の範囲 <code>[start, start + length)</code> のビットを反転させる
+   * 
+   * @param start 範囲の始点
+   * @param length 範囲の長さ
+   * @pre <code>start @< N</code>（さもなければ assert failed）
+   */
+  void flipRange(size_t start, size_t length) {
+    assert(start < N);
+    _bits ^= mask(start, length);
+  }
+
+  /**
+   * @brief MSB と LSB を入れ替える
+   */
+  void swap() {
+    // 1 バイトずつ表引きで反転させながら並べ替え、余分な下位ビットを捨てる
+    uint64_t old = _bits;
+    uint64_t rev = 0;
+    for (size_t i = 0; i < sizeof(word_t); i++, old >>= 8)
+      rev = (rev << 8) | reverseBits(static_cast<uint8_t>(old));
+    _bits = static_cast<word_t>(rev >> (sizeof(word_t) * 8 - N));
+  }
+
+  /**
+   * @brief bitrow の範囲 <code>[start, start + Nout)</code> を、要素数 @e Nout の新しい bitrow にコピーして返す
+   * 
+   * @tparam Nout 範囲の長さ
+   * @param start 範囲の始点（負の値や、はみ出した部分は 0 で埋められる）
+   */
+  template <size_t Nout>
+  bitrow<Nout> range(ssize_t start) const {
+    using out_t = typename bitrow<Nout>::word_t;
+    if (start >= static_cast<ssize_t>(N) || start <= -static_cast<ssize_t>(Nout))
+      return bitrow<Nout>();
+    if (start >= 0)
+      return bitrow<Nout>(static_cast<out_t>(_bits >> start));
+    return bitrow<Nout>(static_cast<out_t>(static_cast<uint64_t>(_bits) << -start));
+  }
+
+  bitrow operator^(const bitrow &rhs) const {
+    return bitrow(_bits ^ rhs._bits);
+  }
+
+  bool operator==(const bitrow &rhs) const {
+    return _bits == rhs._bits;
+  }
+
+  bool operator!=(const bitrow &rhs) const {
+    return _bits != rhs._bits;
+  }
+
+  /**
+   * @brief MSB から順に、各ビットを文字に変換した文字列を返す（デバッグ用）
+   * 
+   * @param zero 0 を表す文字
+   * @param one 1 を表す文字
+   */
+  std::string to_string(char zero = '0', char one = '1') const {
+    std::string retval(N, zero);
+    for (size_t i = 0; i < N; i++) {
+      if (test(N - i - 1))
+        retval[i] = one;
+    }
+    return retval;
+  }
+};
+
+template <size_t N>
+constexpr typename bitrow<N>::word_t bitrow<N>::ALL;
+
+} // namespace MAX7219
+
+#endif // MAX7219Display_bitrow_H_
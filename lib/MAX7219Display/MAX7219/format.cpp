@@ -0,0 +1,145 @@
+/**
+ * @file format.cpp
+ */
+
+#include "format.h"
+#include <math.h>
+#include <string.h>
+
+namespace MAX7219 {
+
+namespace {
+
+/**
+ * @brief dtostrf(value, prec + 2, prec) が出力する文字列の構成
+ */
+struct real_layout_t {
+  bool   special;  //! nan または inf
+  bool   negative; //! 符号が付く
+  size_t spaces;   //! 先頭に詰める空白の数
+  size_t digits;   //! 整数部の桁数
+  double number;   //! 先頭の桁を 1 の位に持ってきた値（丸め済み）
+};
+
+real_layout_t layoutReal(double value, uint8_t prec) {
+
+  real_layout_t layout = {};
+
+  if (isnan(value) || isinf(value)) {
+    layout.special = true;
+    return layout;
+  }
+
+  // ここから先は dtostrf() と同じ演算順にしておかないと、丸めの境目で結果が変わる
+  double number = value;
+  if (number < 0.0) {
+    layout.negative = true;
+    number          = -number;
+  }
+
+  double rounding = 2.0;
+  for (uint8_t i = 0; i < prec; i++)
+    rounding *= 10.0;
+  rounding = 1.0 / rounding;
+  number += rounding;
+
+  double tenpow = 1.0;
+  layout.digits = 1;
+  while (number >= 10.0 * tenpow) {
+    tenpow *= 10.0;
+    layout.digits++;
+  }
+  layout.number = number / tenpow;
+
+  // 最小幅 prec + 2 に満たない分は空白で埋められる
+  int fill = prec + 2 - (prec > 0 ? prec + 1 : 0) - (layout.negative ? 1 : 0) - static_cast<int>(layout.digits);
+  if (fill > 0)
+    layout.spaces = fill;
+
+  return layout;
+}
+
+size_t lengthOf(const real_layout_t &layout, uint8_t prec) {
+
+  if (layout.special)
+    return 3;
+
+  return layout.spaces + (layout.negative ? 1 : 0) + layout.digits + (prec > 0 ? prec + 1 : 0);
+}
+
+} // namespace
+
+size_t formatInteger(long value, uint8_t zero_pad, char *buf) {
+
+  // LONG_MIN でも溢れないよう、絶対値は unsigned long で扱う
+  unsigned long magnitude = value < 0 ? 0UL - static_cast<unsigned long>(value) : static_cast<unsigned long>(value);
+
+  char   digits[3 * sizeof(long)];
+  size_t count = 0;
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+
+  size_t sign   = value < 0 ? 1 : 0;
+  size_t length = sign + count < zero_pad ? zero_pad : sign + count;
+  char  *p      = buf;
+
+  if (sign)
+    *p++ = '-';
+  for (size_t i = sign + count; i < length; i++)
+    *p++ = '0';
+  while (count)
+    *p++ = digits[--count];
+
+  *p = '\0';
+  return length;
+}
+
+size_t realLength(double value, uint8_t prec) {
+  return lengthOf(layoutReal(value, prec), prec);
+}
+
+size_t formatReal(double value, uint8_t prec, char *buf) {
+
+  real_layout_t layout = layoutReal(value, prec);
+
+  if (layout.special) {
+    strcpy(buf, isnan(value) ? "nan" : "inf");
+    return 3;
+  }
+
+  // 入りきらない先頭側は、位置だけ数えて書き込まない
+  size_t length = lengthOf(layout, prec);
+  size_t skip   = length > NUMBER_TEXT_SIZE - 1 ? length - (NUMBER_TEXT_SIZE - 1) : 0;
+  size_t pos    = 0;
+  char  *p      = buf;
+
+  auto put = [&](char c) {
+    if (pos++ >= skip)
+      *p++ = c;
+  };
+
+  for (size_t i = 0; i < layout.spaces; i++)
+    put(' ');
+  if (layout.negative)
+    put('-');
+
+  double number = layout.number;
+  size_t rest   = layout.digits + prec;
+  while (rest-- > 0) {
+    int8_t digit = static_cast<int8_t>(number);
+    if (digit > 9)
+      digit = 9;
+    put('0' + digit);
+    if (rest == prec && prec > 0)
+      put('.');
+    number -= digit;
+    number *= 10.0;
+  }
+
+  *p = '\0';
+  return length - skip;
+}
+
+} // namespace MAX7219
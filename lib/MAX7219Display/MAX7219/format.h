@@ -0,0 +1,53 @@
+/**
+ * @file format.h
+ * @brief 数値を、ヒープを使わずに文字列へ変換する関数
+ */
+
+#ifndef MAX7219Display_format_H_
+#define MAX7219Display_format_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace MAX7219 {
+
+//! formatInteger() / formatReal() に渡すバッファの大きさ（終端文字を含む）
+static constexpr size_t NUMBER_TEXT_SIZE = 2 + 8 * sizeof(long);
+
+/**
+ * @brief 整数を 10 進数の文字列に変換する
+ * 
+ * 結果は <code>sprintf(buf, "%0*ld", zero_pad, value)</code> と同じになる（ @c zero_pad が 0 ならば String(value) と同じ）。
+ * 
+ * @param value 変換する数値
+ * @param zero_pad 1 以上を指定すると、符号を含めてその文字数になるように 0 埋めする（ <code>NUMBER_TEXT_SIZE - 3</code> 以下）
+ * @param[out] buf 要素数 NUMBER_TEXT_SIZE 以上の配列
+ * @return 書き込んだ文字数（終端文字を除く）
+ */
+size_t formatInteger(long value, uint8_t zero_pad, char *buf);
+
+/**
+ * @brief String(value, prec) の長さを、文字列を作らずに求める
+ * 
+ * @param value 数値
+ * @param prec 小数部の桁数
+ * @return String(value, prec) の文字数
+ */
+size_t realLength(double value, uint8_t prec);
+
+/**
+ * @brief 実数を、String(value, prec) と同じ文字列に変換する
+ * 
+ * 丸め方・桁の取り出し方は ESP8266 コアの dtostrf() と同じ手順にしてあるので、1 ドット単位で同じ表示になる。
+ * 文字列が buf に入りきらない場合は、末尾側の <code>NUMBER_TEXT_SIZE - 1</code> 文字だけを書き込む。
+ * 
+ * @param value 変換する数値
+ * @param prec 小数部の桁数
+ * @param[out] buf 要素数 NUMBER_TEXT_SIZE 以上の配列
+ * @return 書き込んだ文字数（終端文字を除く）
+ */
+size_t formatReal(double value, uint8_t prec, char *buf);
+
+} // namespace MAX7219
+
+#endif // MAX7219Display_format_H_
@@ -0,0 +1,31 @@
+/**
+ * @file opcodes.h
+ * @brief MAX7219 のレジスタアドレス
+ */
+
+#ifndef MAX7219Display_opcodes_H_
+#define MAX7219Display_opcodes_H_
+
+#include <stdint.h>
+
+namespace MAX7219 {
+
+// opcodes for the MAX7221 and MAX7219
+static constexpr uint8_t OP_NOOP        = 0;
+static constexpr uint8_t OP_DIGIT0      = 1;
+static constexpr uint8_t OP_DIGIT1      = 2;
+static constexpr uint8_t OP_DIGIT2      = 3;
+static constexpr uint8_t OP_DIGIT3      = 4;
+static constexpr uint8_t OP_DIGIT4      = 5;
+static constexpr uint8_t OP_DIGIT5      = 6;
+static constexpr uint8_t OP_DIGIT6      = 7;
+static constexpr uint8_t OP_DIGIT7      = 8;
+static constexpr uint8_t OP_DECODEMODE  = 9;
+static constexpr uint8_t OP_INTENSITY   = 10;
+static constexpr uint8_t OP_SCANLIMIT   = 11;
+static constexpr uint8_t OP_SHUTDOWN    = 12;
+static constexpr uint8_t OP_DISPLAYTEST = 15;
+
+} // namespace MAX7219
+
+#endif // MAX7219Display_opcodes_H_
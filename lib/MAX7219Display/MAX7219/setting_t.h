@@ -5,6 +5,7 @@
 #ifndef MAX7219Display_setting_t_H_
 #define MAX7219Display_setting_t_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace MAX7219 {
@@ -21,18 +22,102 @@ enum class Rotate {
 
 /**
  * @brief MAX7219 や マトリックスLED の接続順序や向きを定義する構造体
+ * 
+ * 設定はすべてテンプレート引数として与えるので、実行時にはメモリを消費しない。
+ * 
+ * @tparam TopLeftX バッファ上における、マトリックスLED の左上 x 座標
+ * @tparam TopLeftY バッファ上における、マトリックスLED の左上 y 座標
+ * @tparam Rotation マッピング時に回転させるかどうか
+ * @tparam Reverse 反転させるかどうか（ Rotate::_0 または Rotate::_180 では左右反転、それ以外では上下反転）
  */
-typedef struct {
-  //! バッファ上における、マトリックスLED の左上 x 座標
-  size_t topleft_x;
-  //! バッファ上における、マトリックスLED の左上 y 座標
-  size_t topleft_y;
-  //! マッピング時に回転させるかどうか
-  Rotate rotation;
-  //! 反転させるかどうか（ Rotate::_0 または Rotate::_180 では左右反転、それ以外では上下反転）
-  bool reverse;
-} setting_t;
+template <size_t TopLeftX, size_t TopLeftY, Rotate Rotation = Rotate::_0, bool Reverse = false>
+struct setting_t {
+  static constexpr size_t topleft_x = TopLeftX;
+  static constexpr size_t topleft_y = TopLeftY;
+  static constexpr Rotate rotation  = Rotation;
+  static constexpr bool   reverse   = Reverse;
+
+  //! true なら、1 行（OP_DIGIT0 ～ OP_DIGIT7 のどれか）がバッファ上の縦 1 列に対応する
+  static constexpr bool is_vertical = Rotation == Rotate::Clockwise || Rotation == Rotate::Counterclockwise;
+
+  //! 1 行に対応する、バッファ上の領域の幅
+  static constexpr size_t row_width = is_vertical ? 1 : 8;
+  //! 1 行に対応する、バッファ上の領域の高さ
+  static constexpr size_t row_height = is_vertical ? 8 : 1;
+
+  /**
+   * @brief @c row 行目に対応する、バッファ上の領域の左上隅の x 座標
+   * 
+   * @param row 行（0 = LED 上端 = OP_DIGIT7）
+   */
+  static constexpr size_t rowX(size_t row) {
+    return Rotation == Rotate::Clockwise          ? TopLeftX + row
+           : Rotation == Rotate::Counterclockwise ? TopLeftX + 7 - row
+                                                  : TopLeftX;
+  }
+
+  /**
+   * @brief @c row 行目に対応する、バッファ上の領域の左上隅の y 座標
+   * 
+   * @param row 行（0 = LED 上端 = OP_DIGIT7）
+   */
+  static constexpr size_t rowY(size_t row) {
+    return Rotation == Rotate::_0     ? TopLeftY + row
+           : Rotation == Rotate::_180 ? TopLeftY + 7 - row
+                                      : TopLeftY;
+  }
+
+  /**
+   * @brief モジュール内の座標 (lx, ly) のドットが、何行目に送られるか
+   * 
+   * @param lx モジュール左上隅からの x 方向の距離（0 から 7 まで）
+   * @param ly モジュール左上隅からの y 方向の距離（0 から 7 まで）
+   * @return 行（0 = LED 上端 = OP_DIGIT7）
+   */
+  static constexpr size_t digitRow(size_t lx, size_t ly) {
+    return Rotation == Rotate::_0          ? ly
+           : Rotation == Rotate::_180      ? 7 - ly
+           : Rotation == Rotate::Clockwise ? lx
+                                           : 7 - lx;
+  }
+
+  /**
+   * @brief モジュール内の座標 (lx, ly) のドットが、digitRow() 行目のデータの何ビット目に送られるか
+   * 
+   * @param lx モジュール左上隅からの x 方向の距離（0 から 7 まで）
+   * @param ly モジュール左上隅からの y 方向の距離（0 から 7 まで）
+   */
+  static constexpr size_t digitBit(size_t lx, size_t ly) {
+    return Rotation == Rotate::_0          ? (Reverse ? 7 - lx : lx)
+           : Rotation == Rotate::_180      ? (Reverse ? lx : 7 - lx)
+           : Rotation == Rotate::Clockwise ? (Reverse ? ly : 7 - ly)
+                                           : (Reverse ? 7 - ly : ly);
+  }
+};
+
+/**
+ * @brief デイジーチェーン接続された MAX7219 モジュールの並び
+ * 
+ * @tparam Devices 各モジュールの setting_t。マスター (ESP8266) から見て遠い順に書く。
+ */
+template <class... Devices>
+struct layout_t {
+  static_assert(sizeof...(Devices) > 0, "layout_t requires at least one device");
+
+  //! モジュールの個数
+  static constexpr size_t size = sizeof...(Devices);
+
+  /**
+   * @brief この並びを識別する値を取得
+   * 
+   * 並びごとに異なるアドレスを返すので、バッファと Display が同じ並びを前提にしているか確かめるのに使う。
+   */
+  static const void *tag() {
+    static const char tag = 0;
+    return &tag;
+  }
+};
 
 } // namespace MAX7219
 
-#endif // MAX7219Display_setting_t_H_
\ No newline at end of file
+#endif // MAX7219Display_setting_t_H_
@@ -7,6 +7,7 @@
 #define MAX7219Display_H_
 
 #include "MAX7219/Buffer.h"
+#include "MAX7219/DeviceNativeStorage.h"
 #include "MAX7219/Display.h"
 #include "MAX7219/setting_t.h"
 
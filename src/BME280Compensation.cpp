@@ -0,0 +1,117 @@
+#include "BME280Compensation.h"
+
+//! 計測していない（skip）ときのレジスタの値（20 bit、湿度は 16 bit）
+static constexpr int32_t SKIPPED_ADC   = 0x80000;
+static constexpr int32_t SKIPPED_ADC_H = 0x8000;
+
+static uint16_t readUint16LE(const uint8_t *p) {
+  return static_cast<uint16_t>(p[1] << 8 | p[0]);
+}
+
+static int16_t readInt16LE(const uint8_t *p) {
+  return static_cast<int16_t>(readUint16LE(p));
+}
+
+void BME280Compensation::parseCalibration(const uint8_t *calib00, const uint8_t *calib26, calibration_t *calibration) {
+
+  calibration->dig_T1 = readUint16LE(calib00 + 0);
+  calibration->dig_T2 = readInt16LE(calib00 + 2);
+  calibration->dig_T3 = readInt16LE(calib00 + 4);
+  calibration->dig_P1 = readUint16LE(calib00 + 6);
+  calibration->dig_P2 = readInt16LE(calib00 + 8);
+  calibration->dig_P3 = readInt16LE(calib00 + 10);
+  calibration->dig_P4 = readInt16LE(calib00 + 12);
+  calibration->dig_P5 = readInt16LE(calib00 + 14);
+  calibration->dig_P6 = readInt16LE(calib00 + 16);
+  calibration->dig_P7 = readInt16LE(calib00 + 18);
+  calibration->dig_P8 = readInt16LE(calib00 + 20);
+  calibration->dig_P9 = readInt16LE(calib00 + 22);
+  // 0xa0 は使われていない
+  calibration->dig_H1 = calib00[25];
+
+  calibration->dig_H2 = readInt16LE(calib26 + 0);
+  calibration->dig_H3 = calib26[2];
+  // dig_H4 と dig_H5 は 12 bit の符号付き整数で、0xe5 を下位 4 bit ずつ分け合う
+  calibration->dig_H4 = static_cast<int16_t>(static_cast<int8_t>(calib26[3]) * 16 | (calib26[4] & 0x0f));
+  calibration->dig_H5 = static_cast<int16_t>(static_cast<int8_t>(calib26[5]) * 16 | (calib26[4] >> 4));
+  calibration->dig_H6 = static_cast<int8_t>(calib26[6]);
+}
+
+/**
+ * @return 気温 [0.01 ℃]
+ */
+static int32_t compensateTemperature(const BME280Compensation::calibration_t &c, int32_t adc, int32_t *t_fine) {
+
+  int32_t t1   = static_cast<int32_t>(c.dig_T1);
+  int32_t var1 = ((((adc >> 3) - (t1 << 1))) * static_cast<int32_t>(c.dig_T2)) >> 11;
+  int32_t var2 = (((((adc >> 4) - t1) * ((adc >> 4) - t1)) >> 12) * static_cast<int32_t>(c.dig_T3)) >> 14;
+
+  *t_fine = var1 + var2;
+  return (*t_fine * 5 + 128) >> 8;
+}
+
+/**
+ * @return 気圧 [1/256 Pa]
+ */
+static uint32_t compensatePressure(const BME280Compensation::calibration_t &c, int32_t adc, int32_t t_fine) {
+
+  int64_t var1 = static_cast<int64_t>(t_fine) - 128000;
+  int64_t var2 = var1 * var1 * c.dig_P6;
+  var2         = var2 + ((var1 * c.dig_P5) << 17);
+  var2         = var2 + (static_cast<int64_t>(c.dig_P4) << 35);
+  var1         = ((var1 * var1 * c.dig_P3) >> 8) + ((var1 * c.dig_P2) << 12);
+  var1         = (((static_cast<int64_t>(1) << 47) + var1)) * c.dig_P1 >> 33;
+
+  // 0 で割らない
+  if (var1 == 0)
+    return 0;
+
+  int64_t p = 1048576 - adc;
+  p         = (((p << 31) - var2) * 3125) / var1;
+  var1      = (static_cast<int64_t>(c.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+  var2      = (static_cast<int64_t>(c.dig_P8) * p) >> 19;
+  p         = ((p + var1 + var2) >> 8) + (static_cast<int64_t>(c.dig_P7) << 4);
+
+  return static_cast<uint32_t>(p);
+}
+
+/**
+ * @return 湿度 [1/1024 %]
+ */
+static uint32_t compensateHumidity(const BME280Compensation::calibration_t &c, int32_t adc, int32_t t_fine) {
+
+  int32_t v = t_fine - 76800;
+
+  // データシートの式の、2 つの因数
+  int32_t x = ((adc << 14) - (static_cast<int32_t>(c.dig_H4) << 20) - (static_cast<int32_t>(c.dig_H5) * v) + 16384) >> 15;
+  int32_t y = (((v * static_cast<int32_t>(c.dig_H6)) >> 10) * (((v * static_cast<int32_t>(c.dig_H3)) >> 11) + 32768)) >> 10;
+  y         = ((y + 2097152) * static_cast<int32_t>(c.dig_H2) + 8192) >> 14;
+
+  v = x * y;
+  v = v - (((((v >> 15) * (v >> 15)) >> 7) * static_cast<int32_t>(c.dig_H1)) >> 4);
+
+  // 0 - 100 %
+  if (v < 0)
+    v = 0;
+  if (v > 419430400)
+    v = 419430400;
+
+  return static_cast<uint32_t>(v >> 12);
+}
+
+bool BME280Compensation::compensate(const calibration_t &calibration, const uint8_t *data, sample_t *sample) {
+
+  int32_t adc_P = static_cast<int32_t>(data[0]) << 12 | static_cast<int32_t>(data[1]) << 4 | data[2] >> 4;
+  int32_t adc_T = static_cast<int32_t>(data[3]) << 12 | static_cast<int32_t>(data[4]) << 4 | data[5] >> 4;
+  int32_t adc_H = static_cast<int32_t>(data[6]) << 8 | data[7];
+
+  if (adc_T == SKIPPED_ADC || adc_P == SKIPPED_ADC || adc_H == SKIPPED_ADC_H)
+    return false;
+
+  // 気圧と湿度の補正には、気温の補正の途中の値（t_fine）を使う
+  int32_t t_fine;
+  sample->temperature = compensateTemperature(calibration, adc_T, &t_fine);
+  sample->pressure    = compensatePressure(calibration, adc_P, t_fine);
+  sample->humidity    = compensateHumidity(calibration, adc_H, t_fine);
+  return true;
+}
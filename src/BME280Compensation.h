@@ -0,0 +1,84 @@
+/**
+ * @file BME280Compensation.h
+ */
+
+#ifndef BME280Compensation_H_
+#define BME280Compensation_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief BME280 のレジスタの値から、気温・気圧・湿度を求める関数
+ * 
+ * 計算はデータシートの整数演算（気温と湿度は 32 bit、気圧は 64 bit）そのままで、浮動小数点数を使わない。
+ * レジスタの読み書きは呼び出し側が行うので、ハードウェアに依存しない。
+ */
+namespace BME280Compensation {
+
+//! 補正値の前半（dig_T1 - dig_H1）のレジスタの位置と大きさ [bytes]
+static constexpr uint8_t CALIB00_REGISTER = 0x88;
+static constexpr size_t  CALIB00_SIZE     = 26;
+//! 補正値の後半（dig_H2 - dig_H6）のレジスタの位置と大きさ [bytes]
+static constexpr uint8_t CALIB26_REGISTER = 0xe1;
+static constexpr size_t  CALIB26_SIZE     = 7;
+//! 計測結果（press_msb - hum_lsb）のレジスタの位置と大きさ [bytes]
+static constexpr uint8_t DATA_REGISTER = 0xf7;
+static constexpr size_t  DATA_SIZE     = 8;
+
+/**
+ * @brief センサごとの補正値
+ */
+struct calibration_t {
+  uint16_t dig_T1;
+  int16_t  dig_T2;
+  int16_t  dig_T3;
+  uint16_t dig_P1;
+  int16_t  dig_P2;
+  int16_t  dig_P3;
+  int16_t  dig_P4;
+  int16_t  dig_P5;
+  int16_t  dig_P6;
+  int16_t  dig_P7;
+  int16_t  dig_P8;
+  int16_t  dig_P9;
+  uint8_t  dig_H1;
+  int16_t  dig_H2;
+  uint8_t  dig_H3;
+  int16_t  dig_H4;
+  int16_t  dig_H5;
+  int8_t   dig_H6;
+};
+
+/**
+ * @brief 補正した計測結果（固定小数点数）
+ */
+struct sample_t {
+  int32_t  temperature; //! 気温 [0.01 ℃]
+  uint32_t pressure;    //! 気圧 [1/256 Pa]
+  uint32_t humidity;    //! 湿度 [1/1024 %]
+};
+
+/**
+ * @brief 補正値のレジスタの値を読み解く
+ * 
+ * @param calib00 CALIB00_REGISTER から CALIB00_SIZE bytes
+ * @param calib26 CALIB26_REGISTER から CALIB26_SIZE bytes
+ * @param[out] calibration 補正値
+ */
+void parseCalibration(const uint8_t *calib00, const uint8_t *calib26, calibration_t *calibration);
+
+/**
+ * @brief 計測結果のレジスタの値を補正する
+ * 
+ * @param calibration 補正値
+ * @param data DATA_REGISTER から DATA_SIZE bytes（1 回で読めば、すべて同じ計測の値になる）
+ * @param[out] sample 補正した計測結果
+ * @retval true 補正した
+ * @retval false 計測されていない値がある（オーバーサンプリングが skip のときや、電源投入直後の初期値）
+ */
+bool compensate(const calibration_t &calibration, const uint8_t *data, sample_t *sample);
+
+} // namespace BME280Compensation
+
+#endif // BME280Compensation_H_
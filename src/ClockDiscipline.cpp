@@ -0,0 +1,122 @@
+#include "ClockDiscipline.h"
+#include <math.h>
+#include <stdlib.h>
+
+int64_t ClockDiscipline::appliedPhase(int64_t elapsed) const {
+  if (elapsed <= 0)
+    return 0;
+  if (static_cast<uint64_t>(elapsed) >= _phase_span)
+    return _phase;
+  return _phase * elapsed / static_cast<int64_t>(_phase_span);
+}
+
+int64_t ClockDiscipline::now(uint64_t counter) const {
+  auto elapsed = static_cast<int64_t>(counter - _base_counter);
+  return _base_time + elapsed + llround(elapsed * _frequency) + appliedPhase(elapsed);
+}
+
+void ClockDiscipline::step(uint64_t counter, int64_t time) {
+  _base_counter = counter;
+  _base_time    = time;
+  _phase        = 0;
+  _phase_span   = 0;
+  _count        = 0;
+  _next         = 0;
+  _steps++;
+}
+
+bool ClockDiscipline::estimate(uint64_t counter, int64_t *time) {
+
+  if (_count < 2)
+    return false;
+
+  // 最小二乗法で「NTP の時刻 - カウンタ」を直線に当てはめる（桁落ちしないよう counter からの差で計算する）
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (size_t i = 0; i < _count; i++) {
+    auto  &sample = _history[i];
+    double x      = static_cast<int64_t>(sample.counter - counter);
+    double y      = sample.offset;
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+
+  double n           = _count;
+  double denominator = n * sxx - sx * sx;
+  if (denominator <= 0)
+    return false;
+
+  double slope = (n * sxy - sx * sy) / denominator;
+  if (slope > MAX_FREQUENCY)
+    slope = MAX_FREQUENCY;
+  if (slope < -MAX_FREQUENCY)
+    slope = -MAX_FREQUENCY;
+
+  _frequency = slope;
+  *time      = counter + llround((sy - slope * sx) / n);
+  return true;
+}
+
+bool ClockDiscipline::update(uint64_t counter, int64_t offset, uint32_t delay) {
+
+  auto current = now(counter);
+  auto time    = current + offset;
+  _samples++;
+  _last_delay = delay;
+
+  // 1 回だけなら外れ値として捨て、続いたら（サーバーの時刻が変わったなど）時刻を飛ばす
+  bool stepped = !_synced || llabs(offset) > STEP_THRESHOLD_US;
+  if (stepped) {
+    if (_synced && !_spike) {
+      _spike = true;
+      _spikes++;
+      return false;
+    }
+    _poll    = MIN_POLL;
+    _persist = 0;
+    step(counter, time);
+  }
+
+  // 最初の同期のずれは、同期する前の（意味の無い）時刻とのずれなので残さない
+  _last_offset = _synced ? offset : 0;
+  _synced      = true;
+  _spike       = false;
+
+  _history[_next] = {counter, time - static_cast<int64_t>(counter)};
+  _next           = (_next + 1) % HISTORY_SIZE;
+  if (_count < HISTORY_SIZE)
+    _count++;
+
+  if (stepped)
+    return true;
+
+  _jitter = sqrt(_jitter * _jitter + (static_cast<double>(offset) * offset - _jitter * _jitter) / 4);
+
+  // 時計が正しくても、ずれは往復遅延の半分までは生じうる。それを超えたら、周波数の推定が追いついていない
+  auto gate = static_cast<int64_t>(delay / 2);
+  if (gate < MIN_POLL_GATE_US)
+    gate = MIN_POLL_GATE_US;
+
+  if (llabs(offset) <= gate) {
+    if (++_persist >= POLL_PERSIST && _count >= 3 && _poll < MAX_POLL) {
+      _poll++;
+      _persist = 0;
+    }
+  } else {
+    _persist = 0;
+    if (_poll > MIN_POLL)
+      _poll--;
+  }
+
+  // 周波数を推定し直し、推定した時刻とのずれを、時刻が飛ばないよう少しずつ加える
+  int64_t target;
+  if (!estimate(counter, &target))
+    return true;
+
+  _base_counter = counter;
+  _base_time    = current;
+  _phase        = target - current;
+  _phase_span   = static_cast<uint64_t>(llabs(_phase) / MAX_SLEW);
+  return true;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file ClockDiscipline.h
+ */
+
+#ifndef ClockDiscipline_H_
+#define ClockDiscipline_H_
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief NTP の応答から水晶の周波数のずれを推定し、時刻を少しずつ合わせ続けるクラス（PLL/FLL）
+ * 
+ * 時刻は、単調増加するマイクロ秒のカウンタ（ micros64() など）から、次のように求める。
+ * 
+ *   時刻 = 基準の時刻 + 経過 × (1 + 周波数の補正) + 位相の補正
+ * 
+ * 周波数の補正は、直近の応答（最大 HISTORY_SIZE 個）の「NTP の時刻 - カウンタ」を最小二乗法で直線に当てはめた傾き。
+ * 位相の補正（ずれ）は、時刻が飛ばないよう MAX_SLEW 以下の速さで少しずつ加える。ずれが STEP_THRESHOLD_US を
+ * 超えたときだけ、時刻を飛ばす（ステップ）。
+ * ずれが往復遅延の半分（時計が正しくても生じうるずれ）に収まり続けていれば、周波数が正しく推定できているとみなし、
+ * 問い合わせの間隔（poll）を延ばして、NTP の通信を減らす。
+ * 
+ * カウンタは呼び出し側が渡すので、このクラス自体はハードウェアに依存しない。
+ */
+class ClockDiscipline {
+public:
+  //! 時刻を飛ばす、ずれの大きさ [us]
+  static constexpr int64_t STEP_THRESHOLD_US = 128000;
+  //! 周波数の補正の最大値
+  static constexpr double MAX_FREQUENCY = 500e-6;
+  //! 位相を補正する最大の速さ（1 秒あたり 0.5 ms）
+  static constexpr double MAX_SLEW = 500e-6;
+  //! 問い合わせの間隔の最小値（2 の何乗秒か。64 秒）
+  static constexpr uint8_t MIN_POLL = 6;
+  //! 問い合わせの間隔の最大値（2 の何乗秒か。約 4.5 時間）
+  static constexpr uint8_t MAX_POLL = 14;
+  //! 周波数の推定に使う応答の数
+  static constexpr size_t HISTORY_SIZE = 8;
+  //! 間隔を延ばすまでに必要な、続けてずれが小さかった応答の数
+  static constexpr uint8_t POLL_PERSIST = 4;
+  //! ずれが小さいとみなす大きさの下限 [us]（往復遅延の半分がこれより小さいとき）
+  static constexpr int64_t MIN_POLL_GATE_US = 1000;
+
+private:
+  /**
+   * @brief 周波数の推定に使う応答
+   */
+  struct sample_t {
+    uint64_t counter; //! 応答を受け取ったときのカウンタ [us]
+    int64_t  offset;  //! NTP の時刻 - カウンタ [us]
+  };
+
+  uint64_t _base_counter = 0;     //! 基準のカウンタ [us]
+  int64_t  _base_time    = 0;     //! _base_counter のときの時刻 [us]（1970/1/1 00:00:00 UTC から）
+  double   _frequency    = 0;     //! 周波数の補正（カウンタが遅れているなら正）
+  int64_t  _phase        = 0;     //! _base_counter から加えていく位相の補正 [us]
+  uint64_t _phase_span   = 0;     //! _phase を加え終えるまでのカウンタの経過 [us]
+  bool     _synced       = false; //! 1 回以上同期したか
+
+  std::array<sample_t, HISTORY_SIZE> _history = {}; //! 直近の応答（リングバッファ）
+  size_t                             _count   = 0;  //! _history の有効な要素数
+  size_t                             _next    = 0;  //! 次に _history に書き込む位置
+
+  int64_t  _last_offset = 0;        //! 直近の応答のずれ [us]
+  uint32_t _last_delay  = 0;        //! 直近の応答の往復遅延 [us]
+  double   _jitter      = 0;        //! ずれの二乗平均平方根 [us]
+  uint8_t  _poll        = MIN_POLL; //! 問い合わせの間隔（2 の何乗秒か）
+  uint8_t  _persist     = 0;        //! 続けてずれが小さかった応答の数
+  bool     _spike       = false;    //! 直前の応答のずれが STEP_THRESHOLD_US を超えていたか
+  uint32_t _samples     = 0;        //! 受け取った応答の数
+  uint32_t _steps       = 0;        //! 時刻を飛ばした回数（最初の同期を含む）
+  uint32_t _spikes      = 0;        //! 外れ値として捨てた応答の数
+
+  /**
+   * @brief 位相の補正のうち、加え終えた分を求める
+   * 
+   * @param elapsed _base_counter からの経過 [us]
+   */
+  int64_t appliedPhase(int64_t elapsed) const;
+
+  /**
+   * @brief 時刻を飛ばして合わせる（周波数の補正は引き継ぐ）
+   */
+  void step(uint64_t counter, int64_t time);
+
+  /**
+   * @brief _history から、周波数の補正と、counter のときの時刻を推定する
+   * 
+   * @param counter カウンタ [us]
+   * @param[out] time counter のときの時刻の推定値 [us]
+   * @retval false 応答が足りない
+   */
+  bool estimate(uint64_t counter, int64_t *time);
+
+public:
+  /**
+   * @brief カウンタの値から、時刻を求める
+   * 
+   * @param counter カウンタ [us]
+   * @return 時刻 [us]（1970/1/1 00:00:00 UTC から）
+   */
+  int64_t now(uint64_t counter) const;
+
+  /**
+   * @brief NTP の応答を 1 つ反映する
+   * 
+   * @param counter 応答を受け取ったときのカウンタ [us]
+   * @param offset NTP の時刻 - now(counter) [us]
+   * @param delay 往復遅延 [us]
+   * @retval true 反映した
+   * @retval false 外れ値として捨てた
+   */
+  bool update(uint64_t counter, int64_t offset, uint32_t delay);
+
+  /**
+   * @brief 1 回以上同期したか
+   */
+  bool isSynced() const {
+    return _synced;
+  }
+
+  /**
+   * @brief 次の問い合わせまでの間隔を取得する
+   * 
+   * 外れ値を捨てた直後は、それが続くかをすぐ確かめるため、最小の間隔にする。
+   * 
+   * @return 秒
+   */
+  uint32_t getPollInterval() const {
+    return 1UL << (_spike ? MIN_POLL : _poll);
+  }
+
+  /**
+   * @brief 直近の応答のずれを取得する
+   * 
+   * @return マイクロ秒（最初の同期では 0。int32_t の範囲で飽和する）
+   */
+  int32_t getOffset() const {
+    if (_last_offset > INT32_MAX)
+      return INT32_MAX;
+    if (_last_offset < INT32_MIN)
+      return INT32_MIN;
+    return static_cast<int32_t>(_last_offset);
+  }
+
+  uint32_t getDelay() const {
+    return _last_delay;
+  }
+
+  uint32_t getJitter() const {
+    return static_cast<uint32_t>(_jitter);
+  }
+
+  /**
+   * @brief 周波数の補正を取得する
+   * 
+   * @return ppm（カウンタが遅れているなら正）
+   */
+  double getFrequencyPPM() const {
+    return _frequency * 1e6;
+  }
+
+  uint32_t getSamples() const {
+    return _samples;
+  }
+
+  uint32_t getSteps() const {
+    return _steps;
+  }
+
+  uint32_t getSpikes() const {
+    return _spikes;
+  }
+};
+
+#endif // ClockDiscipline_H_
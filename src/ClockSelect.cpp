@@ -0,0 +1,84 @@
+#include "ClockSelect.h"
+#include <algorithm>
+
+/**
+ * @brief 区間の端
+ */
+struct endpoint_t {
+  int64_t value;
+  int8_t  type; //! 下端なら +1、上端なら -1
+};
+
+uint64_t ClockSelect::getDistance(const sample_t &sample) {
+  return sample.delay / 2 + static_cast<uint64_t>(sample.root_distance);
+}
+
+int ClockSelect::select(const sample_t *samples, size_t count, bool *truechimers) {
+
+  if (count > MAX_SAMPLES)
+    count = MAX_SAMPLES;
+
+  for (size_t i = 0; i < count; i++)
+    truechimers[i] = false;
+  if (count == 0)
+    return -1;
+
+  endpoint_t endpoints[MAX_SAMPLES * 2];
+  for (size_t i = 0; i < count; i++) {
+    auto distance         = static_cast<int64_t>(getDistance(samples[i]));
+    endpoints[i * 2]     = {samples[i].offset - distance, +1};
+    endpoints[i * 2 + 1] = {samples[i].offset + distance, -1};
+  }
+
+  // 同じ値なら下端を先にして、端で接する区間も重なるとみなす
+  auto end = endpoints + count * 2;
+  std::sort(endpoints, end, [](const endpoint_t &a, const endpoint_t &b) {
+    return a.value < b.value || (a.value == b.value && a.type > b.type);
+  });
+
+  // falseticker が少ないと仮定したものから順に、残りの区間がすべて重なる範囲を探す
+  int64_t low = INT64_MAX, high = INT64_MIN;
+  for (size_t allow = 0; allow * 2 < count; allow++) {
+    auto need = static_cast<int>(count - allow);
+    low       = INT64_MAX;
+    high      = INT64_MIN;
+
+    int n = 0;
+    for (auto p = endpoints; p != end; p++) {
+      n += p->type;
+      if (n >= need) {
+        low = p->value;
+        break;
+      }
+    }
+
+    n = 0;
+    for (auto p = end; p != endpoints;) {
+      --p;
+      n -= p->type;
+      if (n >= need) {
+        high = p->value;
+        break;
+      }
+    }
+
+    if (low <= high)
+      break;
+  }
+
+  if (low > high)
+    return -1;
+
+  // 範囲と重なる応答のうち、距離が一番小さいもの
+  int best = -1;
+  for (size_t i = 0; i < count; i++) {
+    auto distance = static_cast<int64_t>(getDistance(samples[i]));
+    if (samples[i].offset - distance > high || samples[i].offset + distance < low)
+      continue;
+
+    truechimers[i] = true;
+    if (best < 0 || getDistance(samples[i]) < getDistance(samples[best]))
+      best = i;
+  }
+  return best;
+}
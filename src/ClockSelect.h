@@ -0,0 +1,51 @@
+/**
+ * @file ClockSelect.h
+ */
+
+#ifndef ClockSelect_H_
+#define ClockSelect_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 複数の NTP サーバーの応答から、正しい時刻を返しているもの（truechimer）を見分け、一番確かな応答を選ぶ
+ * 
+ * RFC 5905 の clock select と同じく、応答ごとに「正しい時刻がこの範囲にあるはず」という区間（ずれ ± 距離）を考え、
+ * 過半数の区間が重なる範囲を求める。その範囲と重ならない応答は、誤った時刻を返している（falseticker）とみなす。
+ * 残った応答のうち、距離が一番小さいものを選ぶ。
+ */
+namespace ClockSelect {
+
+//! 一度に選べる応答の最大数
+static constexpr size_t MAX_SAMPLES = 8;
+
+/**
+ * @brief NTP サーバー 1 つの応答
+ */
+struct sample_t {
+  int64_t  offset;        //! サーバーの時刻 - こちらの時刻 [us]
+  uint32_t delay;         //! 往復遅延 [us]
+  uint32_t root_distance; //! サーバーから基準の時計までの誤差 [us]（root delay の半分 + root dispersion）
+};
+
+/**
+ * @brief 応答の距離（正しい時刻とのずれの上限）を求める
+ * 
+ * @return マイクロ秒（往復遅延の半分 + root_distance）
+ */
+uint64_t getDistance(const sample_t &sample);
+
+/**
+ * @brief 一番確かな応答を選ぶ
+ * 
+ * @param samples 応答
+ * @param count 応答の数（MAX_SAMPLES まで）
+ * @param[out] truechimers 応答ごとに、正しい時刻を返しているとみなしたら true（ count 個）
+ * @return 選んだ応答の位置（過半数の区間が重ならなければ -1）
+ */
+int select(const sample_t *samples, size_t count, bool *truechimers);
+
+} // namespace ClockSelect
+
+#endif // ClockSelect_H_
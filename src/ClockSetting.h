@@ -30,6 +30,8 @@ static constexpr unsigned int            DEFAULT_AMBIENT_CHANNELID       = 0;
 static constexpr char                    DEFAULT_AMBIENT_WRITEKEY[]      = "";
 static constexpr bool                    DEFAULT_USE_CUSTOM_SERVER       = false;
 static constexpr char                    DEFAULT_CUSTOM_SERVER_ADDR[]    = "";
+static constexpr uint32_t                DEFAULT_SPI_FREQUENCY           = 0;
+static constexpr bool                    DEFAULT_SERVE_NTP               = false;
 static constexpr brightness_setting_t    DEFAULT_BRIGHTNESS              = {
     DEFAULT_BRIGHTNESS_MANUAL_VALUE,
     DEFAULT_BRIGHTNESS_THRESHOLDS,
@@ -68,6 +70,8 @@ public:
   String               tzcity;
   //! 使用する NTP サーバーの配列
   std::vector<String>  ntp;
+  //! true なら LAN の他の時計に NTP で時刻を返す
+  bool                 serve_ntp;
   //! 気圧計設置地点の標高（海面更正に使う）
   uint16_t             elev;
   //! true なら観測データを Ambient に送信する
@@ -82,6 +86,8 @@ public:
   String               custom_server_addr;
   //! custom_server 用のライトキー
   String               custom_server_writekey;
+  //! MAX7219 との通信に使う SPI クロック周波数（0 なら起動時に自動調整する）
+  uint32_t             spi_frequency;
 
   /**
    * @brief このクラスをシリアライズする
@@ -92,7 +98,7 @@ public:
   void serialize(T &retval) {
 
     size_t capacity =
-        JSON_OBJECT_SIZE(13) + // root
+        JSON_OBJECT_SIZE(15) + // root
         JSON_ARRAY_SIZE(ntp.size()) +
         JSON_ARRAY_SIZE(brightness.thresholds.size()) +
         JSON_OBJECT_SIZE(3) + // brightness
@@ -124,6 +130,7 @@ public:
     for (auto &&i : ntp)
       ntp_j.add(i);
 
+    doc["serve_ntp"]              = serve_ntp;
     doc["elev"]                   = elev;
     doc["use_ambient"]            = use_ambient;
     doc["ambient_channelid"]      = ambient_channelid;
@@ -131,6 +138,7 @@ public:
     doc["use_custom_server"]      = use_custom_server;
     doc["custom_server_addr"]     = custom_server_addr;
     doc["custom_server_writekey"] = custom_server_writekey;
+    doc["spi_frequency"]          = spi_frequency;
 
     serializeJson(doc, retval);
   }
@@ -148,7 +156,7 @@ private:
    */
 public:
   bool deserialize(const String &json) {
-    const size_t        capacity = JSON_ARRAY_SIZE(6) + JSON_ARRAY_SIZE(6) + JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(13) + json.length();
+    const size_t        capacity = JSON_ARRAY_SIZE(6) + JSON_ARRAY_SIZE(6) + JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(15) + json.length();
     DynamicJsonDocument doc(capacity);
 
     auto err = deserializeJson(doc, json);
@@ -189,6 +197,7 @@ public:
       ntp.push_back(DEFAULT_NTP_SERVER);
     }
 
+    serve_ntp              = getOrDefault(doc, "serve_ntp",              DEFAULT_SERVE_NTP);
     elev                   = getOrDefault(doc, "elev",                   DEFAULT_ELEV);
     use_ambient            = getOrDefault(doc, "use_ambient",            DEFAULT_USE_AMBIENT);
     ambient_channelid      = getOrDefault(doc, "ambient_channelid",      DEFAULT_AMBIENT_CHANNELID);
@@ -196,6 +205,7 @@ public:
     use_custom_server      = getOrDefault(doc, "use_custom_server",      DEFAULT_USE_CUSTOM_SERVER);
     custom_server_addr     = getOrDefault(doc, "custom_server_addr",     DEFAULT_CUSTOM_SERVER_ADDR);
     custom_server_writekey = getOrDefault(doc, "custom_server_writekey", DEFAULT_CUSTOM_SERVER_WRITEKEY);
+    spi_frequency          = getOrDefault(doc, "spi_frequency",          DEFAULT_SPI_FREQUENCY);
 
     return true;
   }
@@ -210,6 +220,7 @@ public:
     tzarea                 = DEFAULT_TZAREA;
     tzcity                 = DEFAULT_TZCITY;
     ntp                    = {DEFAULT_NTP_SERVER};
+    serve_ntp              = DEFAULT_SERVE_NTP;
     elev                   = DEFAULT_ELEV;
     use_ambient            = DEFAULT_USE_AMBIENT;
     ambient_channelid      = DEFAULT_AMBIENT_CHANNELID;
@@ -217,6 +228,7 @@ public:
     use_custom_server      = DEFAULT_USE_CUSTOM_SERVER;
     custom_server_addr     = DEFAULT_CUSTOM_SERVER_ADDR;
     custom_server_writekey = DEFAULT_CUSTOM_SERVER_WRITEKEY;
+    spi_frequency          = DEFAULT_SPI_FREQUENCY;
   }
 };
 
@@ -0,0 +1,34 @@
+#include "LocalClock.h"
+
+suseconds_t LocalClock::reload() {
+
+  suseconds_t usec;
+
+  // 変換中に過ぎた時間を含めないよう、カウンタは先に読んでおく
+  auto counter = _counter();
+  _tm          = _convert(&usec);
+  _conversions++;
+
+  _second_start = counter - usec;
+  _valid        = true;
+  return usec;
+}
+
+const struct tm &LocalClock::now(suseconds_t *usec) {
+
+  uint32_t elapsed = _counter() - _second_start;
+
+  if (_valid && elapsed >= 1000000 && elapsed < 2000000 && _tm.tm_sec < 59) {
+    // 分が変わらないなら、秒を進めるだけでよい
+    _tm.tm_sec++;
+    _second_start += 1000000;
+    elapsed -= 1000000;
+  } else if (!_valid || elapsed >= 1000000) {
+    // 分が変わる（夏時間の切り替えや閏秒があるかもしれない）か、しばらく呼ばれなかったので、変換し直す
+    elapsed = reload();
+  }
+
+  if (usec)
+    *usec = elapsed;
+  return _tm;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file LocalClock.h
+ */
+
+#ifndef LocalClock_H_
+#define LocalClock_H_
+
+#include <Arduino.h>
+#include <functional>
+#include <time.h>
+
+/**
+ * @brief 現在時刻（地方時）を、毎回変換せずに求めるクラス
+ * 
+ * 時刻の変換（タイムゾーンの規則の評価を含む）は重いので、1 回変換したら、その後は
+ * マイクロ秒のカウンタの経過時間だけで秒を進める。カウンタは時刻と同じ速さで進まなければならない（そうでなければ、
+ * 変換し直すまでの間にずれて、変換し直したときに跳ぶ）。
+ * 変換し直すのは、分が変わるとき（夏時間の切り替えは分の境目で起きる）、1 秒以上呼ばれなかったとき、
+ * invalidate() されたとき（NTP で時刻が補正されたときなど）だけ。
+ * 
+ * 時刻の変換とカウンタの取得はコンストラクタに渡す関数に任せるので、このクラス自体はハードウェアに依存しない。
+ */
+class LocalClock {
+public:
+  //! 現在時刻を変換する関数。マイクロ秒部分を @c usec に入れて、地方時を返す
+  using TConvert = std::function<struct tm(suseconds_t *usec)>;
+  //! マイクロ秒のカウンタ。TConvert が返す時刻と同じ速さで進むこと（時刻を補正しているなら、補正を含む）
+  using TCounter = std::function<uint32_t()>;
+
+private:
+  TConvert  _convert;
+  TCounter  _counter;
+  struct tm _tm;                  //! 最後に求めた時刻
+  uint32_t  _second_start;        //! _tm の秒が始まったときのカウンタの値
+  bool      _valid       = false; //! _tm と _second_start が有効か
+  uint32_t  _conversions = 0;     //! 時刻を変換した回数
+
+  /**
+   * @brief 現在時刻を変換し直す
+   * 
+   * @return 現在時刻のマイクロ秒部分
+   */
+  suseconds_t reload();
+
+public:
+  /**
+   * @brief Construct a new LocalClock object
+   * 
+   * @param convert 現在時刻を変換する関数
+   * @param counter マイクロ秒のカウンタ
+   */
+  LocalClock(const TConvert &convert, const TCounter &counter)
+      : _convert(convert)
+      , _counter(counter) {}
+
+  /**
+   * @brief 現在時刻を取得する
+   * 
+   * @param[out] usec 現在時刻のマイクロ秒部分（不要なら nullptr）
+   * @return 現在時刻（地方時）
+   */
+  const struct tm &now(suseconds_t *usec = nullptr);
+
+  /**
+   * @brief 次の now() で、必ず時刻を変換し直すようにする
+   * 
+   * 時刻の同期やタイムゾーンの変更の後に呼ぶ。
+   */
+  void invalidate() {
+    _valid = false;
+  }
+
+  /**
+   * @brief これまでに時刻を変換した回数を取得する（計測用）
+   */
+  uint32_t getConversions() const {
+    return _conversions;
+  }
+};
+
+#endif // LocalClock_H_
@@ -0,0 +1,49 @@
+#include "LoopProfiler.h"
+
+constexpr uint32_t LoopProfiler::HISTOGRAM_BOUNDS_US[];
+
+void LoopProfiler::record(LoopPhases phase, uint32_t us) {
+
+  auto  index = static_cast<size_t>(phase);
+  auto &stat  = _stats[index];
+
+  stat.count++;
+  stat.total_us += us;
+  if (us > stat.max_us)
+    stat.max_us = us;
+  if (us > _budgets_us[index])
+    stat.overruns++;
+
+  size_t bin = 0;
+  while (bin < HistogramBins - 1 && us >= HISTOGRAM_BOUNDS_US[bin])
+    bin++;
+  stat.histogram[bin]++;
+}
+
+void LoopProfiler::reset() {
+  _stats        = {};
+  _missed_ticks = 0;
+}
+
+const char *LoopProfiler::getName(LoopPhases phase) {
+
+  switch (phase) {
+  case LoopPhases::BUTTON:
+    return "button";
+  case LoopPhases::DISPLAY:
+    return "display";
+  case LoopPhases::SENSOR:
+    return "sensor";
+  case LoopPhases::UPLOAD:
+    return "upload";
+  case LoopPhases::BRIGHTNESS:
+    return "brightness";
+  case LoopPhases::SERVER:
+    return "server";
+  case LoopPhases::NTP:
+    return "ntp";
+  case LoopPhases::BOOT:
+    return "boot";
+  }
+  return "";
+}
@@ -0,0 +1,107 @@
+/**
+ * @file LoopProfiler.h
+ */
+
+#ifndef LoopProfiler_H_
+#define LoopProfiler_H_
+
+#include <Arduino.h>
+#include <array>
+
+/**
+ * @brief loop() で計測する処理の区分
+ */
+enum class LoopPhases : uint8_t {
+  BUTTON,     //! SEL ボタン
+  DISPLAY,    //! 画面更新
+  SENSOR,     //! 気温計測の開始・読み取り
+  UPLOAD,     //! envdata の送信
+  BRIGHTNESS, //! 測光
+  SERVER,     //! Web サーバー
+  NTP,        //! NTP サーバーの名前解決・問い合わせ・応答の処理
+  BOOT,       //! 起動の続き（Wi-Fi 接続の確認、WiFiManager による設定）
+};
+
+//! LoopPhases の要素数
+static constexpr size_t LOOP_PHASES_COUNT = 8;
+
+/**
+ * @brief loop() の処理ごとに、かかった時間を集計するクラス
+ * 
+ * 処理ごとに時間の上限（予算）を決めておき、超えた回数と、時間の分布（ヒストグラム）を記録する。
+ * 時間の計り方は呼び出し側に任せるので、このクラス自体はハードウェアに依存しない。
+ */
+class LoopProfiler {
+public:
+  //! ヒストグラムの各区間の上限 [us]。最後の区間（これ以上）を加えた数が区間数になる
+  static constexpr uint32_t HISTOGRAM_BOUNDS_US[] = {100, 300, 1000, 3000, 10000, 30000, 100000, 300000, 1000000};
+  //! ヒストグラムの区間数
+  static constexpr size_t HistogramBins = sizeof(HISTOGRAM_BOUNDS_US) / sizeof(HISTOGRAM_BOUNDS_US[0]) + 1;
+
+  /**
+   * @brief 1 つの処理の集計結果
+   */
+  struct phase_stat_t {
+    uint32_t                            count;     //! 計測回数
+    uint32_t                            overruns;  //! 予算を超えた回数
+    uint32_t                            max_us;    //! 最長の時間
+    uint64_t                            total_us;  //! 時間の合計
+    std::array<uint32_t, HistogramBins> histogram; //! 時間の分布
+  };
+
+private:
+  std::array<uint32_t, LOOP_PHASES_COUNT>     _budgets_us;
+  std::array<phase_stat_t, LOOP_PHASES_COUNT> _stats        = {};
+  uint32_t                                    _missed_ticks = 0;
+
+public:
+  /**
+   * @brief Construct a new LoopProfiler object
+   * 
+   * @param budgets_us 処理ごとの予算 [us]（LoopPhases の順）
+   */
+  LoopProfiler(const std::array<uint32_t, LOOP_PHASES_COUNT> &budgets_us)
+      : _budgets_us(budgets_us) {}
+
+  /**
+   * @brief 処理にかかった時間を記録する
+   * 
+   * @param phase 処理
+   * @param us かかった時間 [us]
+   */
+  void record(LoopPhases phase, uint32_t us);
+
+  /**
+   * @brief 定期的な処理（画面更新）が、1 周期以上遅れたことを記録する
+   */
+  void countMissedTick() {
+    _missed_ticks++;
+  }
+
+  /**
+   * @brief 集計結果を捨てる
+   */
+  void reset();
+
+  const phase_stat_t &getStat(LoopPhases phase) const {
+    return _stats[static_cast<size_t>(phase)];
+  }
+
+  uint32_t getBudget(LoopPhases phase) const {
+    return _budgets_us[static_cast<size_t>(phase)];
+  }
+
+  uint32_t getMissedTicks() const {
+    return _missed_ticks;
+  }
+
+  /**
+   * @brief 処理の名前を取得する
+   * 
+   * @param phase 処理
+   * @return 名前（HTTP で返す JSON のキー）
+   */
+  static const char *getName(LoopPhases phase);
+};
+
+#endif // LoopProfiler_H_
@@ -0,0 +1,92 @@
+#include "NtpPacket.h"
+#include <string.h>
+
+//! 1900/1/1 から 1970/1/1 までの秒数
+static constexpr int64_t UNIX_EPOCH = 2208988800LL;
+
+uint32_t NtpPacket::readUint32(const uint8_t *p) {
+  return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 | p[3];
+}
+
+void NtpPacket::writeUint32(uint8_t *p, uint32_t value) {
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+int64_t NtpPacket::readTimestamp(const uint8_t *p) {
+
+  int64_t seconds  = readUint32(p);
+  int64_t fraction = readUint32(p + 4);
+  if (seconds < 0x80000000LL)
+    seconds += 0x100000000LL;
+
+  // 端数は四捨五入する（切り捨てると、writeTimestamp() で書いた時刻が 1 us 戻る）
+  return (seconds - UNIX_EPOCH) * 1000000 + ((fraction * 1000000 + (1LL << 31)) >> 32);
+}
+
+void NtpPacket::writeTimestamp(uint8_t *p, int64_t time) {
+
+  auto seconds = time / 1000000;
+  auto usec    = time % 1000000;
+  if (usec < 0) {
+    seconds--;
+    usec += 1000000;
+  }
+
+  writeUint32(p, static_cast<uint32_t>(seconds + UNIX_EPOCH));
+  writeUint32(p + 4, static_cast<uint32_t>((static_cast<uint64_t>(usec) << 32) / 1000000));
+}
+
+uint32_t NtpPacket::readShort(const uint8_t *p) {
+  return static_cast<uint32_t>((static_cast<uint64_t>(readUint32(p)) * 1000000 + (1 << 15)) >> 16);
+}
+
+void NtpPacket::writeShort(uint8_t *p, uint32_t us) {
+  writeUint32(p, static_cast<uint32_t>((static_cast<uint64_t>(us) << 16) / 1000000));
+}
+
+bool NtpPacket::makeResponse(const uint8_t *request, size_t length, const server_t &server, int64_t receive_time, uint8_t *response) {
+
+  if (length < SIZE)
+    return false;
+
+  // Mode = 3 (client) で、版は 1 - 4
+  auto version = (request[0] >> 3) & 0x07;
+  auto mode    = request[0] & 0x07;
+  if (mode != 3 || version < 1 || version > 4)
+    return false;
+
+  memset(response, 0, SIZE);
+
+  // LI = 0、版はクライアントに合わせる、Mode = 4 (server)
+  response[0] = version << 3 | 4;
+  response[1] = server.stratum;
+  response[2] = request[2]; // Poll
+  response[3] = static_cast<uint8_t>(server.precision);
+  writeShort(response + ROOT_DELAY, server.root_delay);
+  writeShort(response + ROOT_DISPERSION, server.root_dispersion);
+  memcpy(response + REFERENCE_ID, server.reference_id, sizeof(server.reference_id));
+  writeTimestamp(response + REFERENCE_TIME, server.reference_time);
+
+  // クライアントの Transmit Timestamp を、そのまま Originate Timestamp として返す
+  memcpy(response + ORIGIN_TIME, request + TRANSMIT_TIME, 8);
+  writeTimestamp(response + RECEIVE_TIME, receive_time);
+  return true;
+}
+
+bool NtpPacket::isSyncedResponse(const uint8_t *packet, size_t length) {
+
+  if (length < SIZE)
+    return false;
+
+  auto leap    = packet[0] >> 6;
+  auto mode    = packet[0] & 0x07;
+  auto stratum = packet[1];
+  return mode == 4 && leap != 3 && stratum >= 1 && stratum <= 15;
+}
+
+bool NtpPacket::isResponseTo(const uint8_t *packet, const uint8_t *origin) {
+  return memcmp(packet + ORIGIN_TIME, origin, 8) == 0;
+}
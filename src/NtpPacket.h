@@ -0,0 +1,115 @@
+/**
+ * @file NtpPacket.h
+ */
+
+#ifndef NtpPacket_H_
+#define NtpPacket_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief NTP (SNTP) のパケットを読み書きする関数
+ * 
+ * 時刻はすべて 1970/1/1 00:00:00 UTC からのマイクロ秒で扱う。
+ */
+namespace NtpPacket {
+
+//! パケットの大きさ [bytes]（拡張フィールドと MAC を除く）
+static constexpr size_t SIZE = 48;
+//! NTP のポート番号
+static constexpr uint16_t PORT = 123;
+
+// フィールドの位置
+static constexpr size_t ROOT_DELAY      = 4;
+static constexpr size_t ROOT_DISPERSION = 8;
+static constexpr size_t REFERENCE_ID    = 12;
+static constexpr size_t REFERENCE_TIME  = 16;
+static constexpr size_t ORIGIN_TIME     = 24;
+static constexpr size_t RECEIVE_TIME    = 32;
+static constexpr size_t TRANSMIT_TIME   = 40;
+
+/**
+ * @brief 応答に載せる、サーバー（この時計）の状態
+ */
+struct server_t {
+  uint8_t  stratum;         //! 上流のサーバーの Stratum + 1
+  int8_t   precision;       //! 時計の分解能（2 の何乗秒か）
+  uint8_t  reference_id[4]; //! 上流のサーバーの IPv4 アドレス
+  int64_t  reference_time;  //! 最後に上流のサーバーと同期した時刻 [us]
+  uint32_t root_delay;      //! 基準の時計までの往復遅延 [us]
+  uint32_t root_dispersion; //! 基準の時計までの誤差 [us]
+};
+
+uint32_t readUint32(const uint8_t *p);
+void     writeUint32(uint8_t *p, uint32_t value);
+
+/**
+ * @brief NTP のタイムスタンプ（1900 年からの秒と、その 2^-32 秒単位の端数）を読む
+ * 
+ * 秒の最上位ビットが 0 なら、2036 年以降（次の時代）とみなす。
+ * 
+ * @return 時刻 [us]（端数は四捨五入する）
+ */
+int64_t readTimestamp(const uint8_t *p);
+
+/**
+ * @brief NTP のタイムスタンプを書く
+ * 
+ * @param time 時刻 [us]
+ */
+void writeTimestamp(uint8_t *p, int64_t time);
+
+/**
+ * @brief NTP の短い形式（16.16 固定小数点の秒）を読む
+ * 
+ * @return マイクロ秒（端数は四捨五入する）
+ */
+uint32_t readShort(const uint8_t *p);
+
+/**
+ * @brief NTP の短い形式を書く
+ * 
+ * @param us マイクロ秒
+ */
+void writeShort(uint8_t *p, uint32_t us);
+
+/**
+ * @brief クライアントの要求への応答を作る
+ * 
+ * Transmit Timestamp は空けておくので、送る直前に writeTimestamp() で書き込む。
+ * 
+ * @param request 要求
+ * @param length 要求の大きさ
+ * @param server サーバーの状態
+ * @param receive_time 要求を受け取った時刻 [us]
+ * @param[out] response 応答（ SIZE bytes ）
+ * @retval true 応答を作った
+ * @retval false 応答すべき要求ではない（クライアントの要求でない、版が違う、短すぎるなど）
+ */
+bool makeResponse(const uint8_t *request, size_t length, const server_t &server, int64_t receive_time, uint8_t *response);
+
+/**
+ * @brief 同期済みのサーバーからの応答か調べる
+ * 
+ * @param packet 受け取ったパケット
+ * @param length packet の大きさ
+ * @retval true Mode = 4 (server) で、同期済み（LI != 3、Stratum 1 - 15）
+ * @retval false 使えない応答（短すぎる、Kiss-o'-Death など）
+ */
+bool isSyncedResponse(const uint8_t *packet, size_t length);
+
+/**
+ * @brief こちらの問い合わせへの応答か調べる
+ * 
+ * 応答の Originate Timestamp は、問い合わせの Transmit Timestamp と一致する。
+ * 問い合わせごとに違うので、遅れて届いた前の応答や、偽の応答は一致しない。
+ * 
+ * @param packet 受け取ったパケット（ SIZE bytes ）
+ * @param origin 問い合わせに書いた Transmit Timestamp（8 bytes）
+ */
+bool isResponseTo(const uint8_t *packet, const uint8_t *origin);
+
+} // namespace NtpPacket
+
+#endif // NtpPacket_H_
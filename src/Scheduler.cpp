@@ -0,0 +1,55 @@
+#include "Scheduler.h"
+
+constexpr uint32_t Scheduler::MAX_DELAY_US;
+
+bool Scheduler::add(const TTask &task, uint32_t delay_us) {
+
+  if (_count >= MAX_TASKS)
+    return false;
+
+  _tasks[_count].task = task;
+  _tasks[_count].due  = _clock() + std::min(delay_us, MAX_DELAY_US);
+  _count++;
+  return true;
+}
+
+uint32_t Scheduler::runDue() {
+
+  // 途中で時間がかかっても、実行するかどうかは最初の時刻で決める（同じタスクを 2 回続けて実行しない）
+  auto now = _clock();
+
+  for (size_t i = 0; i < _count; i++) {
+    auto &entry = _tasks[i];
+    if (!isDue(entry, now))
+      continue;
+
+    _lateness  = _clock() - entry.due;
+    auto delay = entry.task();
+    entry.due  = _clock() + std::min(delay, MAX_DELAY_US);
+  }
+
+  return untilNext();
+}
+
+uint32_t Scheduler::untilNext() const {
+
+  auto     now    = _clock();
+  uint32_t retval = MAX_DELAY_US;
+
+  for (size_t i = 0; i < _count; i++) {
+    if (isDue(_tasks[i], now))
+      return 0;
+    retval = std::min(retval, _tasks[i].due - now);
+  }
+
+  return retval;
+}
+
+void Scheduler::run() {
+
+  auto wait = runDue();
+  while (wait > 0) {
+    _idle(wait);
+    wait = untilNext();
+  }
+}
@@ -0,0 +1,104 @@
+/**
+ * @file Scheduler.h
+ */
+
+#ifndef Scheduler_H_
+#define Scheduler_H_
+
+#include <Arduino.h>
+#include <array>
+#include <functional>
+
+/**
+ * @brief 登録したタスクを、それぞれが指定した時刻に実行するクラス
+ * 
+ * タスクは実行されるたびに「次に実行するまでの時間」を返す。
+ * 実行すべきタスクが無い間は、コンストラクタに渡す関数（アイドル処理）に時間を渡して休ませる。
+ * 
+ * 時刻の取得もコンストラクタに渡す関数に任せるので、このクラス自体はハードウェアに依存しない。
+ * 時刻は 32 ビットのマイクロ秒で、一周（約 71 分）しても正しく比較できる。
+ */
+class Scheduler {
+public:
+  //! タスク。戻り値は、戻った時点から次に実行するまでのマイクロ秒
+  using TTask = std::function<uint32_t()>;
+  //! 現在時刻（マイクロ秒）を返す関数
+  using TClock = std::function<uint32_t()>;
+  //! アイドル処理。引数は次のタスクまでのマイクロ秒で、それより前に戻ること
+  using TIdle = std::function<void(uint32_t us)>;
+
+  //! 登録できるタスクの最大数（タスクを足すたびに増やさなくてよいよう、余裕を持たせておく）
+  static constexpr size_t MAX_TASKS = 12;
+  //! タスクが返せる最大の待ち時間（これより長ければ切り詰める）。時刻の比較が一周をまたがないようにする
+  static constexpr uint32_t MAX_DELAY_US = 1800000000UL;
+
+private:
+  struct entry_t {
+    TTask    task;
+    uint32_t due; //! 次に実行する時刻
+  };
+
+  std::array<entry_t, MAX_TASKS> _tasks;
+  size_t                         _count    = 0;
+  uint32_t                       _lateness = 0; //! 実行中のタスクが、予定の時刻からどれだけ遅れて始まったか
+  TClock                         _clock;
+  TIdle                          _idle;
+
+  /**
+   * @brief タスク @c entry を実行すべき時刻になっているか
+   */
+  bool isDue(const entry_t &entry, uint32_t now) const {
+    return static_cast<int32_t>(now - entry.due) >= 0;
+  }
+
+public:
+  /**
+   * @brief Construct a new Scheduler object
+   * 
+   * @param clock 現在時刻を返す関数（ micros() など）
+   * @param idle アイドル処理
+   */
+  Scheduler(const TClock &clock, const TIdle &idle)
+      : _clock(clock)
+      , _idle(idle) {}
+
+  /**
+   * @brief タスクを登録する
+   * 
+   * @param task タスク
+   * @param delay_us 初回の実行までのマイクロ秒
+   * @retval true 登録できた
+   * @retval false これ以上登録できない
+   */
+  bool add(const TTask &task, uint32_t delay_us = 0);
+
+  /**
+   * @brief 実行すべき時刻になったタスクを、登録した順に 1 回ずつ実行する
+   * 
+   * @return 次のタスクまでのマイクロ秒（すでに時刻になっているタスクがあれば 0）
+   */
+  uint32_t runDue();
+
+  /**
+   * @brief 次のタスクまでの時間を求める
+   * 
+   * @return 次のタスクまでのマイクロ秒（すでに時刻になっているタスクがあれば 0）
+   */
+  uint32_t untilNext() const;
+
+  /**
+   * @brief 実行中（または最後に実行した）タスクが、予定の時刻からどれだけ遅れて始まったかを取得する
+   * 
+   * @return マイクロ秒
+   */
+  uint32_t getLateness() const {
+    return _lateness;
+  }
+
+  /**
+   * @brief 実行すべきタスクを実行し、次のタスクの時刻になるまでアイドル処理を呼び続ける
+   */
+  void run();
+};
+
+#endif // Scheduler_H_
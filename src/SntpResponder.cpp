@@ -0,0 +1,25 @@
+#include "SntpResponder.h"
+#include <algorithm>
+
+bool SntpResponder::respond(const uint8_t *request, size_t length, uint64_t received_at, const NtpPacket::server_t *server, uint8_t *response, const TSend &send) {
+
+  if (!server || !response || !NtpPacket::makeResponse(request, length, *server, _clock(received_at), response)) {
+    _stats.dropped++;
+    return false;
+  }
+
+  // 送る直前の時刻を T3 にする
+  auto sent_at = _counter();
+  NtpPacket::writeTimestamp(response + NtpPacket::TRANSMIT_TIME, _clock(sent_at));
+  if (!send()) {
+    _stats.dropped++;
+    return false;
+  }
+
+  auto turnaround = static_cast<uint32_t>(sent_at - received_at);
+
+  _stats.served++;
+  _stats.last_turnaround_us = turnaround;
+  _stats.max_turnaround_us  = std::max(_stats.max_turnaround_us, turnaround);
+  return true;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file SntpResponder.h
+ */
+
+#ifndef SntpResponder_H_
+#define SntpResponder_H_
+
+#include "NtpPacket.h"
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief LAN の他の時計から届いた NTP (SNTP) の要求に応答するクラス
+ * 
+ * 要求を受け取った時刻 (T2) と応答を送る時刻 (T3) を応答に書き込み、応答の統計を取る。
+ * T3 は送る直前にカウンタを読み直して求めるので、T2 と T3 の間には応答を作る処理だけが入り、
+ * クライアントが求める往復遅延からは除かれる。
+ * 
+ * カウンタの読み方、時刻への直し方、応答の送り方はコンストラクタと respond() に渡す関数に任せるので、
+ * このクラス自体はハードウェアに依存しない。
+ */
+class SntpResponder {
+public:
+  //! マイクロ秒のカウンタ（ micros64() ）
+  using TCounter = std::function<uint64_t()>;
+  //! カウンタの値を時刻 [us] に直す関数（ ClockDiscipline::now() ）
+  using TClock = std::function<int64_t(uint64_t counter)>;
+  //! respond() に渡した response を送る関数。送れたら true を返す
+  using TSend = std::function<bool()>;
+
+  /**
+   * @brief 応答の統計
+   */
+  struct stats_t {
+    uint32_t served;             //! 応答した数
+    uint32_t dropped;            //! 捨てた要求の数（同期していない、要求が正しくないなど）
+    uint32_t last_turnaround_us; //! 直近の応答の、受け取ってから送るまでの時間
+    uint32_t max_turnaround_us;  //! 受け取ってから送るまでの時間の最大値
+  };
+
+private:
+  TCounter _counter;
+  TClock   _clock;
+  stats_t  _stats = {};
+
+public:
+  /**
+   * @brief Construct a new SntpResponder object
+   * 
+   * @param counter マイクロ秒のカウンタ
+   * @param clock カウンタの値を時刻に直す関数
+   */
+  SntpResponder(const TCounter &counter, const TClock &clock)
+      : _counter(counter)
+      , _clock(clock) {}
+
+  /**
+   * @brief 要求に応答する
+   * 
+   * @param request 要求
+   * @param length 要求の大きさ
+   * @param received_at 要求を受け取ったときのカウンタの値
+   * @param server この時計の状態。上流と同期していなければ nullptr（誤った時刻を広めないよう、応答しない）
+   * @param[out] response 応答の書き込み先（ NtpPacket::SIZE bytes ）。用意できなければ nullptr（要求は捨てる）
+   * @param send @c response を送る関数
+   * @retval true 応答した
+   * @retval false 要求を捨てた
+   */
+  bool respond(const uint8_t *request, size_t length, uint64_t received_at, const NtpPacket::server_t *server, uint8_t *response, const TSend &send);
+
+  const stats_t &getStats() const {
+    return _stats;
+  }
+};
+
+#endif // SntpResponder_H_
@@ -0,0 +1,327 @@
+#include "TZTable.h"
+#include <ctype.h>
+#include <utility>
+
+static constexpr int32_t SECONDS_PER_DAY = 86400;
+
+/**
+ * @brief 負の数でも、小さい方へ丸める割り算
+ */
+static int64_t floorDiv(int64_t a, int64_t b) {
+  return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+/**
+ * @brief 負の数でも、0 以上 b 未満になる剰余
+ */
+static int64_t floorMod(int64_t a, int64_t b) {
+  return a - floorDiv(a, b) * b;
+}
+
+static bool isLeap(int64_t year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int daysInMonth(int64_t year, int month) {
+  static constexpr int DAYS[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  return month == 2 && isLeap(year) ? 29 : DAYS[month - 1];
+}
+
+/**
+ * @brief 数字を読む
+ * 
+ * @param[in,out] p 読む位置
+ * @param[out] value 読んだ値
+ * @param max 最大値
+ * @return 読めたか（数字がない、または最大値を超えていたら false）
+ */
+static bool parseNumber(const char *&p, int32_t *value, int32_t max) {
+
+  if (!isdigit(static_cast<unsigned char>(*p)))
+    return false;
+
+  int32_t n = 0;
+  while (isdigit(static_cast<unsigned char>(*p))) {
+    n = n * 10 + (*p++ - '0');
+    if (n > max)
+      return false;
+  }
+
+  *value = n;
+  return true;
+}
+
+bool TZTable::parseName(const char *&p) {
+
+  // <+09> のような、括弧で囲んだ名前
+  if (*p == '<') {
+    auto begin = ++p;
+    while (*p && *p != '>')
+      p++;
+    if (*p != '>' || p == begin)
+      return false;
+    p++;
+    return true;
+  }
+
+  auto begin = p;
+  while (isalpha(static_cast<unsigned char>(*p)))
+    p++;
+  return p - begin >= 3;
+}
+
+bool TZTable::parseOffset(const char *&p, int32_t *seconds, int32_t max_hours) {
+
+  int32_t sign = 1;
+  if (*p == '+' || *p == '-')
+    sign = *p++ == '-' ? -1 : 1;
+
+  int32_t hours, minutes = 0, secs = 0;
+  if (!parseNumber(p, &hours, max_hours))
+    return false;
+  if (*p == ':' && !parseNumber(++p, &minutes, 59))
+    return false;
+  if (*p == ':' && !parseNumber(++p, &secs, 59))
+    return false;
+
+  *seconds = sign * (hours * 3600 + minutes * 60 + secs);
+  return true;
+}
+
+bool TZTable::parseRule(const char *&p, rule_t *rule) {
+
+  int32_t value;
+  *rule = {};
+
+  if (*p == 'J') {
+    if (!parseNumber(++p, &value, 365) || value < 1)
+      return false;
+    rule->type = 'J';
+    rule->day  = value;
+  } else if (*p == 'M') {
+    int32_t week, day;
+    if (!parseNumber(++p, &value, 12) || value < 1 || *p != '.' ||
+        !parseNumber(++p, &week, 5) || week < 1 || *p != '.' ||
+        !parseNumber(++p, &day, 6))
+      return false;
+    rule->type  = 'M';
+    rule->month = value;
+    rule->week  = week;
+    rule->day   = day;
+  } else {
+    if (!parseNumber(p, &value, 365))
+      return false;
+    rule->type = 'D';
+    rule->day  = value;
+  }
+
+  // 時刻は glibc と同じく、負の時刻と 167 時までを認める
+  rule->time = 2 * 3600;
+  if (*p == '/' && !parseOffset(++p, &rule->time, 167))
+    return false;
+
+  return true;
+}
+
+bool TZTable::parse(const char *tz) {
+
+  auto    p = tz;
+  int32_t offset;
+
+  // 標準時の名前と時差（POSIX の時差は UTC - 地方時なので、符号が逆）
+  if (!p || !parseName(p) || !parseOffset(p, &offset, 24))
+    return false;
+  _std_offset = -offset;
+
+  if (*p == '\0')
+    return true;
+
+  // 夏時間の名前と時差（時差を省略したら、標準時の 1 時間先）
+  if (!parseName(p))
+    return false;
+  _dst_offset = _std_offset + 3600;
+  if (*p && *p != ',') {
+    if (!parseOffset(p, &offset, 24))
+      return false;
+    _dst_offset = -offset;
+  }
+
+  // 夏時間の開始と終了
+  if (*p == ',') {
+    if (!parseRule(++p, &_start) || *p != ',' || !parseRule(++p, &_end) || *p != '\0')
+      return false;
+  } else if (*p == '\0') {
+    _start = {'M', 3, 2, 0, 2 * 3600};
+    _end   = {'M', 11, 1, 0, 2 * 3600};
+  } else {
+    return false;
+  }
+
+  _has_dst = true;
+  return true;
+}
+
+bool TZTable::configure(const char *tz) {
+
+  // 次の変換で、必ず表を作り直させる
+  _year_begin   = _year_end   = 0;
+  _period_begin = _period_end = 0;
+
+  _has_dst    = false;
+  _std_offset = 0;
+  _dst_offset = 0;
+  if (parse(tz))
+    return true;
+
+  // 書式が正しくなければ、UTC とみなす
+  _has_dst    = false;
+  _std_offset = 0;
+  return false;
+}
+
+int64_t TZTable::getTransition(const rule_t &rule, int64_t year, int32_t offset) {
+
+  int64_t days = toDays(year, 1, 1);
+
+  switch (rule.type) {
+  case 'J':
+    // 2/29 は数えない
+    days += rule.day - 1 + (rule.day >= 60 && isLeap(year) ? 1 : 0);
+    break;
+  case 'D':
+    days += rule.day;
+    break;
+  case 'M': {
+    // m 月の、w 番目の d 曜日（w = 5 は最後の d 曜日）
+    auto first   = toDays(year, rule.month, 1);
+    auto weekday = floorMod(first + 4, 7); // 1970/1/1 は木曜日
+    auto day     = (rule.day - weekday + 7) % 7 + (rule.week - 1) * 7;
+    auto mdays   = daysInMonth(year, rule.month);
+    while (day >= mdays)
+      day -= 7;
+    days = first + day;
+    break;
+  }
+  }
+
+  return days * SECONDS_PER_DAY + rule.time - offset;
+}
+
+void TZTable::compile(time_t t) {
+
+  struct tm date;
+  toDate(floorDiv(t, SECONDS_PER_DAY), &date);
+
+  _year       = date.tm_year + 1900;
+  _year_begin = toDays(_year, 1, 1) * SECONDS_PER_DAY;
+  _year_end   = toDays(_year + 1, 1, 1) * SECONDS_PER_DAY;
+  _compiles++;
+
+  if (!_has_dst) {
+    _count  = 0;
+    _before = {_year_begin, _std_offset, false};
+    return;
+  }
+
+  _table[0] = {static_cast<time_t>(getTransition(_start, _year, _std_offset)), _dst_offset, true};
+  _table[1] = {static_cast<time_t>(getTransition(_end, _year, _dst_offset)), _std_offset, false};
+  _count    = 2;
+
+  // 南半球のように、年の途中で夏時間が終わる（年の初めは夏時間）
+  if (_table[1].at < _table[0].at)
+    std::swap(_table[0], _table[1]);
+
+  // 年の初めは、年の最後の切り替えの後と同じ
+  _before = {_year_begin, _table[_count - 1].offset, _table[_count - 1].isdst};
+}
+
+void TZTable::findPeriod(time_t t) {
+
+  if (t < _year_begin || t >= _year_end)
+    compile(t);
+
+  // 切り替え時刻は年の範囲の外にあることもあるので、範囲で切り詰める
+  auto current = _before;
+  auto begin   = _year_begin;
+  auto end     = _year_end;
+
+  for (size_t i = 0; i < _count; i++) {
+    auto &transition = _table[i];
+    if (transition.at > t) {
+      if (transition.at < end)
+        end = transition.at;
+      break;
+    }
+    current = transition;
+    if (transition.at > begin)
+      begin = transition.at;
+  }
+
+  _period_begin = begin;
+  _period_end   = end;
+  _offset       = current.offset;
+  _isdst        = current.isdst;
+}
+
+int32_t TZTable::getOffset(time_t t, bool *isdst) {
+
+  // 前回と同じ範囲なら、比較だけで済む
+  if (t < _period_begin || t >= _period_end)
+    findPeriod(t);
+
+  if (isdst)
+    *isdst = _isdst;
+  return _offset;
+}
+
+struct tm TZTable::localtime(time_t t) {
+
+  bool    isdst;
+  int64_t local = static_cast<int64_t>(t) + getOffset(t, &isdst);
+  int64_t days  = floorDiv(local, SECONDS_PER_DAY);
+  int32_t secs  = local - days * SECONDS_PER_DAY;
+
+  struct tm tm = {};
+  toDate(days, &tm);
+  tm.tm_hour  = secs / 3600;
+  tm.tm_min   = secs / 60 % 60;
+  tm.tm_sec   = secs % 60;
+  tm.tm_isdst = isdst ? 1 : 0;
+  return tm;
+}
+
+// 日付の計算は http://howardhinnant.github.io/date_algorithms.html による
+
+void TZTable::toDate(int64_t days, struct tm *tm) {
+
+  auto z   = days + 719468;
+  auto era = floorDiv(z, 146097);
+  auto doe = z - era * 146097;
+  auto yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  auto doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  auto mp  = (5 * doy + 2) / 153;
+  auto day = doy - (153 * mp + 2) / 5 + 1;
+  auto mon = mp < 10 ? mp + 3 : mp - 9;
+  auto y   = yoe + era * 400 + (mon <= 2 ? 1 : 0);
+
+  tm->tm_year = y - 1900;
+  tm->tm_mon  = mon - 1;
+  tm->tm_mday = day;
+  tm->tm_wday = floorMod(days + 4, 7);
+  tm->tm_yday = days - toDays(y, 1, 1);
+}
+
+int64_t TZTable::toDays(int64_t year, int month, int day) {
+
+  year -= month <= 2 ? 1 : 0;
+  auto era = floorDiv(year, 400);
+  auto yoe = year - era * 400;
+  auto doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  auto doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+time_t TZTable::toTime(const struct tm &tm) {
+  auto days = toDays(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+  return days * SECONDS_PER_DAY + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file TZTable.h
+ */
+
+#ifndef TZTable_H_
+#define TZTable_H_
+
+#include <array>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @brief POSIX 形式のタイムゾーン文字列（ <TZ.h> の TZ_Asia_Tokyo など）を、1 年分の切り替え時刻の表にしておき、
+ * 地方時への変換を、次の切り替え時刻との比較だけで済ませるクラス
+ * 
+ * 表は configure() したときと、年が変わったときにだけ作り直す。
+ * newlib や glibc と同じく、使う規則は UTC での年のものだけとする（年をまたぐ規則でも結果が一致するように）。
+ * 書式は POSIX の TZ 変数（ glibc の拡張である、負の時刻と 24 時以降の時刻を含む）に従う。
+ * 夏時間の名前だけあって規則がない場合は、glibc と同じく "M3.2.0,M11.1.0" とみなす。
+ */
+class TZTable {
+public:
+  /**
+   * @brief 時差が切り替わる時刻
+   */
+  struct transition_t {
+    time_t  at;     //! 切り替わる時刻（UTC）
+    int32_t offset; //! 切り替わった後の時差 [s]（地方時 - UTC）
+    bool    isdst;  //! 切り替わった後が夏時間か
+  };
+
+  //! 表に入れる切り替えの最大数（夏時間の開始と終了）
+  static constexpr size_t MAX_TRANSITIONS = 2;
+
+private:
+  /**
+   * @brief 夏時間の開始または終了の規則
+   */
+  struct rule_t {
+    char     type;  //! 'J'（Jn: 閏日を数えない 1 始まりの日）、'D'（n: 閏日を数える 0 始まりの日）、'M'（Mm.w.d）
+    uint8_t  month; //! 'M' の月（1-12）
+    uint8_t  week;  //! 'M' の週（1-5。5 は最終週）
+    uint16_t day;   //! 'J' と 'D' の日、または 'M' の曜日（0 が日曜日）
+    int32_t  time;  //! 切り替える時刻 [s]（切り替える前の地方時）
+  };
+
+  bool    _has_dst    = false; //! 夏時間があるか
+  int32_t _std_offset = 0;     //! 標準時の時差 [s]（地方時 - UTC）
+  int32_t _dst_offset = 0;     //! 夏時間の時差 [s]
+  rule_t  _start;              //! 夏時間の開始
+  rule_t  _end;                //! 夏時間の終了
+
+  int64_t                                   _year       = 0;  //! 表を作った年（UTC）
+  time_t                                    _year_begin = 0;  //! 表が使える範囲の始め（その年の 1/1 00:00:00 UTC）
+  time_t                                    _year_end   = 0;  //! 表が使える範囲の終わり（翌年の 1/1 00:00:00 UTC）
+  std::array<transition_t, MAX_TRANSITIONS> _table      = {}; //! 切り替え時刻の表（時刻順）
+  size_t                                    _count      = 0;  //! _table の有効な要素数
+  transition_t                              _before     = {}; //! _table の最初の切り替えより前の時差
+  uint32_t                                  _compiles   = 0;  //! 表を作った回数
+
+  time_t  _period_begin = 0;     //! 前回の変換で使った時差が有効な範囲の始め
+  time_t  _period_end   = 0;     //! 前回の変換で使った時差が有効な範囲の終わり（次の切り替え時刻）
+  int32_t _offset       = 0;     //! 前回の変換で使った時差
+  bool    _isdst        = false; //! 前回の変換で使った時差が夏時間か
+
+  static bool parseName(const char *&p);
+  static bool parseOffset(const char *&p, int32_t *seconds, int32_t max_hours);
+  static bool parseRule(const char *&p, rule_t *rule);
+
+  /**
+   * @brief タイムゾーン文字列を読んで、_has_dst, _std_offset, _dst_offset, _start, _end に入れる
+   * 
+   * @retval false 書式が正しくない
+   */
+  bool parse(const char *tz);
+
+  /**
+   * @brief 規則から、その年の切り替え時刻を求める
+   * 
+   * @param rule 規則
+   * @param year 年
+   * @param offset 切り替える前の時差 [s]
+   * @return 切り替え時刻（UTC）
+   */
+  static int64_t getTransition(const rule_t &rule, int64_t year, int32_t offset);
+
+  /**
+   * @brief 時刻が含まれる年の表を作る
+   */
+  void compile(time_t t);
+
+  /**
+   * @brief 時刻が含まれる、時差が変わらない範囲を探して、_period_* と _offset, _isdst に入れる
+   */
+  void findPeriod(time_t t);
+
+public:
+  /**
+   * @brief タイムゾーンを設定する
+   * 
+   * @param tz POSIX 形式のタイムゾーン文字列（RAM 上にあること）
+   * @retval true 設定できた
+   * @retval false 書式が正しくない（UTC とみなす）
+   */
+  bool configure(const char *tz);
+
+  /**
+   * @brief UTC の時刻を地方時に変換する
+   * 
+   * @param t 時刻（UTC）
+   * @return 地方時
+   */
+  struct tm localtime(time_t t);
+
+  /**
+   * @brief 時刻の時差を取得する
+   * 
+   * @param t 時刻（UTC）
+   * @param[out] isdst 夏時間か（不要なら nullptr）
+   * @return 時差 [s]（地方時 - UTC）
+   */
+  int32_t getOffset(time_t t, bool *isdst = nullptr);
+
+  /**
+   * @brief 表を作った回数を取得する（計測用）
+   */
+  uint32_t getCompiles() const {
+    return _compiles;
+  }
+
+  /**
+   * @brief 1970/1/1 からの日数を、年月日に直す
+   * 
+   * @param days 1970/1/1 からの日数
+   * @param[out] tm 年月日と曜日、年内の通算日を入れる
+   */
+  static void toDate(int64_t days, struct tm *tm);
+
+  /**
+   * @brief 年月日を、1970/1/1 からの日数に直す
+   * 
+   * @param year 年
+   * @param month 月（1-12）
+   * @param day 日
+   */
+  static int64_t toDays(int64_t year, int month, int day);
+
+  /**
+   * @brief gmtime() の逆（ timegm() ）
+   * 
+   * @param tm 時刻（UTC）
+   * @return 1970/1/1 00:00:00 UTC からの秒数
+   */
+  static time_t toTime(const struct tm &tm);
+};
+
+#endif // TZTable_H_
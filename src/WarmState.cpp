@@ -0,0 +1,146 @@
+#include "WarmState.h"
+
+//! "WRM1"
+static constexpr uint32_t MAGIC   = 0x314d5257;
+static constexpr uint8_t  VERSION = 1;
+
+/**
+ * @brief リトルエンディアンで書き込み、p を進める
+ */
+static void put(uint8_t *&p, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++)
+    *p++ = value >> (8 * i);
+}
+
+/**
+ * @brief リトルエンディアンで読み込み、p を進める
+ */
+static uint64_t get(const uint8_t *&p, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++)
+    value |= static_cast<uint64_t>(*p++) << (8 * i);
+  return value;
+}
+
+/**
+ * @brief 小数を、単位の整数倍に丸める
+ */
+static int32_t quantize(float value, float unit) {
+  return static_cast<int32_t>(lroundf(value / unit));
+}
+
+size_t WarmState::serialize(const state_t &state, uint8_t *buffer, size_t size) {
+
+  auto count  = state.envdata_count;
+  auto length = FIXED_SIZE + count * ENVDATA_SIZE;
+  if (count > MAX_ENVDATAS || HEADER_SIZE + length > size)
+    return 0;
+  if (state.ambient_transfered > count || state.custom_server_transfered > count)
+    return 0;
+
+  // envdata の時刻は、最初の envdata からの差で持つ
+  time_t base = count > 0 ? state.envdatas[0].time : 0;
+
+  auto p = buffer;
+  put(p, MAGIC, 4);
+  put(p, length, 2);
+  put(p, VERSION, 1);
+  put(p, count, 1);
+
+  p = buffer + HEADER_SIZE;
+  put(p, state.synced ? 1 : 0, 1);
+  put(p, static_cast<uint8_t>(state.brightness), 1);
+  put(p, state.brightness_average, 2);
+  put(p, state.usec, 4);
+  put(p, static_cast<int64_t>(state.time), 8);
+  put(p, state.rtc_cycles, 4);
+  put(p, state.rtc_period, 4);
+  put(p, state.ambient_transfered, 2);
+  put(p, state.custom_server_transfered, 2);
+  put(p, static_cast<int64_t>(base), 8);
+
+  for (size_t i = 0; i < count; i++) {
+    auto &data = state.envdatas[i];
+    if (data.time < base || static_cast<int64_t>(data.time) - base > UINT32_MAX)
+      return 0;
+    put(p, data.time - base, 4);
+    put(p, static_cast<uint16_t>(quantize(data.temperature, 0.01f)), 2);
+    put(p, static_cast<uint16_t>(quantize(data.humidity, 0.01f)), 2);
+    put(p, static_cast<uint16_t>(quantize(data.pressure, 0.1f)), 2);
+  }
+
+  // CRC はヘッダ（ CRC 自身を除く）と中身にわたって計算する
+  auto crc = crc32(buffer, HEADER_SIZE - 4);
+  crc      = crc32(buffer + HEADER_SIZE, length, crc);
+
+  p = buffer + HEADER_SIZE - 4;
+  put(p, crc, 4);
+
+  return HEADER_SIZE + length;
+}
+
+bool WarmState::deserialize(const uint8_t *buffer, size_t size, state_t *state) {
+
+  if (size < HEADER_SIZE)
+    return false;
+
+  auto p       = buffer;
+  auto magic   = get(p, 4);
+  auto length  = get(p, 2);
+  auto version = get(p, 1);
+  auto count   = get(p, 1);
+  auto crc     = get(p, 4);
+
+  if (magic != MAGIC || version != VERSION || count > MAX_ENVDATAS)
+    return false;
+  if (length != FIXED_SIZE + count * ENVDATA_SIZE || HEADER_SIZE + length > size)
+    return false;
+  if (crc != crc32(buffer + HEADER_SIZE, length, crc32(buffer, HEADER_SIZE - 4)))
+    return false;
+
+  state_t result;
+
+  result.synced                   = get(p, 1) != 0;
+  result.brightness               = static_cast<int8_t>(get(p, 1));
+  result.brightness_average       = get(p, 2);
+  result.usec                     = get(p, 4);
+  result.time                     = static_cast<int64_t>(get(p, 8));
+  result.rtc_cycles               = get(p, 4);
+  result.rtc_period               = get(p, 4);
+  result.ambient_transfered       = get(p, 2);
+  result.custom_server_transfered = get(p, 2);
+  result.envdata_count            = count;
+
+  auto base = static_cast<int64_t>(get(p, 8));
+  for (size_t i = 0; i < count; i++) {
+    auto &data = result.envdatas[i];
+
+    data.time        = base + get(p, 4);
+    data.temperature = static_cast<int16_t>(get(p, 2)) * 0.01f;
+    data.humidity    = static_cast<uint16_t>(get(p, 2)) * 0.01f;
+    data.pressure    = static_cast<uint16_t>(get(p, 2)) * 0.1f;
+  }
+
+  // CRC が合っても、書いた側の不具合で値がおかしいかもしれない
+  if (result.usec >= 1000000 || result.ambient_transfered > count || result.custom_server_transfered > count)
+    return false;
+
+  *state = result;
+  return true;
+}
+
+uint64_t WarmState::elapsedUs(const state_t &state, uint32_t rtc_cycles) {
+  return (static_cast<uint64_t>(rtc_cycles - state.rtc_cycles) * state.rtc_period) >> 12;
+}
+
+uint32_t WarmState::crc32(const uint8_t *data, size_t length, uint32_t crc) {
+
+  // 数百バイトしか計算しないので、表を持たずに 1 ビットずつ計算する
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+  }
+  return ~crc;
+}
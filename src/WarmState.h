@@ -0,0 +1,85 @@
+/**
+ * @file WarmState.h
+ */
+
+#ifndef WarmState_H_
+#define WarmState_H_
+
+#include "envdata_t.h"
+#include <Arduino.h>
+#include <array>
+
+namespace WarmState {
+
+//! RTC ユーザーメモリのうち、使える大きさ [bytes]（先頭の 128 bytes は OTA の eboot コマンドが使う）
+static constexpr size_t MAX_SIZE = 384;
+//! ヘッダの大きさ [bytes]（magic, 長さ, 版, envdata の数, CRC-32）
+static constexpr size_t HEADER_SIZE = 12;
+//! envdata 以外の中身の大きさ [bytes]
+static constexpr size_t FIXED_SIZE = 36;
+//! envdata 1 件の大きさ [bytes]（時刻の差, 気温, 湿度, 気圧）
+static constexpr size_t ENVDATA_SIZE = 10;
+//! 保存できる envdata の最大数
+static constexpr size_t MAX_ENVDATAS = (MAX_SIZE - HEADER_SIZE - FIXED_SIZE) / ENVDATA_SIZE;
+
+/**
+ * @brief 再起動をまたいで引き継ぐ状態
+ */
+struct state_t {
+  bool                                synced;                   //! time が確かな時刻か（NTP で同期していたか）
+  time_t                              time;                     //! 保存したときの時刻（UTC）
+  uint32_t                            usec;                     //! time のマイクロ秒部分
+  uint32_t                            rtc_cycles;               //! 保存したときの RTC のカウンタ（ system_get_rtc_time() ）
+  uint32_t                            rtc_period;               //! RTC の 1 カウントの時間 [us] の 4096 倍（ system_rtc_clock_cali_proc() ）
+  uint16_t                            ambient_transfered;       //! envdatas のうち、Ambient に送信済みの件数
+  uint16_t                            custom_server_transfered; //! envdatas のうち、カスタムサーバーに送信済みの件数
+  int8_t                              brightness;               //! 画面の明るさ（-1 なら off）
+  uint16_t                            brightness_average;       //! 光センサの観測値の平均
+  size_t                              envdata_count;            //! envdatas の有効な要素数
+  std::array<envdata_t, MAX_ENVDATAS> envdatas;                 //! 送信していない envdata（古い順）
+};
+
+/**
+ * @brief 状態をバイト列にする
+ * 
+ * envdata は気温 0.01 ℃、湿度 0.01 %、気圧 0.1 hPa 単位に丸める。
+ * 
+ * @param state 状態
+ * @param[out] buffer 書き込み先
+ * @param size buffer の大きさ
+ * @return 書き込んだ大きさ（0 なら buffer が足りないか、state が正しくない）
+ */
+size_t serialize(const state_t &state, uint8_t *buffer, size_t size);
+
+/**
+ * @brief バイト列を検証して、状態に戻す
+ * 
+ * @param buffer 読み込み元
+ * @param size buffer の大きさ
+ * @param[out] state 状態
+ * @retval true 戻せた
+ * @retval false magic や CRC が合わない（電源投入後の RTC メモリなど）
+ */
+bool deserialize(const uint8_t *buffer, size_t size, state_t *state);
+
+/**
+ * @brief 保存してから経った時間を、RTC のカウンタから求める
+ * 
+ * @param state 状態
+ * @param rtc_cycles 今の RTC のカウンタ
+ * @return マイクロ秒
+ */
+uint64_t elapsedUs(const state_t &state, uint32_t rtc_cycles);
+
+/**
+ * @brief CRC-32 (IEEE 802.3) を計算する
+ * 
+ * @param data データ
+ * @param length データの大きさ
+ * @param crc 続きを計算するなら、それまでの値
+ */
+uint32_t crc32(const uint8_t *data, size_t length, uint32_t crc = 0);
+
+} // namespace WarmState
+
+#endif // WarmState_H_
@@ -48,10 +48,18 @@ void Brightness::changeSetting(const brightness_setting_t &setting) {
   _setting = setting;
 }
 
+void Brightness::restore(int8_t brightness, uint16_t average) {
+  _buffer.assign(_buffer.capacity(), average);
+  _before  = average;
+  _current = brightness;
+}
+
 int8_t Brightness::getBrightness() const {
   return _current;
 }
 
 uint16_t Brightness::calcAverageRawValue() const {
+  if (_buffer.empty())
+    return 0;
   return std::accumulate(_buffer.begin(), _buffer.end(), (TBufElem)0) / _buffer.size();
 }
@@ -69,6 +69,13 @@ public:
    * @param setting 新しい設定値
    */
   void changeSetting(const brightness_setting_t &setting);
+  /**
+   * @brief 再起動の前の状態に戻す（観測値の平均が落ち着くのを待たずに済むように）
+   * 
+   * @param brightness LED の明るさ（-1 なら off）
+   * @param average 生の観測値の平均
+   */
+  void restore(int8_t brightness, uint16_t average);
   /**
    * @brief LED の明るさとして設定すべき値を取得する
    * 
@@ -0,0 +1,109 @@
+/**
+ * @file FrameCache.h
+ */
+
+#ifndef FrameCache_H_
+#define FrameCache_H_
+
+#include <Arduino.h>
+#include <array>
+
+/**
+ * @brief 描画済みの画面を、その画面の見た目を決める値（キー）と組にして保持するキャッシュ
+ * 
+ * 同じキーの画面がもう一度必要になったら、描き直す代わりに保持している内容をコピーすれば済む。
+ * 中身は最後に描画した画面から順に最大 Capacity 枚で、溢れたら古いものから捨てる。
+ * 
+ * @tparam FrameBytes 画面 1 枚分のバイト数（MAX7219::BufferBase::FrameBytes）
+ * @tparam BudgetBytes キャッシュ全体に使ってよいバイト数。1 枚分に満たなければキャッシュしない
+ */
+template <size_t FrameBytes, size_t BudgetBytes>
+class FrameCache {
+public:
+  //! キーに含められる値の最大数
+  static constexpr size_t MAX_VALUES = 3;
+
+  /**
+   * @brief 画面の見た目を決める値
+   */
+  struct key_t {
+    uint8_t  pane;               //! 画面の種類
+    uint8_t  count;              //! values の有効な要素数（0 = 空きエントリ）
+    uint64_t values[MAX_VALUES]; //! 画面を構成する部品ごとの値
+
+    bool operator==(const key_t &rhs) const {
+      if (pane != rhs.pane || count != rhs.count)
+        return false;
+      for (size_t i = 0; i < count; i++) {
+        if (values[i] != rhs.values[i])
+          return false;
+      }
+      return true;
+    }
+  };
+
+private:
+  struct entry_t {
+    key_t   key;
+    uint8_t frame[FrameBytes];
+  };
+
+public:
+  //! 保持できる画面の枚数
+  static constexpr size_t Capacity = BudgetBytes / sizeof(entry_t);
+
+private:
+  std::array<entry_t, Capacity> _entries = {};
+  size_t                        _next    = 0; //! 次に上書きするエントリ
+  uint32_t                      _hits    = 0;
+  uint32_t                      _misses  = 0;
+
+public:
+  /**
+   * @brief キーに対応する画面を探す
+   * 
+   * @param key キー
+   * @return 見つかった画面。無ければ nullptr
+   */
+  const uint8_t *find(const key_t &key) {
+
+    for (size_t i = 0; i < Capacity; i++) {
+      if (_entries[i].key.count && _entries[i].key == key) {
+        _hits++;
+        return _entries[i].frame;
+      }
+    }
+
+    _misses++;
+    return nullptr;
+  }
+
+  /**
+   * @brief キーに対応する画面を保持する場所を確保する（一番古い画面を上書きする）
+   * 
+   * @param key キー
+   * @return 画面 1 枚分の書き込み先。キャッシュの大きさが 0 なら nullptr
+   */
+  uint8_t *insert(const key_t &key) {
+
+    if (Capacity == 0)
+      return nullptr;
+
+    entry_t &entry = _entries[_next];
+    if (++_next >= Capacity)
+      _next = 0;
+
+    entry.key = key;
+    return entry.frame;
+  }
+
+  uint32_t getHits() const {
+    return _hits;
+  }
+
+  uint32_t getMisses() const {
+    return _misses;
+  }
+};
+
+#endif // FrameCache_H_
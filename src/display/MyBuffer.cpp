@@ -1,5 +1,4 @@
 #include "MyBuffer.h"
-#include "../main.h"
 #include "MyGraphics.h"
 #include <MAX7219Display.h>
 #include <string>
@@ -9,201 +8,398 @@ static constexpr suseconds_t HALF_OF_SEC_US = 500000; // 0.5秒
 
 static const std::array<char16_t, 7> wd = {u'日', u'月', u'火', u'水', u'木', u'金', u'土'};
 
-void MyBuffer::timeRow2(const struct tm &tm) {
-  if (tm.tm_hour >= 10)
-    this->writeInteger<4, 10>(tm.tm_hour / 10, 0, 0, 6, 4); // 時
-  this->writeInteger<5, 10>(tm.tm_hour % 10, 0, 5, 6, 5);   // 時
-  this->turnDot(true, 11, 8);                               // コロン
-  this->turnDot(true, 11, 13);                              // コロン
-  this->writeInteger<5, 10>(tm.tm_min, 2, 13, 6, 11);       // 分
-  this->writeInteger<3, 5>(tm.tm_sec, 2, 25, 11, 7);        // 秒
-}
-
-bool MyBuffer::isRequireUpdate(const struct tm &tm, suseconds_t us, const envdata_t &envData, IPAddress *addr) const {
-
-  if ((_override_pane == OverridePanes::OFF) != (_prev_override_pane == OverridePanes::OFF))
-    return true;
-
-  if (_pane != _prev_pane)
-    return true;
-
-  auto tm_changed = _prev_tm != tm;
-
-  if (_override_pane == OverridePanes::OFF)
-    return tm_changed;
+using widget_t       = MyBuffer::widget_t;
+using widget_input_t = MyBuffer::widget_input_t;
 
-  auto envData_changed = envData != _prev_envData;
-
-  bool addr_changed;
-  if (addr && addr->isSet())
-    addr_changed = *addr != _prev_addr;
-  else
-    addr_changed = (addr && addr->isSet()) != _prev_addr.isSet();
-
-  switch (_pane) {
-  case Panes::SYNCING_TIME: /* 同期中... */
-  case Panes::TIME:         /* 時刻のみ、秒なし */
-    return tm_changed || (_prev_us < HALF_OF_SEC_US && HALF_OF_SEC_US <= us);
-
-  case Panes::IP_ADDR: /* IPアドレス表示 */
-    return addr_changed;
+/**
+ * @brief 入力によらず同じ内容を描くウィジェット用の key
+ */
+static uint64_t constantKey(const widget_input_t &) {
+  return 0;
+}
 
-  case Panes::PRES_TIME:      /* 気圧＋時刻 */
-  case Panes::TEMP_HUMI_TIME: /* 温度＋湿度＋時刻 */
-    return tm_changed || envData_changed;
+/**
+ * @brief 計測値を、計測結果が有効かどうかも含めて key にする
+ */
+static uint64_t measuredKey(const envdata_t &envData, float value) {
 
-  case Panes::DATE_TIME: /* 日付＋時刻 */
-    return tm_changed;
+  if (!envData.isValid())
+    return 0;
 
-  default:
-    return false;
-  }
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return (static_cast<uint64_t>(1) << 32) | bits;
 }
 
-void MyBuffer::assignPrevValues(const struct tm &tm, suseconds_t us, const envdata_t &envData, IPAddress *addr) {
+/**
+ * @brief 時刻のコロンを点けるか
+ * 
+ * 同期していない間は、偶数秒の前半だけ点ける（正しい時刻と見分けられるよう、普段と違う点滅にする）。
+ * 
+ * @param blink true なら、同期していても 0.5 秒ごとに点滅させる
+ */
+static bool isColonLit(const widget_input_t &in, bool blink) {
 
-  _prev_pane          = _pane;
-  _prev_override_pane = _override_pane;
-  _prev_tm            = tm;
-  _prev_us            = us;
-  _prev_envData       = envData;
+  if (!in.synced)
+    return (in.tm.tm_sec & 1) == 0 && in.us < HALF_OF_SEC_US;
 
-  if (addr && addr->isSet()) {
-    _prev_addr = *addr;
-  } else {
-    _prev_addr = IPAddress();
-  }
+  return !blink || in.us < HALF_OF_SEC_US;
 }
 
-void MyBuffer::update(const struct tm &tm, suseconds_t us, const envdata_t &envData, IPAddress *addr) {
+/* 「時刻＋他の情報」の 2 行目（時刻） */
+
+static const widget_t ROW2_HOUR = {
+    0, 6, 10, 10,
+    [](const widget_input_t &in) -> uint64_t { return in.tm.tm_hour; },
+    [](MyBuffer &buffer, const widget_input_t &in) {
+      if (in.tm.tm_hour >= 10)
+        buffer.writeInteger<4, 10>(in.tm.tm_hour / 10, 0, 0, 6, 4); // 時
+      buffer.writeInteger<5, 10>(in.tm.tm_hour % 10, 0, 5, 6, 5);   // 時
+    }};
+
+static const widget_t ROW2_COLON = {
+    11, 8, 1, 6,
+    [](const widget_input_t &in) -> uint64_t { return isColonLit(in, false); },
+    [](MyBuffer &buffer, const widget_input_t &in) {
+      buffer.turnDot(isColonLit(in, false), 11, 8);  // コロン
+      buffer.turnDot(isColonLit(in, false), 11, 13); // コロン
+    }};
+
+static const widget_t ROW2_MINUTE = {
+    13, 6, 11, 10,
+    [](const widget_input_t &in) -> uint64_t { return in.tm.tm_min; },
+    [](MyBuffer &buffer, const widget_input_t &in) {
+      buffer.writeInteger<5, 10>(in.tm.tm_min, 2, 13, 6, 11); // 分
+    }};
+
+static const widget_t ROW2_SECOND = {
+    25, 11, 7, 5,
+    [](const widget_input_t &in) -> uint64_t { return in.tm.tm_sec; },
+    [](MyBuffer &buffer, const widget_input_t &in) {
+      buffer.writeInteger<3, 5>(in.tm.tm_sec, 2, 25, 11, 7); // 秒
+    }};
+
+/* 画面オフ（フリーズしてないことを示すため 1 ドット点滅させる） */
+static const widget_t OFF_WIDGETS[] = {
+    {0, 0, 1, 1,
+     [](const widget_input_t &in) -> uint64_t { return in.tm.tm_sec & 1; },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.turnDot((in.tm.tm_sec & 1) == 0, 0, 0);
+     }},
+};
+
+/* タイトル画面 */
+static const widget_t WELCOME_WIDGETS[] = {
+    {0, 0, 32, 16,
+     constantKey,
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.write(ConstGraphics::welcome, 0, 0, 32);
+     }},
+};
+
+/* 設定してください */
+static const widget_t REQUIRE_SETTING_WIDGETS[] = {
+    {0, 0, 32, 16,
+     constantKey,
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.write(ConstGraphics::plz_setting, 0, 0, 32);
+     }},
+};
+
+/* 同期中... */
+static const widget_t SYNCING_TIME_WIDGETS[] = {
+    // 3点リーダは「同期中」の領域に含まれるので、まとめて描き直す
+    {0, 8, 32, 8,
+     [](const widget_input_t &in) -> uint64_t {
+       bool odd  = (in.tm.tm_sec & 1) == 1;
+       bool half = in.us >= HALF_OF_SEC_US;
+       return (!odd || !half) | (odd || half) << 1 | (odd || !half) << 2;
+     },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.write(ConstGraphics::douki_chu, 0, 8, 32);
+       // 3点リーダをアニメーションさせる
+       buffer.turnDot((in.tm.tm_sec & 1) == 0 || in.us < HALF_OF_SEC_US, 27, 15);
+       buffer.turnDot((in.tm.tm_sec & 1) == 1 || in.us >= HALF_OF_SEC_US, 29, 15);
+       buffer.turnDot((in.tm.tm_sec & 1) == 1 || in.us < HALF_OF_SEC_US, 31, 15);
+     }},
+};
+
+/* Wi-Fi 接続不可 */
+static const widget_t CONNECT_FAILED_WIDGETS[] = {
+    {0, 0, 32, 16,
+     constantKey,
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.write(ConstGraphics::con_fail, 0, 0, 32);
+     }},
+};
+
+/* IPアドレス表示 */
+static const widget_t IP_ADDR_WIDGETS[] = {
+    {0, 0, 32, 16,
+     [](const widget_input_t &in) -> uint64_t {
+       if (!in.addr || !in.addr->isV4())
+         return 0;
+       return (static_cast<uint64_t>(1) << 32) |
+              static_cast<uint32_t>((*in.addr)[0]) << 24 | static_cast<uint32_t>((*in.addr)[1]) << 16 |
+              static_cast<uint32_t>((*in.addr)[2]) << 8 | static_cast<uint32_t>((*in.addr)[3]);
+     },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       if (in.addr && in.addr->isV4()) {
+         buffer.writeInteger<3, 7>((*in.addr)[0], 0, 0, 0, 11);  // 第1オクテット
+         buffer.turnDot(true, 12, 6);                            // 小数点
+         buffer.writeInteger<3, 7>((*in.addr)[1], 0, 14, 0, 11); // 第2オクテット
+         buffer.turnDot(true, 26, 6);                            // 小数点
+         buffer.writeInteger<3, 7>((*in.addr)[2], 0, 6, 8, 11);  // 第3オクテット
+         buffer.turnDot(true, 18, 14);                           // 小数点
+         buffer.writeInteger<3, 7>((*in.addr)[3], 0, 20, 8, 11); // 第4オクテット
+       } else {
+         // IPv6 は非対応...のはず
+         buffer.writeString<3, 7>(u"---.---.", 14, 0);
+         buffer.writeString<3, 7>(u"---.---", 20, 8);
+       }
+     }},
+};
+
+/* 気圧＋時刻 */
+static const widget_t PRES_TIME_WIDGETS[] = {
+    {-1, 0, 21, 5,
+     [](const widget_input_t &in) -> uint64_t { return measuredKey(in.envData, in.envData.pressure); },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       if (!in.envData.isValid()) {
+         buffer.writeString<3, 5>(u" ---.-", -1, 0);
+       } else {
+         buffer.writeReal<3, 5>(in.envData.pressure, 1, -1, 0, 21);
+       }
+     }},
+    {21, 0, 11, 5,
+     constantKey,
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.writeString<3, 5>(u"hPa", 21, 0);
+     }},
+    ROW2_HOUR,
+    ROW2_COLON,
+    ROW2_MINUTE,
+    ROW2_SECOND,
+};
+
+/* 温度＋湿度＋時刻 */
+static const widget_t TEMP_HUMI_TIME_WIDGETS[] = {
+    // 温度表示
+    {0, 0, 13, 5,
+     [](const widget_input_t &in) -> uint64_t { return measuredKey(in.envData, in.envData.temperature); },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       if (!in.envData.isValid()) {
+         buffer.writeString<3, 5>(u"--.-", 0, 0);
+       } else if (in.envData.temperature < -40.0f) {
+         // 低すぎ
+         buffer.writeString<3, 5>(u"Lo", 3, 0);
+       } else if (in.envData.temperature > 85.0f) {
+         // 高すぎ
+         buffer.writeString<3, 5>(u"Hi", 3, 0);
+       } else {
+         buffer.writeReal<3, 5>(in.envData.temperature, 1, 0, 0, 13);
+       }
+     }},
+    {14, 0, 4, 5,
+     constantKey,
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.writeString<4, 5>(u"℃", 14, 0);
+     }},
+    // 湿度表示
+    {19, 0, 7, 5,
+     [](const widget_input_t &in) -> uint64_t { return measuredKey(in.envData, in.envData.humidity); },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       if (!in.envData.isValid())
+         buffer.writeString<3, 5>(u"--", 19, 0);
+       else if (in.envData.humidity <= 0.0f)
+         buffer.writeString<3, 5>(u"Lo", 19, 0);
+       else if (in.envData.humidity >= 100.0f)
+         buffer.writeString<3, 5>(u"RH", 19, 0);
+       else
+         buffer.writeReal<3, 5>(in.envData.humidity, 0, 19, 0, 7);
+     }},
+    {27, 0, 5, 5,
+     constantKey,
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.writeString<5, 5>(u"%", 27, 0);
+     }},
+    ROW2_HOUR,
+    ROW2_COLON,
+    ROW2_MINUTE,
+    ROW2_SECOND,
+};
+
+/* 時刻のみ、秒なし */
+static const widget_t TIME_WIDGETS[] = {
+    {0, 0, 14, 16,
+     [](const widget_input_t &in) -> uint64_t { return in.tm.tm_hour; },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       if (in.tm.tm_hour >= 10)
+         buffer.writeInteger<6, 16>(in.tm.tm_hour / 10, 0, 0, 0, 6); // 時
+       buffer.writeInteger<7, 16>(in.tm.tm_hour % 10, 0, 7, 0, 7);   // 時
+     }},
+    {15, 4, 1, 8,
+     [](const widget_input_t &in) -> uint64_t { return isColonLit(in, true); },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.turnDot(isColonLit(in, true), 15, 4);  // コロン
+       buffer.turnDot(isColonLit(in, true), 15, 11); // コロン
+     }},
+    {17, 0, 15, 16,
+     [](const widget_input_t &in) -> uint64_t { return in.tm.tm_min; },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.writeInteger<7, 16>(in.tm.tm_min, 2, 17, 0, 15); // 分
+     }},
+};
+
+/* 日付＋時刻 */
+static const widget_t DATE_TIME_WIDGETS[] = {
+    {-2, 0, 9, 5,
+     [](const widget_input_t &in) -> uint64_t { return in.tm.tm_mon; },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.writeInteger<4, 5>(in.tm.tm_mon + 1, 0, -2, 0, 9); // 月
+     }},
+    {8, 0, 5, 5,
+     constantKey,
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.writeString<5, 5>(u"/", 8, 0);
+     }},
+    {14, 0, 9, 5,
+     [](const widget_input_t &in) -> uint64_t { return in.tm.tm_mday; },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.writeInteger<4, 5>(in.tm.tm_mday, 0, 14, 0, 9); // 日
+     }},
+    {25, 0, 7, 7,
+     [](const widget_input_t &in) -> uint64_t { return in.tm.tm_wday; },
+     [](MyBuffer &buffer, const widget_input_t &in) {
+       buffer.writeChar<7, 7>(wd.at(in.tm.tm_wday), 25, 0); // 曜日
+     }},
+    ROW2_HOUR,
+    ROW2_COLON,
+    ROW2_MINUTE,
+    ROW2_SECOND,
+};
+
+template <size_t N>
+static const widget_t *widgetsOf(const widget_t (&widgets)[N], size_t &count) {
+  static_assert(N <= MyBuffer::MAX_WIDGETS, "too many widgets");
+  count = N;
+  return widgets;
+}
 
-  assignPrevValues(tm, us, envData, addr);
+const widget_t *MyBuffer::getWidgets(size_t &count) const {
 
-  if (_override_pane == OverridePanes::OFF) {
-    /* 画面オフ（フリーズしてないことを示すため 1 ドット点滅させる） */
-    this->clearAll();
-    this->turnDot((tm.tm_sec & 1) == 0, 0, 0);
-    return;
-  }
+  if (_override_pane == OverridePanes::OFF)
+    return widgetsOf(OFF_WIDGETS, count);
 
   switch (_pane) {
   case Panes::WELCOME:
-    /* タイトル画面 */
-    this->clearAll();
-    this->write(ConstGraphics::welcome, 0, 0, 32);
-    break;
-
+    return widgetsOf(WELCOME_WIDGETS, count);
   case Panes::REQUIRE_SETTING:
-    /* 設定してください */
-    this->clearAll();
-    this->write(ConstGraphics::plz_setting, 0, 0, 32);
-    break;
-
+    return widgetsOf(REQUIRE_SETTING_WIDGETS, count);
   case Panes::SYNCING_TIME:
-    /* 同期中... */
-    this->clearAll();
+    return widgetsOf(SYNCING_TIME_WIDGETS, count);
+  case Panes::CONNECT_FAILED:
+    return widgetsOf(CONNECT_FAILED_WIDGETS, count);
+  case Panes::IP_ADDR:
+    return widgetsOf(IP_ADDR_WIDGETS, count);
+  case Panes::PRES_TIME:
+    return widgetsOf(PRES_TIME_WIDGETS, count);
+  case Panes::TEMP_HUMI_TIME:
+    return widgetsOf(TEMP_HUMI_TIME_WIDGETS, count);
+  case Panes::TIME:
+    return widgetsOf(TIME_WIDGETS, count);
+  default: /* DATE_TIME */
+    return widgetsOf(DATE_TIME_WIDGETS, count);
+  }
+}
 
-    this->write(ConstGraphics::douki_chu, 0, 8, 32);
-    // 3点リーダをアニメーションさせる
-    this->turnDot((tm.tm_sec & 1) == 0 || us < HALF_OF_SEC_US, 27, 15);
-    this->turnDot((tm.tm_sec & 1) == 1 || us >= HALF_OF_SEC_US, 29, 15);
-    this->turnDot((tm.tm_sec & 1) == 1 || us < HALF_OF_SEC_US, 31, 15);
-    break;
+bool MyBuffer::isRequireFullRedraw() const {
+  return _drawn_pane != _pane || _drawn_off != (_override_pane == OverridePanes::OFF);
+}
 
-  case Panes::CONNECT_FAILED:
-    /* Wi-Fi 接続不可 */
-    this->write(ConstGraphics::con_fail, 0, 0, 32);
-    break;
+bool MyBuffer::isRequireUpdate(const struct tm &tm, suseconds_t us, const envdata_t &envData, IPAddress *addr) const {
 
-  case Panes::IP_ADDR:
-    /* IPアドレス表示 */
-    this->clearAll();
+  if (isRequireFullRedraw())
+    return true;
 
-    if (addr && addr->isV4()) {
-      this->writeInteger<3, 7>((*addr)[0], 0, 0, 0, 11);  // 第1オクテット
-      this->turnDot(true, 12, 6);                         // 小数点
-      this->writeInteger<3, 7>((*addr)[1], 0, 14, 0, 11); // 第2オクテット
-      this->turnDot(true, 26, 6);                         // 小数点
-      this->writeInteger<3, 7>((*addr)[2], 0, 6, 8, 11);  // 第3オクテット
-      this->turnDot(true, 18, 14);                        // 小数点
-      this->writeInteger<3, 7>((*addr)[3], 0, 20, 8, 11); // 第4オクテット
-    } else {
-      // IPv6 は非対応...のはず
-      this->writeString<3, 7>(u"---.---.", 14, 0);
-      this->writeString<3, 7>(u"---.---", 20, 8);
-    }
-    break;
+  widget_input_t  in = {tm, us, envData, addr, _synced};
+  size_t          count;
+  const widget_t *widgets = getWidgets(count);
 
-  case Panes::PRES_TIME:
-    /* 気圧＋時刻 */
-    this->clearAll();
+  for (size_t i = 0; i < count; i++) {
+    if (widgets[i].key(in) != _drawn_keys[i])
+      return true;
+  }
+  return false;
+}
 
-    if (!envData.isValid()) {
-      this->writeString<3, 5>(u" ---.-", -1, 0);
-    } else {
-      this->writeReal<3, 5>(envData.pressure, 1, -1, 0, 21);
-    }
-    this->writeString<3, 5>(u"hPa", 21, 0);
+// 画面のキャッシュのキーには、ウィジェットごとの key() を全部入れる
+static_assert(sizeof(OFF_WIDGETS) / sizeof(widget_t) <= MyBuffer::TFrameCache::MAX_VALUES, "too many widgets to cache");
+static_assert(sizeof(TIME_WIDGETS) / sizeof(widget_t) <= MyBuffer::TFrameCache::MAX_VALUES, "too many widgets to cache");
 
-    timeRow2(tm);
-    break;
+bool MyBuffer::isCacheablePane() const {
+  // 画面オフは 2 枚、時刻のみは 1 分あたり 2 枚（コロンの点灯・消灯。同期していなくても同じ 2 枚）しかない
+  return _override_pane == OverridePanes::OFF || _pane == Panes::TIME;
+}
 
-  case Panes::TEMP_HUMI_TIME:
-    /* 温度＋湿度＋時刻 */
+void MyBuffer::render(const widget_t *widgets, size_t count, const uint64_t *keys, const widget_input_t &in) {
+
+  bool full = isRequireFullRedraw();
+  if (full) {
     this->clearAll();
+    _drawn_pane = _pane;
+    _drawn_off  = _override_pane == OverridePanes::OFF;
+  }
 
-    // 温度表示
-    if (!envData.isValid()) {
-      this->writeString<3, 5>(u"--.-", 0, 0);
-    } else if (envData.temperature < -40.0f) {
-      // 低すぎ
-      this->writeString<3, 5>(u"Lo", 3, 0);
-    } else if (envData.temperature > 85.0f) {
-      // 高すぎ
-      this->writeString<3, 5>(u"Hi", 3, 0);
-    } else {
-      this->writeReal<3, 5>(envData.temperature, 1, 0, 0, 13);
+  for (size_t i = 0; i < count; i++) {
+    const widget_t &widget = widgets[i];
+
+    if (!full) {
+      if (keys[i] == _drawn_keys[i])
+        continue;
+      this->clear(widget.x, widget.y, widget.width, widget.height);
     }
-    this->writeString<4, 5>(u"℃", 14, 0);
 
-    // 湿度表示
-    if (!envData.isValid())
-      this->writeString<3, 5>(u"--", 19, 0);
-    else if (envData.humidity <= 0.0f)
-      this->writeString<3, 5>(u"Lo", 19, 0);
-    else if (envData.humidity >= 100.0f)
-      this->writeString<3, 5>(u"RH", 19, 0);
-    else
-      this->writeReal<3, 5>(envData.humidity, 0, 19, 0, 7);
-    this->writeString<5, 5>(u"%", 27, 0);
-
-    timeRow2(tm);
-    break;
+    widget.draw(*this, in);
+    _drawn_keys[i] = keys[i];
+  }
+}
 
-  case Panes::TIME:
-    /* 時刻のみ、秒なし */
-    this->clearAll();
+void MyBuffer::update(const struct tm &tm, suseconds_t us, const envdata_t &envData, IPAddress *addr) {
 
-    if (tm.tm_hour >= 10)
-      this->writeInteger<6, 16>(tm.tm_hour / 10, 0, 0, 0, 6); // 時
-    this->writeInteger<7, 16>(tm.tm_hour % 10, 0, 7, 0, 7);   // 時
-    this->turnDot(us < HALF_OF_SEC_US, 15, 4);                // コロン
-    this->turnDot(us < HALF_OF_SEC_US, 15, 11);               // コロン
-    this->writeInteger<7, 16>(tm.tm_min, 2, 17, 0, 15);       // 分
-    break;
+  widget_input_t  in = {tm, us, envData, addr, _synced};
+  size_t          count;
+  const widget_t *widgets = getWidgets(count);
 
-  default: /* DATE_TIME */
-    /* 日付＋時刻 */
-    this->clearAll();
+  uint64_t keys[MAX_WIDGETS];
+  for (size_t i = 0; i < count; i++)
+    keys[i] = widgets[i].key(in);
 
-    this->writeInteger<4, 5>(tm.tm_mon + 1, 0, -2, 0, 9); // 月
-    this->writeString<5, 5>(u"/", 8, 0);                  //
-    this->writeInteger<4, 5>(tm.tm_mday, 0, 14, 0, 9);    // 日
-    this->writeChar<7, 7>(wd.at(tm.tm_wday), 25, 0);      // 曜日
+  if (!isCacheablePane()) {
+    render(widgets, count, keys, in);
+    return;
+  }
 
-    timeRow2(tm);
-    break;
+  TFrameCache::key_t frame_key = {};
+  frame_key.pane               = _override_pane == OverridePanes::OFF ? 0xFF : static_cast<uint8_t>(_pane);
+  frame_key.count              = count;
+  memcpy(frame_key.values, keys, count * sizeof(uint64_t));
+
+  const uint8_t *frame = _frame_cache.find(frame_key);
+  if (frame) {
+    // 描き直さずに、前に描いた画面をそのまま使う
+    this->loadFrame(frame);
+    _drawn_pane = _pane;
+    _drawn_off  = _override_pane == OverridePanes::OFF;
+    memcpy(_drawn_keys, keys, count * sizeof(uint64_t));
+    return;
   }
+
+  render(widgets, count, keys, in);
+
+  uint8_t *dest = _frame_cache.insert(frame_key);
+  if (dest)
+    this->saveFrame(dest);
 }
 
 void MyBuffer::setPane(const Panes pane) {
@@ -223,3 +419,15 @@ void MyBuffer::setOverridePane(const OverridePanes pane) {
 OverridePanes MyBuffer::getOverridePane() const {
   return _override_pane;
 }
+
+void MyBuffer::setSynced(bool synced) {
+  _synced = synced;
+}
+
+bool MyBuffer::isSynced() const {
+  return _synced;
+}
+
+const MyBuffer::TFrameCache &MyBuffer::getFrameCache() const {
+  return _frame_cache;
+}
@@ -7,6 +7,8 @@
 
 #include "myutil.h"
 #include "../envdata_t.h"
+#include "../setting.h"
+#include "FrameCache.h"
 #include "MyGraphics.h"
 #include "Panes.h"
 #include <IPAddress.h>
@@ -14,37 +16,87 @@
 #include <string>
 using std::u16string;
 
-class MyBuffer : public MAX7219::Buffer<32, 16, MyGraphics> {
+//! 送信時に並べ替えずに済むよう、Display と同じ並びで保持する
+using MyBufferStorage = MAX7219::DeviceNativeStorage<32, 16, DisplayLayout>;
+
+class MyBuffer : public MAX7219::Buffer<32, 16, MyGraphics, MyBufferStorage> {
+public:
+  /**
+   * @brief ウィジェットの描画内容を決める入力
+   */
+  struct widget_input_t {
+    const struct tm &tm;      //! 現在時刻
+    suseconds_t      us;      //! 現在時刻のマイクロ秒部分
+    const envdata_t &envData; //! 最新の環境計測結果
+    IPAddress       *addr;    //! 現在の IP アドレス
+    bool             synced;  //! 時刻が NTP で同期しているか（ setSynced() ）
+  };
+
+  /**
+   * @brief 画面の部品。 key() の値が変わった時だけ、自分の領域を消して draw() で描き直す
+   * 
+   * @note draw() は (x, y, width, height) の外に描いてはいけない。また、同じ画面のウィジェット同士の領域は重なってはいけない。
+   *       これが守られていれば、一部のウィジェットだけを描き直した結果は、画面全体を描き直した結果と一致する。
+   */
+  struct widget_t {
+    int8_t  x;      //! 領域の左上隅の x 座標
+    int8_t  y;      //! 領域の左上隅の y 座標
+    uint8_t width;  //! 領域の幅
+    uint8_t height; //! 領域の高さ
+
+    //! 描画内容を左右する入力をまとめた値（この値が同じなら、描画結果も同じ）
+    uint64_t (*key)(const widget_input_t &in);
+    //! 領域を描画する（領域はクリア済み）
+    void (*draw)(MyBuffer &buffer, const widget_input_t &in);
+  };
+
+  //! 1 つの画面を構成するウィジェットの最大数
+  static constexpr size_t MAX_WIDGETS = 8;
+
+  using TFrameCache = FrameCache<MyBufferStorage::FrameBytes, FRAME_CACHE_BUDGET>;
+
 private:
-  Panes         _pane;
-  Panes         _prev_pane;
-  OverridePanes _override_pane;
-  OverridePanes _prev_override_pane;
-  struct tm     _prev_tm;
-  suseconds_t   _prev_us;
-  envdata_t     _prev_envData;
-  IPAddress     _prev_addr = IPAddress();
+  Panes         _pane          = Panes::DATE_TIME;
+  OverridePanes _override_pane = OverridePanes::NORMAL;
+  bool          _synced        = false; //! 時刻が NTP で同期しているか
+
+  Panes    _drawn_pane = Panes::INVALID; //! 現在描画されている画面（Panes::INVALID なら、次回は全体を描き直す）
+  bool     _drawn_off  = false;          //! 現在描画されているのが、画面オフの表示か
+  uint64_t _drawn_keys[MAX_WIDGETS];    //! 現在描画されている各ウィジェットの widget_t::key()
+
+  TFrameCache _frame_cache; //! 画面の種類が少ない画面（isCacheablePane()）を使い回すためのキャッシュ
 
   /**
-   * @brief 「時刻＋他の情報」を表示するために、時刻を 2 行目に描画する
+   * @brief 現在の画面を構成するウィジェットを取得する
    * 
-   * @param tm 現在時刻
+   * @param[out] count ウィジェットの数
+   * @return ウィジェットの配列
    */
-  void timeRow2(const struct tm &tm);
+  const widget_t *getWidgets(size_t &count) const;
 
   /**
-   * @brief _prev_** で始まるメンバ変数を現在の値で上書きする
+   * @brief 次回の update() で、画面全体を描き直す必要があるか
+   */
+  bool isRequireFullRedraw() const;
+
+  /**
+   * @brief 現在の画面を _frame_cache に入れるか（見た目の種類が少なく、同じ画面が何度も現れるものだけを入れる）
+   */
+  bool isCacheablePane() const;
+
+  /**
+   * @brief ウィジェットを描画する
    * 
-   * @param tm 現在時刻
-   * @param us 現在時刻のマイクロ秒部分
-   * @param envData 最新の環境計測結果
-   * @param addr 現在の IP アドレス
+   * @param widgets 現在の画面を構成するウィジェット
+   * @param count ウィジェットの数
+   * @param keys 各ウィジェットの widget_t::key()
+   * @param in ウィジェットの描画内容を決める入力
    */
-  void assignPrevValues(const struct tm &tm, suseconds_t us, const envdata_t &envData, IPAddress *addr);
+  void render(const widget_t *widgets, size_t count, const uint64_t *keys, const widget_input_t &in);
 
 public:
   MyBuffer()
-      : MAX7219::Buffer<32, 16, MyGraphics>::Buffer() {}
+      : MAX7219::Buffer<32, 16, MyGraphics, MyBufferStorage>::Buffer() {}
   DISALLOW_COPY(MyBuffer);
   ALLOW_DEFAULT_MOVE(MyBuffer);
 
@@ -63,6 +115,8 @@ public:
   /**
    * @brief 画面を更新する
    * 
+   * 画面が切り替わった時は全体を描き直し、それ以外は入力が変わったウィジェットだけを描き直す。
+   * 
    * @param tm 現在時刻
    * @param us 現在時刻のマイクロ秒部分
    * @param envData 気温・湿度・気圧
@@ -76,6 +130,19 @@ public:
 
   void          setOverridePane(const OverridePanes pane);
   OverridePanes getOverridePane() const;
+
+  /**
+   * @brief 時刻が NTP で同期しているかを設定する
+   * 
+   * 同期していない（保存していた時刻などから数えた仮の時刻の）間は、時刻の画面のコロンを普段と違う間隔で点滅させる。
+   */
+  void setSynced(bool synced);
+  bool isSynced() const;
+
+  /**
+   * @brief 描画済みの画面のキャッシュを取得（ヒット・ミスの回数を見るため）
+   */
+  const TFrameCache &getFrameCache() const;
 };
 
 #endif // MYBUFFER_H_
\ No newline at end of file
@@ -1,899 +1,110 @@
 #include "MyGraphics.h"
 #include <pgmspace.h>
-#include <vector>
 
-#define ZERO_TO_NINE u'0', u'1', u'2', u'3', u'4', u'5', u'6', u'7', u'8', u'9'
+/**
+ * @brief 数字以外の文字と、その文字がグリフ配列の何番目にあるかの組
+ */
+struct glyph_entry_t {
+  char16_t c;
+  uint8_t  index;
+};
+
+/**
+ * @brief glyph_entry_t の配列が、文字コードの昇順に並んでいるか（二分探索の前提）
+ */
+static constexpr bool isSorted(const glyph_entry_t *entries, size_t count) {
+  return count < 2 || (entries[0].c < entries[1].c && isSorted(entries + 1, count - 1));
+}
+
+#define COUNT_OF(array) (sizeof(array) / sizeof((array)[0]))
 
-#define FUNCDEF_GETGLYPH(w, h)                                                   \
-  template <>                                                                    \
-  bool MyGraphics::tryGetGlyph<w, h>(char16_t c, uint8_t *retval) const {        \
-    return tryGetGlyphPtr<h>(glyph##w##x##h, glyph##w##x##h##_chars, c, retval); \
+/**
+ * @brief 数字と、それ以外の文字の両方を持つグリフ配列用の tryGetGlyph を定義する
+ * 
+ * @param digits グリフ配列の先頭に '0' から順に並んでいる数字の数
+ */
+#define FUNCDEF_GETGLYPH(w, h, digits)                                                               \
+  static_assert(isSorted(glyph##w##x##h##_others, COUNT_OF(glyph##w##x##h##_others)), "not sorted"); \
+  template <>                                                                                        \
+  bool MyGraphics::tryGetGlyph<w, h>(char16_t c, uint8_t *retval) const {                            \
+    return tryGetGlyphPtr<h>(glyph##w##x##h, digits, glyph##w##x##h##_others,                        \
+                             COUNT_OF(glyph##w##x##h##_others), c, retval);                          \
   }
 
 /**
- * @brief 文字グリフを取り出す関数
+ * @brief 数字だけを持つグリフ配列用の tryGetGlyph を定義する
  * 
- * @tparam GlyphSize 1文字あたりの要素数
- * @param array 取り出し対象の配列
- * @param glyphes 
- * @param c 取り出したい文字
- * @param[out] retval 受け渡し用配列の先頭アドレス
+ * @param digits グリフ配列の先頭に '0' から順に並んでいる数字の数
+ */
+#define FUNCDEF_GETGLYPH_DIGITS(w, h, digits)                                \
+  template <>                                                                \
+  bool MyGraphics::tryGetGlyph<w, h>(char16_t c, uint8_t *retval) const {    \
+    return tryGetGlyphPtr<h>(glyph##w##x##h, digits, nullptr, 0, c, retval); \
+  }
+
+/**
+ * @brief 数字以外の文字を探す
+ * 
+ * @param others 文字コードの昇順に並んだ表（PROGMEM）
+ * @param count @c others の要素数
+ * @param c 探す文字
+ * @param[out] index 見つかった文字の、グリフ配列での位置
  * @retval true 文字が見つかった
  * @retval false 文字が見つからない
  */
-template <size_t GlyphSize>
-static bool tryGetGlyphPtr(const uint8_t *array, const std::vector<char16_t> &glyphes, char16_t c, uint8_t *retval) {
+static bool findOther(const glyph_entry_t *others, size_t count, char16_t c, size_t &index) {
 
-  for (size_t i = 0; i < glyphes.size(); i++) {
-    if (glyphes.at(i) == c) {
-      if (retval)
-        memcpy_P(retval, array + (i * GlyphSize), GlyphSize);
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    size_t   mid = (lo + hi) / 2;
+    char16_t key = pgm_read_word(&others[mid].c);
+
+    if (key == c) {
+      index = pgm_read_byte(&others[mid].index);
       return true;
     }
+
+    if (key < c)
+      lo = mid + 1;
+    else
+      hi = mid;
   }
   return false;
 }
 
-/// 3x5 サイズの文字グリフ
-static const uint8_t glyph3x5[] PROGMEM = {
-    0b111, // 0
-    0b101,
-    0b101,
-    0b101,
-    0b111,
-
-    0b010, // 1
-    0b010,
-    0b010,
-    0b010,
-    0b010,
-
-    0b111, // 2
-    0b001,
-    0b111,
-    0b100,
-    0b111,
-
-    0b111, // 3
-    0b001,
-    0b111,
-    0b001,
-    0b111,
-
-    0b101, // 4
-    0b101,
-    0b111,
-    0b001,
-    0b001,
-
-    0b111, // 5
-    0b100,
-    0b111,
-    0b001,
-    0b111,
-
-    0b100, // 6
-    0b100,
-    0b111,
-    0b101,
-    0b111,
-
-    0b111, // 7
-    0b001,
-    0b001,
-    0b001,
-    0b001,
-
-    0b111, // 8
-    0b101,
-    0b111,
-    0b101,
-    0b111,
-
-    0b111, // 9
-    0b101,
-    0b111,
-    0b001,
-    0b001,
-
-    0b000, // - (minus)
-    0b000,
-    0b111,
-    0b000,
-    0b000,
-
-    0b100, // h
-    0b100,
-    0b111,
-    0b101,
-    0b101,
-
-    0b111, // P
-    0b101,
-    0b111,
-    0b100,
-    0b100,
-
-    0b111, // a
-    0b001,
-    0b011,
-    0b101,
-    0b011,
-
-    0b111, // R
-    0b101,
-    0b111,
-    0b110,
-    0b001,
-
-    0b101, // H
-    0b101,
-    0b111,
-    0b101,
-    0b101,
-
-    0b010, // i
-    0b000,
-    0b010,
-    0b010,
-    0b010,
-
-    0b100, // L
-    0b100,
-    0b100,
-    0b100,
-    0b111,
-
-    0b000, // o
-    0b000,
-    0b111,
-    0b101,
-    0b111,
-};
-
-static const std::vector<char16_t> glyph3x5_chars = {ZERO_TO_NINE, u'-', u'h', u'P', u'a', u'R', u'H', u'i', u'L', u'o'};
-
-FUNCDEF_GETGLYPH(3, 5);
-
-/// 4x5 サイズの文字グリフ
-static const uint8_t glyph4x5[] PROGMEM = {
-    0b1111, // 0
-    0b1001,
-    0b1001,
-    0b1001,
-    0b1111,
-
-    0b0010, // 1
-    0b0010,
-    0b0010,
-    0b0010,
-    0b0010,
-
-    0b1111, // 2
-    0b0001,
-    0b1111,
-    0b1000,
-    0b1111,
-
-    0b1111, // 3
-    0b0001,
-    0b1111,
-    0b0001,
-    0b1111,
-
-    0b1010, // 4
-    0b1010,
-    0b1111,
-    0b0010,
-    0b0010,
-
-    0b1111, // 5
-    0b1000,
-    0b1111,
-    0b0001,
-    0b1111,
-
-    0b1111, // 6
-    0b1000,
-    0b1111,
-    0b1001,
-    0b1111,
-
-    0b1111, // 7
-    0b0001,
-    0b0001,
-    0b0001,
-    0b0001,
-
-    0b1111, // 8
-    0b1001,
-    0b1111,
-    0b1001,
-    0b1111,
-
-    0b1111, // 9
-    0b1001,
-    0b1111,
-    0b0001,
-    0b1111,
-
-    0b0000, // ℃
-    0b1000,
-    0b0111,
-    0b0100,
-    0b0111,
-
-};
-
-static const std::vector<char16_t> glyph4x5_chars = {ZERO_TO_NINE, u'℃'};
-
-FUNCDEF_GETGLYPH(4, 5);
-
-/// 5x5 サイズの文字グリフ
-static const uint8_t glyph5x5[] PROGMEM = {
-    0b00001, // / (Slash)
-    0b00010,
-    0b00100,
-    0b01000,
-    0b10000,
-
-    0b11001, // %
-    0b11010,
-    0b00100,
-    0b01011,
-    0b10011,
-};
-
-static const std::vector<char16_t> glyph5x5_chars = {u'/', u'%'};
-
-FUNCDEF_GETGLYPH(5, 5);
-
-/// 3x7 サイズの文字グリフ
-static const uint8_t glyph3x7[] PROGMEM = {
-    0b111, // 0
-    0b101,
-    0b101,
-    0b101,
-    0b101,
-    0b101,
-    0b111,
-
-    0b010, // 1
-    0b010,
-    0b010,
-    0b010,
-    0b010,
-    0b010,
-    0b010,
-
-    0b111, // 2
-    0b001,
-    0b001,
-    0b111,
-    0b100,
-    0b100,
-    0b111,
-
-    0b111, // 3
-    0b001,
-    0b001,
-    0b111,
-    0b001,
-    0b001,
-    0b111,
-
-    0b101, // 4
-    0b101,
-    0b101,
-    0b101,
-    0b111,
-    0b001,
-    0b001,
-
-    0b111, // 5
-    0b100,
-    0b100,
-    0b111,
-    0b001,
-    0b001,
-    0b111,
-
-    0b100, // 6
-    0b100,
-    0b100,
-    0b111,
-    0b101,
-    0b101,
-    0b111,
-
-    0b111, // 7
-    0b001,
-    0b001,
-    0b001,
-    0b001,
-    0b001,
-    0b001,
-
-    0b111, // 8
-    0b101,
-    0b101,
-    0b111,
-    0b101,
-    0b101,
-    0b111,
-
-    0b111, // 9
-    0b101,
-    0b101,
-    0b111,
-    0b001,
-    0b001,
-    0b001,
-
-    0b000, // -
-    0b000,
-    0b000,
-    0b111,
-    0b000,
-    0b000,
-    0b000,
-};
-
-static const std::vector<char16_t> glyph3x7_chars = {ZERO_TO_NINE, u'-'};
-
-FUNCDEF_GETGLYPH(3, 7);
-
-/// 7x7 サイズの文字グリフ
-static const uint8_t glyph7x7[] PROGMEM = {
-    0b1111111, // 日
-    0b1000001,
-    0b1000001,
-    0b1111111,
-    0b1000001,
-    0b1000001,
-    0b1111111,
-
-    0b0111111, // 月
-    0b0100001,
-    0b0111111,
-    0b0100001,
-    0b0111111,
-    0b0100001,
-    0b1000011,
-
-    0b0001000, // 火
-    0b1001001,
-    0b0101010,
-    0b0001000,
-    0b0010100,
-    0b0100010,
-    0b1000001,
-
-    0b0001000, // 水
-    0b0001001,
-    0b1101010,
-    0b0101100,
-    0b0101010,
-    0b1001001,
-    0b0001000,
-
-    0b0001000, // 木
-    0b1111111,
-    0b0001000,
-    0b0011100,
-    0b0101010,
-    0b1001001,
-    0b0001000,
-
-    0b0011100, // 金
-    0b0100010,
-    0b1011101,
-    0b0001000,
-    0b1011101,
-    0b0101010,
-    0b1111111,
-
-    0b0001000, // 土
-    0b0001000,
-    0b0111110,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b1111111,
-};
-
-static const std::vector<char16_t> glyph7x7_chars = {u'日', u'月', u'火', u'水', u'木', u'金', u'土'};
-
-FUNCDEF_GETGLYPH(7, 7);
-
-/// 5x8 サイズの文字グリフ
-static const uint8_t glyph5x8[] PROGMEM = {
-    0b11111, // 0
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b11111,
-
-    0b00100, // 1
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-
-    0b11111, // 2
-    0b00001,
-    0b00001,
-    0b00001,
-    0b11111,
-    0b10000,
-    0b10000,
-    0b11111,
-
-    0b11111, // 3
-    0b00001,
-    0b00000,
-    0b01111,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b11111,
-
-    0b00010, // 4
-    0b10010,
-    0b10010,
-    0b10010,
-    0b10010,
-    0b11111,
-    0b00010,
-    0b00010,
-
-    0b11111, // 5
-    0b10000,
-    0b10000,
-    0b11111,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b11111,
-
-    0b11111, // 6
-    0b10000,
-    0b10000,
-    0b11111,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b11111,
-
-    0b11111, // 7
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-
-    0b11111, // 8
-    0b10001,
-    0b10001,
-    0b11111,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-
-    0b11111, // 9
-    0b10001,
-    0b10001,
-    0b10001,
-    0b11111,
-    0b00001,
-    0b00001,
-    0b11111,
-};
-
-static const std::vector<char16_t> glyph5x8_chars = {ZERO_TO_NINE};
-
-FUNCDEF_GETGLYPH(5, 8);
-
-/// 4x10 サイズの文字グリフ
-static const uint8_t glyph4x10[] PROGMEM = {
-    0b1111, // 0
-    0b1001,
-    0b1001,
-    0b1001,
-    0b1001,
-    0b1001,
-    0b1001,
-    0b1001,
-    0b1001,
-    0b1111,
-
-    0b0100, // 1
-    0b0100,
-    0b0100,
-    0b0100,
-    0b0100,
-    0b0100,
-    0b0100,
-    0b0100,
-    0b0100,
-    0b0100,
-
-    0b1111, // 2
-    0b0001,
-    0b0001,
-    0b0001,
-    0b0001,
-    0b0111,
-    0b1000,
-    0b1000,
-    0b1000,
-    0b1111,
-};
-
-static const std::vector<char16_t> glyph4x10_chars = {u'0', u'1', u'2'};
-
-FUNCDEF_GETGLYPH(4, 10);
-
-/// 5x10 サイズの文字グリフ
-static const uint8_t glyph5x10[] PROGMEM = {
-    0b11111, // 0
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b11111,
-
-    0b00100, // 1
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-    0b00100,
-
-    0b11111, // 2
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b01111,
-    0b10000,
-    0b10000,
-    0b10000,
-    0b11111,
-
-    0b11111, // 3
-    0b00001,
-    0b00001,
-    0b00001,
-    0b01111,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b11111,
-
-    0b00010, // 4
-    0b10010,
-    0b10010,
-    0b10010,
-    0b10010,
-    0b10010,
-    0b11111,
-    0b00010,
-    0b00010,
-    0b00010,
-
-    0b11111, // 5
-    0b10000,
-    0b10000,
-    0b10000,
-    0b11110,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b11111,
-
-    0b11111, // 6
-    0b10000,
-    0b10000,
-    0b10000,
-    0b10000,
-    0b11111,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b11111,
-
-    0b11111, // 7
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-
-    0b11111, // 8
-    0b10001,
-    0b10001,
-    0b10001,
-    0b11111,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b10001,
-    0b11111,
-
-    0b11111, // 9
-    0b10001,
-    0b10001,
-    0b10001,
-    0b11111,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b00001,
-    0b11111,
-};
-
-static const std::vector<char16_t> glyph5x10_chars = {ZERO_TO_NINE};
-
-FUNCDEF_GETGLYPH(5, 10);
-
-/// 6x16 サイズの文字グリフ
-static const uint8_t glyph6x16[] PROGMEM = {
-    0b111111, // 0
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b100001,
-    0b111111,
-
-    0b001000, // 1
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-    0b001000,
-
-    0b111111, // 2
-    0b000001,
-    0b000001,
-    0b000001,
-    0b000001,
-    0b000001,
-    0b000001,
-    0b000001,
-    0b011111,
-    0b100000,
-    0b100000,
-    0b100000,
-    0b100000,
-    0b100000,
-    0b100000,
-    0b111111,
-};
-
-static const std::vector<char16_t> glyph6x16_chars = {u'0', u'1', u'2'};
-
-FUNCDEF_GETGLYPH(6, 16);
-
-/// 7x16 サイズの文字グリフ
-static const uint8_t glyph7x16[] PROGMEM = {
-    0b1111111, // 0
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1111111,
-
-    0b0001000, // 1
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-    0b0001000,
-
-    0b1111111, // 2
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0111111,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1111111,
-
-    0b1111111, // 3
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0111111,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b1111111,
-
-    0b0000010, // 4
-    0b1000010,
-    0b1000010,
-    0b1000010,
-    0b1000010,
-    0b1000010,
-    0b1000010,
-    0b1000010,
-    0b1000010,
-    0b1000010,
-    0b1111111,
-    0b0000010,
-    0b0000010,
-    0b0000010,
-    0b0000010,
-    0b0000010,
-
-    0b1111111, // 5
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1111110,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b1111111,
-
-    0b1111111, // 6
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1000000,
-    0b1111111,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1111111,
-
-    0b1111111, // 7
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-
-    0b1111111, // 8
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1111111,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1111111,
+/**
+ * @brief 文字グリフを取り出す関数
+ * 
+ * 数字はグリフ配列の位置を直接計算し、それ以外の文字は @c others を二分探索するので、
+ * 文字の数によらずほぼ一定の時間で見つかる。
+ * 
+ * @tparam GlyphSize 1文字あたりの要素数
+ * @param array 取り出し対象の配列
+ * @param digits @c array の先頭に '0' から順に並んでいる数字の数
+ * @param others 数字以外の文字の表（文字コードの昇順、PROGMEM）
+ * @param others_count @c others の要素数
+ * @param c 取り出したい文字
+ * @param[out] retval 受け渡し用配列の先頭アドレス
+ * @retval true 文字が見つかった
+ * @retval false 文字が見つからない
+ */
+template <size_t GlyphSize>
+static bool tryGetGlyphPtr(const uint8_t *array, uint8_t digits, const glyph_entry_t *others, size_t others_count, char16_t c, uint8_t *retval) {
 
-    0b1111111, // 9
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1000001,
-    0b1111111,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b0000001,
-    0b1111111,
-};
+  size_t index;
+  if (c >= u'0' && static_cast<size_t>(c - u'0') < digits)
+    index = c - u'0';
+  else if (!findOther(others, others_count, c, index))
+    return false;
 
-static const std::vector<char16_t> glyph7x16_chars = {ZERO_TO_NINE};
+  if (retval)
+    memcpy_P(retval, array + (index * GlyphSize), GlyphSize);
+  return true;
+}
 
-FUNCDEF_GETGLYPH(7, 16);
+// 文字グリフ本体と tryGetGlyph の特殊化（fonts/ から tools/font_compiler.py で生成）
+#include "glyph-data.h"
 
 namespace ConstGraphics {
 
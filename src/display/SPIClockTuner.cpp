@@ -0,0 +1,39 @@
+#include "SPIClockTuner.h"
+
+constexpr std::array<uint32_t, 9> SPIClockTuner::CANDIDATES;
+
+bool SPIClockTuner::isReliable(uint32_t frequency) const {
+
+  for (uint8_t i = 0; i < _trials; i++) {
+    if (!_probe(frequency))
+      return false;
+  }
+  return true;
+}
+
+uint32_t SPIClockTuner::tune() {
+
+  // 一度でも失敗したら、それより上の周波数は試さない
+  _max_reliable = 0;
+  for (auto &&f : CANDIDATES) {
+    if (!isReliable(f))
+      break;
+    _max_reliable = f;
+  }
+
+  if (_max_reliable == 0)
+    return 0;
+
+  // マージンを取った周波数以下で、最も高い候補を選ぶ（ただし最低の候補は下回らない）
+  uint32_t limit  = _max_reliable / MARGIN_DIVISOR;
+  uint32_t retval = CANDIDATES.front();
+  for (auto &&f : CANDIDATES) {
+    if (f <= limit)
+      retval = f;
+  }
+  return retval;
+}
+
+uint32_t SPIClockTuner::getMaxReliable() const {
+  return _max_reliable;
+}
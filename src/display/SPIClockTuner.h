@@ -0,0 +1,69 @@
+/**
+ * @file SPIClockTuner.h
+ */
+
+#ifndef SPIClockTuner_H_
+#define SPIClockTuner_H_
+
+#include <Arduino.h>
+#include <array>
+#include <functional>
+
+/**
+ * @brief MAX7219 のデイジーチェーンと確実に通信できる SPI クロック周波数を探すクラス
+ * 
+ * 周波数を低い方から順に試し、最初に失敗した周波数の 1 つ手前を「通信できる最高の周波数」とする。
+ * 実際に使う周波数は、そこから安全マージンを取って決める。
+ * 
+ * 通信できたかどうかの判定は、コンストラクタに渡す関数（プローブ）に任せるので、
+ * このクラス自体はハードウェアに依存しない。
+ */
+class SPIClockTuner {
+public:
+  //! プローブ。引数の周波数で通信を試し、成功したら true を返す
+  using TProbe = std::function<bool(uint32_t frequency)>;
+
+  //! 試す周波数（昇順）。ESP8266 の SPI クロックは 80 MHz の分周で作られるので、割り切れる値にしている
+  static constexpr std::array<uint32_t, 9> CANDIDATES = {
+      100000, 250000, 500000, 1000000, 2000000, 4000000, 5000000, 8000000, 10000000};
+
+  //! 通信できた最高の周波数を、この値で割った周波数以下で使う
+  static constexpr uint32_t MARGIN_DIVISOR = 2;
+
+private:
+  TProbe   _probe;
+  uint8_t  _trials;
+  uint32_t _max_reliable = 0;
+
+  /**
+   * @brief 周波数 @c frequency で、プローブが _trials 回続けて成功するか
+   */
+  bool isReliable(uint32_t frequency) const;
+
+public:
+  /**
+   * @brief Construct a new SPIClockTuner object
+   * 
+   * @param probe プローブ
+   * @param trials 1 つの周波数につき何回試すか（全部成功したら合格）
+   */
+  SPIClockTuner(const TProbe &probe, uint8_t trials = 16)
+      : _probe(probe)
+      , _trials(trials) {}
+
+  /**
+   * @brief 周波数を調整する
+   * 
+   * @return 使うべき周波数。最も低い周波数でも通信できなかったときは 0
+   */
+  uint32_t tune();
+
+  /**
+   * @brief 直前の tune() で、通信できた最高の周波数を取得（マージンを取る前の値）
+   * 
+   * @return 周波数。最も低い周波数でも通信できなかったときは 0
+   */
+  uint32_t getMaxReliable() const;
+};
+
+#endif // SPIClockTuner_H_
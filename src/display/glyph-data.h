@@ -0,0 +1,889 @@
+// auto-generated by script tools/font_compiler.py
+// DO NOT EDIT BY HAND
+
+// MyGraphics.cpp から 1 回だけ include される
+
+#ifndef ESP8266Clock_glyph_data_H_
+#define ESP8266Clock_glyph_data_H_
+
+/// 3x5 サイズの文字グリフ（fonts/glyph3x5.bdf）
+static const uint8_t glyph3x5[] PROGMEM = {
+    0b111, // 0
+    0b101,
+    0b101,
+    0b101,
+    0b111,
+
+    0b010, // 1
+    0b010,
+    0b010,
+    0b010,
+    0b010,
+
+    0b111, // 2
+    0b001,
+    0b111,
+    0b100,
+    0b111,
+
+    0b111, // 3
+    0b001,
+    0b111,
+    0b001,
+    0b111,
+
+    0b101, // 4
+    0b101,
+    0b111,
+    0b001,
+    0b001,
+
+    0b111, // 5
+    0b100,
+    0b111,
+    0b001,
+    0b111,
+
+    0b100, // 6
+    0b100,
+    0b111,
+    0b101,
+    0b111,
+
+    0b111, // 7
+    0b001,
+    0b001,
+    0b001,
+    0b001,
+
+    0b111, // 8
+    0b101,
+    0b111,
+    0b101,
+    0b111,
+
+    0b111, // 9
+    0b101,
+    0b111,
+    0b001,
+    0b001,
+
+    0b000, // -
+    0b000,
+    0b111,
+    0b000,
+    0b000,
+
+    0b101, // H
+    0b101,
+    0b111,
+    0b101,
+    0b101,
+
+    0b100, // L
+    0b100,
+    0b100,
+    0b100,
+    0b111,
+
+    0b111, // P
+    0b101,
+    0b111,
+    0b100,
+    0b100,
+
+    0b111, // R
+    0b101,
+    0b111,
+    0b110,
+    0b001,
+
+    0b111, // a
+    0b001,
+    0b011,
+    0b101,
+    0b011,
+
+    0b100, // h
+    0b100,
+    0b111,
+    0b101,
+    0b101,
+
+    0b010, // i
+    0b000,
+    0b010,
+    0b010,
+    0b010,
+
+    0b000, // o
+    0b000,
+    0b111,
+    0b101,
+    0b111,
+};
+
+/// glyph3x5 のうち、数字以外の文字
+static constexpr glyph_entry_t glyph3x5_others[] PROGMEM = {
+    {u'-', 10},
+    {u'H', 11},
+    {u'L', 12},
+    {u'P', 13},
+    {u'R', 14},
+    {u'a', 15},
+    {u'h', 16},
+    {u'i', 17},
+    {u'o', 18},
+};
+
+FUNCDEF_GETGLYPH(3, 5, 10);
+
+/// 4x5 サイズの文字グリフ（fonts/glyph4x5.bdf）
+static const uint8_t glyph4x5[] PROGMEM = {
+    0b1111, // 0
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1111,
+
+    0b0010, // 1
+    0b0010,
+    0b0010,
+    0b0010,
+    0b0010,
+
+    0b1111, // 2
+    0b0001,
+    0b1111,
+    0b1000,
+    0b1111,
+
+    0b1111, // 3
+    0b0001,
+    0b1111,
+    0b0001,
+    0b1111,
+
+    0b1010, // 4
+    0b1010,
+    0b1111,
+    0b0010,
+    0b0010,
+
+    0b1111, // 5
+    0b1000,
+    0b1111,
+    0b0001,
+    0b1111,
+
+    0b1111, // 6
+    0b1000,
+    0b1111,
+    0b1001,
+    0b1111,
+
+    0b1111, // 7
+    0b0001,
+    0b0001,
+    0b0001,
+    0b0001,
+
+    0b1111, // 8
+    0b1001,
+    0b1111,
+    0b1001,
+    0b1111,
+
+    0b1111, // 9
+    0b1001,
+    0b1111,
+    0b0001,
+    0b1111,
+
+    0b0000, // ℃
+    0b1000,
+    0b0111,
+    0b0100,
+    0b0111,
+};
+
+/// glyph4x5 のうち、数字以外の文字
+static constexpr glyph_entry_t glyph4x5_others[] PROGMEM = {
+    {u'℃', 10},
+};
+
+FUNCDEF_GETGLYPH(4, 5, 10);
+
+/// 5x5 サイズの文字グリフ（fonts/glyph5x5.bdf）
+static const uint8_t glyph5x5[] PROGMEM = {
+    0b11001, // %
+    0b11010,
+    0b00100,
+    0b01011,
+    0b10011,
+
+    0b00001, // /
+    0b00010,
+    0b00100,
+    0b01000,
+    0b10000,
+};
+
+/// glyph5x5 のうち、数字以外の文字
+static constexpr glyph_entry_t glyph5x5_others[] PROGMEM = {
+    {u'%', 0},
+    {u'/', 1},
+};
+
+FUNCDEF_GETGLYPH(5, 5, 0);
+
+/// 3x7 サイズの文字グリフ（fonts/glyph3x7.bdf）
+static const uint8_t glyph3x7[] PROGMEM = {
+    0b111, // 0
+    0b101,
+    0b101,
+    0b101,
+    0b101,
+    0b101,
+    0b111,
+
+    0b010, // 1
+    0b010,
+    0b010,
+    0b010,
+    0b010,
+    0b010,
+    0b010,
+
+    0b111, // 2
+    0b001,
+    0b001,
+    0b111,
+    0b100,
+    0b100,
+    0b111,
+
+    0b111, // 3
+    0b001,
+    0b001,
+    0b111,
+    0b001,
+    0b001,
+    0b111,
+
+    0b101, // 4
+    0b101,
+    0b101,
+    0b101,
+    0b111,
+    0b001,
+    0b001,
+
+    0b111, // 5
+    0b100,
+    0b100,
+    0b111,
+    0b001,
+    0b001,
+    0b111,
+
+    0b100, // 6
+    0b100,
+    0b100,
+    0b111,
+    0b101,
+    0b101,
+    0b111,
+
+    0b111, // 7
+    0b001,
+    0b001,
+    0b001,
+    0b001,
+    0b001,
+    0b001,
+
+    0b111, // 8
+    0b101,
+    0b101,
+    0b111,
+    0b101,
+    0b101,
+    0b111,
+
+    0b111, // 9
+    0b101,
+    0b101,
+    0b111,
+    0b001,
+    0b001,
+    0b001,
+
+    0b000, // -
+    0b000,
+    0b000,
+    0b111,
+    0b000,
+    0b000,
+    0b000,
+};
+
+/// glyph3x7 のうち、数字以外の文字
+static constexpr glyph_entry_t glyph3x7_others[] PROGMEM = {
+    {u'-', 10},
+};
+
+FUNCDEF_GETGLYPH(3, 7, 10);
+
+/// 7x7 サイズの文字グリフ（fonts/glyph7x7.bdf）
+static const uint8_t glyph7x7[] PROGMEM = {
+    0b0001000, // 土
+    0b0001000,
+    0b0111110,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b1111111,
+
+    0b1111111, // 日
+    0b1000001,
+    0b1000001,
+    0b1111111,
+    0b1000001,
+    0b1000001,
+    0b1111111,
+
+    0b0111111, // 月
+    0b0100001,
+    0b0111111,
+    0b0100001,
+    0b0111111,
+    0b0100001,
+    0b1000011,
+
+    0b0001000, // 木
+    0b1111111,
+    0b0001000,
+    0b0011100,
+    0b0101010,
+    0b1001001,
+    0b0001000,
+
+    0b0001000, // 水
+    0b0001001,
+    0b1101010,
+    0b0101100,
+    0b0101010,
+    0b1001001,
+    0b0001000,
+
+    0b0001000, // 火
+    0b1001001,
+    0b0101010,
+    0b0001000,
+    0b0010100,
+    0b0100010,
+    0b1000001,
+
+    0b0011100, // 金
+    0b0100010,
+    0b1011101,
+    0b0001000,
+    0b1011101,
+    0b0101010,
+    0b1111111,
+};
+
+/// glyph7x7 のうち、数字以外の文字
+static constexpr glyph_entry_t glyph7x7_others[] PROGMEM = {
+    {u'土', 0},
+    {u'日', 1},
+    {u'月', 2},
+    {u'木', 3},
+    {u'水', 4},
+    {u'火', 5},
+    {u'金', 6},
+};
+
+FUNCDEF_GETGLYPH(7, 7, 0);
+
+/// 5x8 サイズの文字グリフ（fonts/glyph5x8.bdf）
+static const uint8_t glyph5x8[] PROGMEM = {
+    0b11111, // 0
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b11111,
+
+    0b00100, // 1
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+
+    0b11111, // 2
+    0b00001,
+    0b00001,
+    0b00001,
+    0b11111,
+    0b10000,
+    0b10000,
+    0b11111,
+
+    0b11111, // 3
+    0b00001,
+    0b00000,
+    0b01111,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b11111,
+
+    0b00010, // 4
+    0b10010,
+    0b10010,
+    0b10010,
+    0b10010,
+    0b11111,
+    0b00010,
+    0b00010,
+
+    0b11111, // 5
+    0b10000,
+    0b10000,
+    0b11111,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b11111,
+
+    0b11111, // 6
+    0b10000,
+    0b10000,
+    0b11111,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b11111,
+
+    0b11111, // 7
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+
+    0b11111, // 8
+    0b10001,
+    0b10001,
+    0b11111,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+
+    0b11111, // 9
+    0b10001,
+    0b10001,
+    0b10001,
+    0b11111,
+    0b00001,
+    0b00001,
+    0b11111,
+};
+
+FUNCDEF_GETGLYPH_DIGITS(5, 8, 10);
+
+/// 4x10 サイズの文字グリフ（fonts/glyph4x10.bdf）
+static const uint8_t glyph4x10[] PROGMEM = {
+    0b1111, // 0
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1111,
+
+    0b0100, // 1
+    0b0100,
+    0b0100,
+    0b0100,
+    0b0100,
+    0b0100,
+    0b0100,
+    0b0100,
+    0b0100,
+    0b0100,
+
+    0b1111, // 2
+    0b0001,
+    0b0001,
+    0b0001,
+    0b0001,
+    0b0111,
+    0b1000,
+    0b1000,
+    0b1000,
+    0b1111,
+};
+
+FUNCDEF_GETGLYPH_DIGITS(4, 10, 3);
+
+/// 5x10 サイズの文字グリフ（fonts/glyph5x10.bdf）
+static const uint8_t glyph5x10[] PROGMEM = {
+    0b11111, // 0
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b11111,
+
+    0b00100, // 1
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+
+    0b11111, // 2
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b01111,
+    0b10000,
+    0b10000,
+    0b10000,
+    0b11111,
+
+    0b11111, // 3
+    0b00001,
+    0b00001,
+    0b00001,
+    0b01111,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b11111,
+
+    0b00010, // 4
+    0b10010,
+    0b10010,
+    0b10010,
+    0b10010,
+    0b10010,
+    0b11111,
+    0b00010,
+    0b00010,
+    0b00010,
+
+    0b11111, // 5
+    0b10000,
+    0b10000,
+    0b10000,
+    0b11110,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b11111,
+
+    0b11111, // 6
+    0b10000,
+    0b10000,
+    0b10000,
+    0b10000,
+    0b11111,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b11111,
+
+    0b11111, // 7
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+
+    0b11111, // 8
+    0b10001,
+    0b10001,
+    0b10001,
+    0b11111,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b11111,
+
+    0b11111, // 9
+    0b10001,
+    0b10001,
+    0b10001,
+    0b11111,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b00001,
+    0b11111,
+};
+
+FUNCDEF_GETGLYPH_DIGITS(5, 10, 10);
+
+/// 6x16 サイズの文字グリフ（fonts/glyph6x16.bdf）
+static const uint8_t glyph6x16[] PROGMEM = {
+    0b111111, // 0
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b100001,
+    0b111111,
+
+    0b001000, // 1
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+    0b001000,
+
+    0b111111, // 2
+    0b000001,
+    0b000001,
+    0b000001,
+    0b000001,
+    0b000001,
+    0b000001,
+    0b000001,
+    0b011111,
+    0b100000,
+    0b100000,
+    0b100000,
+    0b100000,
+    0b100000,
+    0b100000,
+    0b111111,
+};
+
+FUNCDEF_GETGLYPH_DIGITS(6, 16, 3);
+
+/// 7x16 サイズの文字グリフ（fonts/glyph7x16.bdf）
+static const uint8_t glyph7x16[] PROGMEM = {
+    0b1111111, // 0
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1111111,
+
+    0b0001000, // 1
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+    0b0001000,
+
+    0b1111111, // 2
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0111111,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1111111,
+
+    0b1111111, // 3
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0111111,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b1111111,
+
+    0b0000010, // 4
+    0b1000010,
+    0b1000010,
+    0b1000010,
+    0b1000010,
+    0b1000010,
+    0b1000010,
+    0b1000010,
+    0b1000010,
+    0b1000010,
+    0b1111111,
+    0b0000010,
+    0b0000010,
+    0b0000010,
+    0b0000010,
+    0b0000010,
+
+    0b1111111, // 5
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1111110,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b1111111,
+
+    0b1111111, // 6
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1000000,
+    0b1111111,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1111111,
+
+    0b1111111, // 7
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+
+    0b1111111, // 8
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1111111,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1111111,
+
+    0b1111111, // 9
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1000001,
+    0b1111111,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b0000001,
+    0b1111111,
+};
+
+FUNCDEF_GETGLYPH_DIGITS(7, 16, 10);
+
+#endif // ESP8266Clock_glyph_data_H_
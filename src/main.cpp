@@ -3,15 +3,17 @@
  */
 
 #include "main.h"
-#include "TZDB.h"
+#include "Scheduler.h"
 #include "envdata_t.h"
 #include <ArduinoJson.h>
-#include <TZ.h>
-#include <Wire.h>
 #include <map>
 #include <time.h>
+#include <utility>
 
 ClockSetting _setting;
+LoopProfiler _profiler(LOOP_PHASE_BUDGETS_US);
+TZTable      _tz;
+LocalClock   _clock([](suseconds_t *usec) { return _tz.localtime(getCurrentTime(usec)); }, getClockCounter);
 
 #ifdef ENABLE_BINARY_SIGNING
 static BearSSL::PublicKey       _signingPubKey(Resource::_public_key);
@@ -19,44 +21,6 @@ static BearSSL::HashSHA256      _signingHash;
 static BearSSL::SigningVerifier _signingVerifier(&_signingPubKey);
 #endif
 
-/**
- * @brief 時刻同期を実行する
- * 
- * @pre WiFi の接続が完了していること。
- */
-void syncTime() {
-  // タイムゾーン設定を読み取り
-  PGM_P tz = TZDB::getTZ(_setting.tzarea, _setting.tzcity);
-  if (!tz)
-    tz = TZ_Etc_GMT;
-
-  // NTPサーバー設定を読み取り
-  std::array<const char *, 3> ntp = {nullptr, nullptr, nullptr};
-
-  size_t i = 0;
-  for (auto &&n : _setting.ntp) {
-    if (i >= ntp.size())
-      break;
-
-    if (!n || n.isEmpty())
-      continue;
-
-    ntp.at(i) = n.c_str();
-    ++i;
-  }
-
-  // 有効なNTPサーバーが指定されなければデフォルト値を使用
-  if (i == 0)
-    ntp.at(0) = DEFAULT_NTP_SERVER;
-
-  // 同期開始
-  pftime::configTime(tz, ntp.at(0), ntp.at(1), ntp.at(2));
-
-  // 同期が完了するまで待つ
-  while (pftime::time(nullptr) < 10000)
-    yield();
-}
-
 /**
  * @brief 1秒に1回実行する処理を記述する
  * 
@@ -72,7 +36,8 @@ void runEverySeconds(const struct tm &tm) {
  * @param tm 現在時刻
  */
 void runEveryMinutes(const struct tm &tm) {
-  // 特にない
+  // 再起動されないまま残っている状態（中断した OTA など）を捨てる
+  expireWarmState();
 }
 
 /**
@@ -81,9 +46,13 @@ void runEveryMinutes(const struct tm &tm) {
  * @param tm 現在時刻
  */
 void runEveryHours(const struct tm &tm) {
-  // 特にない
+  // 電源が切れた後の仮の時刻にするため（ LittleFS に書くので 1 日 1 回だけ）
+  if (tm.tm_hour == TIME_SAVE_HOUR)
+    saveCurrentTime();
 }
 
+static void setupTasks();
+
 /**
  * @brief リセット後1度だけ実行される関数
  */
@@ -100,79 +69,91 @@ void setup() {
   Update.installSignature(&_signingHash, &_signingVerifier);
 #endif
 
-  // SPI、ディスプレイ初期化
-  displayAndBufferInit();
-  startWelcomeDisplay();
-
-  // 温度センサー初期化
-  Wire.begin(I2C_SDA, I2C_SCK);
-  bmeInit();
-
-  connectWiFi();
-  // WiFiManager による Wi-Fi 接続が成功すると、
-  // WiFiManager が内部で持っている ESP8266WebServer は stop されるので
-  // 別の Server を立ち上げても問題なくなる
-
-  // FS が壊れていても、デフォルト値を使えば時計としての機能は損なわれない
-  assert_debug(_fs.begin());
-  //_datas.init();
-  readSetting();
-  setupServer();
-  syncTime();
-
-  auto tm = *pftime::localtime(nullptr, nullptr);
-
-  runEverySeconds(tm);
-  runEveryMinutes(tm);
-  runEveryHours(tm);
-
-  // 気温計測開始コマンド送信
-  startMeasureEnvironment(tm);
-  // 計測完了を待つ <= 9.3 ms
-  delay(10);
-  // 計測結果読み取り
-  readEnvironment();
-
-  stopWelcomeDisplay();
-  _buffer.setPane(_setting.pane);
+  // 時刻の同期などを待たずに、時計として動き始める（残りは bootTask() が並行して行う）
+  startBoot();
+  setupTasks();
 }
 
 /**
- * @brief @c x [us] を 10 ms (10000 us) 単位で切り上げる
+ * @brief @c x [us] を @c unit [us] 単位で切り上げる
  * 
  * @param x マイクロ秒
- * @return <code>x @<= y && y % 10000 == 0</code> を満たすような最小の整数 @c y
+ * @param unit 単位となるマイクロ秒
+ * @return <code>x @< y && y % unit == 0</code> を満たすような最小の整数 @c y
  */
-static inline suseconds_t ceiling10ms(suseconds_t x) {
-  return ((x / 10000) + 1) * 10000;
+static inline suseconds_t ceiling(suseconds_t x, suseconds_t unit) {
+  return ((x / unit) + 1) * unit;
 }
 
 /**
- * @brief ヒマな時に呼び出し続けないといけない関数
+ * @brief 生成から破棄までの時間を ESP.getCycleCount() で計り、_profiler に記録する
  */
-void keeping() {
-  yieldServer();
-  yield();
-}
+class PhaseTimer {
+private:
+  LoopPhases _phase;
+  uint32_t   _start;
+
+public:
+  PhaseTimer(LoopPhases phase)
+      : _phase(phase)
+      , _start(ESP.getCycleCount()) {}
+
+  ~PhaseTimer() {
+    _profiler.record(_phase, (ESP.getCycleCount() - _start) / ESP.getCpuFreqMHz());
+  }
+};
 
 /**
- * @brief target で指示された時刻になったかな？
+ * @brief 実行すべきタスクが無い間の処理
  * 
- * @param target 
- * @retval true まだ
- * @retval false なった
+ * Web サーバーの応答が SCHEDULER_IDLE_SLICE_MS 以上遅れないよう、その間隔で区切って休む。
+ * 
+ * @param us 次のタスクまでのマイクロ秒
  */
-bool timeBefore(suseconds_t target) {
+static void idle(uint32_t us) {
+
+  bool connected;
+  {
+    PhaseTimer timer(LoopPhases::SERVER);
+    connected = yieldServer();
+  }
 
-  static suseconds_t before = 0;
-  static suseconds_t current;
+  // 通信中とその後しばらくは CPU とモデムを起こしておき、続くリクエストに素早く応える
+  if (connected)
+    requestFullPower(POWER_SAVE_BURST_MS);
+  updatePowerMode();
 
-  pftime::localtime(nullptr, &current);
+  if (us >= 1000) {
+    // delay() の間は CPU が休める（省電力モードならライトスリープする）ので、busy-wait よりも消費電力と発熱が少ない
+    delay(std::min<uint32_t>(us / 1000, SCHEDULER_IDLE_SLICE_MS));
+  } else {
+    yield();
+  }
+}
 
-  auto retval = current < target && current > before;
-  before      = current;
+//! loop() で実行するタスク
+static Scheduler _scheduler(micros, idle);
 
-  return retval;
+/**
+ * @brief 時刻の秒数（0 時からの通算）が @c period_s で割って @c offset_s 余る、次の時刻までの時間を求める
+ * 
+ * 今がちょうどその秒の中なら、次の周期の時刻までの時間を返す。
+ * 
+ * @param period_s 周期 [s]
+ * @param offset_s 周期内での位置 [s]
+ * @return マイクロ秒
+ */
+static uint32_t untilSlot(uint32_t period_s, uint32_t offset_s) {
+
+  suseconds_t usec;
+  auto        tm = _clock.now(&usec);
+
+  uint32_t now  = tm.tm_hour * 3600UL + tm.tm_min * 60UL + tm.tm_sec;
+  uint32_t wait = (offset_s + period_s - now % period_s) % period_s;
+  if (wait == 0)
+    wait = period_s;
+
+  return wait * 1000000UL - usec;
 }
 
 static bool enableAmbient() {
@@ -183,8 +164,8 @@ static bool enableCustomServer() {
   return _setting.use_custom_server && _setting.custom_server_addr;
 }
 
-static size_t ambient_transfered       = 0;
-static size_t custom_server_transfered = 0;
+size_t ambient_transfered       = 0;
+size_t custom_server_transfered = 0;
 
 static void sendDataToAmbient() {
 
@@ -217,70 +198,219 @@ static void removeSentEnvdatas() {
 }
 
 /**
- * @brief メインループ
+ * @brief SEL ボタンを確認し、必要があれば画面を更新する
  * 
+ * @return 次の DISPLAY_TICK_US の区切り、0.5 秒、先に描いた画面を送る時刻のうち、最も早いものまでの時間
  */
-void loop() {
+static uint32_t updateDisplayTask() {
+
+  // 次の区切りも過ぎてから始まったなら、画面更新を 1 回以上飛ばしている
+  if (_scheduler.getLateness() >= static_cast<uint32_t>(DISPLAY_TICK_US))
+    _profiler.countMissedTick();
+
+  CpuBoost boost;
+
+  suseconds_t usec;
+  auto        tm = _clock.now(&usec);
+
+  // 時刻が分かるまでは、タイトル画面などをめくらせない
+  if (getTimeSource() != TimeSources::NONE) {
+    PhaseTimer timer(LoopPhases::BUTTON);
+    changePaneIfSELPushed();
+  }
+  {
+    PhaseTimer timer(LoopPhases::DISPLAY);
+    updateDisplay(tm, usec);
+  }
+
+  // 起動してから、初めて時刻を描いた時刻を記録する
+  if (_boot_metrics.first_frame_ms == 0 && getTimeSource() != TimeSources::NONE) {
+    _boot_metrics.first_frame_ms     = millis();
+    _boot_metrics.first_frame_source = getTimeSource();
+  }
+
+  _clock.now(&usec);
+  auto target = std::min(ceiling(usec, DISPLAY_TICK_US), getDisplayLatchTime());
+  // 時刻のみの画面のコロンは 0.5 秒で消えるので、区切りが粗いときもそこで起きる
+  if (usec < 500000)
+    target = std::min<suseconds_t>(target, 500000);
 
-  static suseconds_t usec;
-  static struct tm   tm;
-  static uint8_t     brightness_count = 0;
+  return target > usec ? target - usec : 0;
+}
 
-  // 現在時刻
-  auto new_tm = *pftime::localtime(nullptr, &usec);
+/**
+ * @brief runEverySeconds() などを実行する
+ * 
+ * runEveryMinutes() と runEveryHours() も、起動して最初の 1 回は境目を待たずに実行する。
+ * 
+ * @return 次の秒までの時間
+ */
+static uint32_t runPeriodicTask() {
 
-  changePaneIfSELPushed();
+  static struct tm before;
+  static bool      started = false;
 
-  updateDisplay(new_tm, usec);
+  auto tm = _clock.now();
 
-  if (new_tm != tm) {
-    tm = new_tm;
+  // 秒の境目より少しだけ早く起こされた場合に、同じ秒で 2 回実行しない
+  if (tm != before) {
+    before = tm;
 
-    // この節は1秒に1回だけ実行される
+    // 起動して最初の 1 回は、分や時の境目を待たずにすべて実行する
+    bool first = !started;
+    started    = true;
 
     runEverySeconds(tm);
 
-    if (tm.tm_sec == 0) {
+    if (first || tm.tm_sec == 0)
       runEveryMinutes(tm);
-      if (tm.tm_min == 0)
-        runEveryHours(tm);
-    }
+    if (first || (tm.tm_sec == 0 && tm.tm_min == 0))
+      runEveryHours(tm);
+  }
 
-    if (tm.tm_sec == 0 || tm.tm_sec == 30) {
-      if (!_last_envdata.isValid())
-        bmeInit();
-      // 毎分 00 秒、30 秒に気温計測開始コマンドを送る
-      startMeasureEnvironment(tm);
-    } else if (tm.tm_sec == 1 || tm.tm_sec == 31) {
-      // 毎分 01 秒、31 秒に計測結果を読み取る
-      readEnvironment();
-    }
+  return untilSlot(1, 0);
+}
+
+/**
+ * @brief 毎分 00 秒、30 秒に気温計測開始コマンドを送る
+ * 
+ * @return 次の計測開始までの時間
+ */
+static uint32_t startMeasureTask() {
+
+  auto tm = _clock.now();
 
-    // envdata 送信関係
-    // 重い処理なのでなるべくループの最後に実行する
-    if (!_datas.empty() && tm.tm_min % DATA_SEND_INTERVAL == 0) {
-
-      if (tm.tm_sec == 3 && enableAmbient()) {
-        sendDataToAmbient();
-      } else if (tm.tm_sec == 5 && enableCustomServer()) {
-        sendDataToCustomServer();
-      } else if (tm.tm_sec == 7) {
-        removeSentEnvdatas();
-      }
+  if (tm.tm_sec % 30 == 0) {
+    PhaseTimer timer(LoopPhases::SENSOR);
+    if (!_last_envdata.isValid())
+      bmeInit();
+    startMeasureEnvironment(tm);
+  }
+
+  return untilSlot(30, 0);
+}
+
+/**
+ * @brief 毎分 01 秒、31 秒に計測結果を読み取る
+ * 
+ * @return 次の読み取りまでの時間
+ */
+static uint32_t readEnvironmentTask() {
+
+  auto tm = _clock.now();
+
+  if (tm.tm_sec % 30 == 1) {
+    PhaseTimer timer(LoopPhases::SENSOR);
+    readEnvironment();
+  }
+
+  return untilSlot(30, 1);
+}
+
+/**
+ * @brief 次に sendEnvdataTask() を実行する時刻までの時間を求める
+ */
+static uint32_t untilSendEnvdata() {
+
+  static constexpr uint32_t PERIOD_S = DATA_SEND_INTERVAL * 60UL;
+
+  return std::min({untilSlot(PERIOD_S, 3), untilSlot(PERIOD_S, 5), untilSlot(PERIOD_S, 7)});
+}
+
+/**
+ * @brief DATA_SEND_INTERVAL 分ごとに、envdata を送信する
+ * 
+ * 03 秒に Ambient、05 秒にカスタムサーバーへ送り、07 秒に両方へ送り終えたデータを捨てる。
+ * 
+ * @return 次の送信（または破棄）までの時間
+ */
+static uint32_t sendEnvdataTask() {
+
+  auto tm = _clock.now();
+
+  if (!_datas.empty() && tm.tm_min % DATA_SEND_INTERVAL == 0) {
+    // 送信の間はモデムを起こしておく
+    requestFullPower(POWER_SAVE_BURST_MS);
+    PhaseTimer timer(LoopPhases::UPLOAD);
+
+    if (tm.tm_sec == 3 && enableAmbient()) {
+      sendDataToAmbient();
+    } else if (tm.tm_sec == 5 && enableCustomServer()) {
+      sendDataToCustomServer();
+    } else if (tm.tm_sec == 7) {
+      removeSentEnvdatas();
     }
   }
 
-  // 約 40 ms ごとに測光する
-  if (++brightness_count % 4 == 0)
-    readAndSetBrightness();
-
-  // loop() が大体 10 ms ごとに呼ばれるように調節する
-  // 現在時刻をもう一度取得
-  pftime::localtime(nullptr, &usec);
-  // 次に来るキリのいい時間を計算
-  auto target = ceiling10ms(usec);
-  // target を過ぎるまで待つ
-  while (timeBefore(target)) {
-    keeping();
+  return untilSendEnvdata();
+}
+
+/**
+ * @brief 周囲の明るさを測定する
+ * 
+ * @return 次の測光までの時間（約 40 ms）
+ */
+static uint32_t readBrightnessTask() {
+
+  PhaseTimer timer(LoopPhases::BRIGHTNESS);
+  readAndSetBrightness();
+  return 40000;
+}
+
+/**
+ * @brief 起動の続き（ bootTask() ）を、かかった時間を計りながら実行する
+ */
+static uint32_t timedBootTask() {
+
+  PhaseTimer timer(LoopPhases::BOOT);
+  return bootTask();
+}
+
+/**
+ * @brief NTP の問い合わせ（ ntpTask() ）を、かかった時間を計りながら実行する
+ */
+static uint32_t timedNtpTask() {
+
+  PhaseTimer timer(LoopPhases::NTP);
+  return ntpTask();
+}
+
+/**
+ * @brief loop() で実行するタスクを登録する
+ * 
+ * 同じ時刻になったタスクは、登録した順に実行される。
+ * 重い処理（envdata 送信）は画面更新を遅らせないよう、後ろに置く。
+ * 
+ * @pre startBoot() が済んでいること。
+ */
+static void setupTasks() {
+
+  // タスクと、初回の実行までの時間
+  const std::pair<Scheduler::TTask, uint32_t> tasks[] = {
+      {timedBootTask, 0},
+      {updateDisplayTask, 0},
+      {timedNtpTask, 0},
+      {runPeriodicTask, untilSlot(1, 0)},
+      {startMeasureTask, untilSlot(30, 0)},
+      {readEnvironmentTask, untilSlot(30, 1)},
+      {sendEnvdataTask, untilSendEnvdata()},
+      {readBrightnessTask, 0},
+  };
+  static_assert(sizeof(tasks) / sizeof(tasks[0]) <= Scheduler::MAX_TASKS, "Too many tasks; increase Scheduler::MAX_TASKS.");
+
+  // 登録できなかったタスクは二度と実行されず、時計が黙って止まるので、起動させない
+  for (auto &task : tasks) {
+    if (!_scheduler.add(task.first, task.second)) {
+      Serial.println("ERROR: Failed to add a task to the scheduler.");
+      panic();
+    }
   }
 }
+
+/**
+ * @brief メインループ
+ * 
+ */
+void loop() {
+  _scheduler.run();
+}
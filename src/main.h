@@ -5,7 +5,13 @@
 #ifndef ESP8266Clock_main_H_
 #define ESP8266Clock_main_H_
 
+#include "ClockDiscipline.h"
 #include "ClockSetting.h"
+#include "LocalClock.h"
+#include "LoopProfiler.h"
+#include "NtpPacket.h"
+#include "SntpResponder.h"
+#include "TZTable.h"
 #include "const.h"
 #include "display/Brightness.h"
 #include "display/MyBuffer.h"
@@ -15,42 +21,204 @@
 #include <Arduino.h>
 #include <ESP8266HTTPClient.h>
 #include <ESP8266WiFi.h>
-#include <ESPPerfectTime.h>
 #include <LittleFS.h>
 #include <MAX7219Display.h>
 
 static constexpr char   PATH_OF_SETTING[]           = "/setting";
+static constexpr char   PATH_OF_TIME[]              = "/time";
 static constexpr size_t ADD_BYTES_SERIALIZE_ENVDATA = 43;
 static constexpr FS &   _fs                         = LittleFS;
 
 //! ユーザーが変更可能な時計の動作設定
 extern ClockSetting _setting;
+//! loop() の処理ごとにかかった時間
+extern LoopProfiler _profiler;
+//! _datas のうち、Ambient に送信済みの件数
+extern size_t ambient_transfered;
+//! _datas のうち、カスタムサーバーに送信済みの件数
+extern size_t custom_server_transfered;
+//! タイムゾーンの切り替え時刻の表。地方時への変換に使う
+extern TZTable _tz;
+//! 現在時刻（地方時）。localtime() の代わりに使う
+extern LocalClock _clock;
 
 // main_display
 
-extern MyBuffer         _buffer;
-extern MAX7219::Display _display;
-extern Brightness       _bn;
+/**
+ * @brief 先に描いておいた画面を、秒の境目で送ったときのずれ
+ * 
+ * ずれは「送信の中間点 - 秒の境目」で、負なら境目より早く表示が変わったことを表す。
+ */
+struct display_latency_t {
+  uint32_t count;       //! 計測回数
+  int32_t  last_us;     //! 直近のずれ
+  int32_t  min_us;      //! ずれの最小値
+  int32_t  max_us;      //! ずれの最大値
+  uint32_t transmit_us; //! 直近の送信にかかった時間
+};
 
-void updateDisplay(const struct tm &tm, suseconds_t usec);
-void readAndSetBrightness();
-void changePaneIfSELPushed();
-void displayAndBufferInit();
-void startWelcomeDisplay();
-void stopWelcomeDisplay();
+/**
+ * @brief 画面の処理で loop() が止まっていた時間の集計
+ * 
+ * 画面を描いて commit() するまで（ updateDisplay() ）と、
+ * フレームを SPI に送り始めるまで（ transmitFrame() を呼んでから戻るまで）の 2 つを計測する。
+ */
+struct display_render_t {
+  uint32_t count;    //! 計測回数
+  uint64_t total_us; //! 合計（平均を求めるため）
+  uint32_t min_us;   //! 最小値
+  uint32_t max_us;   //! 最大値
+};
+
+extern MyBuffer                        _buffer;
+extern MAX7219::Display<DisplayLayout> _display;
+extern Brightness                      _bn;
+extern display_latency_t               _display_latency;
+extern display_render_t                _display_render;
+extern display_render_t                _display_transmit;
+
+void        updateDisplay(const struct tm &tm, suseconds_t usec);
+suseconds_t getDisplayLatchTime();
+void        startDisplayTransmit();
+void        readAndSetBrightness();
+void        changePaneIfSELPushed();
+void        displayAndBufferInit();
+void        setupSPIClock();
 
 // main_fileio
 
 void readSetting();
 bool saveSetting();
+bool readSavedTime(time_t *t);
+bool saveTime(time_t t);
 
 // main_server
 
 void setupServer();
-void yieldServer();
+bool yieldServer();
+
+// main_power
+
+/**
+ * @brief 生存期間の間だけ、CPU を 160 MHz にする（省電力モードで、描画などを早く終わらせるため）
+ */
+class CpuBoost {
+public:
+  CpuBoost();
+  ~CpuBoost();
+
+  DISALLOW_COPY(CpuBoost);
+};
+
+void setupPowerSave();
+void requestFullPower(uint32_t ms);
+void updatePowerMode();
+
+// main_boot
+
+/**
+ * @brief 時刻の出どころ（後のものほど確か）
+ */
+enum class TimeSources : uint8_t {
+  NONE,  //! 分からない（起動してからの時間）
+  SAVED, //! 前回保存した時刻から数えた仮の時刻（電源が切れていた間の分だけ遅れる）
+  RTC,   //! 再起動の前の時刻を、RTC のカウンタで進めたもの（同期した時刻とほぼ同じく確か）
+  NTP,   //! NTP で同期した
+};
+
+/**
+ * @brief 起動の段階
+ */
+enum class BootPhases : uint8_t {
+  DISPLAY, //! ディスプレイの初期化
+  SETTING, //! FS のマウント、設定の読み込み、SPI クロックとタイムゾーンの設定
+  SENSOR,  //! 気温センサーの初期化と最初の計測
+  WIFI,    //! Wi-Fi の接続
+  SERVER,  //! Web サーバーの起動
+  NTP,     //! NTP の同期
+};
+
+//! BootPhases の要素数
+static constexpr size_t BOOT_PHASES_COUNT = 6;
+
+/**
+ * @brief 起動にかかった時間（すべて millis() の値。0 ならまだ）
+ */
+struct boot_metrics_t {
+  struct {
+    uint32_t start_ms; //! 始めた時刻
+    uint32_t end_ms;   //! 終えた時刻
+  } phases[BOOT_PHASES_COUNT];
+  uint32_t    first_frame_ms;     //! 初めて時刻を表示した時刻
+  TimeSources first_frame_source; //! そのときの時刻の出どころ
+  uint32_t    sync_ms;            //! NTP で同期した時刻
+};
+
+extern boot_metrics_t _boot_metrics;
+
+void        startBoot();
+uint32_t    bootTask();
+TimeSources getTimeSource();
+time_t      getCurrentTime(suseconds_t *usec);
+uint32_t    getClockCounter();
+void        saveCurrentTime();
+void        saveWarmState();
+void        expireWarmState();
+const char *getBootPhaseName(BootPhases phase);
+const char *getTimeSourceName(TimeSources source);
+
+// main_ntp
+
+/**
+ * @brief NTP サーバーの、直近の問い合わせの結果
+ */
+enum class NtpStates : uint8_t {
+  NONE,        //! まだ問い合わせていない
+  RESOLVING,   //! 名前解決の結果を待っている
+  QUERYING,    //! 応答を待っている
+  NO_RESPONSE, //! 応答が無かった（名前解決の失敗を含む）
+  FALSETICKER, //! 他のサーバーの過半数と時刻が合わなかった
+  TRUECHIMER,  //! 他のサーバーの過半数と時刻が合った
+  SELECTED,    //! 一番確かな応答として、時計に反映した
+};
+
+/**
+ * @brief NTP サーバーの状態（HTTP で返す）
+ */
+struct ntp_server_status_t {
+  const char *name;             //! 名前
+  NtpStates   state;            //! 直近の問い合わせの結果
+  uint8_t     stratum;          //! 直近の応答の Stratum
+  int32_t     offset_us;        //! 直近の応答のずれ（サーバーの時刻 - こちらの時刻）
+  uint32_t    delay_us;         //! 直近の応答の往復遅延
+  uint32_t    root_distance_us; //! 直近の応答の、サーバーから基準の時計までの誤差
+};
+
+//! NTP の応答から周波数のずれを推定し、時刻を合わせ続ける時計（同期した後の時刻の出どころ）
+extern ClockDiscipline _discipline;
+
+void                startNtp();
+uint32_t            ntpTask();
+uint32_t            getNtpAge();
+const char *        getNtpServer();
+size_t              getNtpServerCount();
+ntp_server_status_t getNtpServerStatus(size_t index);
+uint32_t            getNtpNoMajority();
+const char *        getNtpStateName(NtpStates state);
+bool                getNtpReference(NtpPacket::server_t *server);
+
+// main_sntp
+
+//! LAN の他の時計への、NTP の応答の統計
+using sntp_stats_t = SntpResponder::stats_t;
+
+bool         setupSntpServer();
+bool         isSntpServing();
+sntp_stats_t getSntpStats();
 
 // main_network
 
+bool   beginWiFi();
 void   connectWiFi();
 size_t postEnvdatas(const String &addr, const String &writeKey, const size_t start, const size_t maxLength);
 
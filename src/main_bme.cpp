@@ -4,10 +4,13 @@
  */
 
 #include "main.h"
+#include "BME280Compensation.h"
 #include <SparkFunBME280.h>
 
 //! BME280 環境計測センサ
 static BME280 _bme280;
+//! _bme280 の補正値（ bmeInit() で読み出す）
+static BME280Compensation::calibration_t _bme280_calibration;
 //! Ambient への送信のため、過去の環境計測結果を貯めておくキュー
 EnvDataQueue _datas(ENVDATA_STOCK_MAX);
 //! 直前の環境計測結果
@@ -16,15 +19,22 @@ envdata_t _last_envdata = {0};
 static struct tm _measure_start = {0};
 
 /**
- * @brief BME280 を初期化する
+ * @brief BME280 を初期化し、補正値を読み出す
  */
 bool bmeInit() {
   _bme280.setI2CAddress(0x77);
-  if (_bme280.beginI2C())
-    return true;
+  if (!_bme280.beginI2C()) {
+    _bme280.setI2CAddress(0x76);
+    if (!_bme280.beginI2C())
+      return false;
+  }
 
-  _bme280.setI2CAddress(0x76);
-  return _bme280.beginI2C();
+  uint8_t calib00[BME280Compensation::CALIB00_SIZE];
+  uint8_t calib26[BME280Compensation::CALIB26_SIZE];
+  _bme280.readRegisterRegion(calib00, BME280Compensation::CALIB00_REGISTER, sizeof(calib00));
+  _bme280.readRegisterRegion(calib26, BME280Compensation::CALIB26_REGISTER, sizeof(calib26));
+  BME280Compensation::parseCalibration(calib00, calib26, &_bme280_calibration);
+  return true;
 }
 
 /**
@@ -59,13 +69,22 @@ void readEnvironment() {
   if (_measure_start == (struct tm){0})
     return;
 
-  auto temperature = _bme280.readTempC();
-  auto humidity    = _bme280.readFloatHumidity();
-  auto pressure    = _bme280.readFloatPressure() / 100.0f;
+  // 気圧・気温・湿度のレジスタを 1 回で読み出し、整数演算で 1 度だけ補正する
+  // （ 1 回で読めば、途中で次の計測の値に変わることもない）
+  // 読めなかったときは、計測されていない値のまま残る
+  uint8_t raw[BME280Compensation::DATA_SIZE] = {0x80, 0x00, 0x00, 0x80, 0x00, 0x00, 0x80, 0x00};
+  _bme280.readRegisterRegion(raw, BME280Compensation::DATA_REGISTER, sizeof(raw));
+
+  BME280Compensation::sample_t sample      = {};
+  auto                         compensated = BME280Compensation::compensate(_bme280_calibration, raw, &sample);
+
+  auto temperature = sample.temperature / 100.0f;
+  auto humidity    = sample.humidity / 1024.0f;
+  auto pressure    = sample.pressure / 25600.0f;
 
   // 通信に失敗した場合、各値に変な値が入っていることがあるので
   // Operating range 外の値があれば欠測にする
-  if (temperature < -40.0f || temperature > 85.0f || humidity < 0.0f || humidity > 100.0f || pressure < 300.0f || pressure > 1100.0f) {
+  if (!compensated || temperature < -40.0f || temperature > 85.0f || humidity < 0.0f || humidity > 100.0f || pressure < 300.0f || pressure > 1100.0f) {
 
     _last_envdata = {0};
 
@@ -79,8 +98,8 @@ void readEnvironment() {
     };
     _last_envdata = data;
 
-    // 毎分 00 秒に計測したデータだけを Ambient に送る
-    if (_measure_start.tm_sec == 0 && data.isValid())
+    // 毎分 00 秒に計測したデータだけを Ambient に送る（仮の時刻で計測したものは送らない）
+    if (_measure_start.tm_sec == 0 && data.isValid() && getTimeSource() >= TimeSources::RTC)
       _datas.push_back(data);
   }
 
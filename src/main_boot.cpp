@@ -0,0 +1,386 @@
+/**
+ * @file main_boot.cpp
+ * @brief part of the main.cpp
+ */
+
+#include "main.h"
+#include "TZDB.h"
+#include "WarmState.h"
+#include <TZ.h>
+#include <Wire.h>
+
+extern "C" {
+#include <user_interface.h>
+}
+
+//! 状態を保存する RTC ユーザーメモリの位置 [4 bytes 単位]（先頭の 128 bytes は OTA の eboot コマンドが使う）
+static constexpr uint32_t RTC_WARM_STATE_OFFSET = 32;
+//! 保存した状態を、再起動されないまま残しておく時間 [ms]
+static constexpr uint32_t WARM_STATE_LIFETIME_MS = 60000;
+
+boot_metrics_t _boot_metrics = {};
+
+/**
+ * @brief bootTask() が待っているもの
+ */
+enum class BootSteps : uint8_t {
+  WIFI, //! Wi-Fi の接続
+  SYNC, //! NTP の同期
+  DONE, //! 起動完了
+};
+
+static BootSteps _step = BootSteps::WIFI;
+
+//! 今の時刻の出どころ
+static TimeSources _time_source = TimeSources::NONE;
+//! NTP で同期するまでの仮の時刻（ micros64() が _provisional_at のとき、_provisional_time 秒 _provisional_usec だった）
+static time_t   _provisional_time = 0;
+static uint32_t _provisional_usec = 0;
+static uint64_t _provisional_at   = 0;
+
+//! 状態を RTC ユーザーメモリに保存した時刻（ millis() ）
+static uint32_t _warm_state_saved_at = 0;
+//! 保存した状態が残っているか
+static bool _warm_state_saved = false;
+
+static void beginPhase(BootPhases phase) {
+  _boot_metrics.phases[static_cast<size_t>(phase)].start_ms = millis();
+}
+
+static void endPhase(BootPhases phase) {
+  _boot_metrics.phases[static_cast<size_t>(phase)].end_ms = millis();
+}
+
+/**
+ * @brief 時刻の出どころを変えて、時刻を表示する画面にする
+ */
+static void setTimeSource(TimeSources source) {
+
+  _time_source = source;
+  _clock.invalidate();
+  // NTP で同期するまでは、仮の時刻だと分かるようにコロンを点滅させる
+  _buffer.setSynced(source == TimeSources::NTP);
+  _buffer.setPane(_setting.pane);
+}
+
+/**
+ * @brief 設定からタイムゾーンの文字列を取得する
+ */
+static PGM_P getTimeZone() {
+
+  PGM_P tz = TZDB::getTZ(_setting.tzarea, _setting.tzcity);
+  return tz ? tz : TZ_Etc_GMT;
+}
+
+/**
+ * @brief Wi-Fi の接続が完了した後の起動処理
+ */
+static void onWiFiConnected() {
+
+  endPhase(BootPhases::WIFI);
+
+  // WiFiManager の設定モードで表示した画面を戻す
+  if (_buffer.getPane() == Panes::REQUIRE_SETTING)
+    _buffer.setPane(_time_source == TimeSources::NONE ? Panes::SYNCING_TIME : _setting.pane);
+
+  // WiFiManager による Wi-Fi 接続が成功すると、
+  // WiFiManager が内部で持っている ESP8266WebServer は stop されるので
+  // 別の Server を立ち上げても問題なくなる
+  beginPhase(BootPhases::SERVER);
+  setupServer();
+  if (_setting.serve_ntp && !setupSntpServer())
+    Serial.println("WARNING: Failed to start the NTP server on UDP 123.");
+  endPhase(BootPhases::SERVER);
+
+  setupPowerSave();
+
+  beginPhase(BootPhases::NTP);
+  startNtp();
+  _step = BootSteps::SYNC;
+}
+
+/**
+ * @brief RTC ユーザーメモリに保存した状態を消す
+ */
+static void clearWarmState() {
+
+  uint32_t zero = 0;
+  ESP.rtcUserMemoryWrite(RTC_WARM_STATE_OFFSET, &zero, sizeof(zero));
+  _warm_state_saved = false;
+}
+
+/**
+ * @brief 制御された再起動（設定の変更や OTA）の前に保存した状態を、RTC ユーザーメモリから戻す
+ * 
+ * @retval true 時刻も戻せた
+ * @retval false 時刻は戻せなかった（envdata などは戻せたかもしれない）
+ */
+static bool restoreWarmState() {
+
+  // 電源投入やクラッシュの後の RTC ユーザーメモリは使わない
+  if (ESP.getResetInfoPtr()->reason != REASON_SOFT_RESTART)
+    return false;
+
+  uint32_t           buffer[WarmState::MAX_SIZE / 4];
+  WarmState::state_t state;
+  if (!ESP.rtcUserMemoryRead(RTC_WARM_STATE_OFFSET, buffer, sizeof(buffer)) ||
+      !WarmState::deserialize(reinterpret_cast<uint8_t *>(buffer), sizeof(buffer), &state))
+    return false;
+
+  // 次の再起動で、同じ状態をもう一度戻さないように
+  clearWarmState();
+
+  for (size_t i = 0; i < state.envdata_count; i++)
+    _datas.push_back(state.envdatas[i]);
+  ambient_transfered       = state.ambient_transfered;
+  custom_server_transfered = state.custom_server_transfered;
+  _bn.restore(state.brightness, state.brightness_average);
+
+  if (!state.synced)
+    return false;
+
+  // RTC のカウンタは再起動の間も進んでいるので、保存してから経った時間が分かる
+  auto elapsed      = WarmState::elapsedUs(state, system_get_rtc_time()) + state.usec;
+  _provisional_at   = micros64();
+  _provisional_time = state.time + static_cast<time_t>(elapsed / 1000000);
+  _provisional_usec = elapsed % 1000000;
+  return true;
+}
+
+/**
+ * @brief 起動処理のうち、すぐに終わるものを行い、Wi-Fi の接続を始める
+ * 
+ * 残りは bootTask() が、画面更新などと並行して行う。
+ */
+void startBoot() {
+
+  // SPI、ディスプレイ初期化
+  beginPhase(BootPhases::DISPLAY);
+  displayAndBufferInit();
+  endPhase(BootPhases::DISPLAY);
+
+  // FS が壊れていても、デフォルト値を使えば時計としての機能は損なわれない
+  beginPhase(BootPhases::SETTING);
+  assert_debug(_fs.begin());
+  //_datas.init();
+  readSetting();
+  setupSPIClock();
+  // 地方時への変換は、切り替え時刻の表を作って自前で行う（newlib の TZ は mktime() のために設定する）
+  String tz = FPSTR(getTimeZone());
+  assert_debug(_tz.configure(tz.c_str()));
+  setenv("TZ", tz.c_str(), 1);
+  tzset();
+  endPhase(BootPhases::SETTING);
+
+  // 制御された再起動なら、その前の時刻と envdata などを引き継ぐ。
+  // そうでなければ、前回保存した時刻を、同期するまでの仮の時刻にする
+  if (restoreWarmState()) {
+    setTimeSource(TimeSources::RTC);
+  } else if (readSavedTime(&_provisional_time)) {
+    _provisional_at = micros64();
+    setTimeSource(TimeSources::SAVED);
+  }
+
+  // 温度センサー初期化と、最初の計測（計測完了を待つ <= 9.3 ms）
+  beginPhase(BootPhases::SENSOR);
+  Wire.begin(I2C_SDA, I2C_SCK);
+  bmeInit();
+  startMeasureEnvironment(_clock.now());
+  delay(10);
+  readEnvironment();
+  endPhase(BootPhases::SENSOR);
+
+  beginPhase(BootPhases::WIFI);
+  if (!beginWiFi()) {
+    // 設定が無いか、SEL ボタンで設定モードを指示されたので、WiFiManager に任せる（設定が済むまで戻らない）
+    connectWiFi();
+    onWiFiConnected();
+  }
+}
+
+/**
+ * @brief Wi-Fi の接続と NTP の同期を待ち、終わったら次の起動処理に進む
+ * 
+ * @return 次に確認するまでの時間（0.1 秒。起動が完了したら、もう実行しなくてよい）
+ */
+uint32_t bootTask() {
+
+  switch (_step) {
+  case BootSteps::WIFI:
+    if (WiFi.status() == WL_CONNECTED) {
+      onWiFiConnected();
+    } else if (millis() - _boot_metrics.phases[static_cast<size_t>(BootPhases::WIFI)].start_ms >= WIFI_CONNECT_TIMEOUT_MS) {
+      // 接続できないので、WiFiManager に任せる（設定モードに入るか、失敗したらリセットする）
+      connectWiFi();
+      onWiFiConnected();
+    }
+    break;
+
+  case BootSteps::SYNC:
+    if (_discipline.isSynced()) {
+      endPhase(BootPhases::NTP);
+      _boot_metrics.sync_ms = millis();
+      setTimeSource(TimeSources::NTP);
+      saveCurrentTime();
+      _step = BootSteps::DONE;
+
+      Serial.printf_P(PSTR("Boot: first frame %u ms (%s), synced %u ms\n"),
+                      _boot_metrics.first_frame_ms, getTimeSourceName(_boot_metrics.first_frame_source), _boot_metrics.sync_ms);
+    }
+    break;
+
+  case BootSteps::DONE:
+    // もう何もしない
+    return UINT32_MAX;
+  }
+
+  // 時刻が分からない間は、タイトル画面を 2 秒表示した後、「同期中...」と表示する
+  auto shown = millis() - _boot_metrics.phases[static_cast<size_t>(BootPhases::DISPLAY)].end_ms;
+  if (_time_source == TimeSources::NONE && _buffer.getPane() == Panes::WELCOME && shown >= 2000)
+    _buffer.setPane(Panes::SYNCING_TIME);
+
+  return 100000;
+}
+
+/**
+ * @brief 今の時刻の出どころを取得する
+ */
+TimeSources getTimeSource() {
+  return _time_source;
+}
+
+/**
+ * @brief 今の時刻を、今ある一番確かな出どころから取得する
+ * 
+ * @param[out] usec 現在時刻のマイクロ秒部分（不要なら nullptr）
+ * @return 現在時刻（UTC）
+ */
+time_t getCurrentTime(suseconds_t *usec) {
+
+  if (_time_source == TimeSources::NTP) {
+    auto now = _discipline.now(micros64());
+    if (usec)
+      *usec = now % 1000000;
+    return static_cast<time_t>(now / 1000000);
+  }
+
+  // 仮の時刻（出どころが無ければ、起動してからの時間）
+  auto elapsed = micros64() - _provisional_at + _provisional_usec;
+  if (usec)
+    *usec = elapsed % 1000000;
+  return _provisional_time + static_cast<time_t>(elapsed / 1000000);
+}
+
+/**
+ * @brief 今の時刻と同じ速さで進むマイクロ秒のカウンタ（ LocalClock に渡す）
+ * 
+ * NTP で同期していれば、ClockDiscipline の周波数とスルーの補正を含む（ micros() のままだと、分ごとに変換し直すまでの間に
+ * 補正の分だけずれて、変換し直すたびに跳ぶ）。時刻の出どころが変わったときは、setTimeSource() が LocalClock を無効にする。
+ */
+uint32_t getClockCounter() {
+
+  if (_time_source == TimeSources::NTP)
+    return static_cast<uint32_t>(_discipline.now(micros64()));
+  return static_cast<uint32_t>(micros64());
+}
+
+/**
+ * @brief NTP で同期していれば、今の時刻を保存する（再起動したときの仮の時刻にするため）
+ */
+void saveCurrentTime() {
+
+  if (_time_source >= TimeSources::RTC)
+    saveTime(getCurrentTime(nullptr));
+}
+
+/**
+ * @brief 時刻、送信していない envdata、画面の明るさなどを、RTC ユーザーメモリに保存する（制御された再起動の前に呼ぶ）
+ * 
+ * 次の起動で restoreWarmState() が戻す。再起動されないまま WARM_STATE_LIFETIME_MS 経ったら expireWarmState() が捨てる。
+ */
+void saveWarmState() {
+
+  WarmState::state_t state = {};
+  suseconds_t        usec;
+
+  state.synced     = _time_source >= TimeSources::RTC;
+  state.time       = getCurrentTime(&usec);
+  state.usec       = usec;
+  state.rtc_cycles = system_get_rtc_time();
+  state.rtc_period = system_rtc_clock_cali_proc();
+
+  // 入りきらなければ、古いものから捨てる
+  size_t skip = _datas.size() > WarmState::MAX_ENVDATAS ? _datas.size() - WarmState::MAX_ENVDATAS : 0;
+  for (size_t i = skip; i < _datas.size(); i++)
+    state.envdatas[state.envdata_count++] = _datas[i];
+  state.ambient_transfered       = ambient_transfered > skip ? ambient_transfered - skip : 0;
+  state.custom_server_transfered = custom_server_transfered > skip ? custom_server_transfered - skip : 0;
+
+  state.brightness         = _bn.getBrightness();
+  state.brightness_average = _bn.calcAverageRawValue();
+
+  uint32_t buffer[WarmState::MAX_SIZE / 4];
+  if (!WarmState::serialize(state, reinterpret_cast<uint8_t *>(buffer), sizeof(buffer)))
+    return;
+
+  ESP.rtcUserMemoryWrite(RTC_WARM_STATE_OFFSET, buffer, sizeof(buffer));
+  _warm_state_saved_at = millis();
+  _warm_state_saved    = true;
+}
+
+/**
+ * @brief 保存した状態が、再起動されないまま残っていたら捨てる（中断した OTA など）
+ * 
+ * 残しておくと、後のクラッシュなどによる再起動で、古い状態を戻してしまう。
+ */
+void expireWarmState() {
+
+  if (_warm_state_saved && millis() - _warm_state_saved_at >= WARM_STATE_LIFETIME_MS)
+    clearWarmState();
+}
+
+/**
+ * @brief 起動の段階の名前を取得する
+ * 
+ * @param phase 段階
+ * @return 名前（HTTP で返す JSON のキー）
+ */
+const char *getBootPhaseName(BootPhases phase) {
+
+  switch (phase) {
+  case BootPhases::DISPLAY:
+    return "display";
+  case BootPhases::SETTING:
+    return "setting";
+  case BootPhases::SENSOR:
+    return "sensor";
+  case BootPhases::WIFI:
+    return "wifi";
+  case BootPhases::SERVER:
+    return "server";
+  case BootPhases::NTP:
+    return "ntp";
+  }
+  return "";
+}
+
+/**
+ * @brief 時刻の出どころの名前を取得する
+ * 
+ * @param source 出どころ
+ * @return 名前（HTTP で返す JSON の値）
+ */
+const char *getTimeSourceName(TimeSources source) {
+
+  switch (source) {
+  case TimeSources::NONE:
+    return "none";
+  case TimeSources::SAVED:
+    return "saved";
+  case TimeSources::RTC:
+    return "rtc";
+  case TimeSources::NTP:
+    return "ntp";
+  }
+  return "";
+}
@@ -4,21 +4,145 @@
  */
 
 #include "main.h"
+#include "display/SPIClockTuner.h"
 #include <SPI.h>
 #include <Ticker.h>
 
-MyBuffer         _buffer;
-MAX7219::Display _display(SPI_CS_DISPLAY, _buffer, _buffer_settings);
-Brightness       _bn;
+MyBuffer                        _buffer;
+MAX7219::Display<DisplayLayout> _display(SPI_CS_DISPLAY, _buffer);
+Brightness                      _bn;
+display_latency_t               _display_latency = {};
+display_render_t                _display_render  = {};
+display_render_t                _display_transmit = {};
 
-//! loop() に到達するまでの間、画面更新を担うタイマー
-static Ticker _timer_update_display_until_setup;
-//! 電源投入2秒後に「同期中...」と表示するためのタイマー
-static Ticker _timer_pane_change;
+//! commit() された画面を、1 フレームずつ MAX7219 に送るタイマー（送るものが無くなったら止まる）
+static Ticker _timer_transmit_display;
+
+//! 先に描いて hold() している画面の秒（無ければ -1）
+static int8_t _ahead_sec = -1;
+//! 1 行の送信にかかる時間 [us]（直近の latchDisplay() で計測）
+static uint32_t _row_transmit_us = 0;
+
+/**
+ * @brief latchDisplay() で送り始めた画面の、送り終わりを待っている計測
+ */
+static struct {
+  bool     pending;  //! 送り終わりを待っている
+  uint32_t start;    //! 送り始めた micros()
+  uint32_t boundary; //! 秒の境目の micros()
+  size_t   rows;     //! 送った行数
+} _latch = {};
+
+/**
+ * @brief 集計に 1 回分の時間を加える
+ */
+static void addSample(display_render_t &stat, uint32_t elapsed) {
+  if (stat.count == 0 || elapsed < stat.min_us)
+    stat.min_us = elapsed;
+  if (stat.count == 0 || elapsed > stat.max_us)
+    stat.max_us = elapsed;
+  stat.count++;
+  stat.total_us += elapsed;
+}
+
+/**
+ * @brief commit() された画面を送り始め、それにかかった時間を集計する（ /display で見られる）
+ * 
+ * @return _display.transmitFrame() の戻り値
+ */
+static bool transmitFrame() {
+
+  // 前の送信を待っているだけの呼び出しは数えない
+  bool measure = !_display.isBursting() && _display.getPendingRows() > 0;
+
+  auto start     = micros();
+  bool remaining = _display.transmitFrame();
+  if (measure)
+    addSample(_display_transmit, micros() - start);
+
+  return remaining;
+}
+
+/**
+ * @brief 次の秒の時刻を求める
+ * 
+ * @param tm 現在時刻
+ * @param[out] next 次の秒の時刻
+ * @retval true 求められた
+ * @retval false tm を取得してから秒が変わっていた（または閏秒の前後）
+ */
+static bool nextSecond(const struct tm &tm, struct tm *next) {
+
+  // 分が変わらないなら、秒を進めるだけでよい
+  if (tm.tm_sec < 59) {
+    *next = tm;
+    next->tm_sec++;
+    return true;
+  }
+
+  *next = _tz.localtime(getCurrentTime(nullptr) + 1);
+
+  return next->tm_sec == (tm.tm_sec + 1) % 60;
+}
+
+/**
+ * @brief hold() している画面を送り始める
+ * 
+ * 送信は SPI の割り込みで進むので、送り終わりを待たずに戻る。秒の境目からのずれは finishLatch() で記録する。
+ */
+static void latchDisplay() {
+
+  suseconds_t usec;
+  _clock.now(&usec);
+  auto start = micros();
+  auto rows  = _display.getPendingRows();
+
+  _display.release();
+  transmitFrame();
+  startDisplayTransmit();
+
+  // 秒の境目を micros() の値に直す（境目を過ぎてから来た場合は usec が小さい）
+  _latch.pending  = true;
+  _latch.start    = start;
+  _latch.boundary = usec >= 500000 ? start + (1000000 - usec) : start - usec;
+  _latch.rows     = rows;
+  _ahead_sec      = -1;
+}
+
+/**
+ * @brief latchDisplay() で送り始めた画面を送り終えていれば、秒の境目からのずれを記録する（ /display で見られる）
+ */
+static void finishLatch() {
+
+  if (!_latch.pending || _display.isTransmitting())
+    return;
+  _latch.pending = false;
+
+  auto    start   = _latch.start;
+  auto    end     = _latch.rows > 0 ? _display.getTransmittedAt() : start;
+  auto    rows    = _latch.rows;
+  int32_t latency = static_cast<int32_t>(start + (end - start) / 2 - _latch.boundary);
+
+  auto &stat = _display_latency;
+  if (stat.count == 0 || latency < stat.min_us)
+    stat.min_us = latency;
+  if (stat.count == 0 || latency > stat.max_us)
+    stat.max_us = latency;
+  stat.count++;
+  stat.last_us     = latency;
+  stat.transmit_us = end - start;
+
+  // 次は送信の中間点が秒の境目に来るように送り始める（ getDisplayLatchTime() ）
+  if (rows > 0)
+    _row_transmit_us = (end - start) / rows;
+}
 
 /**
  * @brief 必要があれば画面を更新する
  * 
+ * 秒の境目の RENDER_AHEAD_US 前からは、次の秒の画面を描いて hold() しておき、
+ * 送信の中間点が境目に来る時刻（ getDisplayLatchTime() ）に送る。
+ * 
  * @param tm 現在時刻
  * @param usec 現在時刻のマイクロ秒部分
  */
@@ -26,10 +150,69 @@ void updateDisplay(const struct tm &tm, suseconds_t usec) {
   static IPAddress ip;
   ip = WiFi.localIP();
 
-  if (_buffer.isRequireUpdate(tm, usec, _last_envdata, &ip)) {
-    _buffer.update(tm, usec, _last_envdata, &ip);
-    _display.send();
+  struct tm   draw_tm = tm;
+  suseconds_t draw_us = usec;
+
+  finishLatch();
+
+  bool ahead = usec >= 1000000 - RENDER_AHEAD_US && nextSecond(tm, &draw_tm);
+  if (ahead)
+    draw_us = 0;
+
+  // 境目に間に合わなかった画面は、すぐに送る
+  if (_ahead_sec >= 0 && (!ahead || draw_tm.tm_sec != _ahead_sec))
+    latchDisplay();
+
+  if (_buffer.isRequireUpdate(draw_tm, draw_us, _last_envdata, &ip)) {
+    auto start = micros();
+    _buffer.update(draw_tm, draw_us, _last_envdata, &ip);
+    if (ahead) {
+      _display.hold();
+      _ahead_sec = draw_tm.tm_sec;
+    }
+    // 送信は _timer_transmit_display（ hold() 中は latchDisplay() ）に任せて、すぐに loop() へ戻る
+    _display.commit();
+    startDisplayTransmit();
+
+    // 毎フレーム Serial に出すと、それ自体が描画を遅らせるので、/display で見られるように集計だけしておく
+    addSample(_display_render, micros() - start);
   }
+
+  if (_ahead_sec >= 0 && usec >= getDisplayLatchTime())
+    latchDisplay();
+}
+
+/**
+ * @brief commit() された画面と、送信待ちのレジスタ書き込みの送信を始める
+ * 
+ * 1 行ずつ間をあけて送ると、送り終えるまでの間（100 kHz なら 1 行 約 1.3 ms、8 行で 16 ms ほど）新旧の画面の行が
+ * 混ざって見えるので、1 回のコールバックで 1 フレーム分を送り始める。
+ * 送信そのものは SPI の割り込みで進むので、コールバックは SPI の FIFO に 1 行詰めるだけで戻る。
+ * 送るものが無い間はタイマーを止めて、CPU が休めるようにしておく。
+ */
+void startDisplayTransmit() {
+
+  if (_timer_transmit_display.active())
+    return;
+
+  _timer_transmit_display.attach_ms(2, []() {
+    if (!transmitFrame())
+      _timer_transmit_display.detach();
+  });
+}
+
+/**
+ * @brief hold() している画面を送り始める時刻を取得する
+ * 
+ * @return 秒の境目からのマイクロ秒。送るものが無ければ 1000000（次の境目）
+ */
+suseconds_t getDisplayLatchTime() {
+
+  if (_ahead_sec < 0)
+    return 1000000;
+
+  // 送る行数と、1 行あたりの送信時間から、送信にかかる時間を見積もる
+  return 1000000 - _display.getPendingRows() * _row_transmit_us / 2;
 }
 
 static inline int8_t brightnessToIntensity(int8_t b) {
@@ -57,12 +240,14 @@ void readAndSetBrightness() {
     if (_buffer.getOverridePane() == OverridePanes::NORMAL)
       _buffer.setOverridePane(OverridePanes::OFF);
     _display.setIntensity(0);
+    startDisplayTransmit();
 
   } else if (brightness != b) {
     if (_buffer.getOverridePane() == OverridePanes::OFF)
       _buffer.setOverridePane(OverridePanes::NORMAL);
     auto intensity = brightnessToIntensity(b);
     _display.setIntensity(intensity);
+    startDisplayTransmit();
   }
 
   brightness = b;
@@ -119,7 +304,8 @@ void displayAndBufferInit() {
   // SPI 初期化
   pinMode(PORT_SEL, INPUT);
   SPI.begin();
-  SPI.setFrequency(100000);
+  // 設定を読み込むまでは、確実に通信できる周波数を使う（ setupSPIClock() を参照）
+  SPI.setFrequency(SPI_FREQUENCY_FALLBACK);
   SPI.setDataMode(SPI_MODE0);
 
   // ディスプレイ初期化
@@ -128,35 +314,40 @@ void displayAndBufferInit() {
   _buffer.update({0}, 0, {0}, nullptr);
   _display.send();
   _display.shutdownMode(false);
+  startDisplayTransmit();
 }
 
 /**
- * @brief ディスプレイ更新用タイマーを開始
+ * @brief SPI クロック周波数を設定する。未調整なら、先に自動調整して設定を保存する
  * 
- * @post 他の画面を表示させる前に必ず stopWelcomeDisplay() を呼び出すこと
+ * @pre readSetting() が呼ばれていること。
  */
-void startWelcomeDisplay() {
+void setupSPIClock() {
 
-  _timer_update_display_until_setup.attach_ms(100, []() {
-    suseconds_t usec;
-    auto        tm = *pftime::localtime(nullptr, &usec);
+  if (_setting.spi_frequency == 0 && SPI_LOOPBACK) {
 
-    if (_buffer.isRequireUpdate(tm, usec, {0}, nullptr)) {
-      _buffer.update(tm, usec, {0}, nullptr);
-      _display.send();
-    }
-  });
+    SPIClockTuner tuner([](uint32_t frequency) {
+      _display.waitTransmitted();
+      SPI.setFrequency(frequency);
+      return _display.loopback(random(256));
+    });
 
-  _timer_pane_change.once_ms(2000, []() {
-    _buffer.setPane(Panes::SYNCING_TIME);
-  });
-}
+    _setting.spi_frequency = tuner.tune();
+    Serial.printf_P(PSTR("SPI clock: max reliable %u Hz, use %u Hz\n"), tuner.getMaxReliable(), _setting.spi_frequency);
 
-/**
- * @brief ディスプレイ更新用タイマーを停止
- */
-void stopWelcomeDisplay() {
+    if (_setting.spi_frequency != 0)
+      saveSetting();
 
-  _timer_pane_change.detach();
-  _timer_update_display_until_setup.detach();
-}
\ No newline at end of file
+    // 化けたデータで MAX7219 の設定が変わっているかもしれないので、初期化し直す
+    _display.waitTransmitted();
+    SPI.setFrequency(_setting.spi_frequency != 0 ? _setting.spi_frequency : SPI_FREQUENCY_FALLBACK);
+    _display.init();
+    _display.send();
+    _display.shutdownMode(false);
+    startDisplayTransmit();
+    return;
+  }
+
+  _display.waitTransmitted();
+  SPI.setFrequency(_setting.spi_frequency != 0 ? _setting.spi_frequency : SPI_FREQUENCY_FALLBACK);
+}
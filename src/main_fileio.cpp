@@ -38,3 +38,42 @@ bool saveSetting() {
   f.close();
   return true;
 }
+
+/**
+ * @brief 保存しておいた時刻を読み込む
+ * 
+ * @param[out] t 時刻（UTC）
+ * @retval true 成功
+ * @retval false 保存されていないか、読めなかった
+ */
+bool readSavedTime(time_t *t) {
+
+  File f = _fs.open(PATH_OF_TIME, "r");
+  if (!f)
+    return false;
+
+  // NTP で同期した時刻しか保存しないので、それより前の値は壊れている
+  auto value = strtoll(f.readString().c_str(), nullptr, 10);
+  if (value < 1600000000)
+    return false;
+
+  *t = value;
+  return true;
+}
+
+/**
+ * @brief 時刻を保存する（再起動したときの仮の時刻にするため）
+ * 
+ * @param t 時刻（UTC）
+ * @retval true 成功
+ * @retval false 不成功
+ */
+bool saveTime(time_t t) {
+
+  File f = _fs.open(PATH_OF_TIME, "w");
+  if (!f)
+    return false;
+  f.print(static_cast<long long>(t));
+  f.close();
+  return true;
+}
@@ -14,7 +14,6 @@
 static void wifiConfigModeCallback(WiFiManager *wiFiManager) {
 
   // display にメッセージを表示
-  stopWelcomeDisplay();
   _buffer.setPane(Panes::REQUIRE_SETTING);
   _buffer.update({0}, 0, {0}, nullptr);
   _display.send();
@@ -35,7 +34,6 @@ static void wifiConfigModeCallback(WiFiManager *wiFiManager) {
 static void failedToConnect() {
 
   Serial.println("failed to connect and hit timeout");
-  stopWelcomeDisplay();
   _buffer.setPane(Panes::CONNECT_FAILED);
   _buffer.update({0}, 0, {0}, nullptr);
   _display.send();
@@ -46,6 +44,22 @@ static void failedToConnect() {
   delay(1000);
 }
 
+/**
+ * @brief 保存されている設定で、Wi-Fi の接続を始める（接続は待たない）
+ * 
+ * @retval true 接続を始めた（ WiFi.status() で完了を確認する）
+ * @retval false 設定が無いか、SEL ボタンが押されているので、 connectWiFi() で設定モードに入る必要がある
+ */
+bool beginWiFi() {
+
+  if (digitalRead(PORT_SEL) == 0 || WiFi.SSID().isEmpty())
+    return false;
+
+  WiFi.mode(WIFI_STA);
+  WiFi.begin();
+  return true;
+}
+
 /**
  * @brief WiFiManager を利用して Wi-Fi 接続する
  * 必要に応じて自動的に設定モード（SoftAP モード）に入る
@@ -0,0 +1,521 @@
+/**
+ * @file main_ntp.cpp
+ * @brief part of the main.cpp
+ */
+
+#include "main.h"
+#include "ClockSelect.h"
+#include "NtpPacket.h"
+#include <array>
+#include <lwip/dns.h>
+#include <lwip/udp.h>
+
+//! 応答に載せる時計の分解能（2^-20 秒 ≒ 1 us）
+static constexpr int8_t NTP_PRECISION = -20;
+//! 時計の誤差が、同期してから増えていく速さ（RFC 5905 の PHI、15 ppm）
+static constexpr double NTP_DISPERSION_RATE = 15e-6;
+
+ClockDiscipline _discipline;
+
+/**
+ * @brief NTP サーバーごとの状態
+ */
+struct ntp_server_t {
+  String                name;        //! 名前（アドレスでもよい）
+  IPAddress             address;     //! 名前解決したアドレス
+  bool                  resolved;    //! address が有効か
+  bool                  resolving;   //! 名前解決の結果を待っているか
+  bool                  waiting;     //! 応答を待っているか
+  uint8_t               failures;    //! 続けて応答が無かった回数
+  uint8_t               origin[8];   //! 送った Transmit Timestamp（応答の Originate Timestamp と照合する）
+  int64_t               sent_time;   //! 問い合わせを送ったときの時刻 [us]
+  uint64_t              received_at; //! 応答を受け取ったときのカウンタ（ micros64() ）
+  uint8_t               stratum;     //! 応答の Stratum
+  uint32_t              root_delay;  //! 応答の Root Delay [us]
+  uint32_t              root_disp;   //! 応答の Root Dispersion [us]
+  ClockSelect::sample_t sample;      //! 直近の応答
+  NtpStates             state;       //! 直近の問い合わせの結果
+};
+
+//! 問い合わせる NTP サーバー
+static std::array<ntp_server_t, NTP_MAX_SERVERS> _ntp_servers;
+static size_t                                    _ntp_server_count = 0;
+//! 1 台ずつ問い合わせるとき（ NTP_PARALLEL が false ）に、問い合わせる _ntp_servers の位置
+static size_t _ntp_server = 0;
+//! 直近に選んだ _ntp_servers の位置（まだなら -1）
+static int _ntp_selected = -1;
+
+//! 問い合わせと応答に使う UDP の PCB
+static udp_pcb *_ntp_pcb = nullptr;
+//! 問い合わせを始めたか
+static bool _ntp_started = false;
+//! 応答を待っているか
+static bool _ntp_waiting = false;
+//! 問い合わせを送った時刻（ millis() ）
+static uint32_t _ntp_sent_ms = 0;
+//! 次に問い合わせる時刻（ millis() ）
+static uint32_t _ntp_next_ms = 0;
+//! 直近の応答を時計に反映した時刻（ millis() ）と、そのときの時刻 [us]
+static uint32_t _ntp_last_ms   = 0;
+static int64_t  _ntp_last_time = 0;
+//! 過半数のサーバーの時刻が一致せず、時計に反映できなかった回数
+static uint32_t _ntp_no_majority = 0;
+
+/**
+ * @brief 名前解決が済んだ（または失敗した）ときに lwIP から呼ばれ、サーバーのアドレスを記録する
+ * 
+ * lwIP のコールバックは loop() の合間に呼ばれるので、_ntp_servers を書き換えても競合しない。
+ * 待っている間に startNtp() でサーバーが入れ替わっていたら、結果は捨てる。
+ * 名前解決に失敗したら、次の問い合わせを NTP_RETRY_MS 後にする。
+ */
+static void onNtpServerResolved(const char *name, const ip_addr_t *addr, void *arg) {
+
+  auto index = reinterpret_cast<uintptr_t>(arg);
+  if (index >= _ntp_server_count)
+    return;
+
+  auto &server = _ntp_servers[index];
+  if (!server.resolving || server.name != name)
+    return;
+
+  server.resolving = false;
+  if (!addr) {
+    // DNS サーバーに届かないなら、すぐに問い合わせ直しても同じなので、間をあける
+    server.state = NtpStates::NO_RESPONSE;
+    server.failures++;
+    _ntp_next_ms = millis() + NTP_RETRY_MS;
+    return;
+  }
+
+  server.address  = IPAddress(addr);
+  server.resolved = true;
+}
+
+/**
+ * @brief サーバーの名前解決を始める
+ * 
+ * DNS サーバーの応答は待たずに戻り、結果は onNtpServerResolved() で受け取る。
+ * 
+ * @param index _ntp_servers の位置
+ * @retval true アドレスが分かった（アドレスが直接書かれていたか、lwIP が覚えていた）
+ * @retval false 名前解決の結果を待っているか、始められなかった
+ */
+static bool resolveNtpServer(size_t index) {
+
+  auto &server = _ntp_servers[index];
+  if (server.resolving)
+    return false;
+
+  ip_addr_t addr;
+  auto      err = dns_gethostbyname(server.name.c_str(), &addr, onNtpServerResolved, reinterpret_cast<void *>(index));
+  if (err == ERR_OK) {
+    server.address  = IPAddress(&addr);
+    server.resolved = true;
+    return true;
+  }
+
+  server.resolving = err == ERR_INPROGRESS;
+  return false;
+}
+
+/**
+ * @brief サーバーに問い合わせを送る
+ * 
+ * @pre server.resolved が true であること。
+ * @retval true 送った
+ * @retval false 送信に失敗した
+ */
+static bool sendNtpRequest(ntp_server_t &server) {
+
+  auto p = pbuf_alloc(PBUF_TRANSPORT, NtpPacket::SIZE, PBUF_RAM);
+  if (!p)
+    return false;
+
+  // LI = 0, VN = 4, Mode = 3 (client)
+  auto packet = static_cast<uint8_t *>(p->payload);
+  memset(packet, 0, NtpPacket::SIZE);
+  packet[0] = 0x23;
+
+  server.sent_time = _discipline.now(micros64());
+  NtpPacket::writeTimestamp(packet + NtpPacket::TRANSMIT_TIME, server.sent_time);
+  memcpy(server.origin, packet + NtpPacket::TRANSMIT_TIME, sizeof(server.origin));
+
+  auto err = udp_sendto(_ntp_pcb, p, server.address, NtpPacket::PORT);
+  pbuf_free(p);
+  return err == ERR_OK;
+}
+
+/**
+ * @brief 応答を受け取ったときに lwIP から呼ばれ、問い合わせたサーバーの応答として記録する
+ * 
+ * 受け取った時刻 (T4) は、ntpTask() が次に動くのを待たず、ここで記録する（待つと、その分だけ往復遅延が長く、
+ * ずれが偏って見える）。lwIP のコールバックは loop() の合間に呼ばれるので、_ntp_servers を書き換えても競合しない。
+ */
+static void receiveNtpResponse(void *arg, udp_pcb *pcb, pbuf *p, const ip_addr_t *addr, u16_t port) {
+
+  auto received_at = micros64();
+
+  uint8_t packet[NtpPacket::SIZE];
+  auto    length = pbuf_copy_partial(p, packet, sizeof(packet), 0);
+  pbuf_free(p);
+  if (!NtpPacket::isSyncedResponse(packet, length))
+    return;
+
+  // こちらの問い合わせへの応答か（ Originate Timestamp はサーバーごとに違うので、遅れて届いた前の応答は合わない）
+  IPAddress remote(addr);
+  for (size_t i = 0; i < _ntp_server_count; i++) {
+    auto &server = _ntp_servers[i];
+    if (!server.waiting || server.address != remote || !NtpPacket::isResponseTo(packet, server.origin))
+      continue;
+
+    // T1: 送信、T2: サーバーの受信、T3: サーバーの送信、T4: 受信
+    auto t1 = server.sent_time;
+    auto t2 = NtpPacket::readTimestamp(packet + NtpPacket::RECEIVE_TIME);
+    auto t3 = NtpPacket::readTimestamp(packet + NtpPacket::TRANSMIT_TIME);
+    auto t4 = _discipline.now(received_at);
+
+    auto delay = (t4 - t1) - (t3 - t2);
+    if (delay < 0)
+      delay = 0;
+
+    server.root_delay           = NtpPacket::readShort(packet + NtpPacket::ROOT_DELAY);
+    server.root_disp            = NtpPacket::readShort(packet + NtpPacket::ROOT_DISPERSION);
+    server.sample.offset        = ((t2 - t1) + (t3 - t4)) / 2;
+    server.sample.delay         = static_cast<uint32_t>(delay);
+    server.sample.root_distance = server.root_delay / 2 + server.root_disp;
+    server.received_at          = received_at;
+    server.stratum              = packet[1];
+    server.waiting              = false;
+    server.failures             = 0;
+    return;
+  }
+}
+
+/**
+ * @brief 応答を待っているサーバーが、もう無いか
+ */
+static bool receivedAllNtpResponses() {
+
+  for (size_t i = 0; i < _ntp_server_count; i++) {
+    if (_ntp_servers[i].waiting)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 受け取った応答から一番確かなものを選び、時計に反映する
+ * 
+ * @retval true 反映した
+ * @retval false 応答が無いか、過半数のサーバーの時刻が一致しなかった
+ */
+static bool applyNtpResponses() {
+
+  ClockSelect::sample_t samples[NTP_MAX_SERVERS];
+  size_t                indexes[NTP_MAX_SERVERS];
+  bool                  truechimers[NTP_MAX_SERVERS];
+  size_t                count = 0;
+
+  for (size_t i = 0; i < _ntp_server_count; i++) {
+    auto &server = _ntp_servers[i];
+    if (server.state != NtpStates::QUERYING)
+      continue;
+
+    if (server.waiting) {
+      // 応答が続けて無ければ、アドレスが変わったのかもしれない
+      server.waiting = false;
+      server.state   = NtpStates::NO_RESPONSE;
+      if (++server.failures >= 2)
+        server.resolved = false;
+      continue;
+    }
+
+    samples[count] = server.sample;
+    indexes[count] = i;
+    count++;
+  }
+
+  if (count == 0)
+    return false;
+
+  auto best = ClockSelect::select(samples, count, truechimers);
+  for (size_t i = 0; i < count; i++)
+    _ntp_servers[indexes[i]].state = truechimers[i] ? NtpStates::TRUECHIMER : NtpStates::FALSETICKER;
+
+  if (best < 0) {
+    _ntp_no_majority++;
+    return false;
+  }
+
+  auto &server  = _ntp_servers[indexes[best]];
+  server.state  = NtpStates::SELECTED;
+  _ntp_selected = indexes[best];
+
+  auto steps = _discipline.getSteps();
+  _discipline.update(server.received_at, server.sample.offset, server.sample.delay);
+
+  // 時刻を飛ばしたなら、秒の境目を求め直させる
+  if (_discipline.getSteps() != steps)
+    _clock.invalidate();
+
+  _ntp_last_ms   = millis();
+  _ntp_last_time = _discipline.now(server.received_at);
+  return true;
+}
+
+/**
+ * @brief 名前解決の結果を待っているサーバーがあるか
+ */
+static bool resolvingNtpServers() {
+
+  for (size_t i = 0; i < _ntp_server_count; i++) {
+    if (_ntp_servers[i].resolving)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief サーバーに問い合わせを送る（ NTP_PARALLEL なら、すべてのサーバーに一度に送る）
+ * 
+ * アドレスが分からないサーバーは、名前解決を始めるだけで、今回は送らない。
+ * 
+ * @retval true 1 つ以上送った
+ * @retval false 送れなかった
+ */
+static bool startNtpQuery() {
+
+  // 応答を待つ間はモデムを起こしておく
+  requestFullPower(POWER_SAVE_BURST_MS);
+
+  bool sent = false;
+  for (size_t i = 0; i < _ntp_server_count; i++) {
+    auto &server = _ntp_servers[i];
+    server.waiting = false;
+    if (!NTP_PARALLEL && i != _ntp_server)
+      continue;
+
+    // 名前解決は、初めてのときと、応答が続けて無かったときだけ行う
+    if (!server.resolved && !resolveNtpServer(i)) {
+      // 結果を待っている間は失敗に数えない
+      if (server.resolving) {
+        server.state = NtpStates::RESOLVING;
+        continue;
+      }
+      server.state = NtpStates::NO_RESPONSE;
+      server.failures++;
+      continue;
+    }
+
+    server.state = NtpStates::QUERYING;
+    if (sendNtpRequest(server)) {
+      server.waiting = true;
+      sent           = true;
+    } else {
+      server.state = NtpStates::NO_RESPONSE;
+      if (++server.failures >= 2)
+        server.resolved = false;
+    }
+  }
+
+  _ntp_sent_ms = millis();
+  return sent;
+}
+
+/**
+ * @brief 設定された NTP サーバーへの問い合わせを始める
+ * 
+ * @pre WiFi の接続が完了していること。
+ */
+void startNtp() {
+
+  _ntp_server_count = 0;
+  for (auto &&n : _setting.ntp) {
+    if (_ntp_server_count >= _ntp_servers.size())
+      break;
+    if (!n || n.isEmpty())
+      continue;
+
+    auto &server = _ntp_servers[_ntp_server_count++];
+    server       = {};
+    server.name  = n;
+  }
+
+  // 有効なNTPサーバーが指定されなければデフォルト値を使用
+  if (_ntp_server_count == 0) {
+    auto &server = _ntp_servers[_ntp_server_count++];
+    server       = {};
+    server.name  = DEFAULT_NTP_SERVER;
+  }
+
+  // 応答は receiveNtpResponse() で受け取る（ポートは空いているものを使う）
+  if (!_ntp_pcb) {
+    _ntp_pcb = udp_new();
+    if (!_ntp_pcb)
+      return;
+    udp_bind(_ntp_pcb, IP_ADDR_ANY, 0);
+    udp_recv(_ntp_pcb, receiveNtpResponse, nullptr);
+  }
+
+  _ntp_next_ms = millis();
+  _ntp_started = true;
+}
+
+/**
+ * @brief NTP サーバーに問い合わせ、応答を時計に反映する
+ * 
+ * すべての応答が届くか NTP_TIMEOUT_MS 経ったら、ClockSelect で一番確かな応答を選んで反映する。
+ * 問い合わせの間隔は _discipline が決める（周波数が正しく推定できていれば長くなる）。
+ * 反映できなければ、同期するまでは NTP_RETRY_MS、同期した後は最小の間隔で問い合わせ直す。
+ * 
+ * @return 次に確認するまでの時間
+ */
+uint32_t ntpTask() {
+
+  if (!_ntp_started)
+    return 100000;
+
+  if (_ntp_waiting) {
+    if (!receivedAllNtpResponses() && millis() - _ntp_sent_ms < NTP_TIMEOUT_MS)
+      return 10000;
+
+    _ntp_waiting = false;
+    if (applyNtpResponses()) {
+      _ntp_next_ms = _ntp_last_ms + _discipline.getPollInterval() * 1000;
+    } else {
+      _ntp_next_ms = millis() + (_discipline.isSynced() ? (1UL << ClockDiscipline::MIN_POLL) * 1000 : NTP_RETRY_MS);
+    }
+
+    // 1 台ずつ問い合わせるなら、応答が無かったときだけ次のサーバーに移る
+    if (!NTP_PARALLEL && _ntp_servers[_ntp_server].state != NtpStates::SELECTED)
+      _ntp_server = (_ntp_server + 1) % _ntp_server_count;
+  }
+
+  auto now = millis();
+  if (static_cast<int32_t>(now - _ntp_next_ms) < 0)
+    return std::min<uint32_t>(_ntp_next_ms - now, UINT32_MAX / 1000) * 1000;
+
+  if (startNtpQuery()) {
+    _ntp_waiting = true;
+    return 10000;
+  }
+
+  // 名前解決の結果が届いたら、すぐに問い合わせる
+  if (resolvingNtpServers()) {
+    _ntp_next_ms = millis() + NTP_DNS_POLL_MS;
+    return NTP_DNS_POLL_MS * 1000;
+  }
+
+  if (!NTP_PARALLEL)
+    _ntp_server = (_ntp_server + 1) % _ntp_server_count;
+
+  _ntp_next_ms = millis() + NTP_RETRY_MS;
+  return NTP_RETRY_MS * 1000;
+}
+
+/**
+ * @brief 直近の応答を時計に反映してからの時間を取得する
+ * 
+ * @return ミリ秒（まだ反映していなければ UINT32_MAX）
+ */
+uint32_t getNtpAge() {
+  return _discipline.getSamples() ? millis() - _ntp_last_ms : UINT32_MAX;
+}
+
+/**
+ * @brief 直近に選んだ NTP サーバーを取得する
+ */
+const char *getNtpServer() {
+  return _ntp_selected >= 0 ? _ntp_servers[_ntp_selected].name.c_str() : "";
+}
+
+/**
+ * @brief NTP サーバーの数を取得する
+ */
+size_t getNtpServerCount() {
+  return _ntp_server_count;
+}
+
+/**
+ * @brief NTP サーバーの、直近の問い合わせの結果を取得する
+ * 
+ * @param index 0 から getNtpServerCount() - 1 まで
+ */
+ntp_server_status_t getNtpServerStatus(size_t index) {
+
+  auto &server = _ntp_servers[index];
+  auto  offset = server.sample.offset;
+
+  ntp_server_status_t status;
+  status.name             = server.name.c_str();
+  status.state            = server.state;
+  status.stratum          = server.stratum;
+  status.offset_us        = static_cast<int32_t>(std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, offset)));
+  status.delay_us         = server.sample.delay;
+  status.root_distance_us = server.sample.root_distance;
+  return status;
+}
+
+/**
+ * @brief 過半数のサーバーの時刻が一致せず、時計に反映できなかった回数を取得する
+ */
+uint32_t getNtpNoMajority() {
+  return _ntp_no_majority;
+}
+
+/**
+ * @brief NTP サーバーの問い合わせの結果の名前を取得する
+ * 
+ * @param state 結果
+ * @return 名前（HTTP で返す JSON の値）
+ */
+const char *getNtpStateName(NtpStates state) {
+
+  switch (state) {
+  case NtpStates::NONE:
+    return "none";
+  case NtpStates::RESOLVING:
+    return "resolving";
+  case NtpStates::QUERYING:
+    return "querying";
+  case NtpStates::NO_RESPONSE:
+    return "no_response";
+  case NtpStates::FALSETICKER:
+    return "falseticker";
+  case NtpStates::TRUECHIMER:
+    return "truechimer";
+  case NtpStates::SELECTED:
+    return "selected";
+  }
+  return "";
+}
+
+/**
+ * @brief LAN の他の時計に NTP で応答するときに載せる、この時計の状態を取得する
+ * 
+ * @param[out] server 状態
+ * @retval true 取得できた
+ * @retval false 上流のサーバーと同期していないので、応答してはいけない
+ */
+bool getNtpReference(NtpPacket::server_t *server) {
+
+  if (getTimeSource() != TimeSources::NTP || _ntp_selected < 0)
+    return false;
+
+  // Stratum 16 は「同期していない」を表す
+  auto &upstream = _ntp_servers[_ntp_selected];
+  if (upstream.stratum + 1 >= 16)
+    return false;
+
+  // 誤差は、上流のサーバーの誤差、ジッタ、同期してからの経過で増える分の和
+  auto age = millis() - _ntp_last_ms;
+
+  server->stratum         = upstream.stratum + 1;
+  server->precision       = NTP_PRECISION;
+  server->reference_time  = _ntp_last_time;
+  server->root_delay      = upstream.root_delay + upstream.sample.delay;
+  server->root_dispersion = upstream.root_disp + _discipline.getJitter() + static_cast<uint32_t>(age * 1000.0 * NTP_DISPERSION_RATE);
+  for (size_t i = 0; i < sizeof(server->reference_id); i++)
+    server->reference_id[i] = upstream.address[i];
+  return true;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file main_power.cpp
+ * @brief part of the main.cpp
+ */
+
+#include "main.h"
+
+extern "C" {
+#include <gpio.h>
+#include <user_interface.h>
+}
+
+//! CPU とモデムを起こしておく期限（ millis() ）
+static uint32_t _full_power_until = 0;
+//! CPU とモデムを起こしているか
+static bool _full_power = false;
+
+/**
+ * @brief CPU とモデムを、起こした状態と省電力の状態とで切り替える
+ */
+static void setFullPower(bool value) {
+
+  if (_full_power == value)
+    return;
+
+  _full_power = value;
+  system_update_cpu_freq(value ? SYS_CPU_160MHZ : SYS_CPU_80MHZ);
+  // ライトスリープ中も AP との接続は保たれ、DTIM ビーコンのたびに起きて受信する
+  // ただし NTP で時刻を返すなら、要求だけが DTIM ビーコンまで待たされて往復の遅延が偏るので、モデムは眠らせない
+  WiFi.setSleepMode(value || _setting.serve_ntp ? WIFI_NONE_SLEEP : WIFI_LIGHT_SLEEP);
+}
+
+/**
+ * @brief 省電力モードを開始する
+ * 
+ * @pre Wi-Fi の接続が完了していること。
+ */
+void setupPowerSave() {
+
+  if (!POWER_SAVE)
+    return;
+
+  // SEL ボタン（押すと LOW）でもライトスリープから起きる
+  gpio_pin_wakeup_enable(GPIO_ID_PIN(PORT_SEL), GPIO_PIN_INTR_LOLEVEL);
+
+  _full_power = true;
+  setFullPower(false);
+}
+
+/**
+ * @brief しばらくの間、CPU とモデムを起こしておく（HTTP の通信の前後など）
+ * 
+ * @param ms 起こしておく時間 [ms]
+ */
+void requestFullPower(uint32_t ms) {
+
+  if (!POWER_SAVE)
+    return;
+
+  uint32_t until = millis() + ms;
+  if (!_full_power || static_cast<int32_t>(until - _full_power_until) > 0)
+    _full_power_until = until;
+
+  setFullPower(true);
+}
+
+/**
+ * @brief requestFullPower() の期限が過ぎていたら、省電力の状態に戻す
+ */
+void updatePowerMode() {
+
+  if (_full_power && static_cast<int32_t>(millis() - _full_power_until) >= 0)
+    setFullPower(false);
+}
+
+CpuBoost::CpuBoost() {
+  if (POWER_SAVE && !_full_power)
+    system_update_cpu_freq(SYS_CPU_160MHZ);
+}
+
+CpuBoost::~CpuBoost() {
+  if (POWER_SAVE && !_full_power)
+    system_update_cpu_freq(SYS_CPU_80MHZ);
+}
@@ -207,6 +207,10 @@ static void reboot() {
 
   _server.stop();
 
+  // 再起動した後、時刻や送信していない envdata を引き継ぐ
+  saveCurrentTime();
+  saveWarmState();
+
   ESP.restart();
   delay(1000);
 }
@@ -311,6 +315,55 @@ static void handleBrightness() {
   }
 }
 
+static void handleDisplay() {
+
+  auto method = _server.method();
+  if (method != HTTP_GET && method != HTTP_HEAD) {
+    methodNotAllowed();
+    return;
+  }
+
+  static constexpr size_t capacity = JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(4);
+  DynamicJsonDocument     doc(capacity);
+
+  auto &cache = _buffer.getFrameCache();
+
+  doc["frame_cache"]["capacity"] = static_cast<uint32_t>(MyBuffer::TFrameCache::Capacity);
+  doc["frame_cache"]["hits"]     = cache.getHits();
+  doc["frame_cache"]["misses"]   = cache.getMisses();
+
+  // 秒の境目から、実際に表示が変わるまでのずれ
+  doc["latency"]["count"]       = _display_latency.count;
+  doc["latency"]["last_us"]     = _display_latency.last_us;
+  doc["latency"]["min_us"]      = _display_latency.min_us;
+  doc["latency"]["max_us"]      = _display_latency.max_us;
+  doc["latency"]["transmit_us"] = _display_latency.transmit_us;
+
+  // 画面を描いて commit() するまでの時間
+  auto &render = _display_render;
+  doc["render"]["count"]  = render.count;
+  doc["render"]["min_us"] = render.min_us;
+  doc["render"]["avg_us"] = render.count ? static_cast<uint32_t>(render.total_us / render.count) : 0;
+  doc["render"]["max_us"] = render.max_us;
+
+  // フレームを送り始めるまでの時間（送信そのものは SPI の割り込みで進むので、 latency.transmit_us より短い）
+  auto &transmit = _display_transmit;
+  doc["transmit"]["count"]  = transmit.count;
+  doc["transmit"]["min_us"] = transmit.min_us;
+  doc["transmit"]["avg_us"] = transmit.count ? static_cast<uint32_t>(transmit.total_us / transmit.count) : 0;
+  doc["transmit"]["max_us"] = transmit.max_us;
+
+  String json;
+  serializeJson(doc, json);
+
+  if (method == HTTP_HEAD) {
+    _server.setContentLength(json.length());
+    _server.send_P(HTTP_CODE_OK, MIME_APPLICATION_JSON, nullptr);
+  } else {
+    _server.send(HTTP_CODE_OK, FPSTR(MIME_APPLICATION_JSON), json);
+  }
+}
+
 static inline void badRequest(String message) {
   _server.send(HTTP_CODE_BAD_REQUEST, MIME_TEXT_PLAIN, message);
 }
@@ -323,6 +376,143 @@ static inline void errorWhileSave() {
   _server.send_P(HTTP_CODE_INTERNAL_SERVER_ERROR, MIME_TEXT_PLAIN, PSTR("An error occured while saving settings"));
 }
 
+/**
+ * @brief パス /profile に対するハンドラ
+ * 
+ * GET で loop() の処理ごとにかかった時間の集計を返す。POST で reset=reset を送ると、集計を捨ててから返す。
+ */
+static void handleProfile() {
+
+  auto method = _server.method();
+  if (method != HTTP_GET && method != HTTP_HEAD && method != HTTP_POST) {
+    methodNotAllowed();
+    return;
+  }
+
+  if (method == HTTP_POST) {
+    if (_server.arg("reset") != "reset") {
+      badRequest_P(PSTR("Unknown or empty params"));
+      return;
+    }
+    _profiler.reset();
+  }
+
+  static constexpr size_t bins     = LoopProfiler::HistogramBins;
+  static constexpr size_t capacity = JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(bins - 1) + JSON_OBJECT_SIZE(LOOP_PHASES_COUNT)
+                                   + LOOP_PHASES_COUNT * (JSON_OBJECT_SIZE(6) + JSON_ARRAY_SIZE(bins))
+                                   + JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(BOOT_PHASES_COUNT) + BOOT_PHASES_COUNT * JSON_OBJECT_SIZE(2);
+  DynamicJsonDocument     doc(capacity);
+
+  doc["missed_ticks"] = _profiler.getMissedTicks();
+
+  auto bounds = doc.createNestedArray("histogram_bounds_us");
+  for (size_t i = 0; i < bins - 1; i++)
+    bounds.add(LoopProfiler::HISTOGRAM_BOUNDS_US[i]);
+
+  auto phases = doc.createNestedObject("phases");
+  for (size_t i = 0; i < LOOP_PHASES_COUNT; i++) {
+    auto  phase = static_cast<LoopPhases>(i);
+    auto &stat  = _profiler.getStat(phase);
+    auto  obj   = phases.createNestedObject(LoopProfiler::getName(phase));
+
+    obj["budget_us"] = _profiler.getBudget(phase);
+    obj["count"]     = stat.count;
+    obj["overruns"]  = stat.overruns;
+    obj["max_us"]    = stat.max_us;
+    obj["mean_us"]   = stat.count ? static_cast<uint32_t>(stat.total_us / stat.count) : 0;
+
+    auto histogram = obj.createNestedArray("histogram");
+    for (auto &&n : stat.histogram)
+      histogram.add(n);
+  }
+
+  // 起動にかかった時間（ millis() の値）
+  auto boot = doc.createNestedObject("boot");
+
+  boot["time_source"]        = getTimeSourceName(getTimeSource());
+  boot["first_frame_ms"]     = _boot_metrics.first_frame_ms;
+  boot["first_frame_source"] = getTimeSourceName(_boot_metrics.first_frame_source);
+  boot["sync_ms"]            = _boot_metrics.sync_ms;
+
+  auto boot_phases = boot.createNestedObject("phases");
+  for (size_t i = 0; i < BOOT_PHASES_COUNT; i++) {
+    auto &phase = _boot_metrics.phases[i];
+    auto  obj   = boot_phases.createNestedObject(getBootPhaseName(static_cast<BootPhases>(i)));
+
+    obj["start_ms"] = phase.start_ms;
+    obj["end_ms"]   = phase.end_ms;
+  }
+
+  String json;
+  serializeJson(doc, json);
+
+  if (method == HTTP_HEAD) {
+    _server.setContentLength(json.length());
+    _server.send_P(HTTP_CODE_OK, MIME_APPLICATION_JSON, nullptr);
+  } else {
+    _server.send(HTTP_CODE_OK, FPSTR(MIME_APPLICATION_JSON), json);
+  }
+}
+
+static void handleNtp() {
+
+  auto method = _server.method();
+  if (method != HTTP_GET && method != HTTP_HEAD) {
+    methodNotAllowed();
+    return;
+  }
+
+  static constexpr size_t capacity = JSON_OBJECT_SIZE(14) + JSON_ARRAY_SIZE(NTP_MAX_SERVERS) + NTP_MAX_SERVERS * JSON_OBJECT_SIZE(6) + JSON_OBJECT_SIZE(5);
+  DynamicJsonDocument     doc(capacity);
+
+  doc["synced"]        = _discipline.isSynced();
+  doc["server"]        = getNtpServer();
+  doc["age_ms"]        = getNtpAge();
+  doc["offset_us"]     = _discipline.getOffset();
+  doc["delay_us"]      = _discipline.getDelay();
+  doc["jitter_us"]     = _discipline.getJitter();
+  doc["frequency_ppm"] = _discipline.getFrequencyPPM();
+  doc["poll_s"]        = _discipline.getPollInterval();
+  doc["samples"]       = _discipline.getSamples();
+  doc["steps"]         = _discipline.getSteps();
+  doc["spikes"]        = _discipline.getSpikes();
+  doc["no_majority"]   = getNtpNoMajority();
+
+  // サーバーごとの、直近の問い合わせの結果
+  auto servers = doc.createNestedArray("servers");
+  for (size_t i = 0; i < getNtpServerCount(); i++) {
+    auto status = getNtpServerStatus(i);
+    auto obj    = servers.createNestedObject();
+
+    obj["name"]             = status.name;
+    obj["state"]            = getNtpStateName(status.state);
+    obj["stratum"]          = status.stratum;
+    obj["offset_us"]        = status.offset_us;
+    obj["delay_us"]         = status.delay_us;
+    obj["root_distance_us"] = status.root_distance_us;
+  }
+
+  // LAN の他の時計への応答
+  auto sntp  = getSntpStats();
+  auto serve = doc.createNestedObject("responder");
+
+  serve["enabled"]            = isSntpServing();
+  serve["served"]             = sntp.served;
+  serve["dropped"]            = sntp.dropped;
+  serve["last_turnaround_us"] = sntp.last_turnaround_us;
+  serve["max_turnaround_us"]  = sntp.max_turnaround_us;
+
+  String json;
+  serializeJson(doc, json);
+
+  if (method == HTTP_HEAD) {
+    _server.setContentLength(json.length());
+    _server.send_P(HTTP_CODE_OK, MIME_APPLICATION_JSON, nullptr);
+  } else {
+    _server.send(HTTP_CODE_OK, FPSTR(MIME_APPLICATION_JSON), json);
+  }
+}
+
 static void handlePostSetting() {
 
   static const String              k_use_ambient            = "use-ambient";
@@ -353,6 +543,7 @@ static void handlePostSetting() {
     _setting.override_pane = pane;
     _buffer.setOverridePane(pane);
     _display.testMode(pane == OverridePanes::TEST);
+    startDisplayTransmit();
 
   } else if (contains(dic, "pane")) {
 
@@ -418,6 +609,20 @@ static void handlePostSetting() {
     }
 
     _setting.ntp.assign(new_ntp.cbegin(), new_ntp.cend());
+    _setting.serve_ntp = contains(dic, "serve-ntp");
+
+    if (!saveSetting()) {
+      errorWhileSave();
+      return;
+    }
+
+    reboot();
+    return;
+
+  } else if (contains(dic, "spi_calibrate")) {
+
+    // 周波数を未調整に戻し、再起動時に setupSPIClock() で調整させる
+    _setting.spi_frequency = 0;
 
     if (!saveSetting()) {
       errorWhileSave();
@@ -542,6 +747,8 @@ static void handlePostSetting() {
 void setupServer() {
 
   _updater.setup(&_server);
+  // OTA の後の再起動に備えて、書き込みが進むたびに状態を保存しておく
+  Update.onProgress([](size_t progress, size_t total) { saveWarmState(); });
 
   _server.on("/envdata", handleEnvdata);
 
@@ -552,6 +759,12 @@ void setupServer() {
 
   _server.on("/brightness", handleBrightness);
 
+  _server.on("/display", handleDisplay);
+
+  _server.on("/profile", handleProfile);
+
+  _server.on("/ntp", handleNtp);
+
   // パスに対するハンドラが定義されていない場合、FS にあるファイルを返そうとしてみる
   _server.onNotFound([]() {
     if (handleFileRead(_server.uri(), _server.method(), _server.header(IF_NONE_MATCH)))
@@ -568,6 +781,13 @@ void setupServer() {
   _server.begin();
 }
 
-void yieldServer() {
+/**
+ * @brief HTTP リクエストを処理する
+ * 
+ * @retval true クライアントと接続中
+ * @retval false 接続しているクライアントは無い
+ */
+bool yieldServer() {
   _server.handleClient();
+  return _server.getStatus() != HC_NONE;
 }
\ No newline at end of file
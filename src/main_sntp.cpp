@@ -0,0 +1,77 @@
+/**
+ * @file main_sntp.cpp
+ * @brief part of the main.cpp
+ */
+
+#include "main.h"
+#include "NtpPacket.h"
+#include "SntpResponder.h"
+#include <lwip/udp.h>
+
+//! 要求を受け付ける UDP の PCB（ nullptr なら応答していない）
+static udp_pcb *_sntp_pcb = nullptr;
+//! 要求への応答（時刻は _discipline から求める）
+static SntpResponder _sntp_responder(micros64, [](uint64_t counter) { return _discipline.now(counter); });
+
+/**
+ * @brief 要求を受け取ったときに、lwIP から呼ばれる
+ * 
+ * loop() に戻るのを待たず、受け取ったその場で応答する（時刻の書き込みと統計は SntpResponder を参照）。
+ * 応答の pbuf は先に用意しておき、送る時刻を書いてから udp_sendto() までの間を短くする。
+ * lwIP のコールバックは loop() の合間（ yield() や delay() の中）に呼ばれるので、_discipline を読んでも競合しない。
+ */
+static void receiveSntpRequest(void *arg, udp_pcb *pcb, pbuf *p, const ip_addr_t *addr, u16_t port) {
+
+  auto received_at = micros64();
+
+  uint8_t request[NtpPacket::SIZE];
+  size_t  length = pbuf_copy_partial(p, request, sizeof(request), 0);
+  pbuf_free(p);
+
+  NtpPacket::server_t server;
+  bool                synced   = getNtpReference(&server);
+  auto                response = synced ? pbuf_alloc(PBUF_TRANSPORT, NtpPacket::SIZE, PBUF_RAM) : nullptr;
+  auto                payload  = response ? static_cast<uint8_t *>(response->payload) : nullptr;
+
+  _sntp_responder.respond(request, length, received_at, synced ? &server : nullptr, payload, [&]() {
+    return udp_sendto(pcb, response, addr, port) == ERR_OK;
+  });
+
+  if (response)
+    pbuf_free(response);
+}
+
+/**
+ * @brief LAN の他の時計に、NTP (SNTP) で時刻を返し始める
+ * 
+ * 応答の Stratum は上流のサーバーの Stratum + 1。上流と同期するまでは、要求を捨てる。
+ * 
+ * @retval true 始めた（既に始めていた）
+ * @retval false UDP 123 番を使えなかった
+ */
+bool setupSntpServer() {
+
+  if (_sntp_pcb)
+    return true;
+
+  auto pcb = udp_new();
+  if (!pcb)
+    return false;
+
+  if (udp_bind(pcb, IP_ADDR_ANY, NtpPacket::PORT) != ERR_OK) {
+    udp_remove(pcb);
+    return false;
+  }
+
+  udp_recv(pcb, receiveSntpRequest, nullptr);
+  _sntp_pcb = pcb;
+  return true;
+}
+
+bool isSntpServing() {
+  return _sntp_pcb != nullptr;
+}
+
+sntp_stats_t getSntpStats() {
+  return _sntp_responder.getStats();
+}
@@ -8,7 +8,7 @@
 
 #include <Arduino.h>
 #include <MAX7219Display.h>
-#include <vector>
+#include <array>
 
 //! WiFiManager のAP名
 static constexpr char AP_NAME[] = "ESP8266Clock";
@@ -23,6 +23,47 @@ static constexpr char DEFAULT_TZCITY[] = "Tokyo";
 //! シリアルポートのボーレート
 static constexpr unsigned long SERIAL_BAUD_RATE = 115200;
 
+//! 起動時に、保存されている設定での Wi-Fi 接続を待つ時間 [ms]。過ぎたら WiFiManager に任せる（設定モードに入ることもある）
+static constexpr uint32_t WIFI_CONNECT_TIMEOUT_MS = 30000;
+//! 毎日、時刻を保存する時（地方時の 0 - 23）。電源が切れた後の、仮の時刻に使う
+//! 同期したときと、制御された再起動の前にも保存するので、フラッシュを傷めないよう 1 日 1 回にとどめる
+static constexpr uint8_t TIME_SAVE_HOUR = 3;
+
+//! 問い合わせる NTP サーバーの最大数（設定画面で入力できる数）
+static constexpr size_t NTP_MAX_SERVERS = 3;
+//! true なら、すべての NTP サーバーに一度に問い合わせ、応答を比べて一番確かなものを選ぶ（誤った時刻のサーバーを除ける）
+//! false なら 1 台ずつ問い合わせ、応答が無ければ次のサーバーに移る
+static constexpr bool NTP_PARALLEL = true;
+//! NTP サーバーの応答を待つ時間 [ms]。過ぎたら、届いた応答だけで選ぶ
+static constexpr uint32_t NTP_TIMEOUT_MS = 1000;
+//! 同期するまで、NTP サーバーに問い合わせ直す間隔 [ms]
+static constexpr uint32_t NTP_RETRY_MS = 2000;
+//! NTP サーバーの名前解決の結果を確かめる間隔 [ms]（名前解決は待たずに、結果が届いてから問い合わせる）
+static constexpr uint32_t NTP_DNS_POLL_MS = 100;
+
+//! 省電力モード。タスクの無い間は CPU をライトスリープ、モデムをスリープさせ、CPU を 80 MHz に落とす
+//! Web サーバーの応答は少し遅くなる。秒の表示の正確さと消費電流への効果は、まだ実機で測っていないので、既定では無効
+static constexpr bool POWER_SAVE = false;
+//! 省電力モードで、HTTP リクエストや envdata の送信の後、CPU (160 MHz) とモデムを起こしておく時間 [ms]
+static constexpr uint32_t POWER_SAVE_BURST_MS = 3000;
+
+//! タスクが無い間に休む最長の時間 [ms]。Web サーバーの応答はこれ以上は遅れない
+static constexpr uint32_t SCHEDULER_IDLE_SLICE_MS = POWER_SAVE ? 20 : 5;
+//! SEL ボタンの確認と画面更新の間隔 [us]
+static constexpr suseconds_t DISPLAY_TICK_US = POWER_SAVE ? 40000 : 10000;
+
+//! loop() の処理ごとの時間の予算 [us]（LoopPhases の順）。超えた回数が /profile で分かる
+static constexpr std::array<uint32_t, 8> LOOP_PHASE_BUDGETS_US = {
+    200,    // SEL ボタン
+    5000,   // 画面更新（先に描いた画面の送信を含む）
+    3000,   // 気温計測の開始・読み取り
+    100000, // envdata の送信
+    500,    // 測光
+    10000,  // Web サーバー
+    2000,   // NTP の名前解決・問い合わせ・応答の選択と反映（応答の受け取りは lwIP のコールバック）
+    1000,   // 起動の続き（WiFiManager の設定画面に入ると、ここで大きく超える）
+};
+
 //! 気温計測何回ごとに、サーバーにデータを送信するか
 static constexpr uint8_t DATA_SEND_INTERVAL = 1;
 
@@ -37,6 +78,20 @@ static constexpr int SPI_MOSI       = 13;
 static constexpr int SPI_CLK        = 14;
 static constexpr int SPI_CS_DISPLAY = 12; // MISO と被っても大丈夫
 
+//! 最後の MAX7219 の DOUT が MISO に繋がっているなら true（SPI クロック周波数の自動調整に使う）
+//! このボードでは MISO のピンを CS に使っているので false
+static constexpr bool SPI_LOOPBACK = false;
+//! SPI クロック周波数を自動調整しない（できない）ときに使う周波数
+static constexpr uint32_t SPI_FREQUENCY_FALLBACK = 100000;
+
+//! 描画済みの画面を使い回すためのキャッシュに使うメモリ（バイト）
+//! 時刻のみの画面のコロン点灯・消灯の 2 枚と、画面オフの 2 枚が入る大きさ
+static constexpr size_t FRAME_CACHE_BUDGET = 640;
+
+//! 次の秒の画面を、秒の境目の何マイクロ秒前から描いておくか
+//! DISPLAY_TICK_US と描画時間を足したより長くしておく
+static constexpr suseconds_t RENDER_AHEAD_US = 50000;
+
 // I2C で使うピン番号
 static constexpr int I2C_SDA = 4;
 static constexpr int I2C_SCK = 2;
@@ -45,17 +100,16 @@ static constexpr int I2C_SCK = 2;
 static constexpr uint8_t PORT_SEL = 5;
 
 //! ディスプレイバッファの設定
-const std::vector<MAX7219::setting_t> _buffer_settings = {
-    // {X, Y, 向き, 反転}
+using DisplayLayout = MAX7219::layout_t<
+    // <X, Y, 向き, 反転>
     // ESP8266 から見て遠い順に書く
-    {24, 0, MAX7219::Rotate::_0,   false},
-    {16, 0, MAX7219::Rotate::_0,   false},
-    {8,  0, MAX7219::Rotate::_0,   false},
-    {0,  0, MAX7219::Rotate::_0,   false},
-    {0,  8, MAX7219::Rotate::_180, false},
-    {8,  8, MAX7219::Rotate::_180, false},
-    {16, 8, MAX7219::Rotate::_180, false},
-    {24, 8, MAX7219::Rotate::_180, false},
-};
+    MAX7219::setting_t<24, 0, MAX7219::Rotate::_0,   false>,
+    MAX7219::setting_t<16, 0, MAX7219::Rotate::_0,   false>,
+    MAX7219::setting_t<8,  0, MAX7219::Rotate::_0,   false>,
+    MAX7219::setting_t<0,  0, MAX7219::Rotate::_0,   false>,
+    MAX7219::setting_t<0,  8, MAX7219::Rotate::_180, false>,
+    MAX7219::setting_t<8,  8, MAX7219::Rotate::_180, false>,
+    MAX7219::setting_t<16, 8, MAX7219::Rotate::_180, false>,
+    MAX7219::setting_t<24, 8, MAX7219::Rotate::_180, false>>;
 
 #endif // ESP8266Clock_Setting_H_
\ No newline at end of file
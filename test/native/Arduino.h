@@ -0,0 +1,125 @@
+/**
+ * @file Arduino.h
+ * @brief ホスト（env:native）で単体テストするための、Arduino API の代用品
+ *
+ * テストするコード（ハードウェアに依存しない部分）が使う分だけを用意する。
+ * micros() などの時刻は実際には進まないので、テストが mock_micros を進める。
+ */
+
+#ifndef NativeArduino_H_
+#define NativeArduino_H_
+
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/types.h>
+#include <time.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define FPSTR(p) (p)
+#define F(s) (s)
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+inline uint8_t pgm_read_byte(const void *p) {
+  return *static_cast<const uint8_t *>(p);
+}
+
+inline uint16_t pgm_read_word(const void *p) {
+  uint16_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint32_t pgm_read_dword(const void *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline void *memcpy_P(void *dest, const void *src, size_t n) {
+  return memcpy(dest, src, n);
+}
+
+inline int strcmp_P(const char *a, const char *b) {
+  return strcmp(a, b);
+}
+
+inline size_t strlen_P(const char *s) {
+  return strlen(s);
+}
+
+//! micros() などが返す時刻 [us]。テストが進める
+inline uint64_t mock_micros = 0;
+
+inline unsigned long micros() {
+  return static_cast<uint32_t>(mock_micros);
+}
+
+inline uint64_t micros64() {
+  return mock_micros;
+}
+
+inline unsigned long millis() {
+  return static_cast<uint32_t>(mock_micros / 1000);
+}
+
+inline void delay(unsigned long ms) {
+  mock_micros += ms * 1000;
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  mock_micros += us;
+}
+
+inline void yield() {}
+
+inline void pinMode(uint8_t, uint8_t) {}
+
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+inline int digitalRead(uint8_t) {
+  return HIGH;
+}
+
+/**
+ * @brief 出力を捨てる Serial
+ */
+struct NativeSerial {
+  template <class... T>
+  void print(T...) {}
+  template <class... T>
+  void println(T...) {}
+  template <class... T>
+  void printf(T...) {}
+  template <class... T>
+  void printf_P(T...) {}
+};
+
+inline NativeSerial Serial;
+
+/**
+ * @brief テストするコードの引数の型として使える分だけの String
+ */
+class String : public std::string {
+public:
+  String() {}
+  String(const char *s)
+      : std::string(s ? s : "") {}
+  String(const std::string &s)
+      : std::string(s) {}
+};
+
+#endif // NativeArduino_H_
@@ -0,0 +1,29 @@
+/**
+ * @file IPAddress.h
+ * @brief ホスト（env:native）で単体テストするための、IPAddress の代用品（IPv4 のみ）
+ */
+
+#ifndef NativeIPAddress_H_
+#define NativeIPAddress_H_
+
+#include <Arduino.h>
+
+class IPAddress {
+private:
+  uint8_t _octets[4] = {};
+
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : _octets{a, b, c, d} {}
+
+  bool isV4() const {
+    return true;
+  }
+
+  uint8_t operator[](int index) const {
+    return _octets[index];
+  }
+};
+
+#endif // NativeIPAddress_H_
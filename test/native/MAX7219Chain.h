@@ -0,0 +1,105 @@
+/**
+ * @file MAX7219Chain.h
+ * @brief ホスト（env:native）で単体テストするための、デイジーチェーン接続された MAX7219 の模型
+ */
+
+#ifndef NativeMAX7219Chain_H_
+#define NativeMAX7219Chain_H_
+
+#include <MAX7219Display.h>
+#include <SPI.h>
+#include <array>
+
+template <class TLayout>
+class MAX7219Chain;
+
+/**
+ * @brief SPI の代用品に送られたデータを読んで、各 MAX7219 のレジスタの値を再現するクラス
+ *
+ * 送信 1 回分のデータは、先頭の 2 バイトが最も遠いデバイスに届く（ MAX7219::Display と同じ並び）。
+ * LED の点灯状態は、 MAX7219::setting_t の digitRow() と digitBit() を使って、バッファ上の座標に直して読む。
+ *
+ * @tparam Devices MAX7219::Display に渡すものと同じ setting_t の並び
+ */
+template <class... Devices>
+class MAX7219Chain<MAX7219::layout_t<Devices...>> {
+public:
+  static constexpr size_t DeviceCount = sizeof...(Devices);
+
+  //! デバイスごとのレジスタの値（添字はレジスタアドレス）
+  using registers_t = std::array<uint8_t, 16>;
+
+private:
+  using expand = int[];
+
+  std::array<registers_t, DeviceCount> _registers = {};
+  size_t                               _read      = 0;     //! SPI.packets のうち、読んだ数
+  bool                                 _malformed = false; //! 大きさがデバイスの個数と合わない送信があったか
+
+  /**
+   * @brief デバイス @e TDevice の LED のうち、バッファ上の座標 (x, y) にあるものが点灯しているか
+   */
+  template <class TDevice>
+  static bool dotOf(const registers_t &registers, size_t x, size_t y) {
+
+    if (x < TDevice::topleft_x || x >= TDevice::topleft_x + 8 || y < TDevice::topleft_y || y >= TDevice::topleft_y + 8)
+      return false;
+
+    size_t lx = x - TDevice::topleft_x;
+    size_t ly = y - TDevice::topleft_y;
+    return (registers[MAX7219::OP_DIGIT7 - TDevice::digitRow(lx, ly)] >> TDevice::digitBit(lx, ly)) & 1;
+  }
+
+public:
+  /**
+   * @brief SPI.packets のうち、まだ読んでいない送信をレジスタに反映する
+   *
+   * @return 反映した送信の数
+   */
+  size_t update() {
+
+    size_t count = 0;
+    for (; _read < SPI.packets.size(); _read++, count++) {
+      auto &packet = SPI.packets[_read];
+      if (packet.size() != DeviceCount * 2) {
+        _malformed = true;
+        continue;
+      }
+      for (size_t i = 0; i < DeviceCount; i++) {
+        uint8_t address = packet[i * 2] & 0x0f;
+        if (address != MAX7219::OP_NOOP)
+          _registers[i][address] = packet[i * 2 + 1];
+      }
+    }
+    return count;
+  }
+
+  /**
+   * @brief 大きさがデバイスの個数と合わない送信があったか
+   */
+  bool isMalformed() const {
+    return _malformed;
+  }
+
+  /**
+   * @brief デバイスのレジスタの値を取得する
+   *
+   * @param device デバイスの番号（遠い方から 0, 1, ...）
+   */
+  const registers_t &getRegisters(size_t device) const {
+    return _registers[device];
+  }
+
+  /**
+   * @brief バッファ上の座標 (x, y) にある LED が点灯しているか
+   */
+  bool getDot(size_t x, size_t y) const {
+
+    bool   dot = false;
+    size_t i   = 0;
+    (void)expand{0, (dot |= dotOf<Devices>(_registers[i++], x, y), 0)...};
+    return dot;
+  }
+};
+
+#endif // NativeMAX7219Chain_H_
@@ -0,0 +1,54 @@
+/**
+ * @file SPI.h
+ * @brief ホスト（env:native）で単体テストするための、SPI の代用品
+ * 
+ * 送ったデータを、1 回の送信（ CS を LOW にしてから HIGH に戻すまで）ごとに packets に記録する。
+ * transferBytes() で受け取るデータは、テストが receive に設定した関数で作る。
+ */
+
+#ifndef NativeSPI_H_
+#define NativeSPI_H_
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+
+#define SPI_MODE0 0
+
+class SPIClass {
+public:
+  //! transferBytes() で受け取るデータを作る関数。引数は送信データ、受信データの書き込み先、バイト数
+  using TReceive = std::function<void(const uint8_t *out, uint8_t *in, uint32_t size)>;
+
+  std::vector<std::vector<uint8_t>> packets;          //! 送ったデータ（送信 1 回ごと）
+  TReceive                          receive;          //! nullptr なら 0 を受け取る
+  uint32_t                          frequency = 0;    //! setFrequency() で設定された周波数
+  bool                              record    = true; //! false なら writeBytes() で送ったデータを packets に記録しない（計測用）
+  size_t                            written   = 0;    //! writeBytes() で送ったバイト数の合計
+
+  void begin() {}
+
+  void setFrequency(uint32_t value) {
+    frequency = value;
+  }
+
+  void setDataMode(uint8_t) {}
+
+  void writeBytes(const uint8_t *data, uint32_t size) {
+    written += size;
+    if (record)
+      packets.emplace_back(data, data + size);
+  }
+
+  void transferBytes(const uint8_t *out, uint8_t *in, uint32_t size) {
+    packets.emplace_back(out, out + size);
+    if (receive)
+      receive(packets.back().data(), in, size);
+    else
+      memset(in, 0, size);
+  }
+};
+
+inline SPIClass SPI;
+
+#endif // NativeSPI_H_
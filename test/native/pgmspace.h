@@ -0,0 +1,11 @@
+/**
+ * @file pgmspace.h
+ * @brief ホスト（env:native）では、PROGMEM も RAM にあるので、Arduino.h の代用品だけで足りる
+ */
+
+#ifndef NativePgmspace_H_
+#define NativePgmspace_H_
+
+#include <Arduino.h>
+
+#endif // NativePgmspace_H_
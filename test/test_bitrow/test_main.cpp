@@ -0,0 +1,211 @@
+/**
+ * @file test_main.cpp
+ * @brief MAX7219::bitrow と BufferBase の描画の単体テスト（ pio test -e native ）
+ *
+ * bitrow の範囲操作を std::bitset で 1 ビットずつ計算した結果と比べ、
+ * BufferBase::write() / clear() / turnDot() の結果を 1 ドットずつ描いた結果と比べる。
+ */
+
+#include <MAX7219Display.h>
+#include <bitset>
+#include <random>
+#include <unity.h>
+
+static std::mt19937 _random;
+
+/**
+ * @brief bitrow の内容が std::bitset と一致するか
+ */
+template <size_t N>
+static void assertSame(const std::bitset<N> &expected, const MAX7219::bitrow<N> &actual) {
+  TEST_ASSERT_EQUAL_STRING(expected.to_string().c_str(), actual.to_string().c_str());
+}
+
+template <size_t N>
+static MAX7219::bitrow<N> toBitrow(const std::bitset<N> &bits) {
+  return MAX7219::bitrow<N>(static_cast<typename MAX7219::bitrow<N>::word_t>(bits.to_ullong()));
+}
+
+/**
+ * @brief mask() / setRange() / flipRange() を、すべての範囲について std::bitset と比べる
+ */
+template <size_t N>
+static void checkRanges() {
+
+  for (size_t start = 0; start < N; start++) {
+    for (size_t length = 0; length <= N + 1; length++) {
+      std::bitset<N> bits(_random() | static_cast<uint64_t>(_random()) << 32);
+
+      std::bitset<N> mask;
+      for (size_t i = start; i < start + length && i < N; i++)
+        mask.set(i);
+      TEST_ASSERT_EQUAL_UINT64(mask.to_ullong(), MAX7219::bitrow<N>::mask(start, length));
+
+      auto row = toBitrow(bits);
+      row.setRange(start, length, true);
+      assertSame(bits | mask, row);
+
+      row = toBitrow(bits);
+      row.setRange(start, length, false);
+      assertSame(bits & ~mask, row);
+
+      row = toBitrow(bits);
+      row.flipRange(start, length);
+      assertSame(bits ^ mask, row);
+    }
+  }
+}
+
+void test_ranges_8() {
+  checkRanges<8>();
+}
+
+void test_ranges_24() {
+  checkRanges<24>();
+}
+
+void test_ranges_32() {
+  checkRanges<32>();
+}
+
+void test_ranges_40() {
+  checkRanges<40>();
+}
+
+void test_ranges_64() {
+  checkRanges<64>();
+}
+
+/**
+ * @brief range<8>() は、はみ出した部分を 0 で埋める
+ */
+template <size_t N>
+static void checkRange8() {
+
+  for (int trial = 0; trial < 20; trial++) {
+    std::bitset<N> bits(_random() | static_cast<uint64_t>(_random()) << 32);
+    auto           row = toBitrow(bits);
+
+    for (ssize_t start = -9; start <= static_cast<ssize_t>(N) + 1; start++) {
+      std::bitset<8> expected;
+      for (ssize_t i = 0; i < 8; i++)
+        if (start + i >= 0 && start + i < static_cast<ssize_t>(N))
+          expected[i] = bits[start + i];
+      assertSame(expected, row.template range<8>(start));
+    }
+  }
+}
+
+void test_range8() {
+  checkRange8<8>();
+  checkRange8<32>();
+  checkRange8<64>();
+}
+
+/**
+ * @brief swap() は MSB と LSB を入れ替える
+ */
+template <size_t N>
+static void checkSwap() {
+
+  for (int trial = 0; trial < 50; trial++) {
+    std::bitset<N> bits(_random() | static_cast<uint64_t>(_random()) << 32);
+    std::bitset<N> expected;
+    for (size_t i = 0; i < N; i++)
+      expected[N - 1 - i] = bits[i];
+
+    auto row = toBitrow(bits);
+    row.swap();
+    assertSame(expected, row);
+  }
+}
+
+void test_swap() {
+  checkSwap<8>();
+  checkSwap<12>();
+  checkSwap<32>();
+  checkSwap<45>();
+  checkSwap<64>();
+}
+
+/**
+ * @brief BufferBase の描画の結果が、1 ドットずつ描いた結果と一致するか
+ */
+void test_buffer_drawing_matches_dots() {
+
+  MAX7219::Buffer<40, 16> buffer;
+  bool                    dots[16][40] = {};
+
+  for (int trial = 0; trial < 2000; trial++) {
+    ssize_t x = static_cast<ssize_t>(_random() % 56) - 8;
+    ssize_t y = static_cast<ssize_t>(_random() % 24) - 8;
+
+    switch (_random() % 3) {
+    case 0: {
+      // 32 ビットのデータも使う
+      size_t   width  = 1 + _random() % 32;
+      size_t   height = 1 + _random() % 8;
+      uint32_t data[8];
+      for (size_t j = 0; j < height; j++)
+        data[j] = _random();
+      buffer.write(data, x, y, width, height);
+
+      for (size_t j = 0; j < height; j++)
+        for (size_t i = 0; i < width; i++)
+          if (x + static_cast<ssize_t>(i) >= 0 && x + i < 40 && y + static_cast<ssize_t>(j) >= 0 && y + j < 16)
+            dots[y + j][x + i] = (data[j] >> (width - 1 - i)) & 1;
+      break;
+    }
+
+    case 1: {
+      size_t width  = 1 + _random() % 48;
+      size_t height = 1 + _random() % 8;
+      buffer.clear(x, y, width, height);
+
+      for (size_t j = 0; j < height; j++)
+        for (size_t i = 0; i < width; i++)
+          if (x + static_cast<ssize_t>(i) >= 0 && x + i < 40 && y + static_cast<ssize_t>(j) >= 0 && y + j < 16)
+            dots[y + j][x + i] = false;
+      break;
+    }
+
+    case 2: {
+      bool is_on = _random() & 1;
+      buffer.turnDot(is_on, x, y);
+      if (x >= 0 && x < 40 && y >= 0 && y < 16)
+        dots[y][x] = is_on;
+      break;
+    }
+    }
+  }
+
+  // getHorizontialFrom() は左端を MSB とする 8 ドット分
+  for (size_t y = 0; y < 16; y++) {
+    for (size_t x = 0; x < 40; x += 8) {
+      uint8_t expected = 0;
+      for (size_t i = 0; i < 8; i++)
+        expected = static_cast<uint8_t>(expected << 1 | dots[y][x + i]);
+      TEST_ASSERT_EQUAL_HEX8(expected, buffer.getHorizontialFrom(x, y, false));
+    }
+  }
+}
+
+void setUp() {
+  _random.seed(1);
+}
+
+void tearDown() {}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_ranges_8);
+  RUN_TEST(test_ranges_24);
+  RUN_TEST(test_ranges_32);
+  RUN_TEST(test_ranges_40);
+  RUN_TEST(test_ranges_64);
+  RUN_TEST(test_range8);
+  RUN_TEST(test_swap);
+  RUN_TEST(test_buffer_drawing_matches_dots);
+  return UNITY_END();
+}
@@ -0,0 +1,298 @@
+/**
+ * @file test_main.cpp
+ * @brief BME280Compensation の単体テスト（ pio test -e native ）
+ *
+ * データシートの計算例と、データシートの補正式（ bme280_compensate_*_int32/int64 ）の写しの両方と比べる。
+ */
+
+#include "BME280Compensation.h"
+#include <random>
+#include <string.h>
+#include <unity.h>
+
+using BME280Compensation::calibration_t;
+using BME280Compensation::sample_t;
+
+static std::mt19937 _random;
+
+/**
+ * @brief データシートの補正式の写し（変数名もデータシートのまま）
+ */
+struct Reference {
+  const calibration_t &c;
+  int32_t              t_fine = 0;
+
+  int32_t compensateT(int32_t adc_T) {
+    int32_t var1, var2, T;
+    var1   = ((((adc_T >> 3) - ((int32_t)c.dig_T1 << 1))) * ((int32_t)c.dig_T2)) >> 11;
+    var2   = (((((adc_T >> 4) - ((int32_t)c.dig_T1)) * ((adc_T >> 4) - ((int32_t)c.dig_T1))) >> 12) * ((int32_t)c.dig_T3)) >> 14;
+    t_fine = var1 + var2;
+    T      = (t_fine * 5 + 128) >> 8;
+    return T;
+  }
+
+  uint32_t compensateP(int32_t adc_P) {
+    int64_t var1, var2, p;
+    var1 = ((int64_t)t_fine) - 128000;
+    var2 = var1 * var1 * (int64_t)c.dig_P6;
+    var2 = var2 + ((var1 * (int64_t)c.dig_P5) << 17);
+    var2 = var2 + (((int64_t)c.dig_P4) << 35);
+    var1 = ((var1 * var1 * (int64_t)c.dig_P3) >> 8) + ((var1 * (int64_t)c.dig_P2) << 12);
+    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)c.dig_P1) >> 33;
+    if (var1 == 0)
+      return 0;
+    p    = 1048576 - adc_P;
+    p    = (((p << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)c.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((int64_t)c.dig_P8) * p) >> 19;
+    p    = ((p + var1 + var2) >> 8) + (((int64_t)c.dig_P7) << 4);
+    return (uint32_t)p;
+  }
+
+  uint32_t compensateH(int32_t adc_H) {
+    int32_t v_x1_u32r;
+    v_x1_u32r = (t_fine - ((int32_t)76800));
+    v_x1_u32r = (((((adc_H << 14) - (((int32_t)c.dig_H4) << 20) - (((int32_t)c.dig_H5) * v_x1_u32r)) + ((int32_t)16384)) >> 15) *
+                 (((((((v_x1_u32r * ((int32_t)c.dig_H6)) >> 10) * (((v_x1_u32r * ((int32_t)c.dig_H3)) >> 11) + ((int32_t)32768))) >> 10) + ((int32_t)2097152)) * ((int32_t)c.dig_H2) + 8192) >> 14));
+    v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * ((int32_t)c.dig_H1)) >> 4));
+    v_x1_u32r = (v_x1_u32r < 0 ? 0 : v_x1_u32r);
+    v_x1_u32r = (v_x1_u32r > 419430400 ? 419430400 : v_x1_u32r);
+    return (uint32_t)(v_x1_u32r >> 12);
+  }
+};
+
+/**
+ * @brief データシートの計算例の補正値（湿度は量産品の典型的な値）
+ */
+static calibration_t datasheetCalibration() {
+  return {27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000, 75, 362, 0, 324, 50, 30};
+}
+
+/**
+ * @brief 計測結果のレジスタ（ press_msb - hum_lsb ）の値を作る
+ */
+static void makeData(uint8_t *data, int32_t adc_P, int32_t adc_T, int32_t adc_H) {
+  data[0] = adc_P >> 12;
+  data[1] = adc_P >> 4;
+  data[2] = (adc_P & 0x0f) << 4;
+  data[3] = adc_T >> 12;
+  data[4] = adc_T >> 4;
+  data[5] = (adc_T & 0x0f) << 4;
+  data[6] = adc_H >> 8;
+  data[7] = adc_H;
+}
+
+/**
+ * @brief 補正値のレジスタの値を作る（ parseCalibration() の逆）
+ */
+static void makeCalibration(const calibration_t &c, uint8_t *calib00, uint8_t *calib26) {
+
+  const uint16_t words[] = {c.dig_T1, (uint16_t)c.dig_T2, (uint16_t)c.dig_T3, c.dig_P1, (uint16_t)c.dig_P2, (uint16_t)c.dig_P3,
+                            (uint16_t)c.dig_P4, (uint16_t)c.dig_P5, (uint16_t)c.dig_P6, (uint16_t)c.dig_P7, (uint16_t)c.dig_P8, (uint16_t)c.dig_P9};
+  for (size_t i = 0; i < 12; i++) {
+    calib00[i * 2]     = words[i];
+    calib00[i * 2 + 1] = words[i] >> 8;
+  }
+  calib00[24] = 0;
+  calib00[25] = c.dig_H1;
+
+  calib26[0] = c.dig_H2;
+  calib26[1] = c.dig_H2 >> 8;
+  calib26[2] = c.dig_H3;
+  calib26[3] = c.dig_H4 >> 4;
+  calib26[4] = (c.dig_H4 & 0x0f) | (c.dig_H5 & 0x0f) << 4;
+  calib26[5] = c.dig_H5 >> 4;
+  calib26[6] = c.dig_H6;
+}
+
+void setUp() {
+  _random.seed(1);
+}
+
+void tearDown() {}
+
+/**
+ * @brief データシートの計算例（ adc_T = 519888, adc_P = 415148 ）で、 25.08 ℃、 100653.27 Pa になる
+ */
+void test_datasheet_example() {
+
+  auto     calibration = datasheetCalibration();
+  uint8_t  data[BME280Compensation::DATA_SIZE];
+  sample_t sample;
+
+  makeData(data, 415148, 519888, 30000);
+  TEST_ASSERT_TRUE(BME280Compensation::compensate(calibration, data, &sample));
+
+  TEST_ASSERT_EQUAL_INT32(2508, sample.temperature);
+  TEST_ASSERT_DOUBLE_WITHIN(0.02, 100653.27, sample.pressure / 256.0);
+
+  Reference reference{calibration};
+  reference.compensateT(519888);
+  TEST_ASSERT_EQUAL_INT32(128422, reference.t_fine);
+  TEST_ASSERT_EQUAL_UINT32(reference.compensateP(415148), sample.pressure);
+  TEST_ASSERT_EQUAL_UINT32(reference.compensateH(30000), sample.humidity);
+}
+
+/**
+ * @brief 補正値のレジスタを読み解く（ dig_H4 と dig_H5 は 0xe5 を分け合う 12 bit の符号付き整数）
+ */
+void test_parse_calibration() {
+
+  static const calibration_t cases[] = {
+      datasheetCalibration(),
+      {65535, -32768, 32767, 1, 32767, -32768, -1, 1, -1, 0, 0, 0, 255, -32768, 255, 2047, 2047, 127},
+      {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -2048, -2048, -128},
+      {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, -1, -1, -1},
+  };
+
+  for (auto &&expected : cases) {
+    uint8_t calib00[BME280Compensation::CALIB00_SIZE];
+    uint8_t calib26[BME280Compensation::CALIB26_SIZE];
+    makeCalibration(expected, calib00, calib26);
+
+    calibration_t actual;
+    BME280Compensation::parseCalibration(calib00, calib26, &actual);
+    TEST_ASSERT_EQUAL(expected.dig_T1, actual.dig_T1);
+    TEST_ASSERT_EQUAL(expected.dig_T2, actual.dig_T2);
+    TEST_ASSERT_EQUAL(expected.dig_T3, actual.dig_T3);
+    TEST_ASSERT_EQUAL(expected.dig_P1, actual.dig_P1);
+    TEST_ASSERT_EQUAL(expected.dig_P2, actual.dig_P2);
+    TEST_ASSERT_EQUAL(expected.dig_P3, actual.dig_P3);
+    TEST_ASSERT_EQUAL(expected.dig_P4, actual.dig_P4);
+    TEST_ASSERT_EQUAL(expected.dig_P5, actual.dig_P5);
+    TEST_ASSERT_EQUAL(expected.dig_P6, actual.dig_P6);
+    TEST_ASSERT_EQUAL(expected.dig_P7, actual.dig_P7);
+    TEST_ASSERT_EQUAL(expected.dig_P8, actual.dig_P8);
+    TEST_ASSERT_EQUAL(expected.dig_P9, actual.dig_P9);
+    TEST_ASSERT_EQUAL(expected.dig_H1, actual.dig_H1);
+    TEST_ASSERT_EQUAL(expected.dig_H2, actual.dig_H2);
+    TEST_ASSERT_EQUAL(expected.dig_H3, actual.dig_H3);
+    TEST_ASSERT_EQUAL(expected.dig_H4, actual.dig_H4);
+    TEST_ASSERT_EQUAL(expected.dig_H5, actual.dig_H5);
+    TEST_ASSERT_EQUAL(expected.dig_H6, actual.dig_H6);
+  }
+}
+
+/**
+ * @brief 量産品の範囲の補正値と計測値で、データシートの補正式と一致する
+ */
+void test_matches_datasheet_formulas() {
+
+  auto base = datasheetCalibration();
+  auto vary = [](int value, int range) { return value + static_cast<int>(_random() % (2 * range + 1)) - range; };
+
+  for (int i = 0; i < 200000; i++) {
+    calibration_t c = base;
+    c.dig_T1        = vary(base.dig_T1, 1000);
+    c.dig_T2        = vary(base.dig_T2, 1000);
+    c.dig_T3        = vary(base.dig_T3, 100);
+    c.dig_P1        = vary(base.dig_P1, 2000);
+    c.dig_P2        = vary(base.dig_P2, 500);
+    c.dig_P3        = vary(base.dig_P3, 200);
+    c.dig_P4        = vary(base.dig_P4, 3000);
+    c.dig_P5        = vary(base.dig_P5, 100);
+    c.dig_P6        = vary(base.dig_P6, 7);
+    c.dig_P7        = vary(base.dig_P7, 500);
+    c.dig_P8        = vary(base.dig_P8, 1000);
+    c.dig_P9        = vary(base.dig_P9, 1000);
+    c.dig_H1        = vary(50, 50);
+    c.dig_H2        = vary(350, 50);
+    c.dig_H3        = _random() % 2 ? 0 : vary(10, 10);
+    c.dig_H4        = vary(320, 80);
+    c.dig_H5        = vary(50, 50);
+    c.dig_H6        = vary(30, 10);
+
+    int32_t adc_T = vary(500000, 100000); // およそ -40 - 85 ℃
+    int32_t adc_P = vary(400000, 200000);
+    int32_t adc_H = _random() % 0x10000;
+    // skip のときの値は避ける
+    if (adc_T == 0x80000)
+      adc_T++;
+    if (adc_P == 0x80000)
+      adc_P++;
+    if (adc_H == 0x8000)
+      adc_H++;
+
+    uint8_t  data[BME280Compensation::DATA_SIZE];
+    sample_t sample;
+    makeData(data, adc_P, adc_T, adc_H);
+    TEST_ASSERT_TRUE(BME280Compensation::compensate(c, data, &sample));
+
+    Reference reference{c};
+    TEST_ASSERT_EQUAL_INT32(reference.compensateT(adc_T), sample.temperature);
+    TEST_ASSERT_EQUAL_UINT32(reference.compensateP(adc_P), sample.pressure);
+    TEST_ASSERT_EQUAL_UINT32(reference.compensateH(adc_H), sample.humidity);
+  }
+}
+
+/**
+ * @brief 湿度は 0 - 100 % に収める
+ */
+void test_humidity_is_clamped() {
+
+  auto     calibration = datasheetCalibration();
+  uint8_t  data[BME280Compensation::DATA_SIZE];
+  sample_t sample;
+
+  makeData(data, 415148, 519888, 0);
+  TEST_ASSERT_TRUE(BME280Compensation::compensate(calibration, data, &sample));
+  TEST_ASSERT_EQUAL_UINT32(0, sample.humidity);
+
+  makeData(data, 415148, 519888, 0xffff);
+  TEST_ASSERT_TRUE(BME280Compensation::compensate(calibration, data, &sample));
+  TEST_ASSERT_EQUAL_UINT32(100 * 1024, sample.humidity);
+}
+
+/**
+ * @brief dig_P1 が 0 なら（補正値が読めていない）、 0 で割らずに気圧を 0 にする
+ */
+void test_pressure_without_calibration() {
+
+  auto     calibration = datasheetCalibration();
+  uint8_t  data[BME280Compensation::DATA_SIZE];
+  sample_t sample;
+
+  calibration.dig_P1 = 0;
+  makeData(data, 415148, 519888, 30000);
+  TEST_ASSERT_TRUE(BME280Compensation::compensate(calibration, data, &sample));
+  TEST_ASSERT_EQUAL_INT32(2508, sample.temperature);
+  TEST_ASSERT_EQUAL_UINT32(0, sample.pressure);
+}
+
+/**
+ * @brief 計測されていない値（ skip のときと、電源投入直後の初期値）があれば補正しない
+ */
+void test_skipped_values() {
+
+  auto     calibration = datasheetCalibration();
+  uint8_t  data[BME280Compensation::DATA_SIZE];
+  sample_t sample = {1, 2, 3};
+
+  makeData(data, 0x80000, 519888, 30000);
+  TEST_ASSERT_FALSE(BME280Compensation::compensate(calibration, data, &sample));
+  makeData(data, 415148, 0x80000, 30000);
+  TEST_ASSERT_FALSE(BME280Compensation::compensate(calibration, data, &sample));
+  makeData(data, 415148, 519888, 0x8000);
+  TEST_ASSERT_FALSE(BME280Compensation::compensate(calibration, data, &sample));
+
+  // 電源投入直後のレジスタ（データシートの Reset state）
+  static const uint8_t reset[] = {0x80, 0x00, 0x00, 0x80, 0x00, 0x00, 0x80, 0x00};
+  TEST_ASSERT_FALSE(BME280Compensation::compensate(calibration, reset, &sample));
+
+  // 書き換えない
+  TEST_ASSERT_EQUAL_INT32(1, sample.temperature);
+  TEST_ASSERT_EQUAL_UINT32(2, sample.pressure);
+  TEST_ASSERT_EQUAL_UINT32(3, sample.humidity);
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_datasheet_example);
+  RUN_TEST(test_parse_calibration);
+  RUN_TEST(test_matches_datasheet_formulas);
+  RUN_TEST(test_humidity_is_clamped);
+  RUN_TEST(test_pressure_without_calibration);
+  RUN_TEST(test_skipped_values);
+  return UNITY_END();
+}
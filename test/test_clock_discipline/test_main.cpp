@@ -0,0 +1,276 @@
+/**
+ * @file test_main.cpp
+ * @brief ClockDiscipline の単体テスト（ pio test -e native ）
+ *
+ * 周波数のずれたカウンタと、ゆらぎのある NTP サーバーの模型を相手に、決めた間隔で問い合わせさせて、
+ * 周波数と時刻が収束するか、外れ値やサーバーの時刻の変化をどう扱うかを調べる。
+ */
+
+#include "ClockDiscipline.h"
+#include <math.h>
+#include <random>
+#include <unity.h>
+
+static std::mt19937 _random;
+
+/**
+ * @brief 周波数のずれたカウンタと、NTP サーバーの模型
+ */
+class SimulatedClock {
+private:
+  double   _error;         //! カウンタの周波数のずれ（カウンタが遅れているなら正）
+  int64_t  _epoch;         //! カウンタが 0 のときの真の時刻 [us]
+  uint32_t _delay;         //! 往復遅延 [us]
+  uint32_t _noise;         //! 測ったずれのゆらぎの最大値 [us]
+  double   _counter = 1e6; //! カウンタ [us]
+
+public:
+  SimulatedClock(double error_ppm, uint32_t delay, uint32_t noise)
+      : _error(error_ppm * 1e-6)
+      , _epoch(INT64_C(1700000000) * 1000000)
+      , _delay(delay)
+      , _noise(noise) {}
+
+  uint64_t counter() const {
+    return static_cast<uint64_t>(_counter);
+  }
+
+  /**
+   * @brief カウンタ @c counter のときの真の時刻 [us]
+   */
+  int64_t trueTime(uint64_t counter) const {
+    return _epoch + llround(counter * (1 + _error));
+  }
+
+  /**
+   * @brief 真の時刻で @c seconds 秒進める
+   */
+  void advance(double seconds) {
+    _counter += seconds * 1e6 / (1 + _error);
+  }
+
+  /**
+   * @brief サーバーの時刻を @c us だけ変える
+   */
+  void shift(int64_t us) {
+    _epoch += us;
+  }
+
+  /**
+   * @brief 今のカウンタで問い合わせた応答を、 @c discipline に反映する
+   */
+  bool poll(ClockDiscipline &discipline) const {
+    int64_t noise = _noise > 0 ? static_cast<int64_t>(_random() % (2 * _noise + 1)) - _noise : 0;
+    return discipline.update(counter(), trueTime(counter()) + noise - discipline.now(counter()), _delay);
+  }
+
+  /**
+   * @brief 時刻の誤差 [us]
+   */
+  int64_t error(const ClockDiscipline &discipline) const {
+    return discipline.now(counter()) - trueTime(counter());
+  }
+};
+
+/**
+ * @brief discipline が求める間隔で、 @c count 回問い合わせる
+ */
+static void run(SimulatedClock &clock, ClockDiscipline &discipline, int count) {
+  for (int i = 0; i < count; i++) {
+    clock.poll(discipline);
+    clock.advance(discipline.getPollInterval());
+  }
+}
+
+void setUp() {
+  _random.seed(1);
+}
+
+void tearDown() {}
+
+/**
+ * @brief 最初の応答で時刻を合わせる（ずれは残さない）
+ */
+void test_first_update_steps() {
+
+  ClockDiscipline discipline;
+  SimulatedClock  clock(30, 20000, 0);
+
+  TEST_ASSERT_FALSE(discipline.isSynced());
+  TEST_ASSERT_TRUE(clock.poll(discipline));
+  TEST_ASSERT_TRUE(discipline.isSynced());
+  TEST_ASSERT_EQUAL(0, clock.error(discipline));
+  TEST_ASSERT_EQUAL(0, discipline.getOffset());
+  TEST_ASSERT_EQUAL(1, discipline.getSteps());
+  TEST_ASSERT_EQUAL(1, discipline.getSamples());
+  TEST_ASSERT_EQUAL_UINT32(1UL << ClockDiscipline::MIN_POLL, discipline.getPollInterval());
+}
+
+/**
+ * @brief 周波数のずれを推定して、時刻の誤差が小さいまま問い合わせの間隔を延ばす
+ */
+void test_converges() {
+
+  static const double errors[] = {0, 50, -120, 300, -450};
+
+  for (auto error : errors) {
+    ClockDiscipline discipline;
+    SimulatedClock  clock(error, 20000, 500);
+    char            message[32];
+    snprintf(message, sizeof(message), "%+.0f ppm", error);
+
+    run(clock, discipline, 60);
+
+    TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1.0, error, discipline.getFrequencyPPM(), message);
+    TEST_ASSERT_EQUAL_MESSAGE(1, discipline.getSteps(), message);
+    TEST_ASSERT_EQUAL_MESSAGE(0, discipline.getSpikes(), message);
+    TEST_ASSERT_GREATER_THAN_MESSAGE(1UL << ClockDiscipline::MIN_POLL, discipline.getPollInterval(), message);
+
+    // 間隔を延ばしても、次の問い合わせまでの間、誤差は往復遅延の半分に収まる
+    for (int i = 0; i < 20; i++) {
+      auto interval = discipline.getPollInterval();
+      for (uint32_t s = 0; s < interval; s += interval / 8) {
+        TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(10000, llabs(clock.error(discipline)), message);
+        clock.advance(interval / 8);
+      }
+      TEST_ASSERT_TRUE_MESSAGE(clock.poll(discipline), message);
+    }
+  }
+}
+
+/**
+ * @brief 周波数の補正は MAX_FREQUENCY までに制限する
+ */
+void test_frequency_is_clamped() {
+
+  ClockDiscipline discipline;
+  SimulatedClock  clock(2000, 20000, 0);
+
+  for (int i = 0; i < 20; i++) {
+    clock.poll(discipline);
+    clock.advance(64);
+  }
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, ClockDiscipline::MAX_FREQUENCY * 1e6, discipline.getFrequencyPPM());
+}
+
+/**
+ * @brief 応答を反映しても時刻は飛ばず、MAX_SLEW を超える速さでは動かない
+ */
+void test_slews_without_jumps() {
+
+  ClockDiscipline discipline;
+  SimulatedClock  clock(0, 20000, 0);
+
+  run(clock, discipline, 10);
+
+  // サーバーの時刻を、ステップしない範囲で変える
+  clock.shift(100000);
+
+  auto counter = clock.counter();
+  auto before  = discipline.now(counter);
+  TEST_ASSERT_TRUE(clock.poll(discipline));
+  TEST_ASSERT_EQUAL(before, discipline.now(counter));
+  TEST_ASSERT_EQUAL(1, discipline.getSteps());
+
+  // 1 秒ごとの進み方は、 1 秒 ± (MAX_FREQUENCY + MAX_SLEW) に収まる
+  int64_t previous = before;
+  for (int s = 1; s <= 600; s++) {
+    auto time = discipline.now(counter + s * 1000000ULL);
+    TEST_ASSERT_INT64_WITHIN(llround((ClockDiscipline::MAX_FREQUENCY + ClockDiscipline::MAX_SLEW) * 1e6) + 1, 1000000, time - previous);
+    previous = time;
+  }
+}
+
+/**
+ * @brief 1 回だけ大きくずれた応答は捨て、すぐに問い合わせ直させる
+ */
+void test_single_spike_is_ignored() {
+
+  ClockDiscipline discipline;
+  SimulatedClock  clock(25, 20000, 500);
+
+  run(clock, discipline, 30);
+  auto frequency = discipline.getFrequencyPPM();
+  TEST_ASSERT_GREATER_THAN(1UL << ClockDiscipline::MIN_POLL, discipline.getPollInterval());
+
+  auto counter = clock.counter();
+  auto before  = discipline.now(counter);
+  TEST_ASSERT_FALSE(discipline.update(counter, 1000000, 20000));
+  TEST_ASSERT_EQUAL(1, discipline.getSpikes());
+  TEST_ASSERT_EQUAL(before, discipline.now(counter));
+  TEST_ASSERT_EQUAL_UINT32(1UL << ClockDiscipline::MIN_POLL, discipline.getPollInterval());
+
+  // 次が普通の応答なら、何事もなかったように続ける
+  clock.advance(discipline.getPollInterval());
+  TEST_ASSERT_TRUE(clock.poll(discipline));
+  TEST_ASSERT_EQUAL(1, discipline.getSteps());
+  TEST_ASSERT_GREATER_THAN(1UL << ClockDiscipline::MIN_POLL, discipline.getPollInterval());
+  TEST_ASSERT_DOUBLE_WITHIN(0.5, frequency, discipline.getFrequencyPPM());
+  TEST_ASSERT_LESS_OR_EQUAL(5000, llabs(clock.error(discipline)));
+}
+
+/**
+ * @brief 大きなずれが続けば（サーバーの時刻が変わった）、時刻を飛ばし、周波数の補正は引き継ぐ
+ */
+void test_persistent_offset_steps() {
+
+  ClockDiscipline discipline;
+  SimulatedClock  clock(-80, 20000, 0);
+
+  run(clock, discipline, 30);
+  auto frequency = discipline.getFrequencyPPM();
+
+  clock.shift(-3600 * INT64_C(1000000));
+  TEST_ASSERT_FALSE(clock.poll(discipline));
+  clock.advance(discipline.getPollInterval());
+  TEST_ASSERT_TRUE(clock.poll(discipline));
+
+  TEST_ASSERT_EQUAL(2, discipline.getSteps());
+  TEST_ASSERT_EQUAL(1, discipline.getSpikes());
+  TEST_ASSERT_EQUAL(0, clock.error(discipline));
+  TEST_ASSERT_EQUAL(INT32_MIN, discipline.getOffset());
+  TEST_ASSERT_EQUAL_UINT32(1UL << ClockDiscipline::MIN_POLL, discipline.getPollInterval());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, frequency, discipline.getFrequencyPPM());
+
+  // その後も収束する
+  run(clock, discipline, 30);
+  TEST_ASSERT_DOUBLE_WITHIN(1.0, -80, discipline.getFrequencyPPM());
+  TEST_ASSERT_LESS_OR_EQUAL(2000, llabs(clock.error(discipline)));
+}
+
+/**
+ * @brief 問い合わせの間隔は、ずれが往復遅延の半分を超えれば縮め、MIN_POLL と MAX_POLL の間に収める
+ */
+void test_poll_interval_bounds() {
+
+  ClockDiscipline discipline;
+  SimulatedClock  clock(10, 2000, 0);
+
+  run(clock, discipline, 200);
+  TEST_ASSERT_EQUAL_UINT32(1UL << ClockDiscipline::MAX_POLL, discipline.getPollInterval());
+
+  // ずれが往復遅延の半分（ここでは MIN_POLL_GATE_US ）を超えると縮める
+  auto interval = discipline.getPollInterval();
+  clock.shift(5000);
+  TEST_ASSERT_TRUE(clock.poll(discipline));
+  TEST_ASSERT_EQUAL_UINT32(interval / 2, discipline.getPollInterval());
+
+  for (int i = 0; i < 20; i++) {
+    clock.shift(5000);
+    clock.poll(discipline);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1UL << ClockDiscipline::MIN_POLL, discipline.getPollInterval());
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_first_update_steps);
+  RUN_TEST(test_converges);
+  RUN_TEST(test_frequency_is_clamped);
+  RUN_TEST(test_slews_without_jumps);
+  RUN_TEST(test_single_spike_is_ignored);
+  RUN_TEST(test_persistent_offset_steps);
+  RUN_TEST(test_poll_interval_bounds);
+  return UNITY_END();
+}
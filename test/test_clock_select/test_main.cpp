@@ -0,0 +1,227 @@
+/**
+ * @file test_main.cpp
+ * @brief ClockSelect の単体テスト（ pio test -e native ）
+ *
+ * 区間の重なり方が決まっている例と、乱数で作った応答について、
+ * 過半数の区間が重なる点があるときだけ選び、選んだものが truechimer の中で一番距離が小さいかを調べる。
+ */
+
+#include "ClockSelect.h"
+#include <random>
+#include <unity.h>
+#include <vector>
+
+using ClockSelect::sample_t;
+
+static std::mt19937 _random;
+
+/**
+ * @brief ずれ @c offset で、距離が @c distance になる応答
+ */
+static sample_t makeSample(int64_t offset, uint32_t distance) {
+  return {offset, 0, distance};
+}
+
+/**
+ * @brief 点 @c x を含む区間の数
+ */
+static size_t countCovering(const std::vector<sample_t> &samples, int64_t x) {
+
+  size_t count = 0;
+  for (auto &&sample : samples) {
+    auto distance = static_cast<int64_t>(ClockSelect::getDistance(sample));
+    if (sample.offset - distance <= x && x <= sample.offset + distance)
+      count++;
+  }
+  return count;
+}
+
+/**
+ * @brief 過半数の区間が重なる点があるか（区間の端だけ調べれば足りる）
+ */
+static bool hasMajority(const std::vector<sample_t> &samples) {
+
+  for (auto &&sample : samples) {
+    auto distance = static_cast<int64_t>(ClockSelect::getDistance(sample));
+    for (auto x : {sample.offset - distance, sample.offset + distance})
+      if (countCovering(samples, x) * 2 > samples.size())
+        return true;
+  }
+  return false;
+}
+
+void setUp() {
+  _random.seed(1);
+}
+
+void tearDown() {}
+
+/**
+ * @brief 距離は、往復遅延の半分と root_distance の和
+ */
+void test_distance() {
+
+  TEST_ASSERT_EQUAL_UINT64(0, ClockSelect::getDistance({0, 0, 0}));
+  TEST_ASSERT_EQUAL_UINT64(10000 + 3000, ClockSelect::getDistance({-5, 20001, 3000}));
+  TEST_ASSERT_EQUAL_UINT64(UINT32_MAX / 2 + static_cast<uint64_t>(UINT32_MAX), ClockSelect::getDistance({0, UINT32_MAX, UINT32_MAX}));
+}
+
+/**
+ * @brief 応答がなければ選べず、1 つならそれを選ぶ
+ */
+void test_zero_and_one() {
+
+  bool truechimers[ClockSelect::MAX_SAMPLES] = {true};
+  TEST_ASSERT_EQUAL(-1, ClockSelect::select(nullptr, 0, truechimers));
+
+  sample_t one[] = {makeSample(123456, 20000)};
+  TEST_ASSERT_EQUAL(0, ClockSelect::select(one, 1, truechimers));
+  TEST_ASSERT_TRUE(truechimers[0]);
+}
+
+/**
+ * @brief 1 つだけ外れた応答は falseticker とし、残りから距離が一番小さいものを選ぶ
+ */
+void test_single_falseticker() {
+
+  sample_t samples[] = {
+      makeSample(1000, 20000),
+      makeSample(-2000, 15000),
+      makeSample(3600000000LL, 5000), // 距離は一番小さいが、1 時間ずれている
+      makeSample(500, 8000),
+  };
+  bool truechimers[4];
+
+  TEST_ASSERT_EQUAL(3, ClockSelect::select(samples, 4, truechimers));
+  TEST_ASSERT_TRUE(truechimers[0]);
+  TEST_ASSERT_TRUE(truechimers[1]);
+  TEST_ASSERT_FALSE(truechimers[2]);
+  TEST_ASSERT_TRUE(truechimers[3]);
+}
+
+/**
+ * @brief falseticker が少数なら、それらどうしが重なっていても除ける
+ */
+void test_minority_falsetickers() {
+
+  sample_t samples[] = {
+      makeSample(900000, 20000),
+      makeSample(0, 10000),
+      makeSample(910000, 20000),
+      makeSample(5000, 10000),
+      makeSample(-3000, 10000),
+  };
+  bool truechimers[5];
+
+  TEST_ASSERT_EQUAL(1, ClockSelect::select(samples, 5, truechimers));
+  TEST_ASSERT_FALSE(truechimers[0]);
+  TEST_ASSERT_TRUE(truechimers[1]);
+  TEST_ASSERT_FALSE(truechimers[2]);
+  TEST_ASSERT_TRUE(truechimers[3]);
+  TEST_ASSERT_TRUE(truechimers[4]);
+}
+
+/**
+ * @brief 過半数が重ならなければ（2 対 2 や、ばらばら）選ばない
+ */
+void test_no_majority() {
+
+  bool truechimers[4];
+
+  sample_t pair[] = {makeSample(0, 1000), makeSample(10000, 1000)};
+  TEST_ASSERT_EQUAL(-1, ClockSelect::select(pair, 2, truechimers));
+  TEST_ASSERT_FALSE(truechimers[0]);
+  TEST_ASSERT_FALSE(truechimers[1]);
+
+  sample_t split[] = {makeSample(0, 1000), makeSample(500, 1000), makeSample(100000, 1000), makeSample(100500, 1000)};
+  TEST_ASSERT_EQUAL(-1, ClockSelect::select(split, 4, truechimers));
+
+  sample_t scattered[] = {makeSample(0, 1000), makeSample(10000, 1000), makeSample(20000, 1000)};
+  TEST_ASSERT_EQUAL(-1, ClockSelect::select(scattered, 3, truechimers));
+}
+
+/**
+ * @brief 端で接する区間も、重なるとみなす
+ */
+void test_touching_intervals_overlap() {
+
+  sample_t samples[] = {makeSample(0, 1000), makeSample(2000, 1000)};
+  bool     truechimers[2];
+
+  TEST_ASSERT_EQUAL(0, ClockSelect::select(samples, 2, truechimers));
+  TEST_ASSERT_TRUE(truechimers[0]);
+  TEST_ASSERT_TRUE(truechimers[1]);
+
+  samples[1].offset++;
+  TEST_ASSERT_EQUAL(-1, ClockSelect::select(samples, 2, truechimers));
+}
+
+/**
+ * @brief MAX_SAMPLES を超える応答は使わず、truechimers にも書き込まない
+ */
+void test_count_is_limited() {
+
+  sample_t samples[ClockSelect::MAX_SAMPLES + 2];
+  bool     truechimers[ClockSelect::MAX_SAMPLES + 2];
+
+  for (size_t i = 0; i < ClockSelect::MAX_SAMPLES; i++)
+    samples[i] = makeSample(i * 100, 10000);
+  // 使われないはずの、距離が一番小さい応答
+  samples[ClockSelect::MAX_SAMPLES]     = makeSample(0, 1);
+  samples[ClockSelect::MAX_SAMPLES + 1] = makeSample(0, 1);
+  truechimers[ClockSelect::MAX_SAMPLES] = truechimers[ClockSelect::MAX_SAMPLES + 1] = false;
+
+  TEST_ASSERT_EQUAL(0, ClockSelect::select(samples, ClockSelect::MAX_SAMPLES + 2, truechimers));
+  for (size_t i = 0; i < ClockSelect::MAX_SAMPLES; i++)
+    TEST_ASSERT_TRUE(truechimers[i]);
+  TEST_ASSERT_FALSE(truechimers[ClockSelect::MAX_SAMPLES]);
+  TEST_ASSERT_FALSE(truechimers[ClockSelect::MAX_SAMPLES + 1]);
+}
+
+/**
+ * @brief 乱数の応答でも、過半数が重なる点があるときだけ選び、選んだものは truechimer の中で一番距離が小さい
+ */
+void test_random_samples() {
+
+  for (int i = 0; i < 100000; i++) {
+    size_t                count = 1 + _random() % ClockSelect::MAX_SAMPLES;
+    std::vector<sample_t> samples;
+    for (size_t j = 0; j < count; j++)
+      samples.push_back({static_cast<int64_t>(_random() % 200) - 100, static_cast<uint32_t>(_random() % 60), static_cast<uint32_t>(_random() % 30)});
+
+    bool truechimers[ClockSelect::MAX_SAMPLES];
+    int  best = ClockSelect::select(samples.data(), count, truechimers);
+
+    TEST_ASSERT_EQUAL(hasMajority(samples), best >= 0);
+    if (best < 0) {
+      for (size_t j = 0; j < count; j++)
+        TEST_ASSERT_FALSE(truechimers[j]);
+      continue;
+    }
+
+    // truechimer は過半数で、選んだものは truechimer
+    size_t truechimer_count = 0;
+    for (size_t j = 0; j < count; j++)
+      truechimer_count += truechimers[j] ? 1 : 0;
+    TEST_ASSERT_GREATER_THAN(count / 2, truechimer_count);
+    TEST_ASSERT_TRUE(truechimers[best]);
+
+    for (size_t j = 0; j < count; j++)
+      if (truechimers[j])
+        TEST_ASSERT_LESS_OR_EQUAL(ClockSelect::getDistance(samples[j]), ClockSelect::getDistance(samples[best]));
+  }
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_distance);
+  RUN_TEST(test_zero_and_one);
+  RUN_TEST(test_single_falseticker);
+  RUN_TEST(test_minority_falsetickers);
+  RUN_TEST(test_no_majority);
+  RUN_TEST(test_touching_intervals_overlap);
+  RUN_TEST(test_count_is_limited);
+  RUN_TEST(test_random_samples);
+  return UNITY_END();
+}
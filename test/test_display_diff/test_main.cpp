@@ -0,0 +1,240 @@
+/**
+ * @file test_main.cpp
+ * @brief Display::send() / sendChanged() の単体テスト（ pio test -e native ）
+ *
+ * SPI に送られたデータを MAX7219Chain で MAX7219 のレジスタに反映し、
+ * LED の点灯状態が Buffer の内容と一致するか、変化のない行・デバイスを送っていないかを調べる。
+ */
+
+#include "../native/MAX7219Chain.h"
+#include "setting.h"
+#include <MAX7219Display.h>
+#include <random>
+#include <unity.h>
+
+//! 向きと反転が混ざった並び
+using MixedLayout = MAX7219::layout_t<
+    MAX7219::setting_t<0,  0, MAX7219::Rotate::Clockwise,        true>,
+    MAX7219::setting_t<8,  0, MAX7219::Rotate::Counterclockwise, false>,
+    MAX7219::setting_t<16, 0, MAX7219::Rotate::_180,             true>,
+    MAX7219::setting_t<16, 8, MAX7219::Rotate::_0,               true>,
+    MAX7219::setting_t<8,  8, MAX7219::Rotate::Clockwise,        false>,
+    MAX7219::setting_t<0,  8, MAX7219::Rotate::Counterclockwise, true>>;
+
+/**
+ * @brief 乱数で描いたグラフィックを Buffer と参照用の配列の両方に書き込む
+ */
+template <size_t Width, size_t Height>
+class Painter {
+private:
+  std::mt19937 _random;
+
+public:
+  MAX7219::Buffer<Width, Height> buffer;
+  bool                           dots[Height][Width] = {};
+
+  explicit Painter(uint32_t seed)
+      : _random(seed) {}
+
+  void turnDot(bool is_on, ssize_t x, ssize_t y) {
+    buffer.turnDot(is_on, x, y);
+    if (x >= 0 && y >= 0 && static_cast<size_t>(x) < Width && static_cast<size_t>(y) < Height)
+      dots[y][x] = is_on;
+  }
+
+  /**
+   * @brief 乱数で 1 回描く（ドット、はみ出す矩形の塗りつぶし、消去のいずれか）
+   */
+  void paint() {
+
+    ssize_t x = static_cast<ssize_t>(_random() % (Width + 8)) - 4;
+    ssize_t y = static_cast<ssize_t>(_random() % (Height + 8)) - 4;
+
+    switch (_random() % 3) {
+    case 0:
+      turnDot(_random() & 1, x, y);
+      break;
+
+    case 1: {
+      size_t   width  = 1 + _random() % 16;
+      size_t   height = 1 + _random() % 8;
+      uint16_t data[8];
+      for (size_t j = 0; j < height; j++)
+        data[j] = static_cast<uint16_t>(_random());
+      buffer.write(data, x, y, width, height);
+
+      for (size_t j = 0; j < height; j++)
+        for (size_t i = 0; i < width; i++)
+          if (x + i < Width && y + j < Height && x + static_cast<ssize_t>(i) >= 0 && y + static_cast<ssize_t>(j) >= 0)
+            dots[y + j][x + i] = (data[j] >> (width - 1 - i)) & 1;
+      break;
+    }
+
+    case 2: {
+      size_t width  = 1 + _random() % 12;
+      size_t height = 1 + _random() % 6;
+      buffer.clear(x, y, width, height);
+
+      for (size_t j = 0; j < height; j++)
+        for (size_t i = 0; i < width; i++)
+          if (x + i < Width && y + j < Height && x + static_cast<ssize_t>(i) >= 0 && y + static_cast<ssize_t>(j) >= 0)
+            dots[y + j][x + i] = false;
+      break;
+    }
+    }
+  }
+};
+
+/**
+ * @brief LED の点灯状態が参照用の配列と一致するか
+ */
+template <class TChain, size_t Width, size_t Height>
+static void assertDots(const TChain &chain, const Painter<Width, Height> &painter) {
+
+  for (size_t y = 0; y < Height; y++)
+    for (size_t x = 0; x < Width; x++)
+      if (chain.getDot(x, y) != painter.dots[y][x]) {
+        char message[32];
+        snprintf(message, sizeof(message), "dot (%zu, %zu)", x, y);
+        TEST_FAIL_MESSAGE(message);
+      }
+}
+
+void setUp() {
+  SPI.packets.clear();
+}
+
+void tearDown() {}
+
+/**
+ * @brief send() で、全体が送られる
+ */
+template <class TLayout, size_t Width, size_t Height>
+static void checkSend(uint32_t seed) {
+
+  Painter<Width, Height>    painter(seed);
+  MAX7219::Display<TLayout> display(0, painter.buffer);
+  MAX7219Chain<TLayout>     chain;
+
+  for (int frame = 0; frame < 20; frame++) {
+    for (int i = 0; i < 10; i++)
+      painter.paint();
+
+    display.send();
+    TEST_ASSERT_EQUAL(8, chain.update());
+    assertDots(chain, painter);
+  }
+  TEST_ASSERT_FALSE(chain.isMalformed());
+}
+
+void test_send_matches_buffer() {
+  checkSend<DisplayLayout, 32, 16>(1);
+}
+
+void test_send_matches_buffer_mixed_rotation() {
+  checkSend<MixedLayout, 24, 16>(2);
+}
+
+/**
+ * @brief sendChanged() だけで更新しても、LED の点灯状態は Buffer の内容と一致する
+ */
+template <class TLayout, size_t Width, size_t Height>
+static void checkSendChanged(uint32_t seed) {
+
+  Painter<Width, Height>    painter(seed);
+  MAX7219::Display<TLayout> display(0, painter.buffer);
+  MAX7219Chain<TLayout>     chain;
+
+  display.send();
+  chain.update();
+
+  for (int frame = 0; frame < 200; frame++) {
+    for (int i = 0, n = frame % 4; i < n; i++)
+      painter.paint();
+
+    display.sendChanged();
+    chain.update();
+    assertDots(chain, painter);
+  }
+  TEST_ASSERT_FALSE(chain.isMalformed());
+}
+
+void test_send_changed_matches_buffer() {
+  checkSendChanged<DisplayLayout, 32, 16>(3);
+}
+
+void test_send_changed_matches_buffer_mixed_rotation() {
+  checkSendChanged<MixedLayout, 24, 16>(4);
+}
+
+/**
+ * @brief sendChanged() は、変化のない行を送らず、変化のないデバイスには OP_NOOP を送る
+ */
+void test_send_changed_skips_unchanged() {
+
+  MAX7219::Buffer<32, 16>         buffer;
+  MAX7219::Display<DisplayLayout> display(0, buffer);
+
+  display.send();
+  SPI.packets.clear();
+
+  // 変化なし
+  display.sendChanged();
+  TEST_ASSERT_EQUAL(0, SPI.packets.size());
+  TEST_ASSERT_EQUAL(0, display.getLastSentBytes());
+
+  // 1 ドットだけ変えると、1 行だけ送られ、そのデバイス以外は OP_NOOP
+  buffer.turnDot(true, 3, 12);
+  display.sendChanged();
+  TEST_ASSERT_EQUAL(1, SPI.packets.size());
+  TEST_ASSERT_EQUAL(16, display.getLastSentBytes());
+
+  size_t active = 0;
+  for (size_t i = 0; i < 8; i++)
+    if (SPI.packets[0][i * 2] != MAX7219::OP_NOOP)
+      active++;
+  TEST_ASSERT_EQUAL(1, active);
+  // (3, 12) は下段の左端のデバイス（遠い方から 4 番目）
+  TEST_ASSERT_NOT_EQUAL(MAX7219::OP_NOOP, SPI.packets[0][4 * 2]);
+
+  // 送った後はまた変化なし
+  SPI.packets.clear();
+  display.sendChanged();
+  TEST_ASSERT_EQUAL(0, SPI.packets.size());
+}
+
+/**
+ * @brief clearAll() の後の sendChanged() は、Buffer の内容をすべて送り直す
+ */
+void test_clear_all_resends_everything() {
+
+  Painter<32, 16>                 painter(5);
+  MAX7219::Display<DisplayLayout> display(0, painter.buffer);
+  MAX7219Chain<DisplayLayout>     chain;
+
+  for (int i = 0; i < 30; i++)
+    painter.paint();
+  display.send();
+  display.clearAll();
+  chain.update();
+
+  for (size_t y = 0; y < 16; y++)
+    for (size_t x = 0; x < 32; x++)
+      TEST_ASSERT_FALSE(chain.getDot(x, y));
+
+  display.sendChanged();
+  chain.update();
+  assertDots(chain, painter);
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_send_matches_buffer);
+  RUN_TEST(test_send_matches_buffer_mixed_rotation);
+  RUN_TEST(test_send_changed_matches_buffer);
+  RUN_TEST(test_send_changed_matches_buffer_mixed_rotation);
+  RUN_TEST(test_send_changed_skips_unchanged);
+  RUN_TEST(test_clear_all_resends_everything);
+  return UNITY_END();
+}
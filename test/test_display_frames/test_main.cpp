@@ -0,0 +1,315 @@
+/**
+ * @file test_main.cpp
+ * @brief Display::commit() / transmitStep() / transmitFrame() と、送信待ちのレジスタ書き込みの単体テスト（ pio test -e native ）
+ *
+ * SPI に送られたデータを MAX7219Chain で MAX7219 のレジスタに反映し、
+ * フレームが混ざらずに表示されるか、レジスタ書き込みが OP_NOOP の枠に詰めて送られるかを調べる。
+ */
+
+#include "../native/MAX7219Chain.h"
+#include "setting.h"
+#include <MAX7219Display.h>
+#include <random>
+#include <unity.h>
+
+using TBuffer  = MAX7219::Buffer<32, 16>;
+using TDisplay = MAX7219::Display<DisplayLayout>;
+using TChain   = MAX7219Chain<DisplayLayout>;
+
+static std::mt19937 _random;
+
+/**
+ * @brief 乱数でドットを描く
+ */
+static void paintDots(TBuffer &buffer, int count) {
+  for (int i = 0; i < count; i++)
+    buffer.turnDot(_random() & 1, _random() % 32, _random() % 16);
+}
+
+/**
+ * @brief @c src の内容を @c dest に写す（ Buffer はコピーできないので saveFrame() を使う）
+ */
+static void copyFrame(const TBuffer &src, TBuffer &dest) {
+
+  uint8_t frame[TBuffer::FrameBytes];
+  src.saveFrame(frame);
+  dest.loadFrame(frame);
+}
+
+/**
+ * @brief LED の点灯状態が @c expected の内容と一致するか
+ */
+static void assertShows(const TChain &chain, const TBuffer &expected) {
+
+  for (size_t y = 0; y < 16; y++) {
+    for (size_t x = 0; x < 32; x++) {
+      bool dot = (expected.getHorizontialFrom(x & ~7U, y, false) >> (7 - (x & 7))) & 1;
+      if (chain.getDot(x, y) != dot) {
+        char message[32];
+        snprintf(message, sizeof(message), "dot (%zu, %zu)", x, y);
+        TEST_FAIL_MESSAGE(message);
+      }
+    }
+  }
+}
+
+/**
+ * @brief 送信 1 回分のデータのうち、OP_NOOP でないデバイスの数
+ */
+static size_t countActive(const std::vector<uint8_t> &packet) {
+
+  size_t count = 0;
+  for (size_t i = 0; i < packet.size(); i += 2)
+    if ((packet[i] & 0x0f) != MAX7219::OP_NOOP)
+      count++;
+  return count;
+}
+
+void setUp() {
+  _random.seed(1);
+  SPI.packets.clear();
+}
+
+void tearDown() {}
+
+/**
+ * @brief transmitFrame() は、commit() したフレームを 1 回で送り切る
+ */
+void test_transmit_frame_sends_whole_frame() {
+
+  TBuffer  buffer;
+  TDisplay display(0, buffer);
+  TChain   chain;
+
+  for (int frame = 0; frame < 50; frame++) {
+    paintDots(buffer, 10);
+    display.commit();
+    TEST_ASSERT_TRUE(display.isTransmitting());
+
+    TEST_ASSERT_FALSE(display.transmitFrame());
+    TEST_ASSERT_FALSE(display.isTransmitting());
+    TEST_ASSERT_EQUAL(0, display.getPendingRows());
+
+    chain.update();
+    assertShows(chain, buffer);
+  }
+  TEST_ASSERT_FALSE(chain.isMalformed());
+}
+
+/**
+ * @brief transmitStep() は、変化した行だけを上から 1 行ずつ送る
+ */
+void test_transmit_step_sends_one_row_at_a_time() {
+
+  TBuffer  buffer;
+  TDisplay display(0, buffer);
+
+  display.send();
+  SPI.packets.clear();
+
+  // 上段の 1 行目と 6 行目、下段の 3 行目を変える
+  buffer.turnDot(true, 2, 1);
+  buffer.turnDot(true, 30, 6);
+  buffer.turnDot(true, 9, 11);
+  display.commit();
+
+  size_t rows = display.getPendingRows();
+  TEST_ASSERT_GREATER_THAN(0, rows);
+  TEST_ASSERT_LESS_OR_EQUAL(3, rows);
+
+  size_t steps = 0;
+  int    last  = MAX7219::OP_DIGIT7 + 1;
+  while (display.isTransmitting()) {
+    display.transmitStep();
+    steps++;
+
+    // 上の行（ OP_DIGIT7 ）から順に送る
+    auto &packet = SPI.packets.back();
+    int   digit  = 0;
+    for (size_t i = 0; i < packet.size(); i += 2)
+      if (packet[i] != MAX7219::OP_NOOP)
+        digit = packet[i];
+    TEST_ASSERT_LESS_THAN(last, digit);
+    last = digit;
+  }
+  TEST_ASSERT_EQUAL(rows, steps);
+  TEST_ASSERT_EQUAL(rows, SPI.packets.size());
+
+  // もう送るものはない
+  TEST_ASSERT_FALSE(display.transmitStep());
+  TEST_ASSERT_EQUAL(rows, SPI.packets.size());
+}
+
+/**
+ * @brief 送信を始める前の commit() は、1 つのフレームにまとめられる
+ */
+void test_commits_are_merged() {
+
+  TBuffer  buffer;
+  TDisplay display(0, buffer);
+  TChain   chain;
+
+  display.send();
+  SPI.packets.clear();
+
+  // 同じ行の、別のデバイスを変える
+  buffer.turnDot(true, 1, 0);
+  display.commit();
+  buffer.turnDot(true, 25, 0);
+  display.commit();
+  TEST_ASSERT_EQUAL(1, display.getPendingRows());
+
+  display.transmitFrame();
+  TEST_ASSERT_EQUAL(1, SPI.packets.size());
+  TEST_ASSERT_EQUAL(2, countActive(SPI.packets[0]));
+
+  chain.update();
+  assertShows(chain, buffer);
+}
+
+/**
+ * @brief 送信中に commit() したフレームは、送信中のフレームを送り切ってから送られ、混ざって表示されない
+ */
+void test_frames_do_not_tear() {
+
+  TBuffer  buffer;
+  TDisplay display(0, buffer);
+  TChain   chain;
+
+  for (int frame = 0; frame < 50; frame++) {
+    paintDots(buffer, 20);
+    display.commit();
+    TBuffer first;
+    copyFrame(buffer, first);
+
+    // 1 行送ったところで、次のフレームを commit() する
+    display.transmitStep();
+    paintDots(buffer, 20);
+    display.commit();
+
+    // 送信中のフレームの残りだけが送られる
+    bool remaining = display.transmitFrame();
+    chain.update();
+    assertShows(chain, first);
+
+    if (remaining) {
+      TEST_ASSERT_FALSE(display.transmitFrame());
+      chain.update();
+    }
+    assertShows(chain, buffer);
+  }
+}
+
+/**
+ * @brief hold() の間は、commit() したフレームを送らない
+ */
+void test_hold_and_release() {
+
+  TBuffer  buffer;
+  TDisplay display(0, buffer);
+  TChain   chain;
+
+  display.hold();
+  paintDots(buffer, 20);
+  display.commit();
+
+  TEST_ASSERT_FALSE(display.transmitStep());
+  TEST_ASSERT_EQUAL(0, SPI.packets.size());
+  TEST_ASSERT_TRUE(display.isHolding());
+
+  display.release();
+  TEST_ASSERT_FALSE(display.transmitFrame());
+  chain.update();
+  assertShows(chain, buffer);
+}
+
+/**
+ * @brief レジスタ書き込みは、送る行の OP_NOOP の枠に詰められ、同じレジスタへの書き込みは最後の値だけが送られる
+ */
+void test_commands_fill_noop_slots() {
+
+  TBuffer  buffer;
+  TDisplay display(0, buffer);
+  TChain   chain;
+
+  display.send();
+  SPI.packets.clear();
+
+  display.setIntensity(3);
+  display.setIntensity(9);
+  display.shutdownMode(false);
+  TEST_ASSERT_TRUE(display.hasPendingCommands());
+
+  // 1 デバイスだけ変化した行に、残りのデバイスの書き込みが詰められる
+  buffer.turnDot(true, 5, 2);
+  display.sendChanged();
+  TEST_ASSERT_EQUAL(8, countActive(SPI.packets.front()));
+
+  display.flush();
+  TEST_ASSERT_FALSE(display.hasPendingCommands());
+  chain.update();
+
+  // 書き込みはデバイスごとに明るさと復帰の 2 つだけで、変化したデバイスの分が 2 回の flush() に残る
+  TEST_ASSERT_EQUAL(3, SPI.packets.size());
+  for (size_t i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL(9, chain.getRegisters(i)[MAX7219::OP_INTENSITY]);
+    TEST_ASSERT_EQUAL(1, chain.getRegisters(i)[MAX7219::OP_SHUTDOWN]);
+  }
+  assertShows(chain, buffer);
+}
+
+/**
+ * @brief デバイスごとの明るさは、 transmitStep() でフレームと一緒に送られる
+ */
+void test_per_device_intensity_with_frames() {
+
+  TBuffer  buffer;
+  TDisplay display(0, buffer);
+  TChain   chain;
+
+  display.setIntensity({0, 1, 2, 3, 4, 5, 6, 7});
+  paintDots(buffer, 30);
+  display.commit();
+  display.transmitFrame();
+  display.flush();
+  chain.update();
+
+  for (size_t i = 0; i < 8; i++)
+    TEST_ASSERT_EQUAL(i, chain.getRegisters(i)[MAX7219::OP_INTENSITY]);
+  assertShows(chain, buffer);
+}
+
+/**
+ * @brief sendChanged() は、commit() したまま送っていないフレームを先に送る
+ */
+void test_send_changed_flushes_frames() {
+
+  TBuffer  buffer;
+  TDisplay display(0, buffer);
+  TChain   chain;
+
+  paintDots(buffer, 20);
+  display.commit();
+  display.hold();
+  paintDots(buffer, 20);
+  display.sendChanged();
+
+  TEST_ASSERT_FALSE(display.isTransmitting());
+  TEST_ASSERT_FALSE(display.isHolding());
+  chain.update();
+  assertShows(chain, buffer);
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_transmit_frame_sends_whole_frame);
+  RUN_TEST(test_transmit_step_sends_one_row_at_a_time);
+  RUN_TEST(test_commits_are_merged);
+  RUN_TEST(test_frames_do_not_tear);
+  RUN_TEST(test_hold_and_release);
+  RUN_TEST(test_commands_fill_noop_slots);
+  RUN_TEST(test_per_device_intensity_with_frames);
+  RUN_TEST(test_send_changed_flushes_frames);
+  return UNITY_END();
+}
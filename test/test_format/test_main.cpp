@@ -0,0 +1,236 @@
+/**
+ * @file test_main.cpp
+ * @brief formatInteger() / formatReal() / realLength() の単体テスト（ pio test -e native ）
+ *
+ * formatReal() は String(value, prec) と同じ文字列を返すはずなので、
+ * 実機の String(value, prec) で得られる文字列の表と、ESP8266 コアの dtostrf() の写しの両方と比べる。
+ */
+
+#include <MAX7219/format.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <random>
+#include <string.h>
+#include <string>
+#include <unity.h>
+
+using MAX7219::NUMBER_TEXT_SIZE;
+
+/**
+ * @brief ESP8266 コア（ core_esp8266_noniso.c ）の dtostrf() の写し。 String(value, prec) は dtostrf(value, prec + 2, prec) を使う
+ */
+static std::string referenceString(double number, uint8_t prec) {
+
+  if (isnan(number))
+    return "nan";
+  if (isinf(number))
+    return "inf";
+
+  std::string out;
+  bool        negative = false;
+  int         fillme   = prec + 2;
+  if (prec > 0)
+    fillme -= prec + 1;
+  if (number < 0.0) {
+    negative = true;
+    fillme--;
+    number = -number;
+  }
+
+  double rounding = 2.0;
+  for (uint8_t i = 0; i < prec; ++i)
+    rounding *= 10.0;
+  rounding = 1.0 / rounding;
+  number += rounding;
+
+  double tenpow     = 1.0;
+  int    digitcount = 1;
+  while (number >= 10.0 * tenpow) {
+    tenpow *= 10.0;
+    digitcount++;
+  }
+  number /= tenpow;
+  fillme -= digitcount;
+
+  while (fillme-- > 0)
+    out += ' ';
+  if (negative)
+    out += '-';
+
+  digitcount += prec;
+  while (digitcount-- > 0) {
+    int8_t digit = static_cast<int8_t>(number);
+    if (digit > 9)
+      digit = 9;
+    out += static_cast<char>('0' | digit);
+    if (digitcount == prec && prec > 0)
+      out += '.';
+    number -= digit;
+    number *= 10.0;
+  }
+  return out;
+}
+
+/**
+ * @brief formatReal() と realLength() の結果が @c expected と一致するか（入りきらない分は末尾側を比べる）
+ */
+static void assertReal(const std::string &expected, double value, uint8_t prec) {
+
+  char   buf[NUMBER_TEXT_SIZE + 1];
+  size_t length = MAX7219::formatReal(value, prec, buf);
+
+  std::string tail = expected.size() > NUMBER_TEXT_SIZE - 1 ? expected.substr(expected.size() - (NUMBER_TEXT_SIZE - 1)) : expected;
+  char        message[64];
+  snprintf(message, sizeof(message), "value %.17g, prec %u", value, prec);
+
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(tail.c_str(), buf, message);
+  TEST_ASSERT_EQUAL_MESSAGE(tail.size(), length, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.size(), MAX7219::realLength(value, prec), message);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * @brief 実機の String(value, prec) と同じ文字列になる（丸めの境目を含む）
+ */
+void test_real_matches_recorded_strings() {
+
+  static const struct {
+    double      value;
+    uint8_t     prec;
+    const char *expected;
+  } cases[] = {
+      {0, 0, " 0"},
+      {0, 2, "0.00"},
+      {-0.0, 2, "0.00"},
+      {0.5, 0, " 1"},
+      {1.5, 0, " 2"},
+      {2.5, 0, " 3"},
+      {-0.5, 0, "-1"},
+      {0.005, 2, "0.01"},
+      {0.015, 2, "0.02"},
+      {0.025, 2, "0.03"},
+      {1.005, 2, "1.00"},
+      {2.675, 2, "2.67"},
+      {9.995, 2, "10.00"},
+      {9.9949999, 2, "9.99"},
+      {99.5, 0, "100"},
+      {-99.5, 0, "-100"},
+      {999.95, 1, "1000.0"},
+      {1e-10, 2, "0.00"},
+      {-1e-10, 2, "-0.00"},
+      {-0.004, 2, "-0.00"},
+      {123456789.125, 2, "123456789.12"},
+      {21.3, 1, "21.3"},
+      {-5.25, 1, "-5.2"},
+      {1013.25, 1, "1013.2"},
+      {0.1, 6, "0.100000"},
+      {1.0 / 3, 10, "0.3333333333"},
+      {4294967296.5, 0, "4294967297"},
+      {1e15, 3, "1000000000000000.000"},
+  };
+
+  for (auto &&c : cases)
+    assertReal(c.expected, c.value, c.prec);
+}
+
+/**
+ * @brief nan と inf は、符号や桁数に関係なく 3 文字
+ */
+void test_real_special_values() {
+
+  for (uint8_t prec = 0; prec < 4; prec++) {
+    assertReal("nan", NAN, prec);
+    assertReal("nan", -NAN, prec);
+    assertReal("inf", INFINITY, prec);
+    assertReal("inf", -INFINITY, prec);
+  }
+}
+
+/**
+ * @brief buf に入りきらない数値は、末尾側だけが書き込まれる
+ */
+void test_real_too_long() {
+
+  assertReal(referenceString(1e300, 2), 1e300, 2);
+  assertReal(referenceString(-DBL_MAX, 0), -DBL_MAX, 0);
+  assertReal(referenceString(1e20, 15), 1e20, 15);
+}
+
+/**
+ * @brief 乱数の値でも dtostrf() の写しと一致する
+ */
+void test_real_matches_dtostrf() {
+
+  std::mt19937_64 random(1);
+
+  for (int i = 0; i < 100000; i++) {
+    uint8_t prec = random() % 7;
+    double  value;
+
+    switch (i % 3) {
+    case 0:
+      // 表示で使う範囲
+      value = (static_cast<int64_t>(random() % 2000001) - 1000000) / 1000.0;
+      break;
+    case 1:
+      // 丸めの境目（ 5 で終わる値）
+      value = (static_cast<int64_t>(random() % 200001) - 100000) / 10.0 + 0.05 * (random() & 1 ? 1 : -1);
+      break;
+    default:
+      // 任意のビット列（ nan、inf、非正規化数を含む）
+      uint64_t bits = random();
+      memcpy(&value, &bits, sizeof(value));
+      break;
+    }
+
+    assertReal(referenceString(value, prec), value, prec);
+  }
+}
+
+/**
+ * @brief formatInteger() は sprintf("%0*ld") と同じ文字列になる
+ */
+void test_integer_matches_sprintf() {
+
+  static const long values[] = {0, 1, -1, 9, 10, -10, 99, 100, 12345, -12345, LONG_MAX, LONG_MIN, LONG_MIN + 1, INT32_MAX, INT32_MIN};
+
+  for (long value : values) {
+    for (uint8_t zero_pad = 0; zero_pad <= NUMBER_TEXT_SIZE - 3; zero_pad++) {
+      char expected[NUMBER_TEXT_SIZE + 8];
+      snprintf(expected, sizeof(expected), "%0*ld", zero_pad, value);
+
+      char   buf[NUMBER_TEXT_SIZE];
+      size_t length = MAX7219::formatInteger(value, zero_pad, buf);
+      TEST_ASSERT_EQUAL_STRING(expected, buf);
+      TEST_ASSERT_EQUAL(strlen(expected), length);
+    }
+  }
+
+  std::mt19937_64 random(2);
+  for (int i = 0; i < 100000; i++) {
+    long    value    = static_cast<long>(random()) >> (random() % 64);
+    uint8_t zero_pad = random() % 8;
+
+    char expected[NUMBER_TEXT_SIZE + 8];
+    snprintf(expected, sizeof(expected), "%0*ld", zero_pad, value);
+
+    char buf[NUMBER_TEXT_SIZE];
+    MAX7219::formatInteger(value, zero_pad, buf);
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+  }
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_real_matches_recorded_strings);
+  RUN_TEST(test_real_special_values);
+  RUN_TEST(test_real_too_long);
+  RUN_TEST(test_real_matches_dtostrf);
+  RUN_TEST(test_integer_matches_sprintf);
+  return UNITY_END();
+}
@@ -0,0 +1,240 @@
+/**
+ * @file test_main.cpp
+ * @brief LocalClock の単体テスト（ pio test -e native ）
+ *
+ * 時刻を少しずつ進めながら、 LocalClock::now() が毎回 localtime_r() で変換した結果と一致するかを、
+ * 夏時間の切り替えの前後で調べる。タイムゾーンは実機と同じく POSIX 形式で与える（設定画面で選べる全ての地域は TZZones.h ）。
+ */
+
+#include "../native/TZZones.h"
+#include "LocalClock.h"
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+static std::mt19937 _random;
+static int64_t      _now_us;         //! 現在時刻（ UNIX 時間のマイクロ秒）
+static int64_t      _counter_offset; //! カウンタと現在時刻の差（カウンタは、現在時刻にこれを足した値の下位 32 ビット）
+
+static LocalClock makeClock() {
+  return LocalClock(
+      [](suseconds_t *usec) {
+        struct tm tm;
+        time_t    now = _now_us / 1000000;
+        *usec         = _now_us % 1000000;
+        localtime_r(&now, &tm);
+        return tm;
+      },
+      [] { return static_cast<uint32_t>(_now_us + _counter_offset); });
+}
+
+static void setTZ(const char *tz) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+/**
+ * @brief LocalClock::now() が、 localtime_r() で変換した結果と一致するか
+ */
+static void assertNow(LocalClock &clock) {
+
+  suseconds_t      usec;
+  const struct tm &actual = clock.now(&usec);
+
+  struct tm expected;
+  time_t    now = _now_us / 1000000;
+  localtime_r(&now, &expected);
+
+  char message[80];
+  strftime(message, sizeof(message), "expected %F %T %Z", &expected);
+  snprintf(message + strlen(message), sizeof(message) - strlen(message), ".%06ld", static_cast<long>(_now_us % 1000000));
+
+  TEST_ASSERT_EQUAL_MESSAGE(_now_us % 1000000, usec, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_sec, actual.tm_sec, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_min, actual.tm_min, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_hour, actual.tm_hour, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_mday, actual.tm_mday, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_mon, actual.tm_mon, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_year, actual.tm_year, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_wday, actual.tm_wday, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_yday, actual.tm_yday, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_isdst, actual.tm_isdst, message);
+}
+
+/**
+ * @brief 2024 年の、UTC からのずれが変わる時刻（を含む 1 時間の始まり）を探す
+ */
+static std::vector<time_t> findTransitions() {
+
+  std::vector<time_t> retval;
+  time_t              start = 1704067200; // 2024-01-01T00:00:00Z
+  struct tm           tm;
+
+  localtime_r(&start, &tm);
+  long offset = tm.tm_gmtoff;
+  for (time_t t = start; t < start + 366 * 86400; t += 3600) {
+    localtime_r(&t, &tm);
+    if (tm.tm_gmtoff != offset)
+      retval.push_back(t - 3600);
+    offset = tm.tm_gmtoff;
+  }
+  return retval;
+}
+
+void setUp() {
+  _random.seed(1);
+  _counter_offset = 0;
+}
+
+void tearDown() {
+  setTZ("UTC0");
+}
+
+/**
+ * @brief 夏時間の切り替えの前後を、ばらばらの間隔で進めても localtime_r() と一致する
+ */
+void test_matches_localtime_across_dst() {
+
+  static const char *zones[] = {
+      "EST5EDT,M3.2.0,M11.1.0",                       // America/New_York
+      "GMT0BST,M3.5.0/1,M10.5.0",                     // Europe/London
+      "CET-1CEST,M3.5.0,M10.5.0/3",                   // Europe/Berlin
+      "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0",         // Australia/Lord_Howe（30 分だけずれる）
+      "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45", // Pacific/Chatham（ 2:45 に切り替わる）
+      "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",             // America/Godthab（前日の時刻で切り替わる）
+  };
+
+  for (auto tz : zones) {
+    setTZ(tz);
+    auto transitions = findTransitions();
+    TEST_ASSERT_EQUAL_MESSAGE(2, transitions.size(), tz);
+
+    for (auto transition : transitions) {
+      auto   clock = makeClock();
+      size_t calls = 0;
+      size_t gaps  = 0;
+      _now_us      = (transition - 3600) * INT64_C(1000000) + _random() % 1000000;
+
+      while (_now_us < (transition + 2 * 3600) * INT64_C(1000000)) {
+        assertNow(clock);
+        calls++;
+        // 多くは 1 秒未満、時々 1 秒を超えて進める
+        if (_random() % 100 == 0) {
+          _now_us += 1000000 + _random() % 3000000;
+          gaps++;
+        } else {
+          _now_us += _random() % 1000000;
+        }
+      }
+
+      // 変換は最初と、分が変わるとき、しばらく呼ばれなかったときだけ
+      TEST_ASSERT_LESS_OR_EQUAL(1 + 3 * 60 + gaps, clock.getConversions());
+      TEST_ASSERT_LESS_THAN(calls / 10, clock.getConversions());
+    }
+  }
+}
+
+/**
+ * @brief 設定画面で選べる全ての地域（ TZZones.h ）で、切り替えの前後 2 分を localtime_r() と比べる
+ */
+void test_matches_localtime_in_every_zone() {
+
+  size_t zones_with_dst = 0;
+
+  for (auto &&zone : TZ_ZONES) {
+    setTZ(zone.posix);
+    auto transitions = findTransitions();
+    if (!transitions.empty())
+      zones_with_dst++;
+
+    for (auto transition : transitions) {
+      // 切り替えを含む 1 時間を、秒の境目の前後で 1 分ずつ刻んで探す
+      struct tm tm;
+      localtime_r(&transition, &tm);
+      long   offset = tm.tm_gmtoff;
+      time_t at     = transition;
+      while (at < transition + 3600 && (localtime_r(&at, &tm), tm.tm_gmtoff == offset))
+        at += 60;
+
+      auto clock = makeClock();
+      _now_us    = (at - 120) * INT64_C(1000000) + _random() % 1000000;
+      while (_now_us < (at + 120) * INT64_C(1000000)) {
+        assertNow(clock);
+        _now_us += _random() % 300000;
+      }
+    }
+  }
+
+  TEST_ASSERT_GREATER_THAN(0, zones_with_dst);
+}
+
+/**
+ * @brief ちょうど秒の境目でも、秒が進む
+ */
+void test_second_boundaries() {
+
+  setTZ("JST-9");
+  auto clock = makeClock();
+  _now_us    = INT64_C(1700000058) * 1000000 + 999999;
+
+  for (int i = 0; i < 200; i++) {
+    assertNow(clock);
+    _now_us += 1;
+    assertNow(clock);
+    _now_us += 999999;
+  }
+}
+
+/**
+ * @brief カウンタ（ 32 ビット）が一周しても、進み方は変わらない
+ */
+void test_counter_wraparound() {
+
+  setTZ("EST5EDT,M3.2.0,M11.1.0");
+  auto clock = makeClock();
+  // 下位 32 ビットが一周する少し前から
+  _now_us = (INT64_C(1710054000) * 1000000 | 0xFFFFFFFFLL) - 5000000;
+
+  for (int i = 0; i < 2000; i++) {
+    assertNow(clock);
+    _now_us += _random() % 20000;
+  }
+}
+
+/**
+ * @brief 時刻が補正されたら、 invalidate() の後の now() で変換し直す
+ */
+void test_invalidate_after_step() {
+
+  setTZ("CET-1CEST,M3.5.0,M10.5.0/3");
+  auto clock = makeClock();
+  _now_us    = INT64_C(1711846800) * 1000000; // 2024-03-31T01:00:00Z（夏時間の始まり）
+
+  assertNow(clock);
+  auto conversions = clock.getConversions();
+
+  // NTP で時刻を 2 時間戻す。カウンタは 0.3 秒しか進まない
+  _now_us -= 7200 * INT64_C(1000000) - 300000;
+  _counter_offset += 7200 * INT64_C(1000000);
+  clock.invalidate();
+  assertNow(clock);
+  TEST_ASSERT_EQUAL(conversions + 1, clock.getConversions());
+
+  for (int i = 0; i < 100; i++) {
+    _now_us += _random() % 500000;
+    assertNow(clock);
+  }
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_localtime_across_dst);
+  RUN_TEST(test_matches_localtime_in_every_zone);
+  RUN_TEST(test_second_boundaries);
+  RUN_TEST(test_counter_wraparound);
+  RUN_TEST(test_invalidate_after_step);
+  return UNITY_END();
+}
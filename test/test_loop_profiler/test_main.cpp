@@ -0,0 +1,211 @@
+/**
+ * @file test_main.cpp
+ * @brief LoopProfiler の単体テスト（ pio test -e native ）
+ *
+ * ヒストグラムの区間の境目、予算を超えた回数、集計を捨てたときの状態を調べる。
+ */
+
+#include "LoopProfiler.h"
+#include <random>
+#include <set>
+#include <string>
+#include <unity.h>
+
+static std::mt19937 _random;
+
+//! テストで使う予算 [us]（処理ごとに変えておく）
+static std::array<uint32_t, LOOP_PHASES_COUNT> makeBudgets() {
+
+  std::array<uint32_t, LOOP_PHASES_COUNT> budgets;
+  for (size_t i = 0; i < LOOP_PHASES_COUNT; i++)
+    budgets[i] = 1000 * (i + 1);
+  return budgets;
+}
+
+/**
+ * @brief @c us を記録したときに入るはずの区間（上限と等しい値は次の区間に入る）
+ */
+static size_t expectedBin(uint32_t us) {
+
+  for (size_t bin = 0; bin < LoopProfiler::HistogramBins - 1; bin++)
+    if (us < LoopProfiler::HISTOGRAM_BOUNDS_US[bin])
+      return bin;
+  return LoopProfiler::HistogramBins - 1;
+}
+
+void setUp() {
+  _random.seed(1);
+}
+
+void tearDown() {}
+
+/**
+ * @brief 区間の上限と等しい値は次の区間に入り、1 小さい値はその区間に入る
+ */
+void test_histogram_bin_edges() {
+
+  for (size_t bin = 0; bin < LoopProfiler::HistogramBins - 1; bin++) {
+    auto bound = LoopProfiler::HISTOGRAM_BOUNDS_US[bin];
+
+    LoopProfiler profiler(makeBudgets());
+    profiler.record(LoopPhases::DISPLAY, bound - 1);
+    profiler.record(LoopPhases::DISPLAY, bound);
+    profiler.record(LoopPhases::DISPLAY, bound);
+
+    auto &histogram = profiler.getStat(LoopPhases::DISPLAY).histogram;
+    for (size_t i = 0; i < LoopProfiler::HistogramBins; i++) {
+      uint32_t expected = (i == bin ? 1 : 0) + (i == bin + 1 ? 2 : 0);
+      TEST_ASSERT_EQUAL_UINT32(expected, histogram[i]);
+    }
+  }
+
+  // 0 は最初の区間
+  LoopProfiler profiler(makeBudgets());
+  profiler.record(LoopPhases::BUTTON, 0);
+  TEST_ASSERT_EQUAL_UINT32(1, profiler.getStat(LoopPhases::BUTTON).histogram[0]);
+}
+
+/**
+ * @brief 1 秒以上は最後の区間に入り、最長の時間と合計も 32 ビットを超えて正しく集計する
+ */
+void test_one_second_and_longer() {
+
+  LoopProfiler profiler(makeBudgets());
+  auto        &stat = profiler.getStat(LoopPhases::SERVER);
+
+  static const uint32_t values[] = {1000000, 1000001, 5000000, UINT32_MAX};
+  uint64_t              total    = 0;
+  for (auto us : values) {
+    profiler.record(LoopPhases::SERVER, us);
+    total += us;
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(1000000, LoopProfiler::HISTOGRAM_BOUNDS_US[LoopProfiler::HistogramBins - 2]);
+  TEST_ASSERT_EQUAL_UINT32(4, stat.histogram[LoopProfiler::HistogramBins - 1]);
+  TEST_ASSERT_EQUAL_UINT32(0, stat.histogram[LoopProfiler::HistogramBins - 2]);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, stat.max_us);
+  TEST_ASSERT_EQUAL_UINT64(total, stat.total_us);
+  TEST_ASSERT_EQUAL_UINT32(4, stat.overruns);
+
+  // 999999 us は 1 つ手前の区間
+  profiler.record(LoopPhases::SERVER, 999999);
+  TEST_ASSERT_EQUAL_UINT32(1, stat.histogram[LoopProfiler::HistogramBins - 2]);
+}
+
+/**
+ * @brief 予算ちょうどは超えたとみなさず、処理ごとの予算で数える
+ */
+void test_overruns_against_budget() {
+
+  auto         budgets = makeBudgets();
+  LoopProfiler profiler(budgets);
+
+  for (size_t i = 0; i < LOOP_PHASES_COUNT; i++) {
+    auto phase = static_cast<LoopPhases>(i);
+    TEST_ASSERT_EQUAL_UINT32(budgets[i], profiler.getBudget(phase));
+
+    profiler.record(phase, budgets[i] - 1);
+    profiler.record(phase, budgets[i]);
+    profiler.record(phase, budgets[i] + 1);
+
+    auto &stat = profiler.getStat(phase);
+    TEST_ASSERT_EQUAL_UINT32(3, stat.count);
+    TEST_ASSERT_EQUAL_UINT32(1, stat.overruns);
+    TEST_ASSERT_EQUAL_UINT32(budgets[i] + 1, stat.max_us);
+    TEST_ASSERT_EQUAL_UINT64(3 * static_cast<uint64_t>(budgets[i]), stat.total_us);
+  }
+}
+
+/**
+ * @brief 乱数の時間でも、区間・回数・最長・合計が、素直に数えた結果と一致し、ほかの処理には影響しない
+ */
+void test_random_values() {
+
+  LoopProfiler profiler(makeBudgets());
+
+  std::array<LoopProfiler::phase_stat_t, LOOP_PHASES_COUNT> expected = {};
+  auto                                                      budgets  = makeBudgets();
+
+  for (int i = 0; i < 100000; i++) {
+    size_t   index = _random() % LOOP_PHASES_COUNT;
+    uint32_t us    = _random() >> (_random() % 32);
+    profiler.record(static_cast<LoopPhases>(index), us);
+
+    auto &stat = expected[index];
+    stat.count++;
+    stat.total_us += us;
+    stat.max_us = std::max(stat.max_us, us);
+    stat.overruns += us > budgets[index] ? 1 : 0;
+    stat.histogram[expectedBin(us)]++;
+  }
+
+  for (size_t i = 0; i < LOOP_PHASES_COUNT; i++) {
+    auto &actual = profiler.getStat(static_cast<LoopPhases>(i));
+    TEST_ASSERT_EQUAL_UINT32(expected[i].count, actual.count);
+    TEST_ASSERT_EQUAL_UINT32(expected[i].overruns, actual.overruns);
+    TEST_ASSERT_EQUAL_UINT32(expected[i].max_us, actual.max_us);
+    TEST_ASSERT_EQUAL_UINT64(expected[i].total_us, actual.total_us);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected[i].histogram.data(), actual.histogram.data(), LoopProfiler::HistogramBins);
+  }
+}
+
+/**
+ * @brief reset() で集計と遅れた回数は 0 に戻り、予算は残る
+ */
+void test_reset() {
+
+  auto         budgets = makeBudgets();
+  LoopProfiler profiler(budgets);
+
+  for (size_t i = 0; i < LOOP_PHASES_COUNT; i++)
+    profiler.record(static_cast<LoopPhases>(i), 2000000);
+  profiler.countMissedTick();
+  profiler.countMissedTick();
+  TEST_ASSERT_EQUAL_UINT32(2, profiler.getMissedTicks());
+
+  profiler.reset();
+
+  TEST_ASSERT_EQUAL_UINT32(0, profiler.getMissedTicks());
+  for (size_t i = 0; i < LOOP_PHASES_COUNT; i++) {
+    auto  phase = static_cast<LoopPhases>(i);
+    auto &stat  = profiler.getStat(phase);
+    TEST_ASSERT_EQUAL_UINT32(0, stat.count);
+    TEST_ASSERT_EQUAL_UINT32(0, stat.overruns);
+    TEST_ASSERT_EQUAL_UINT32(0, stat.max_us);
+    TEST_ASSERT_EQUAL_UINT64(0, stat.total_us);
+    for (auto n : stat.histogram)
+      TEST_ASSERT_EQUAL_UINT32(0, n);
+    TEST_ASSERT_EQUAL_UINT32(budgets[i], profiler.getBudget(phase));
+  }
+
+  // reset() の後も、最初から数え直せる
+  profiler.record(LoopPhases::SENSOR, 50);
+  TEST_ASSERT_EQUAL_UINT32(1, profiler.getStat(LoopPhases::SENSOR).count);
+  TEST_ASSERT_EQUAL_UINT32(50, profiler.getStat(LoopPhases::SENSOR).max_us);
+  TEST_ASSERT_EQUAL_UINT32(1, profiler.getStat(LoopPhases::SENSOR).histogram[0]);
+}
+
+/**
+ * @brief すべての処理に、空でなく重ならない名前がある（ /profile の JSON のキー）
+ */
+void test_names() {
+
+  std::set<std::string> names;
+  for (size_t i = 0; i < LOOP_PHASES_COUNT; i++) {
+    std::string name = LoopProfiler::getName(static_cast<LoopPhases>(i));
+    TEST_ASSERT_FALSE(name.empty());
+    TEST_ASSERT_TRUE(names.insert(name).second);
+  }
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_histogram_bin_edges);
+  RUN_TEST(test_one_second_and_longer);
+  RUN_TEST(test_overruns_against_budget);
+  RUN_TEST(test_random_values);
+  RUN_TEST(test_reset);
+  RUN_TEST(test_names);
+  return UNITY_END();
+}
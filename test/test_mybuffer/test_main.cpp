@@ -0,0 +1,152 @@
+/**
+ * @file test_main.cpp
+ * @brief MyBuffer::update() の単体テスト（ pio test -e native ）
+ *
+ * 入力が変わったウィジェットだけを描き直した結果（と、キャッシュから戻した画面）が、
+ * 毎回新しい MyBuffer に画面全体を描いた結果と一致するかを、時刻を進めながら調べる。
+ */
+
+#include "display/MyBuffer.h"
+#include <memory>
+#include <random>
+#include <unity.h>
+
+static std::mt19937 _random;
+
+/**
+ * @brief 新しい MyBuffer に、同じ設定・入力で画面全体を描いたものと比べる
+ */
+static void assertSameAsFullRender(const MyBuffer &buffer, const struct tm &tm, suseconds_t us, const envdata_t &envData, IPAddress *addr) {
+
+  auto full = std::unique_ptr<MyBuffer>(new MyBuffer());
+  full->setPane(buffer.getPane());
+  full->setOverridePane(buffer.getOverridePane());
+  full->setSynced(buffer.isSynced());
+  full->update(tm, us, envData, addr);
+
+  uint8_t expected[MyBufferStorage::FrameBytes];
+  uint8_t actual[MyBufferStorage::FrameBytes];
+  full->saveFrame(expected);
+  buffer.saveFrame(actual);
+
+  char message[64];
+  strftime(message, sizeof(message), "%F %T", &tm);
+  snprintf(message + strlen(message), sizeof(message) - strlen(message), ".%06ld pane %u", static_cast<long>(us), static_cast<unsigned>(buffer.getPane()));
+  TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, actual, sizeof(expected), message);
+}
+
+void setUp() {
+  _random.seed(1);
+}
+
+void tearDown() {}
+
+/**
+ * @brief 画面を切り替えながら時刻を進めても、描き直した結果は画面全体を描いた結果と一致する
+ */
+void test_incremental_matches_full_render() {
+
+  static const Panes panes[] = {Panes::DATE_TIME, Panes::TEMP_HUMI_TIME, Panes::PRES_TIME, Panes::TIME, Panes::IP_ADDR,
+                                Panes::WELCOME, Panes::REQUIRE_SETTING, Panes::SYNCING_TIME, Panes::CONNECT_FAILED};
+
+  auto        buffer  = std::unique_ptr<MyBuffer>(new MyBuffer());
+  time_t      now     = 1700000000;
+  suseconds_t us      = 0;
+  envdata_t   envData = {};
+  IPAddress   addr(192, 168, 1, 23);
+
+  buffer->setPane(Panes::DATE_TIME);
+
+  for (int step = 0; step < 20000; step++) {
+
+    // 多くは 0.1 秒ずつ進め、時々大きく進める（分・時・日の繰り上がり）
+    switch (_random() % 100) {
+    case 0:
+      now += _random() % 100000;
+      break;
+    case 1:
+      now += 3600 - now % 3600 - 1;
+      break;
+    default:
+      us += 100000;
+      if (us >= 1000000) {
+        us -= 1000000;
+        now++;
+      }
+      break;
+    }
+
+    // 時々、計測値や画面・設定を変える
+    switch (_random() % 200) {
+    case 0:
+      envData = {now, (static_cast<int>(_random() % 800) - 200) / 10.0f, (_random() % 1000) / 10.0f, 950 + (_random() % 1000) / 10.0f};
+      break;
+    case 1:
+      envData = {};
+      break;
+    case 2:
+    case 3:
+      buffer->setPane(panes[_random() % (sizeof(panes) / sizeof(panes[0]))]);
+      break;
+    case 4:
+      buffer->setOverridePane(buffer->getOverridePane() == OverridePanes::OFF ? OverridePanes::NORMAL : OverridePanes::OFF);
+      break;
+    case 5:
+      buffer->setSynced(!buffer->isSynced());
+      break;
+    case 6:
+      addr = IPAddress(_random(), _random(), _random(), _random());
+      break;
+    }
+
+    struct tm tm;
+    gmtime_r(&now, &tm);
+
+    bool required = buffer->isRequireUpdate(tm, us, envData, &addr);
+    if (required)
+      buffer->update(tm, us, envData, &addr);
+
+    assertSameAsFullRender(*buffer, tm, us, envData, &addr);
+
+    // 描き直しが要らないと言われたら、本当に要らない
+    if (!required) {
+      auto    before = std::unique_ptr<uint8_t[]>(new uint8_t[MyBufferStorage::FrameBytes]);
+      uint8_t after[MyBufferStorage::FrameBytes];
+      buffer->saveFrame(before.get());
+      buffer->update(tm, us, envData, &addr);
+      buffer->saveFrame(after);
+      TEST_ASSERT_EQUAL_MEMORY(before.get(), after, sizeof(after));
+    }
+  }
+
+  // 時刻のみの画面は、キャッシュから戻しているはず
+  TEST_ASSERT_GREATER_THAN(0, buffer->getFrameCache().getHits());
+}
+
+/**
+ * @brief 入力が変わらなければ、 isRequireUpdate() は false を返す
+ */
+void test_no_update_without_change() {
+
+  auto      buffer  = std::unique_ptr<MyBuffer>(new MyBuffer());
+  time_t    now     = 1700000000;
+  envdata_t envData = {now, 21.5f, 40.0f, 1013.0f};
+  struct tm tm;
+  gmtime_r(&now, &tm);
+
+  buffer->setPane(Panes::TEMP_HUMI_TIME);
+  TEST_ASSERT_TRUE(buffer->isRequireUpdate(tm, 0, envData, nullptr));
+  buffer->update(tm, 0, envData, nullptr);
+  TEST_ASSERT_FALSE(buffer->isRequireUpdate(tm, 0, envData, nullptr));
+
+  envData.temperature = 21.6f;
+  TEST_ASSERT_TRUE(buffer->isRequireUpdate(tm, 0, envData, nullptr));
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_incremental_matches_full_render);
+  RUN_TEST(test_no_update_without_change);
+  return UNITY_END();
+}
@@ -0,0 +1,313 @@
+/**
+ * @file test_main.cpp
+ * @brief NtpPacket の単体テスト（ pio test -e native ）
+ *
+ * タイムスタンプと短い形式の読み書き、makeResponse() が作る応答、
+ * クライアントが応答を受け付けるかどうかの判定（ isSyncedResponse() / isResponseTo() ）を調べる。
+ */
+
+#include "NtpPacket.h"
+#include <random>
+#include <string.h>
+#include <unity.h>
+
+static std::mt19937_64 _random;
+
+//! 1900/1/1 から 1970/1/1 までの秒数
+static constexpr int64_t UNIX_EPOCH = 2208988800LL;
+
+/**
+ * @brief クライアントの要求を作る（ sendNtpRequest() と同じ）
+ */
+static void makeRequest(uint8_t *request, int64_t transmit_time) {
+  memset(request, 0, NtpPacket::SIZE);
+  request[0] = 0x23; // LI = 0, VN = 4, Mode = 3 (client)
+  request[2] = 6;    // Poll
+  NtpPacket::writeTimestamp(request + NtpPacket::TRANSMIT_TIME, transmit_time);
+}
+
+static NtpPacket::server_t makeServer() {
+  return {2, -10, {192, 168, 1, 1}, INT64_C(1700000000123456), 12345, 6789};
+}
+
+void setUp() {
+  _random.seed(1);
+}
+
+void tearDown() {}
+
+/**
+ * @brief 32 ビットの値は、ネットワークバイトオーダーで読み書きする
+ */
+void test_uint32_is_big_endian() {
+
+  uint8_t buf[4];
+  NtpPacket::writeUint32(buf, 0x12345678);
+  TEST_ASSERT_EQUAL_HEX8(0x12, buf[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x34, buf[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x56, buf[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x78, buf[3]);
+  TEST_ASSERT_EQUAL_HEX32(0x12345678, NtpPacket::readUint32(buf));
+
+  NtpPacket::writeUint32(buf, 0xfedcba98);
+  TEST_ASSERT_EQUAL_HEX32(0xfedcba98, NtpPacket::readUint32(buf));
+}
+
+/**
+ * @brief タイムスタンプは 1900 年からの秒と 2^-32 秒単位の端数
+ */
+void test_timestamp_known_values() {
+
+  uint8_t buf[8];
+
+  // 1970/1/1 00:00:00.5
+  NtpPacket::writeTimestamp(buf, 500000);
+  TEST_ASSERT_EQUAL_HEX32(0x83aa7e80, NtpPacket::readUint32(buf));
+  TEST_ASSERT_EQUAL_HEX32(0x80000000, NtpPacket::readUint32(buf + 4));
+  TEST_ASSERT_EQUAL_INT64(500000, NtpPacket::readTimestamp(buf));
+
+  // 1969/12/31 23:59:59.75（負の時刻）
+  NtpPacket::writeTimestamp(buf, -250000);
+  TEST_ASSERT_EQUAL_HEX32(0x83aa7e7f, NtpPacket::readUint32(buf));
+  TEST_ASSERT_EQUAL_HEX32(0xc0000000, NtpPacket::readUint32(buf + 4));
+  TEST_ASSERT_EQUAL_INT64(-250000, NtpPacket::readTimestamp(buf));
+}
+
+/**
+ * @brief 2036 年（秒が一周する）以降も読み書きできる
+ */
+void test_timestamp_era_rollover() {
+
+  uint8_t buf[8];
+  int64_t rollover = (INT64_C(0x100000000) - UNIX_EPOCH) * 1000000; // 2036/2/7 06:28:16
+
+  NtpPacket::writeTimestamp(buf, rollover - 1000000);
+  TEST_ASSERT_EQUAL_HEX32(0xffffffff, NtpPacket::readUint32(buf));
+  TEST_ASSERT_EQUAL_INT64(rollover - 1000000, NtpPacket::readTimestamp(buf));
+
+  NtpPacket::writeTimestamp(buf, rollover);
+  TEST_ASSERT_EQUAL_HEX32(0x00000000, NtpPacket::readUint32(buf));
+  TEST_ASSERT_EQUAL_INT64(rollover, NtpPacket::readTimestamp(buf));
+
+  NtpPacket::writeTimestamp(buf, rollover + 86400 * INT64_C(1000000));
+  TEST_ASSERT_EQUAL_INT64(rollover + 86400 * INT64_C(1000000), NtpPacket::readTimestamp(buf));
+}
+
+/**
+ * @brief 書いたタイムスタンプを読むと、元の時刻に戻る（ 1968 年から 2104 年まで）
+ */
+void test_timestamp_round_trip() {
+
+  uint8_t buf[8];
+  int64_t begin = (INT64_C(0x80000000) - UNIX_EPOCH) * 1000000;
+  int64_t end   = (INT64_C(0x180000000) - UNIX_EPOCH) * 1000000;
+
+  for (int i = 0; i < 1000000; i++) {
+    int64_t time = begin + static_cast<int64_t>(_random() % static_cast<uint64_t>(end - begin));
+    NtpPacket::writeTimestamp(buf, time);
+    TEST_ASSERT_EQUAL_INT64(time, NtpPacket::readTimestamp(buf));
+  }
+
+  // 端数の全ての値
+  for (int64_t usec = 0; usec < 1000000; usec++) {
+    NtpPacket::writeTimestamp(buf, INT64_C(1700000000) * 1000000 + usec);
+    TEST_ASSERT_EQUAL_INT64(INT64_C(1700000000) * 1000000 + usec, NtpPacket::readTimestamp(buf));
+  }
+}
+
+/**
+ * @brief 短い形式は 16.16 固定小数点の秒で、読み書きの誤差は 1 単位（約 15 us）以内
+ */
+void test_short_format() {
+
+  uint8_t buf[4];
+
+  NtpPacket::writeShort(buf, 1000000);
+  TEST_ASSERT_EQUAL_HEX32(0x00010000, NtpPacket::readUint32(buf));
+  TEST_ASSERT_EQUAL_UINT32(1000000, NtpPacket::readShort(buf));
+
+  NtpPacket::writeShort(buf, 500000);
+  TEST_ASSERT_EQUAL_HEX32(0x00008000, NtpPacket::readUint32(buf));
+
+  NtpPacket::writeUint32(buf, 0x00000001);
+  TEST_ASSERT_EQUAL_UINT32(15, NtpPacket::readShort(buf)); // 15.26 us
+
+  for (int i = 0; i < 100000; i++) {
+    uint32_t us = _random() % 60000000;
+    NtpPacket::writeShort(buf, us);
+    TEST_ASSERT_UINT32_WITHIN(15, us, NtpPacket::readShort(buf));
+  }
+}
+
+/**
+ * @brief 応答は、要求の Transmit Timestamp を Originate Timestamp として返し、サーバーの状態を載せる
+ */
+void test_make_response() {
+
+  uint8_t request[NtpPacket::SIZE];
+  uint8_t response[NtpPacket::SIZE];
+  auto    server = makeServer();
+
+  makeRequest(request, INT64_C(1700000000) * 1000000 + 250000);
+  memset(response, 0xaa, sizeof(response));
+  TEST_ASSERT_TRUE(NtpPacket::makeResponse(request, sizeof(request), server, INT64_C(1700000000) * 1000000 + 260000, response));
+
+  TEST_ASSERT_EQUAL_HEX8(0x24, response[0]); // LI = 0, VN = 4, Mode = 4 (server)
+  TEST_ASSERT_EQUAL(2, response[1]);
+  TEST_ASSERT_EQUAL(6, response[2]);
+  TEST_ASSERT_EQUAL(-10, static_cast<int8_t>(response[3]));
+  TEST_ASSERT_UINT32_WITHIN(15, 12345, NtpPacket::readShort(response + NtpPacket::ROOT_DELAY));
+  TEST_ASSERT_UINT32_WITHIN(15, 6789, NtpPacket::readShort(response + NtpPacket::ROOT_DISPERSION));
+  TEST_ASSERT_EQUAL_MEMORY(server.reference_id, response + NtpPacket::REFERENCE_ID, 4);
+  TEST_ASSERT_EQUAL_INT64(server.reference_time, NtpPacket::readTimestamp(response + NtpPacket::REFERENCE_TIME));
+  TEST_ASSERT_EQUAL_MEMORY(request + NtpPacket::TRANSMIT_TIME, response + NtpPacket::ORIGIN_TIME, 8);
+  TEST_ASSERT_EQUAL_INT64(INT64_C(1700000000) * 1000000 + 260000, NtpPacket::readTimestamp(response + NtpPacket::RECEIVE_TIME));
+
+  // Transmit Timestamp は、送る直前に書き込むので空けておく
+  static const uint8_t zeros[8] = {};
+  TEST_ASSERT_EQUAL_MEMORY(zeros, response + NtpPacket::TRANSMIT_TIME, 8);
+}
+
+/**
+ * @brief 応答の版は要求に合わせ、クライアントの要求でないものや短すぎるものには応答しない
+ */
+void test_make_response_rejects() {
+
+  uint8_t request[NtpPacket::SIZE];
+  uint8_t response[NtpPacket::SIZE];
+  auto    server = makeServer();
+
+  for (uint8_t version = 0; version < 8; version++) {
+    for (uint8_t mode = 0; mode < 8; mode++) {
+      makeRequest(request, 1);
+      request[0] = version << 3 | mode;
+
+      bool expected = mode == 3 && version >= 1 && version <= 4;
+      TEST_ASSERT_EQUAL(expected, NtpPacket::makeResponse(request, sizeof(request), server, 2, response));
+      if (expected)
+        TEST_ASSERT_EQUAL_HEX8(version << 3 | 4, response[0]);
+    }
+  }
+
+  makeRequest(request, 1);
+  TEST_ASSERT_FALSE(NtpPacket::makeResponse(request, NtpPacket::SIZE - 1, server, 2, response));
+}
+
+/**
+ * @brief クライアントは、同期済みのサーバーからの応答だけを受け付ける
+ */
+void test_synced_response() {
+
+  uint8_t request[NtpPacket::SIZE];
+  uint8_t response[NtpPacket::SIZE];
+  auto    server = makeServer();
+
+  makeRequest(request, 1);
+  NtpPacket::makeResponse(request, sizeof(request), server, 2, response);
+  TEST_ASSERT_TRUE(NtpPacket::isSyncedResponse(response, sizeof(response)));
+  TEST_ASSERT_FALSE(NtpPacket::isSyncedResponse(response, sizeof(response) - 1));
+
+  // LI = 3（同期していない）
+  uint8_t packet[NtpPacket::SIZE];
+  for (int leap = 0; leap < 4; leap++) {
+    memcpy(packet, response, sizeof(packet));
+    packet[0] = (packet[0] & 0x3f) | leap << 6;
+    TEST_ASSERT_EQUAL(leap != 3, NtpPacket::isSyncedResponse(packet, sizeof(packet)));
+  }
+
+  // Mode = 4 (server) だけ
+  for (int mode = 0; mode < 8; mode++) {
+    memcpy(packet, response, sizeof(packet));
+    packet[0] = (packet[0] & 0xf8) | mode;
+    TEST_ASSERT_EQUAL(mode == 4, NtpPacket::isSyncedResponse(packet, sizeof(packet)));
+  }
+
+  // Stratum 0 (Kiss-o'-Death) と 16 以上（同期していない）
+  for (int stratum = 0; stratum < 256; stratum++) {
+    memcpy(packet, response, sizeof(packet));
+    packet[1] = stratum;
+    TEST_ASSERT_EQUAL(stratum >= 1 && stratum <= 15, NtpPacket::isSyncedResponse(packet, sizeof(packet)));
+  }
+}
+
+/**
+ * @brief 自分の問い合わせへの応答だけを受け付ける（前の問い合わせへの応答や、他の問い合わせへの応答は受け付けない）
+ */
+void test_origin_check() {
+
+  uint8_t request[NtpPacket::SIZE];
+  uint8_t response[NtpPacket::SIZE];
+  uint8_t origin[8];
+  auto    server = makeServer();
+  int64_t sent   = INT64_C(1700000000) * 1000000;
+
+  makeRequest(request, sent);
+  memcpy(origin, request + NtpPacket::TRANSMIT_TIME, sizeof(origin));
+  NtpPacket::makeResponse(request, sizeof(request), server, sent + 10000, response);
+  TEST_ASSERT_TRUE(NtpPacket::isResponseTo(response, origin));
+
+  // 1 us 違う問い合わせ（前の問い合わせや、他のサーバーへの問い合わせ）への応答
+  uint8_t other[NtpPacket::SIZE];
+  makeRequest(request, sent - 1);
+  NtpPacket::makeResponse(request, sizeof(request), server, sent + 10000, other);
+  TEST_ASSERT_FALSE(NtpPacket::isResponseTo(other, origin));
+
+  // Originate Timestamp のどのビットが違っても受け付けない
+  for (size_t bit = 0; bit < 64; bit++) {
+    uint8_t packet[NtpPacket::SIZE];
+    memcpy(packet, response, sizeof(packet));
+    packet[NtpPacket::ORIGIN_TIME + bit / 8] ^= 1 << (bit % 8);
+    TEST_ASSERT_FALSE(NtpPacket::isResponseTo(packet, origin));
+  }
+}
+
+/**
+ * @brief 要求と応答をやりとりして、クライアントが求めるずれと往復遅延が正しい
+ */
+void test_exchange_offset_and_delay() {
+
+  for (int i = 0; i < 10000; i++) {
+    int64_t  client_error = static_cast<int64_t>(_random() % 2000000001) - 1000000000; // クライアントの時計のずれ
+    uint32_t one_way      = _random() % 100000;
+    uint32_t processing   = _random() % 1000;
+    int64_t  t            = INT64_C(1700000000) * 1000000 + static_cast<int64_t>(_random() % 1000000000000);
+
+    // T1: クライアントの送信（クライアントの時計）
+    uint8_t request[NtpPacket::SIZE];
+    auto    t1 = t + client_error;
+    makeRequest(request, t1);
+
+    // T2, T3: サーバーの受信と送信
+    uint8_t response[NtpPacket::SIZE];
+    t += one_way;
+    TEST_ASSERT_TRUE(NtpPacket::makeResponse(request, sizeof(request), makeServer(), t, response));
+    t += processing;
+    NtpPacket::writeTimestamp(response + NtpPacket::TRANSMIT_TIME, t);
+
+    // T4: クライアントの受信（ receiveNtpResponse() と同じ計算）
+    t += one_way;
+    auto t4 = t + client_error;
+    TEST_ASSERT_EQUAL_INT64(t1, NtpPacket::readTimestamp(response + NtpPacket::ORIGIN_TIME));
+    auto t2 = NtpPacket::readTimestamp(response + NtpPacket::RECEIVE_TIME);
+    auto t3 = NtpPacket::readTimestamp(response + NtpPacket::TRANSMIT_TIME);
+
+    TEST_ASSERT_EQUAL_INT64(-client_error, ((t2 - t1) + (t3 - t4)) / 2);
+    TEST_ASSERT_EQUAL_INT64(2 * one_way, (t4 - t1) - (t3 - t2));
+  }
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_uint32_is_big_endian);
+  RUN_TEST(test_timestamp_known_values);
+  RUN_TEST(test_timestamp_era_rollover);
+  RUN_TEST(test_timestamp_round_trip);
+  RUN_TEST(test_short_format);
+  RUN_TEST(test_make_response);
+  RUN_TEST(test_make_response_rejects);
+  RUN_TEST(test_synced_response);
+  RUN_TEST(test_origin_check);
+  RUN_TEST(test_exchange_offset_and_delay);
+  return UNITY_END();
+}
@@ -0,0 +1,192 @@
+/**
+ * @file test_main.cpp
+ * @brief Scheduler の単体テスト（ pio test -e native ）
+ *
+ * 時刻はテストが進める変数で、アイドル処理は渡された時間だけ時刻を進める（眠ったことにする）。
+ */
+
+#include "Scheduler.h"
+#include <string>
+#include <unity.h>
+#include <vector>
+
+static uint32_t              _now;
+static std::vector<uint32_t> _idles; //! アイドル処理に渡された時間
+
+static Scheduler makeScheduler() {
+  return Scheduler([] { return _now; },
+                   [](uint32_t us) {
+                     _idles.push_back(us);
+                     _now += us;
+                   });
+}
+
+void setUp() {
+  _now = 1000;
+  _idles.clear();
+}
+
+void tearDown() {}
+
+/**
+ * @brief 同じ時刻になったタスクは、登録した順に実行される
+ */
+void test_due_tasks_run_in_registration_order() {
+
+  auto        scheduler = makeScheduler();
+  std::string log;
+
+  scheduler.add([&] { log += 'a'; return 300U; }, 100);
+  scheduler.add([&] { log += 'b'; return 200U; }, 100);
+  scheduler.add([&] { log += 'c'; return 100U; }, 0);
+
+  scheduler.run(); // c（時刻 1000）
+  scheduler.run(); // a, b（時刻 1100）, c（時刻 1100）
+  scheduler.run(); // c（時刻 1200）
+  scheduler.run(); // b, c（時刻 1300）
+  scheduler.run(); // a, c（時刻 1400）
+
+  TEST_ASSERT_EQUAL_STRING("cabccbcac", log.c_str());
+}
+
+/**
+ * @brief タスクは、返した時間だけ後に実行される。それまではアイドル処理が呼ばれる
+ */
+void test_tasks_run_at_requested_interval() {
+
+  auto                  scheduler = makeScheduler();
+  std::vector<uint32_t> fast;
+  std::vector<uint32_t> slow;
+
+  scheduler.add([&] { fast.push_back(_now); return 250000U; });
+  scheduler.add([&] { slow.push_back(_now); return 1000000U; }, 500000);
+
+  while (_now < 1000 + 3000000)
+    scheduler.run();
+
+  TEST_ASSERT_EQUAL(12, fast.size());
+  TEST_ASSERT_EQUAL(3, slow.size());
+  for (size_t i = 1; i < fast.size(); i++)
+    TEST_ASSERT_EQUAL_UINT32(250000, fast[i] - fast[i - 1]);
+  TEST_ASSERT_EQUAL_UINT32(1000 + 500000, slow[0]);
+  for (size_t i = 1; i < slow.size(); i++)
+    TEST_ASSERT_EQUAL_UINT32(1000000, slow[i] - slow[i - 1]);
+
+  // 眠りすぎない
+  for (auto us : _idles)
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(250000, us);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.getLateness());
+}
+
+/**
+ * @brief 時刻（32 ビット）が一周しても、順序と間隔は変わらない
+ */
+void test_clock_wraparound() {
+
+  _now = 0xFFFFFFFFUL - 1000;
+
+  auto                  scheduler = makeScheduler();
+  std::vector<uint32_t> runs;
+  bool                  late_ran = false;
+
+  scheduler.add([&] { runs.push_back(_now); return 300U; });
+  // 一周をまたいだ後の時刻に予定されたタスクが、またぐ前に実行されてはいけない
+  scheduler.add([&] { late_ran = true; TEST_ASSERT_LESS_THAN(0x80000000UL, _now); return Scheduler::MAX_DELAY_US; }, 1500);
+
+  for (int i = 0; i < 10; i++)
+    scheduler.run();
+
+  TEST_ASSERT_TRUE(late_ran);
+  TEST_ASSERT_GREATER_THAN(5, runs.size());
+  for (size_t i = 1; i < runs.size(); i++)
+    TEST_ASSERT_EQUAL_UINT32(300, runs[i] - runs[i - 1]);
+}
+
+/**
+ * @brief MAX_DELAY_US より長い待ち時間は切り詰められる（時刻の比較が一周をまたがない）
+ */
+void test_delay_is_clamped() {
+
+  auto scheduler = makeScheduler();
+  int  count     = 0;
+
+  TEST_ASSERT_TRUE(scheduler.add([&] { count++; return 0xFFFFFFFFU; }, 0xFFFFFFFFU));
+  TEST_ASSERT_EQUAL_UINT32(Scheduler::MAX_DELAY_US, scheduler.untilNext());
+
+  _now += Scheduler::MAX_DELAY_US;
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.untilNext());
+  TEST_ASSERT_EQUAL_UINT32(Scheduler::MAX_DELAY_US, scheduler.runDue());
+  TEST_ASSERT_EQUAL(1, count);
+
+  // 切り詰めた後も、まだ時刻になっていないと判定される
+  _now += Scheduler::MAX_DELAY_US - 1;
+  TEST_ASSERT_EQUAL_UINT32(1, scheduler.untilNext());
+}
+
+/**
+ * @brief 待ち時間 0 を返すタスクも、 runDue() 1 回につき 1 回しか実行されない
+ */
+void test_zero_delay_runs_once_per_pass() {
+
+  auto scheduler = makeScheduler();
+  int  count     = 0;
+
+  scheduler.add([&] { count++; return 0U; });
+
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.runDue());
+  TEST_ASSERT_EQUAL(1, count);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.runDue());
+  TEST_ASSERT_EQUAL(2, count);
+}
+
+/**
+ * @brief 遅れて始まったタスクは getLateness() で分かり、次の予定は実行し終えた時刻から数える
+ */
+void test_lateness() {
+
+  auto     scheduler = makeScheduler();
+  uint32_t lateness  = 0;
+  uint32_t started   = 0;
+
+  // 実行に 700 us かかるタスク
+  scheduler.add([&] { lateness = scheduler.getLateness(); _now += 700; return 1000U; });
+  scheduler.add([&] { lateness = scheduler.getLateness(); started = _now; return 5000U; }, 500);
+
+  // どちらも予定より遅れて runDue() を呼ぶ
+  _now += 600;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL_UINT32(1600 + 700, started);
+  TEST_ASSERT_EQUAL_UINT32(1600 + 700 - 1500, lateness);
+
+  // 1 つ目のタスクは、戻った時刻（ 2300 ）から 1000 us 後
+  TEST_ASSERT_EQUAL_UINT32(1000, scheduler.untilNext());
+
+  _now += 1000;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL_UINT32(0, lateness);
+}
+
+/**
+ * @brief MAX_TASKS 個を超えては登録できない
+ */
+void test_add_fails_when_full() {
+
+  auto scheduler = makeScheduler();
+
+  for (size_t i = 0; i < Scheduler::MAX_TASKS; i++)
+    TEST_ASSERT_TRUE(scheduler.add([] { return 1000U; }));
+  TEST_ASSERT_FALSE(scheduler.add([] { return 1000U; }));
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_due_tasks_run_in_registration_order);
+  RUN_TEST(test_tasks_run_at_requested_interval);
+  RUN_TEST(test_clock_wraparound);
+  RUN_TEST(test_delay_is_clamped);
+  RUN_TEST(test_zero_delay_runs_once_per_pass);
+  RUN_TEST(test_lateness);
+  RUN_TEST(test_add_fails_when_full);
+  return UNITY_END();
+}
@@ -0,0 +1,250 @@
+/**
+ * @file test_main.cpp
+ * @brief SntpResponder の単体テスト（ pio test -e native ）
+ *
+ * 偽のカウンタと偽のクライアントを使い、応答に載る T2 / T3 と、クライアントが求める往復遅延と時刻のずれを調べる。
+ * 同期していないとき、要求が正しくないとき、送れなかったときに捨てた数も調べる。
+ */
+
+#include "NtpPacket.h"
+#include "SntpResponder.h"
+#include <random>
+#include <string.h>
+#include <unity.h>
+
+static std::mt19937 _random;
+
+//! 正しい時刻の起点 [us]（サーバーの時計は正しい時刻を指す）
+static constexpr int64_t EPOCH = INT64_C(1700000000) * 1000000;
+
+//! サーバーのカウンタの現在値（ respond() の中で読まれる）
+static uint64_t _server_counter;
+
+static NtpPacket::server_t makeServer() {
+  return {2, -10, {192, 168, 1, 1}, EPOCH - 1000000, 12345, 6789};
+}
+
+static SntpResponder makeResponder() {
+  return SntpResponder([]() { return _server_counter; }, [](uint64_t counter) { return EPOCH + static_cast<int64_t>(counter); });
+}
+
+/**
+ * @brief クライアントの要求を作る（ sendNtpRequest() と同じ）
+ */
+static void makeRequest(uint8_t *request, int64_t transmit_time) {
+  memset(request, 0, NtpPacket::SIZE);
+  request[0] = 0x23; // LI = 0, VN = 4, Mode = 3 (client)
+  request[2] = 6;    // Poll
+  NtpPacket::writeTimestamp(request + NtpPacket::TRANSMIT_TIME, transmit_time);
+}
+
+/**
+ * @brief 偽のクライアントが 1 回問い合わせた結果
+ */
+struct exchange_t {
+  bool    answered; //! 応答を受け取った
+  int64_t t1;       //! 要求を送った時刻（クライアントの時計）
+  int64_t t2;       //! サーバーが要求を受け取った時刻
+  int64_t t3;       //! サーバーが応答を送った時刻
+  int64_t t4;       //! 応答を受け取った時刻（クライアントの時計）
+  int64_t delay;    //! クライアントが求めた往復遅延 [us]
+  int64_t offset;   //! クライアントが求めた、サーバーの時計とのずれ [us]
+};
+
+/**
+ * @brief 偽のクライアントから問い合わせる
+ *
+ * @param responder 応答するサーバー
+ * @param sent_at 要求を送るときの正しい時刻（ EPOCH からの us ）
+ * @param client_offset クライアントの時計の、正しい時刻からのずれ [us]
+ * @param out_us 要求がサーバーに届くまでの時間 [us]
+ * @param processing_us サーバーが受け取ってから送るまでにかかる時間 [us]
+ * @param back_us 応答がクライアントに届くまでの時間 [us]
+ */
+static exchange_t query(SntpResponder &responder, uint64_t sent_at, int64_t client_offset, uint32_t out_us, uint32_t processing_us, uint32_t back_us) {
+
+  exchange_t result = {};
+  result.t1         = EPOCH + static_cast<int64_t>(sent_at) + client_offset;
+
+  uint8_t request[NtpPacket::SIZE];
+  makeRequest(request, result.t1);
+
+  uint64_t received_at = sent_at + out_us;
+  _server_counter      = received_at + processing_us;
+
+  uint8_t  response[NtpPacket::SIZE];
+  uint8_t  wire[NtpPacket::SIZE];
+  uint64_t departed_at = 0;
+  auto     server      = makeServer();
+  responder.respond(request, sizeof(request), received_at, &server, response, [&]() {
+    memcpy(wire, response, sizeof(wire));
+    departed_at = _server_counter;
+    return true;
+  });
+  if (!departed_at)
+    return result;
+
+  result.answered = true;
+  result.t4       = EPOCH + static_cast<int64_t>(departed_at + back_us) + client_offset;
+
+  // クライアントは自分の送った要求への、同期したサーバーの応答だけを受け付ける
+  TEST_ASSERT_TRUE(NtpPacket::isSyncedResponse(wire, sizeof(wire)));
+  TEST_ASSERT_TRUE(NtpPacket::isResponseTo(wire, request + NtpPacket::TRANSMIT_TIME));
+
+  result.t2     = NtpPacket::readTimestamp(wire + NtpPacket::RECEIVE_TIME);
+  result.t3     = NtpPacket::readTimestamp(wire + NtpPacket::TRANSMIT_TIME);
+  result.delay  = (result.t4 - result.t1) - (result.t3 - result.t2);
+  result.offset = ((result.t2 - result.t1) + (result.t3 - result.t4)) / 2;
+  return result;
+}
+
+void setUp() {
+  _random.seed(1);
+  _server_counter = 0;
+}
+
+void tearDown() {}
+
+/**
+ * @brief T2 は受け取った時刻、T3 は送る直前の時刻で、T3 - T2 は処理にかかった時間になる
+ */
+void test_receive_and_transmit_times() {
+
+  auto responder = makeResponder();
+  auto result    = query(responder, 5000000, 0, 1500, 800, 1500);
+
+  TEST_ASSERT_TRUE(result.answered);
+  TEST_ASSERT_EQUAL_INT64(EPOCH + 5001500, result.t2);
+  TEST_ASSERT_EQUAL_INT64(EPOCH + 5002300, result.t3);
+  TEST_ASSERT_EQUAL_INT64(800, result.t3 - result.t2);
+}
+
+/**
+ * @brief 処理にかかった時間は、クライアントが求める往復遅延に入らない
+ */
+void test_processing_is_excluded_from_delay() {
+
+  auto responder = makeResponder();
+
+  for (uint32_t processing_us : {0u, 1u, 500u, 20000u, 300000u}) {
+    auto result = query(responder, 7000000, 250000, 2000, processing_us, 2000);
+    TEST_ASSERT_TRUE(result.answered);
+    TEST_ASSERT_EQUAL_INT64(processing_us, result.t3 - result.t2);
+    TEST_ASSERT_EQUAL_INT64(4000, result.delay);
+    TEST_ASSERT_EQUAL_INT64(-250000, result.offset);
+  }
+}
+
+/**
+ * @brief 乱数のずれと遅延でも、クライアントが求める往復遅延と時刻のずれは正しい値になる
+ *
+ * 行きと帰りの遅延が違うと、時刻のずれはその差の半分だけずれる（ NTP の原理上の誤差）。
+ */
+void test_random_clients() {
+
+  auto responder = makeResponder();
+
+  for (int i = 0; i < 10000; i++) {
+    uint64_t sent_at       = _random() % 1000000000;
+    int64_t  client_offset = static_cast<int64_t>(_random() % 2000000000) - 1000000000;
+    uint32_t out_us        = _random() % 100000;
+    uint32_t processing_us = _random() % 50000;
+    uint32_t back_us       = _random() % 100000;
+
+    auto result = query(responder, sent_at, client_offset, out_us, processing_us, back_us);
+    TEST_ASSERT_TRUE(result.answered);
+    TEST_ASSERT_EQUAL_INT64(processing_us, result.t3 - result.t2);
+    TEST_ASSERT_EQUAL_INT64(out_us + back_us, result.delay);
+
+    double expected = -client_offset + (static_cast<double>(out_us) - back_us) / 2;
+    TEST_ASSERT_INT64_WITHIN(1, static_cast<int64_t>(expected), result.offset);
+  }
+}
+
+/**
+ * @brief 応答した数と、受け取ってから送るまでの時間の直近の値と最大値を数える
+ */
+void test_turnaround_stats() {
+
+  auto responder = makeResponder();
+
+  static const uint32_t processing[] = {300, 1200, 700};
+  uint64_t              sent_at      = 1000000;
+  for (auto us : processing) {
+    TEST_ASSERT_TRUE(query(responder, sent_at, 0, 1000, us, 1000).answered);
+    TEST_ASSERT_EQUAL_UINT32(us, responder.getStats().last_turnaround_us);
+    sent_at += 1000000;
+  }
+
+  auto &stats = responder.getStats();
+  TEST_ASSERT_EQUAL_UINT32(3, stats.served);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+  TEST_ASSERT_EQUAL_UINT32(700, stats.last_turnaround_us);
+  TEST_ASSERT_EQUAL_UINT32(1200, stats.max_turnaround_us);
+}
+
+/**
+ * @brief 上流と同期していない、応答の領域がない、要求が正しくないときは、送らずに捨てる
+ */
+void test_drops_without_sending() {
+
+  auto    responder = makeResponder();
+  auto    server    = makeServer();
+  uint8_t request[NtpPacket::SIZE];
+  uint8_t response[NtpPacket::SIZE];
+  int     sent = 0;
+  auto    send = [&]() {
+    sent++;
+    return true;
+  };
+
+  makeRequest(request, EPOCH);
+  _server_counter = 100;
+
+  // 同期していない
+  TEST_ASSERT_FALSE(responder.respond(request, sizeof(request), 0, nullptr, response, send));
+  // 応答の領域を用意できなかった
+  TEST_ASSERT_FALSE(responder.respond(request, sizeof(request), 0, &server, nullptr, send));
+  // 短い
+  TEST_ASSERT_FALSE(responder.respond(request, NtpPacket::SIZE - 1, 0, &server, response, send));
+  // Mode = 4 (server)
+  request[0] = 0x24;
+  TEST_ASSERT_FALSE(responder.respond(request, sizeof(request), 0, &server, response, send));
+
+  TEST_ASSERT_EQUAL(0, sent);
+  TEST_ASSERT_EQUAL_UINT32(0, responder.getStats().served);
+  TEST_ASSERT_EQUAL_UINT32(4, responder.getStats().dropped);
+  TEST_ASSERT_EQUAL_UINT32(0, responder.getStats().max_turnaround_us);
+}
+
+/**
+ * @brief 送れなかった応答は、応答した数ではなく捨てた数に入り、時間の統計も変えない
+ */
+void test_send_failure_is_dropped() {
+
+  auto    responder = makeResponder();
+  auto    server    = makeServer();
+  uint8_t request[NtpPacket::SIZE];
+  uint8_t response[NtpPacket::SIZE];
+
+  makeRequest(request, EPOCH);
+  _server_counter = 5000;
+  TEST_ASSERT_FALSE(responder.respond(request, sizeof(request), 0, &server, response, []() { return false; }));
+
+  TEST_ASSERT_EQUAL_UINT32(0, responder.getStats().served);
+  TEST_ASSERT_EQUAL_UINT32(1, responder.getStats().dropped);
+  TEST_ASSERT_EQUAL_UINT32(0, responder.getStats().last_turnaround_us);
+  TEST_ASSERT_EQUAL_UINT32(0, responder.getStats().max_turnaround_us);
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_receive_and_transmit_times);
+  RUN_TEST(test_processing_is_excluded_from_delay);
+  RUN_TEST(test_random_clients);
+  RUN_TEST(test_turnaround_stats);
+  RUN_TEST(test_drops_without_sending);
+  RUN_TEST(test_send_failure_is_dropped);
+  return UNITY_END();
+}
@@ -0,0 +1,198 @@
+/**
+ * @file test_main.cpp
+ * @brief SPIClockTuner の単体テスト（ pio test -e native ）
+ *
+ * setupSPIClock() と同じく Display::loopback() をプローブにして、
+ * 決まった周波数を超えると通信が化けるデイジーチェーンの模型を相手に調整させる。
+ */
+
+#include "display/SPIClockTuner.h"
+#include "setting.h"
+#include <MAX7219Display.h>
+#include <SPI.h>
+#include <deque>
+#include <unity.h>
+
+/**
+ * @brief デイジーチェーンの模型。各デバイスのシフトレジスタ（2 バイト）を通って、最後のデバイスの DOUT から返ってくる
+ */
+class SimulatedChain {
+private:
+  std::deque<uint8_t> _shift;         //! チェーン全体のシフトレジスタ（先頭が DOUT 側）
+  uint32_t            _max_frequency; //! これを超える周波数では、受信データが化ける
+  uint32_t            _error_period;  //! 化ける周波数で、何バイトに 1 回化けるか
+  uint32_t            _bytes = 0;     //! 化ける周波数で受信したバイト数
+
+public:
+  SimulatedChain(size_t device_count, uint32_t max_frequency, uint32_t error_period = 1)
+      : _shift(device_count * 2, 0)
+      , _max_frequency(max_frequency)
+      , _error_period(error_period) {}
+
+  void transfer(const uint8_t *out, uint8_t *in, uint32_t size) {
+
+    for (uint32_t i = 0; i < size; i++) {
+      uint8_t received = _shift.front();
+      _shift.pop_front();
+      _shift.push_back(out[i]);
+
+      if (SPI.frequency > _max_frequency && ++_bytes % _error_period == 0)
+        received ^= 0x01;
+      in[i] = received;
+    }
+  }
+};
+
+static MAX7219::Buffer<32, 16>         _buffer;
+static MAX7219::Display<DisplayLayout> _display(0, _buffer);
+
+/**
+ * @brief setupSPIClock() と同じプローブで、チェーン @c chain に対して周波数を調整する
+ */
+static uint32_t tune(SimulatedChain &chain, uint32_t *max_reliable) {
+
+  SPI.receive = [&chain](const uint8_t *out, uint8_t *in, uint32_t size) {
+    chain.transfer(out, in, size);
+  };
+
+  uint8_t       seed = 0;
+  SPIClockTuner tuner([&seed](uint32_t frequency) {
+    SPI.setFrequency(frequency);
+    return _display.loopback(seed++);
+  });
+
+  uint32_t retval = tuner.tune();
+  *max_reliable   = tuner.getMaxReliable();
+  return retval;
+}
+
+void setUp() {
+  SPI.packets.clear();
+  SPI.frequency = 0;
+}
+
+void tearDown() {
+  SPI.receive = nullptr;
+}
+
+/**
+ * @brief loopback() は、デバイスの個数分遅れて返ってきた検査パターンを確かめる
+ */
+void test_loopback_matches_chain_length() {
+
+  SimulatedChain matched(8, 10000000);
+  SimulatedChain shorter(7, 10000000);
+  SimulatedChain longer(9, 10000000);
+
+  SPI.frequency = 1000000;
+  SPI.receive   = [&](const uint8_t *out, uint8_t *in, uint32_t size) { matched.transfer(out, in, size); };
+  TEST_ASSERT_TRUE(_display.loopback(0x12));
+  TEST_ASSERT_TRUE(_display.loopback(0x34));
+
+  SPI.receive = [&](const uint8_t *out, uint8_t *in, uint32_t size) { shorter.transfer(out, in, size); };
+  TEST_ASSERT_FALSE(_display.loopback(0x12));
+
+  SPI.receive = [&](const uint8_t *out, uint8_t *in, uint32_t size) { longer.transfer(out, in, size); };
+  TEST_ASSERT_FALSE(_display.loopback(0x12));
+}
+
+/**
+ * @brief 検査パターンのアドレス部はすべて OP_NOOP なので、表示は変わらない
+ */
+void test_loopback_sends_only_noop() {
+
+  SimulatedChain chain(8, 10000000);
+  SPI.receive = [&](const uint8_t *out, uint8_t *in, uint32_t size) { chain.transfer(out, in, size); };
+
+  for (int seed = 0; seed < 256; seed++) {
+    _display.loopback(seed);
+    for (size_t i = 0; i < SPI.packets.back().size(); i += 2)
+      TEST_ASSERT_EQUAL(MAX7219::OP_NOOP, SPI.packets.back()[i] & 0x0f);
+  }
+}
+
+/**
+ * @brief 通信できる最高の周波数を見つけ、その半分以下の候補を選ぶ
+ */
+void test_tune_finds_max_reliable() {
+
+  uint32_t max_reliable;
+
+  SimulatedChain chain5m(8, 5000000);
+  TEST_ASSERT_EQUAL_UINT32(2000000, tune(chain5m, &max_reliable));
+  TEST_ASSERT_EQUAL_UINT32(5000000, max_reliable);
+
+  SimulatedChain chain1m(8, 1500000);
+  TEST_ASSERT_EQUAL_UINT32(500000, tune(chain1m, &max_reliable));
+  TEST_ASSERT_EQUAL_UINT32(1000000, max_reliable);
+}
+
+/**
+ * @brief すべての候補で通信できれば、最高の候補の半分を選ぶ
+ */
+void test_tune_all_reliable() {
+
+  uint32_t       max_reliable;
+  SimulatedChain chain(8, 80000000);
+
+  TEST_ASSERT_EQUAL_UINT32(5000000, tune(chain, &max_reliable));
+  TEST_ASSERT_EQUAL_UINT32(SPIClockTuner::CANDIDATES.back(), max_reliable);
+}
+
+/**
+ * @brief 最も低い候補でしか通信できなければ、マージンを取れなくても最も低い候補を選ぶ
+ */
+void test_tune_lowest_only() {
+
+  uint32_t       max_reliable;
+  SimulatedChain chain(8, 100000);
+
+  TEST_ASSERT_EQUAL_UINT32(100000, tune(chain, &max_reliable));
+  TEST_ASSERT_EQUAL_UINT32(100000, max_reliable);
+}
+
+/**
+ * @brief 時々しか化けない周波数も、通信できないものとして扱う
+ */
+void test_tune_rejects_intermittent_errors() {
+
+  uint32_t max_reliable;
+
+  // 100 バイトに 1 回（検査 1 回は 32 バイトで、 16 回検査する）
+  SimulatedChain chain(8, 4000000, 100);
+  TEST_ASSERT_EQUAL_UINT32(2000000, tune(chain, &max_reliable));
+  TEST_ASSERT_EQUAL_UINT32(4000000, max_reliable);
+}
+
+/**
+ * @brief チェーンの長さが合わない（配線の誤りなど）と、どの周波数でも通信できない
+ */
+void test_tune_fails_with_wrong_chain() {
+
+  uint32_t max_reliable;
+
+  SimulatedChain shorter(7, 80000000);
+  TEST_ASSERT_EQUAL_UINT32(0, tune(shorter, &max_reliable));
+  TEST_ASSERT_EQUAL_UINT32(0, max_reliable);
+
+  // MISO が繋がっていない
+  SPI.receive = nullptr;
+  SPIClockTuner tuner([](uint32_t frequency) {
+    SPI.setFrequency(frequency);
+    return _display.loopback(0x5a);
+  });
+  TEST_ASSERT_EQUAL_UINT32(0, tuner.tune());
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_loopback_matches_chain_length);
+  RUN_TEST(test_loopback_sends_only_noop);
+  RUN_TEST(test_tune_finds_max_reliable);
+  RUN_TEST(test_tune_all_reliable);
+  RUN_TEST(test_tune_lowest_only);
+  RUN_TEST(test_tune_rejects_intermittent_errors);
+  RUN_TEST(test_tune_fails_with_wrong_chain);
+  return UNITY_END();
+}
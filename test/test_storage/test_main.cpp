@@ -0,0 +1,218 @@
+/**
+ * @file test_main.cpp
+ * @brief RowMajorStorage と DeviceNativeStorage の単体テストとベンチマーク（ pio test -e native ）
+ *
+ * 同じ描画をした 2 つの Buffer が、同じ内容を持ち、Display から同じデータを送ることを確かめ、
+ * 描画と送信、 getRow() にかかる時間をホスト上で比べる（計測値は表示するだけで、合否には使わない）。
+ */
+
+#include "setting.h"
+#include <MAX7219Display.h>
+#include <SPI.h>
+#include <chrono>
+#include <random>
+#include <unity.h>
+
+using expand = int[];
+
+using RowMajorBuffer = MAX7219::Buffer<32, 16>;
+using NativeBuffer   = MAX7219::Buffer<32, 16, MAX7219::EmptyGraphics, MAX7219::DeviceNativeStorage<32, 16, DisplayLayout>>;
+
+//! 縦向きのデバイスだけの並び（ getRow() が最も重くなる。 DisplayLayout の Display からは、並べ替えて送られる）
+using VerticalLayout = MAX7219::layout_t<
+    MAX7219::setting_t<24, 0, MAX7219::Rotate::Clockwise>,
+    MAX7219::setting_t<16, 0, MAX7219::Rotate::Clockwise>,
+    MAX7219::setting_t<8,  0, MAX7219::Rotate::Clockwise>,
+    MAX7219::setting_t<0,  0, MAX7219::Rotate::Clockwise>,
+    MAX7219::setting_t<0,  8, MAX7219::Rotate::Counterclockwise>,
+    MAX7219::setting_t<8,  8, MAX7219::Rotate::Counterclockwise>,
+    MAX7219::setting_t<16, 8, MAX7219::Rotate::Counterclockwise>,
+    MAX7219::setting_t<24, 8, MAX7219::Rotate::Counterclockwise>>;
+using VerticalBuffer = MAX7219::Buffer<32, 16, MAX7219::EmptyGraphics, MAX7219::DeviceNativeStorage<32, 16, VerticalLayout>>;
+
+/**
+ * @brief 乱数で 1 回描く（ドット、はみ出す矩形の塗りつぶし、消去のいずれか）
+ */
+template <class... TBuffers>
+static void paint(std::mt19937 &random, TBuffers &...buffers) {
+
+  ssize_t x = static_cast<ssize_t>(random() % 40) - 4;
+  ssize_t y = static_cast<ssize_t>(random() % 24) - 4;
+
+  switch (random() % 3) {
+  case 0: {
+    bool is_on = random() & 1;
+    (void)expand{0, (buffers.turnDot(is_on, x, y), 0)...};
+    break;
+  }
+
+  case 1: {
+    size_t   width  = 1 + random() % 16;
+    size_t   height = 1 + random() % 8;
+    uint16_t data[8];
+    for (size_t j = 0; j < height; j++)
+      data[j] = static_cast<uint16_t>(random());
+    (void)expand{0, (buffers.write(data, x, y, width, height), 0)...};
+    break;
+  }
+
+  case 2: {
+    size_t width  = 1 + random() % 12;
+    size_t height = 1 + random() % 6;
+    (void)expand{0, (buffers.clear(x, y, width, height), 0)...};
+    break;
+  }
+  }
+}
+
+/**
+ * @brief 2 つの Buffer の内容が一致するか（ 8 ドットずつ比べる）
+ */
+template <class TExpected, class TActual>
+static void assertSameContents(const TExpected &expected, const TActual &actual) {
+
+  for (size_t y = 0; y < 16; y++)
+    for (size_t x = 0; x < 32; x += 8)
+      TEST_ASSERT_EQUAL_HEX8(expected.getHorizontialFrom(x, y, false), actual.getHorizontialFrom(x, y, false));
+}
+
+/**
+ * @brief 送ったデータを取り出して SPI.packets を空にする
+ */
+static std::vector<std::vector<uint8_t>> takePackets() {
+
+  std::vector<std::vector<uint8_t>> packets;
+  packets.swap(SPI.packets);
+  return packets;
+}
+
+void setUp() {
+  SPI.packets.clear();
+  SPI.record = true;
+}
+
+void tearDown() {}
+
+/**
+ * @brief 同じ描画をすれば、同じ内容になり、send() / sendChanged() で同じデータが送られる
+ */
+void test_storages_are_equivalent() {
+
+  std::mt19937                    random(1);
+  RowMajorBuffer                  row_major;
+  NativeBuffer                    native;
+  VerticalBuffer                  vertical;
+  MAX7219::Display<DisplayLayout> row_major_display(0, row_major);
+  MAX7219::Display<DisplayLayout> native_display(0, native);
+
+  for (int frame = 0; frame < 300; frame++) {
+    for (int i = 0, n = frame % 5; i < n; i++)
+      paint(random, row_major, native, vertical);
+
+    assertSameContents(row_major, native);
+    assertSameContents(row_major, vertical);
+
+    if (frame % 50 == 0) {
+      row_major_display.send();
+      auto expected = takePackets();
+      native_display.send();
+      TEST_ASSERT_TRUE(expected == takePackets());
+    } else {
+      row_major_display.sendChanged();
+      auto expected = takePackets();
+      native_display.sendChanged();
+      TEST_ASSERT_TRUE(expected == takePackets());
+    }
+  }
+}
+
+/**
+ * @brief saveFrame() と loadFrame() で、同じ内容に戻る
+ */
+void test_save_and_load_frame() {
+
+  std::mt19937 random(2);
+  NativeBuffer native;
+  NativeBuffer restored;
+
+  for (int i = 0; i < 50; i++)
+    paint(random, native);
+
+  uint8_t frame[NativeBuffer::FrameBytes];
+  native.saveFrame(frame);
+  restored.loadFrame(frame);
+  assertSameContents(native, restored);
+}
+
+/**
+ * @brief @c func を @c count 回実行して、1 回あたりの時間 [ns] を表示する
+ */
+template <class TFunc>
+static double measure(const char *name, int count, TFunc func) {
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++)
+    func(i);
+  auto   elapsed = std::chrono::steady_clock::now() - start;
+  double ns      = std::chrono::duration<double, std::nano>(elapsed).count() / count;
+
+  char message[128];
+  snprintf(message, sizeof(message), "%-72s %10.1f ns", name, ns);
+  TEST_MESSAGE(message);
+  return ns;
+}
+
+/**
+ * @brief 時計の表示のように、毎フレーム数か所を描き直して送る
+ */
+template <class TBuffer>
+static void benchmarkFrames(const char *name) {
+
+  TBuffer                         buffer;
+  MAX7219::Display<DisplayLayout> display(0, buffer);
+  std::mt19937                    random(3);
+  uint16_t                        glyphs[10][7];
+  for (auto &glyph : glyphs)
+    for (auto &row : glyph)
+      row = static_cast<uint16_t>(random());
+
+  SPI.record = false;
+  display.send();
+
+  std::string label = std::string(name) + " draw + sendChanged()";
+  measure(label.c_str(), 20000, [&](int i) {
+    // 秒の 1 の位は毎回、10 の位は 10 回に 1 回変わる
+    buffer.write(glyphs[i % 10], 26, 9, 5, 7);
+    buffer.write(glyphs[i / 10 % 6], 20, 9, 5, 7);
+    display.sendChanged();
+  });
+
+  label = std::string(name) + " send()";
+  measure(label.c_str(), 20000, [&](int) {
+    display.send();
+  });
+
+  volatile uint32_t sink = 0;
+  label                  = std::string(name) + " getHorizontialFrom() x 64";
+  measure(label.c_str(), 20000, [&](int) {
+    for (size_t y = 0; y < 16; y++)
+      for (size_t x = 0; x < 32; x += 8)
+        sink = sink + buffer.getHorizontialFrom(x, y, false);
+  });
+}
+
+void test_benchmark() {
+
+  benchmarkFrames<RowMajorBuffer>("RowMajorStorage");
+  benchmarkFrames<NativeBuffer>("DeviceNativeStorage");
+  benchmarkFrames<VerticalBuffer>("DeviceNativeStorage (vertical, other layout)");
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_storages_are_equivalent);
+  RUN_TEST(test_save_and_load_frame);
+  RUN_TEST(test_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,259 @@
+/**
+ * @file test_main.cpp
+ * @brief TZTable の単体テスト（ pio test -e native ）
+ *
+ * 設定画面で選べる全ての地域（ TZZones.h ）の timezone 文字列を、TZTable と glibc の両方に与えて、
+ * 切り替え時刻とその前後、ばらばらの時刻で、地方時と時差が一致するかを調べる。
+ */
+
+#include "../native/TZZones.h"
+#include "TZTable.h"
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+static std::mt19937_64 _random;
+
+static void setTZ(const char *tz) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+/**
+ * @brief TZTable の変換結果が、 localtime_r() と一致するか
+ */
+static void assertSame(TZTable &table, time_t t, const char *tz) {
+
+  struct tm expected;
+  localtime_r(&t, &expected);
+
+  bool isdst;
+  auto offset = table.getOffset(t, &isdst);
+  auto actual = table.localtime(t);
+  char message[128];
+  snprintf(message, sizeof(message), "%s at %lld", tz, static_cast<long long>(t));
+
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_gmtoff, offset, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_isdst, isdst, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_sec, actual.tm_sec, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_min, actual.tm_min, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_hour, actual.tm_hour, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_mday, actual.tm_mday, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_mon, actual.tm_mon, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_year, actual.tm_year, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_wday, actual.tm_wday, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_yday, actual.tm_yday, message);
+  TEST_ASSERT_EQUAL_MESSAGE(expected.tm_isdst, actual.tm_isdst, message);
+}
+
+/**
+ * @brief glibc で、時差が変わる最初の時刻を @c begin から @c end の間で二分探索する（ begin と end の時差は違うこと）
+ */
+static time_t findChange(time_t begin, time_t end) {
+
+  struct tm tm;
+  localtime_r(&begin, &tm);
+  long offset = tm.tm_gmtoff;
+
+  while (end - begin > 1) {
+    auto middle = begin + (end - begin) / 2;
+    localtime_r(&middle, &tm);
+    if (tm.tm_gmtoff == offset)
+      begin = middle;
+    else
+      end = middle;
+  }
+  return end;
+}
+
+/**
+ * @brief UTC の年 @c year の間に、glibc で時差が変わる時刻を全て求める
+ */
+static std::vector<time_t> findTransitions(int64_t year) {
+
+  std::vector<time_t> retval;
+  time_t              begin = TZTable::toDays(year, 1, 1) * 86400;
+  time_t              end   = TZTable::toDays(year + 1, 1, 1) * 86400;
+  struct tm           tm;
+
+  localtime_r(&begin, &tm);
+  long offset = tm.tm_gmtoff;
+  for (time_t t = begin + 86400; t <= end; t += 86400) {
+    localtime_r(&t, &tm);
+    if (tm.tm_gmtoff != offset)
+      retval.push_back(findChange(t - 86400, t));
+    offset = tm.tm_gmtoff;
+  }
+  return retval;
+}
+
+void setUp() {
+  _random.seed(1);
+  // glibc が TZ の値をファイル名（ "EST5EDT" など）として読まないよう、POSIX 形式として解釈させる
+  setenv("TZDIR", "/nonexistent", 1);
+}
+
+void tearDown() {
+  setTZ("UTC0");
+}
+
+/**
+ * @brief 設定画面で選べる全ての地域（ TZZones.h ）の timezone 文字列を読める
+ */
+void test_configure_every_zone() {
+
+  TZTable table;
+  for (auto &&zone : TZ_ZONES)
+    TEST_ASSERT_TRUE_MESSAGE(table.configure(zone.posix), zone.name);
+}
+
+/**
+ * @brief 設定画面で選べる全ての地域（ TZZones.h ）で、切り替え時刻の前後と、ばらばらの時刻が glibc と一致する
+ */
+void test_matches_glibc_in_every_zone() {
+
+  // 1970 年から 2060 年までの全ての年と、閏年の規則の境目（ glibc は 1970 年より前には規則を使わないので、比べない）
+  std::vector<int64_t> years;
+  for (int64_t year = 1970; year <= 2060; year++)
+    years.push_back(year);
+  for (int64_t year : {2100, 2104, 2400})
+    years.push_back(year);
+
+  size_t transitions = 0;
+
+  for (auto &&zone : TZ_ZONES) {
+    setTZ(zone.posix);
+    TZTable table;
+    table.configure(zone.posix);
+
+    for (auto year : years) {
+      for (auto at : findTransitions(year)) {
+        for (time_t t = at - 2; t <= at + 2; t++)
+          assertSame(table, t, zone.name);
+        transitions++;
+      }
+
+      // 年の境目
+      time_t begin = TZTable::toDays(year, 1, 1) * 86400;
+      if (year > 1970)
+        assertSame(table, begin - 1, zone.name);
+      assertSame(table, begin, zone.name);
+    }
+
+    // ばらばらの時刻（前回の変換と同じ範囲とは限らない）
+    for (int i = 0; i < 2000; i++) {
+      time_t t = static_cast<time_t>(_random() % (INT64_C(200) * 365 * 86400));
+      assertSame(table, t, zone.name);
+    }
+  }
+
+  TEST_ASSERT_GREATER_THAN(0, transitions);
+}
+
+/**
+ * @brief glibc の拡張（負の時刻、24 時以降の時刻、Jn と n の日付）と、規則のない夏時間も glibc と一致する
+ */
+void test_matches_glibc_extensions() {
+
+  static const char *zones[] = {
+      "EST5EDT",                                 // 規則がなければ M3.2.0,M11.1.0
+      "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",        // 前日の時刻
+      "<+0330>-3:30<+0430>,J79/24,J263/24",      // 24 時
+      "IST-2IDT,M3.4.4/26,M10.5.0",              // 26 時
+      "<-04>4<-03>,M9.1.6/24,M4.1.6/24",         // 南半球
+      "XXX3YYY,0/0,365/25",                      // 0 始まりの日（閏年の 12/31 は 365）
+      "XXX3YYY,J1/0,J365/25",                    // 閏日を数えない日
+      "XXX3YYY,J59,J60",                         // 閏年でも J60 は 3/1
+      "<+00>0<+02>-2,M3.5.0/1,M10.5.0/3",        // 2 時間ずれる
+      "AAA-10:30:15BBB-11:45:30,M10.1.0,M4.1.0", // 秒まである時差
+      "XXX3YYY,M1.1.0/167,M12.5.6/-167",         // 最大の時刻
+  };
+
+  for (auto tz : zones) {
+    setTZ(tz);
+    TZTable table;
+    TEST_ASSERT_TRUE_MESSAGE(table.configure(tz), tz);
+
+    for (int64_t year = 1995; year <= 2030; year++) {
+      for (auto at : findTransitions(year))
+        for (time_t t = at - 2; t <= at + 2; t++)
+          assertSame(table, t, tz);
+    }
+    for (int i = 0; i < 20000; i++) {
+      time_t t = static_cast<time_t>(_random() % (INT64_C(60) * 365 * 86400)) + INT64_C(20) * 365 * 86400;
+      assertSame(table, t, tz);
+    }
+  }
+}
+
+/**
+ * @brief 書式が正しくなければ、UTC とみなす
+ */
+void test_invalid_is_utc() {
+
+  static const char *zones[] = {"", "JST", "AB-9", "JST-9X", "JST-25", "JST-9JDT,M3.2.0", "JST-9JDT,M13.1.0,M11.1.0", "JST-9JDT,M3.6.0,M11.1.0", "JST-9JDT,J0,J100", "<+09-9", "JST-9JDT,M3.2.0/168,M11.1.0"};
+
+  for (auto tz : zones) {
+    TZTable table;
+    TEST_ASSERT_FALSE_MESSAGE(table.configure(tz), tz);
+    TEST_ASSERT_EQUAL_MESSAGE(0, table.getOffset(1700000000), tz);
+  }
+
+  TZTable table;
+  TEST_ASSERT_FALSE(table.configure(nullptr));
+  TEST_ASSERT_EQUAL(0, table.getOffset(1700000000));
+}
+
+/**
+ * @brief 時刻順に変換していけば、表を作り直すのは年が変わるときだけ
+ */
+void test_compiles_once_per_year() {
+
+  TZTable table;
+  table.configure("CET-1CEST,M3.5.0,M10.5.0/3");
+
+  time_t begin = TZTable::toDays(2024, 1, 1) * 86400;
+  for (time_t t = begin; t < begin + 3 * 366 * 86400; t += 600)
+    table.localtime(t);
+
+  TEST_ASSERT_EQUAL(4, table.getCompiles());
+}
+
+/**
+ * @brief toDate() / toDays() / toTime() は、 gmtime_r() / timegm() と一致する
+ */
+void test_date_conversion() {
+
+  for (int i = 0; i < 100000; i++) {
+    time_t t = static_cast<time_t>(_random() % (INT64_C(20000) * 365 * 86400)) - INT64_C(10000) * 365 * 86400;
+
+    struct tm expected;
+    gmtime_r(&t, &expected);
+
+    struct tm actual = {};
+    int64_t   days   = t / 86400 - (t % 86400 < 0 ? 1 : 0);
+    TZTable::toDate(days, &actual);
+    TEST_ASSERT_EQUAL(expected.tm_year, actual.tm_year);
+    TEST_ASSERT_EQUAL(expected.tm_mon, actual.tm_mon);
+    TEST_ASSERT_EQUAL(expected.tm_mday, actual.tm_mday);
+    TEST_ASSERT_EQUAL(expected.tm_wday, actual.tm_wday);
+    TEST_ASSERT_EQUAL(expected.tm_yday, actual.tm_yday);
+
+    TEST_ASSERT_EQUAL(days, TZTable::toDays(expected.tm_year + 1900, expected.tm_mon + 1, expected.tm_mday));
+    TEST_ASSERT_EQUAL(t, TZTable::toTime(expected));
+  }
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_configure_every_zone);
+  RUN_TEST(test_matches_glibc_in_every_zone);
+  RUN_TEST(test_matches_glibc_extensions);
+  RUN_TEST(test_invalid_is_utc);
+  RUN_TEST(test_compiles_once_per_year);
+  RUN_TEST(test_date_conversion);
+  return UNITY_END();
+}
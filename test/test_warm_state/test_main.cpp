@@ -0,0 +1,262 @@
+/**
+ * @file test_main.cpp
+ * @brief WarmState の単体テスト（ pio test -e native ）
+ *
+ * 乱数で作った状態を serialize() / deserialize() で往復させたり、バイト列を壊したりして、
+ * 戻せるもの・戻してはいけないものを調べる。
+ */
+
+#include "WarmState.h"
+#include <random>
+#include <unity.h>
+
+using WarmState::state_t;
+
+static std::mt19937 _random;
+
+/**
+ * @brief 乱数で、正しい状態を作る
+ */
+static state_t makeState(size_t count) {
+
+  state_t state = {};
+  state.synced                   = _random() & 1;
+  state.time                     = 1700000000 + _random() % 100000000;
+  state.usec                     = _random() % 1000000;
+  state.rtc_cycles               = _random();
+  state.rtc_period               = 5 * 4096 + _random() % 8192;
+  state.brightness               = static_cast<int>(_random() % 17) - 1;
+  state.brightness_average       = _random();
+  state.envdata_count            = count;
+  state.ambient_transfered       = count > 0 ? _random() % (count + 1) : 0;
+  state.custom_server_transfered = count > 0 ? _random() % (count + 1) : 0;
+
+  time_t time = state.time - 86400;
+  for (size_t i = 0; i < count; i++) {
+    time += _random() % 600;
+    state.envdatas[i] = {time, (static_cast<int>(_random() % 8000) - 3000) / 100.0f, (_random() % 10000) / 100.0f, (8000 + _random() % 3000) / 10.0f};
+  }
+  return state;
+}
+
+static void assertSameState(const state_t &expected, const state_t &actual) {
+
+  TEST_ASSERT_EQUAL(expected.synced, actual.synced);
+  TEST_ASSERT_EQUAL(expected.time, actual.time);
+  TEST_ASSERT_EQUAL_UINT32(expected.usec, actual.usec);
+  TEST_ASSERT_EQUAL_UINT32(expected.rtc_cycles, actual.rtc_cycles);
+  TEST_ASSERT_EQUAL_UINT32(expected.rtc_period, actual.rtc_period);
+  TEST_ASSERT_EQUAL(expected.brightness, actual.brightness);
+  TEST_ASSERT_EQUAL(expected.brightness_average, actual.brightness_average);
+  TEST_ASSERT_EQUAL(expected.ambient_transfered, actual.ambient_transfered);
+  TEST_ASSERT_EQUAL(expected.custom_server_transfered, actual.custom_server_transfered);
+  TEST_ASSERT_EQUAL(expected.envdata_count, actual.envdata_count);
+
+  // envdata は保存する単位に丸められる
+  for (size_t i = 0; i < expected.envdata_count; i++) {
+    auto &e = expected.envdatas[i];
+    auto &a = actual.envdatas[i];
+    TEST_ASSERT_EQUAL(e.time, a.time);
+    TEST_ASSERT_FLOAT_WITHIN(0.0051f, e.temperature, a.temperature);
+    TEST_ASSERT_FLOAT_WITHIN(0.0051f, e.humidity, a.humidity);
+    TEST_ASSERT_FLOAT_WITHIN(0.051f, e.pressure, a.pressure);
+  }
+}
+
+void setUp() {
+  _random.seed(1);
+}
+
+void tearDown() {}
+
+/**
+ * @brief CRC-32 は、よく知られた検査値になり、分けて計算しても同じ値になる
+ */
+void test_crc32() {
+
+  static const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+  TEST_ASSERT_EQUAL_HEX32(0x00000000, WarmState::crc32(check, 0));
+  TEST_ASSERT_EQUAL_HEX32(0xcbf43926, WarmState::crc32(check, sizeof(check)));
+  TEST_ASSERT_EQUAL_HEX32(0xcbf43926, WarmState::crc32(check + 4, 5, WarmState::crc32(check, 4)));
+
+  static const uint8_t zeros[32] = {};
+  TEST_ASSERT_EQUAL_HEX32(0x190a55ad, WarmState::crc32(zeros, sizeof(zeros)));
+}
+
+/**
+ * @brief serialize() したものを deserialize() すると、元の状態に戻る
+ */
+void test_round_trip() {
+
+  uint8_t buffer[WarmState::MAX_SIZE];
+
+  for (int i = 0; i < 1000; i++) {
+    size_t count = i % (WarmState::MAX_ENVDATAS + 1);
+    auto   state = makeState(count);
+
+    auto size = WarmState::serialize(state, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL(WarmState::HEADER_SIZE + WarmState::FIXED_SIZE + count * WarmState::ENVDATA_SIZE, size);
+
+    state_t restored;
+    TEST_ASSERT_TRUE(WarmState::deserialize(buffer, size, &restored));
+    assertSameState(state, restored);
+
+    // もう一度 serialize() しても、同じバイト列になる
+    uint8_t again[WarmState::MAX_SIZE];
+    TEST_ASSERT_EQUAL(size, WarmState::serialize(restored, again, sizeof(again)));
+    TEST_ASSERT_EQUAL_MEMORY(buffer, again, size);
+  }
+}
+
+/**
+ * @brief envdata を最大数まで入れても MAX_SIZE に収まり、それより多ければ serialize() できない
+ */
+void test_max_envdatas() {
+
+  uint8_t buffer[WarmState::MAX_SIZE + 64];
+  auto    state = makeState(WarmState::MAX_ENVDATAS);
+
+  auto size = WarmState::serialize(state, buffer, WarmState::MAX_SIZE);
+  TEST_ASSERT_GREATER_THAN(0, size);
+  TEST_ASSERT_LESS_OR_EQUAL(WarmState::MAX_SIZE, size);
+
+  state.envdata_count = WarmState::MAX_ENVDATAS + 1;
+  TEST_ASSERT_EQUAL(0, WarmState::serialize(state, buffer, sizeof(buffer)));
+
+  // buffer が 1 バイトでも足りなければ書かない
+  state.envdata_count = WarmState::MAX_ENVDATAS;
+  TEST_ASSERT_EQUAL(0, WarmState::serialize(state, buffer, size - 1));
+}
+
+/**
+ * @brief 正しくない状態は serialize() できない
+ */
+void test_serialize_rejects_invalid_state() {
+
+  uint8_t buffer[WarmState::MAX_SIZE];
+
+  auto state               = makeState(5);
+  state.ambient_transfered = 6;
+  TEST_ASSERT_EQUAL(0, WarmState::serialize(state, buffer, sizeof(buffer)));
+
+  state                          = makeState(5);
+  state.custom_server_transfered = 6;
+  TEST_ASSERT_EQUAL(0, WarmState::serialize(state, buffer, sizeof(buffer)));
+
+  // 最初の envdata より古い envdata
+  state                  = makeState(5);
+  state.envdatas[3].time = state.envdatas[0].time - 1;
+  TEST_ASSERT_EQUAL(0, WarmState::serialize(state, buffer, sizeof(buffer)));
+
+  // 時刻の差が 32 ビットに収まらない
+  state                  = makeState(5);
+  state.envdatas[4].time = state.envdatas[0].time + INT64_C(0x100000000);
+  TEST_ASSERT_EQUAL(0, WarmState::serialize(state, buffer, sizeof(buffer)));
+}
+
+/**
+ * @brief どの 1 ビットが反転しても、deserialize() は失敗し、状態を書き換えない
+ */
+void test_every_bit_flip_is_rejected() {
+
+  uint8_t buffer[WarmState::MAX_SIZE];
+  auto    state = makeState(WarmState::MAX_ENVDATAS);
+  auto    size  = WarmState::serialize(state, buffer, sizeof(buffer));
+
+  state_t untouched = makeState(1);
+  for (size_t i = 0; i < size * 8; i++) {
+    buffer[i / 8] ^= 1 << (i % 8);
+
+    state_t restored = untouched;
+    if (WarmState::deserialize(buffer, size, &restored)) {
+      char message[32];
+      snprintf(message, sizeof(message), "bit %zu", i);
+      TEST_FAIL_MESSAGE(message);
+    }
+    assertSameState(untouched, restored);
+
+    buffer[i / 8] ^= 1 << (i % 8);
+  }
+
+  state_t restored;
+  TEST_ASSERT_TRUE(WarmState::deserialize(buffer, size, &restored));
+}
+
+/**
+ * @brief 電源投入後の RTC メモリ（ 0 や乱数）や、途中で切れたバイト列は戻さない
+ */
+void test_garbage_is_rejected() {
+
+  uint8_t buffer[WarmState::MAX_SIZE];
+  state_t state;
+
+  memset(buffer, 0, sizeof(buffer));
+  TEST_ASSERT_FALSE(WarmState::deserialize(buffer, sizeof(buffer), &state));
+  memset(buffer, 0xff, sizeof(buffer));
+  TEST_ASSERT_FALSE(WarmState::deserialize(buffer, sizeof(buffer), &state));
+
+  for (int i = 0; i < 1000; i++) {
+    for (auto &b : buffer)
+      b = _random();
+    TEST_ASSERT_FALSE(WarmState::deserialize(buffer, sizeof(buffer), &state));
+  }
+
+  auto size = WarmState::serialize(makeState(10), buffer, sizeof(buffer));
+  TEST_ASSERT_FALSE(WarmState::deserialize(buffer, size - 1, &state));
+  TEST_ASSERT_FALSE(WarmState::deserialize(buffer, WarmState::HEADER_SIZE - 1, &state));
+  TEST_ASSERT_TRUE(WarmState::deserialize(buffer, size, &state));
+}
+
+/**
+ * @brief CRC が合っていても、値が正しくなければ戻さない
+ */
+void test_invalid_values_are_rejected() {
+
+  uint8_t buffer[WarmState::MAX_SIZE];
+  state_t state;
+
+  // usec を 1000000 にして、CRC を計算し直す
+  auto size = WarmState::serialize(makeState(3), buffer, sizeof(buffer));
+  auto usec = buffer + WarmState::HEADER_SIZE + 4;
+  usec[0] = 1000000 & 0xff;
+  usec[1] = (1000000 >> 8) & 0xff;
+  usec[2] = (1000000 >> 16) & 0xff;
+  usec[3] = 0;
+
+  uint32_t crc = WarmState::crc32(buffer, WarmState::HEADER_SIZE - 4);
+  crc          = WarmState::crc32(buffer + WarmState::HEADER_SIZE, size - WarmState::HEADER_SIZE, crc);
+  for (size_t i = 0; i < 4; i++)
+    buffer[WarmState::HEADER_SIZE - 4 + i] = crc >> (8 * i);
+
+  TEST_ASSERT_FALSE(WarmState::deserialize(buffer, size, &state));
+}
+
+/**
+ * @brief 経過時間は、RTC のカウンタが一周していても求められる
+ */
+void test_elapsed_us() {
+
+  state_t state    = {};
+  state.rtc_cycles = 0xfffff000;
+  state.rtc_period = static_cast<uint32_t>(5.75 * 4096); // 1 カウント 5.75 us
+
+  TEST_ASSERT_EQUAL_UINT64(0, WarmState::elapsedUs(state, 0xfffff000));
+  TEST_ASSERT_EQUAL_UINT64(5750, WarmState::elapsedUs(state, 0xfffff000 + 1000));
+  // 一周をまたぐ
+  TEST_ASSERT_EQUAL_UINT64(static_cast<uint64_t>(0x1000 + 1000000) * 23 / 4, WarmState::elapsedUs(state, 1000000));
+}
+
+int main(int argc, char **argv) {
+
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32);
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_max_envdatas);
+  RUN_TEST(test_serialize_rejects_invalid_state);
+  RUN_TEST(test_every_bit_flip_is_rejected);
+  RUN_TEST(test_garbage_is_rejected);
+  RUN_TEST(test_invalid_values_are_rejected);
+  RUN_TEST(test_elapsed_us);
+  return UNITY_END();
+}
@@ -7,6 +7,7 @@
 2. 二分探索法によるルックアップテーブルをコード生成して、(../src/TZDB.h)
    a. 設定画面 HTML から POST されてきた地域名/都市名を検証する。
    b. 地域名/都市名の組から、<TZ.h> にある timezone 文字列を辞書引きする。
+3. 単体テストのために、全ての地域名/都市名と timezone 文字列の表を生成する。(../test/native/TZZones.h)
 
 2. について
 std::unordered_map を使いたいところだが、PROGMEM できない……
@@ -27,8 +28,10 @@ with io.StringIO(rawdata) as f:
   zones = csv.reader(f, delimiter=',', quotechar='"')
 
   cities = {}
+  rows = []
 
   for row in zones:
+    rows.append(row)
     area, city = row[0].split('/', 1)
     if area not in cities:
       cities[area] = [city]
@@ -119,4 +122,28 @@ PGM_P TZDB::getTZ(const String &area, const String &city) {
 ''')
 
   f.write('const size_t TZDB::area_maxlength = %d;\n' % (area_maxlength + 1))
-  f.write('const size_t TZDB::city_maxlength = %d;\n' % (city_maxlength + 1))
\ No newline at end of file
+  f.write('const size_t TZDB::city_maxlength = %d;\n' % (city_maxlength + 1))
+
+with open('../test/native/TZZones.h', 'w') as f:
+  f.write('''// auto-generated by script tools/TZupdate.py
+// DO NOT EDIT BY HAND
+//
+// src/TZDB.cpp と同じ zones.csv から作った、全ての地域名/都市名と timezone 文字列の表（単体テスト用）
+// via: https://raw.githubusercontent.com/nayarsystems/posix_tz_db/master/zones.csv
+
+#ifndef TZZones_H_
+#define TZZones_H_
+
+struct tz_zone_t {
+  const char *name;  //! 地域名/都市名
+  const char *posix; //! timezone 文字列
+};
+
+static const tz_zone_t TZ_ZONES[] = {
+''')
+  for row in rows:
+    f.write('    {"%s", "%s"},\n' % (row[0], row[1]))
+  f.write('''};
+
+#endif // TZZones_H_
+''')
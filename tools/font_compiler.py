@@ -0,0 +1,305 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+fonts ディレクトリ内のビットマップフォントを、MyGraphics 用の PROGMEM グリフ配列に変換するスクリプト。
+Build/Upload の前に自動的に実行されるほか、単体でも実行できる（python3 tools/font_compiler.py）。
+
+入力（1 ファイル = 1 サイズ。同じサイズのフォントを複数置くことはできない）
+  *.bdf  BDF 形式。セルの大きさは FONTBOUNDINGBOX から取る。
+  *.png  グリフを左上から横方向に敷き詰めた画像。ファイル名の末尾を "<幅>x<高さ>.png" とし、
+         同名の .txt（UTF-8）に、画像に並んでいる順に文字を書いておく。暗い不透明なドットが ON。
+
+出力: src/display/glyph-data.h（MyGraphics.cpp から include される）
+  - glyph<幅>x<高さ>[]         グリフ本体。1 行 = 1 要素で、Buffer::write() がそのまま受け取れる右詰めのビット列
+  - glyph<幅>x<高さ>_others[]  索引。数字は配列の先頭に '0' から並べるので、それ以外の文字だけを昇順に持つ
+  - MyGraphics::tryGetGlyph<幅, 高さ> の特殊化
+"""
+
+import io, os, re, sys, struct, zlib
+
+try:
+  Import("env")
+  project_dir = env.subst("$PROJECT_DIR")
+except NameError:
+  project_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+fonts_dir = os.path.join(project_dir, 'fonts')
+output_path = os.path.join(project_dir, 'src', 'display', 'glyph-data.h')
+
+# Buffer::writeChar() は uint8_t の配列でグリフを受け取るので、幅は 8 ドットまで
+MAX_WIDTH = 8
+
+header = """// auto-generated by script tools/font_compiler.py
+// DO NOT EDIT BY HAND
+
+// MyGraphics.cpp から 1 回だけ include される
+
+#ifndef ESP8266Clock_glyph_data_H_
+#define ESP8266Clock_glyph_data_H_
+"""
+
+footer = """
+#endif // ESP8266Clock_glyph_data_H_
+"""
+
+
+class FontError(Exception):
+  pass
+
+
+class Font:
+  """1 サイズ分のグリフ。glyphs は {文字: [行, ...]}、行は右詰めのビット列"""
+
+  def __init__(self, source, width, height):
+    self.source = source
+    self.width = width
+    self.height = height
+    self.glyphs = {}
+
+  def add(self, c, rows):
+    if c in self.glyphs:
+      raise FontError('%s: duplicated glyph U+%04X' % (self.source, ord(c)))
+    if ord(c) > 0xFFFF:
+      raise FontError('%s: U+%04X is out of char16_t' % (self.source, ord(c)))
+    self.glyphs[c] = rows
+
+
+def load_bdf(path):
+  """BDF ファイルを読み込む"""
+  with open(path, 'r', encoding='utf-8', errors='replace') as f:
+    lines = [line.strip() for line in f]
+
+  font = None
+  i = 0
+  while i < len(lines):
+    words = lines[i].split()
+    i += 1
+    if not words:
+      continue
+
+    if words[0] == 'FONTBOUNDINGBOX':
+      fbb_w, fbb_h, fbb_x, fbb_y = map(int, words[1:5])
+      font = Font(path, fbb_w, fbb_h)
+
+    elif words[0] == 'STARTCHAR':
+      if font is None:
+        raise FontError('%s: FONTBOUNDINGBOX is missing' % (path))
+
+      encoding = dwidth = bbx = None
+      while not lines[i].startswith('BITMAP'):
+        props = lines[i].split()
+        if props[0] == 'ENCODING':
+          encoding = int(props[1])
+        elif props[0] == 'DWIDTH':
+          dwidth = int(props[1])
+        elif props[0] == 'BBX':
+          bbx = list(map(int, props[1:5]))
+        i += 1
+      i += 1
+
+      bitmap = []
+      while lines[i] != 'ENDCHAR':
+        bitmap.append(int(lines[i], 16))
+        i += 1
+      i += 1
+
+      if encoding is None or encoding < 0:
+        continue
+      if bbx is None:
+        bbx = [font.width, font.height, fbb_x, fbb_y]
+      # Buffer は固定ピッチで文字を並べるので、送り幅はセルの幅と同じでなければならない
+      if dwidth is not None and dwidth != font.width:
+        raise FontError('%s: U+%04X has DWIDTH %d (expected %d)' % (path, encoding, dwidth, font.width))
+
+      # BBX の位置に合わせて、グリフをセルの中に置く
+      bb_w, bb_h, bb_x, bb_y = bbx
+      top = (fbb_y + fbb_h) - (bb_y + bb_h)
+      left = bb_x - fbb_x
+      row_bits = (bb_w + 7) // 8 * 8
+      rows = [0] * font.height
+      for r, bits in enumerate(bitmap[:bb_h]):
+        y = top + r
+        for col in range(bb_w):
+          x = left + col
+          if (bits >> (row_bits - 1 - col)) & 1:
+            if not (0 <= x < font.width and 0 <= y < font.height):
+              raise FontError('%s: U+%04X does not fit in the bounding box' % (path, encoding))
+            rows[y] |= 1 << (font.width - 1 - x)
+      font.add(chr(encoding), rows)
+
+  if font is None:
+    raise FontError('%s: not a BDF file' % (path))
+  return font
+
+
+def read_png(path):
+  """PNG（8 ビット、インターレース無し）を読み込み、(幅, 高さ, ドットが ON かを返す関数) を返す"""
+  with open(path, 'rb') as f:
+    data = f.read()
+  if data[:8] != b'\x89PNG\r\n\x1a\n':
+    raise FontError('%s: not a PNG file' % (path))
+
+  pos = 8
+  idat = b''
+  while pos < len(data):
+    length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+    body = data[pos + 8:pos + 8 + length]
+    pos += 12 + length
+    if kind == b'IHDR':
+      width, height, depth, color, _, _, interlace = struct.unpack('>IIBBBBB', body)
+    elif kind == b'IDAT':
+      idat += body
+    elif kind == b'IEND':
+      break
+
+  channels = {0: 1, 2: 3, 4: 2, 6: 4}.get(color)
+  if depth != 8 or channels is None or interlace:
+    raise FontError('%s: only 8-bit non-interlaced gray/RGB(A) PNG is supported' % (path))
+
+  raw = zlib.decompress(idat)
+  stride = width * channels
+  pixels = []
+  prev = bytearray(stride)
+  for y in range(height):
+    kind = raw[y * (stride + 1)]
+    line = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+    for x in range(stride):
+      a = line[x - channels] if x >= channels else 0
+      b = prev[x]
+      c = prev[x - channels] if x >= channels else 0
+      if kind == 1:
+        line[x] = (line[x] + a) & 0xFF
+      elif kind == 2:
+        line[x] = (line[x] + b) & 0xFF
+      elif kind == 3:
+        line[x] = (line[x] + (a + b) // 2) & 0xFF
+      elif kind == 4:
+        p = a + b - c
+        pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+        line[x] = (line[x] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 0xFF
+    pixels.append(line)
+    prev = line
+
+  def is_on(x, y):
+    px = pixels[y][x * channels:(x + 1) * channels]
+    gray = px[0] if channels <= 2 else (px[0] * 299 + px[1] * 587 + px[2] * 114) // 1000
+    alpha = px[-1] if channels in (2, 4) else 255
+    return alpha >= 128 and gray < 128
+
+  return width, height, is_on
+
+
+def load_png(path):
+  """PNG ファイルと、同名の .txt を読み込む"""
+  m = re.search(r'(\d+)x(\d+)\.png$', path)
+  if not m:
+    raise FontError('%s: file name must end with "<width>x<height>.png"' % (path))
+  width, height = int(m.group(1)), int(m.group(2))
+
+  with open(path[:-4] + '.txt', 'r', encoding='utf-8') as f:
+    chars = ''.join(f.read().split())
+
+  image_w, image_h, is_on = read_png(path)
+  columns = image_w // width
+  if columns == 0 or len(chars) > columns * (image_h // height):
+    raise FontError('%s: image is too small for %d glyphs' % (path, len(chars)))
+
+  font = Font(path, width, height)
+  for i, c in enumerate(chars):
+    left, top = (i % columns) * width, (i // columns) * height
+    rows = []
+    for y in range(height):
+      row = 0
+      for x in range(width):
+        row = (row << 1) | (1 if is_on(left + x, top + y) else 0)
+      rows.append(row)
+    font.add(c, rows)
+  return font
+
+
+def char_comment(c):
+  """行コメントに書く文字（行末の \\ は次の行をコメントにしてしまうので避ける）"""
+  return 'U+%04X' % (ord(c)) if c == '\\' or not c.isprintable() else c
+
+
+def char_literal(c):
+  return "u'\\u%04x'" % (ord(c)) if c in "\\'" or not c.isprintable() else "u'%s'" % (c)
+
+
+def write_font(f, font):
+  """1 サイズ分の配列と tryGetGlyph を書き出す"""
+  w, h = font.width, font.height
+  if not (0 < w <= MAX_WIDTH):
+    raise FontError('%s: width must be 1..%d' % (font.source, MAX_WIDTH))
+
+  # 数字は '0' から連続している分だけを先頭に並べ、残りは文字コード順にする
+  digits = 0
+  while str(digits) in font.glyphs and digits < 10:
+    digits += 1
+  order = [str(i) for i in range(digits)]
+  others = sorted(c for c in font.glyphs if c not in order)
+  order += others
+
+  source = os.path.relpath(font.source, project_dir).replace('\\', '/')
+  f.write('\n/// %dx%d サイズの文字グリフ（%s）\n' % (w, h, source))
+  f.write('static const uint8_t glyph%dx%d[] PROGMEM = {\n' % (w, h))
+  for n, c in enumerate(order):
+    if n > 0:
+      f.write('\n')
+    for r, row in enumerate(font.glyphs[c]):
+      line = '    0b%s,' % (format(row, '0%db' % (w)))
+      f.write(line + (' // %s\n' % (char_comment(c)) if r == 0 else '\n'))
+  f.write('};\n\n')
+
+  if others:
+    f.write('/// glyph%dx%d のうち、数字以外の文字\n' % (w, h))
+    f.write('static constexpr glyph_entry_t glyph%dx%d_others[] PROGMEM = {\n' % (w, h))
+    for c in others:
+      f.write('    {%s, %d},\n' % (char_literal(c), order.index(c)))
+    f.write('};\n\n')
+    f.write('FUNCDEF_GETGLYPH(%d, %d, %d);\n' % (w, h, digits))
+  else:
+    f.write('FUNCDEF_GETGLYPH_DIGITS(%d, %d, %d);\n' % (w, h, digits))
+
+
+def compile_fonts():
+  fonts = {}
+  for name in sorted(os.listdir(fonts_dir)):
+    path = os.path.join(fonts_dir, name)
+    if name.endswith('.bdf'):
+      font = load_bdf(path)
+    elif name.endswith('.png'):
+      font = load_png(path)
+    else:
+      continue
+
+    size = (font.width, font.height)
+    if size in fonts:
+      raise FontError('%s: size %dx%d is already defined by %s' % (path, size[0], size[1], fonts[size].source))
+    fonts[size] = font
+    print("Compiling font %s" % (path))
+
+  text = header
+  for size in sorted(fonts, key=lambda s: (s[1], s[0])):
+    with io.StringIO() as buf:
+      write_font(buf, fonts[size])
+      text += buf.getvalue()
+  text += footer
+
+  # 内容が変わらない時は書き込まない（MyGraphics.cpp の再コンパイルを避ける）
+  if os.path.isfile(output_path):
+    with open(output_path, 'r', encoding='utf-8') as f:
+      if f.read() == text:
+        return
+  with open(output_path, 'w', encoding='utf-8', newline='\n') as f:
+    f.write(text)
+
+
+try:
+  compile_fonts()
+except FontError as e:
+  sys.stderr.write('Error: %s\n' % (e))
+  if 'env' in globals():
+    env.Exit(1)
+  sys.exit(1)